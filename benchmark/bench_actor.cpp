@@ -42,6 +42,7 @@ class ActorTraits<TestActor> {
  public:
   static constexpr bool need_context = false;
   static constexpr bool need_start_up = true;
+  static constexpr bool is_stealable = false;
 };
 }  // namespace td
 
@@ -324,6 +325,111 @@ class QueryBench final : public td::Benchmark {
   td::ActorOwn<ServerActor> server_;
 };
 
+class StealingManagerActor final : public td::Actor {
+ public:
+  int left_worker_n = 0;
+
+  void on_worker_finished(td::uint32 value) {
+    td::do_not_optimize_away(value);
+    if (--left_worker_n == 0) {
+      td::Scheduler::instance()->finish();
+    }
+  }
+};
+
+class StealingWorkerActor final : public td::Actor {
+ public:
+  td::ActorId<StealingManagerActor> manager;
+
+  void run(int n) {
+    left_n_ = n;
+    loop();
+  }
+
+ private:
+  int left_n_ = 0;
+  td::uint32 value_ = 1;
+
+  void start_up() final {
+  }
+
+  void loop() final {
+    if (left_n_ == 0) {
+      send_closure(manager, &StealingManagerActor::on_worker_finished, value_);
+      return;
+    }
+    left_n_--;
+    for (int i = 0; i < 10000; i++) {
+      value_ = value_ * 1664525 + 1013904223;
+    }
+    // return to the scheduler after each task, so the actor can be stolen while waiting in the ready list
+    yield();
+  }
+};
+
+namespace td {
+template <>
+class ActorTraits<StealingWorkerActor> {
+ public:
+  static constexpr bool need_context = false;
+  static constexpr bool need_start_up = true;
+  static constexpr bool is_stealable = true;
+};
+}  // namespace td
+
+class StealingBench final : public td::Benchmark {
+  static constexpr int WORKER_COUNT = 64;
+
+  int thread_n_ = -1;
+  bool use_stealing_ = false;
+  td::vector<td::ActorId<StealingWorkerActor>> workers_;
+  td::unique_ptr<td::ConcurrentScheduler> scheduler_;
+
+ public:
+  StealingBench(int thread_n, bool use_stealing) : thread_n_(thread_n), use_stealing_(use_stealing) {
+  }
+
+  td::string get_description() const final {
+    return PSTRING() << "Stealing (threads_n = " << thread_n_ << ", stealing = " << use_stealing_ << ")";
+  }
+
+  void start_up() final {
+    scheduler_ = td::make_unique<td::ConcurrentScheduler>(thread_n_, 0);
+    if (use_stealing_) {
+      scheduler_->enable_work_stealing();
+    }
+
+    auto manager = scheduler_->create_actor_unsafe<StealingManagerActor>(0, "StealingManagerActor").release();
+    manager.get_actor_unsafe()->left_worker_n = WORKER_COUNT;
+
+    // all workers are created on the same scheduler; only work stealing can spread them
+    workers_.clear();
+    for (int i = 0; i < WORKER_COUNT; i++) {
+      workers_.push_back(
+          scheduler_->create_actor_unsafe<StealingWorkerActor>(thread_n_ ? 1 : 0, "StealingWorkerActor").release());
+      workers_.back().get_actor_unsafe()->manager = manager;
+    }
+    scheduler_->start();
+  }
+
+  void run(int n) final {
+    {
+      auto guard = scheduler_->get_main_guard();
+      for (auto &worker : workers_) {
+        send_closure(worker, &StealingWorkerActor::run, td::max(n / WORKER_COUNT, 1));
+      }
+    }
+    while (scheduler_->run_main(10)) {
+      // empty
+    }
+  }
+
+  void tear_down() final {
+    scheduler_->finish();
+    scheduler_.reset();
+  }
+};
+
 int main() {
   td::init_openssl_threads();
 
@@ -346,4 +452,10 @@ int main() {
   bench(RingBench<0>(504, 2));
   bench(RingBench<1>(504, 2));
   bench(RingBench<2>(504, 2));
+  bench(StealingBench(0, false));
+  bench(StealingBench(4, false));
+  bench(StealingBench(1, true));
+  bench(StealingBench(2, true));
+  bench(StealingBench(4, true));
+  bench(StealingBench(8, true));
 }
@@ -0,0 +1,102 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/utils/benchmark.h"
+#include "td/utils/common.h"
+#include "td/utils/Hints.h"
+#include "td/utils/logging.h"
+#include "td/utils/port/Clocks.h"
+#include "td/utils/port/Stat.h"
+#include "td/utils/Random.h"
+#include "td/utils/SliceBuilder.h"
+#include "td/utils/utf8.h"
+
+static constexpr td::int32 NAME_COUNT = 1000000;
+
+static td::string gen_word(td::Random::Xorshift128plus &rnd) {
+  static const char *syllables[] = {"al", "an", "ar", "da", "el", "en", "ex", "ia", "ik", "in", "ka", "la", "ma",
+                                    "na", "ne", "ni", "ol", "on", "ra", "ri", "sa", "se", "ta", "to", "va", "ya",
+                                    "ан", "ва", "да", "ей", "ка", "ли", "на", "ов", "ра", "се", "та", "юр"};
+  static constexpr int SYLLABLE_COUNT = static_cast<int>(sizeof(syllables) / sizeof(*syllables));
+  td::string word;
+  auto length = rnd.fast(2, 5);
+  for (int i = 0; i < length; i++) {
+    word += syllables[rnd.fast(0, SYLLABLE_COUNT - 1)];
+  }
+  return word;
+}
+
+static td::string gen_name(td::Random::Xorshift128plus &rnd) {
+  auto name = gen_word(rnd);
+  if (rnd.fast(0, 3) != 0) {
+    name += ' ';
+    name += gen_word(rnd);
+  }
+  return name;
+}
+
+static void fill_hints(td::Hints &hints) {
+  td::Random::Xorshift128plus rnd(123);
+  for (td::int32 i = 1; i <= NAME_COUNT; i++) {
+    hints.add(i, gen_name(rnd));
+    hints.set_rating(i, rnd.fast(-1000000, 0));
+  }
+}
+
+class HintsSearchBench final : public td::Benchmark {
+ public:
+  HintsSearchBench(td::Hints &hints, bool allow_typos, bool is_long_query)
+      : hints_(hints), allow_typos_(allow_typos), is_long_query_(is_long_query) {
+  }
+
+  td::string get_description() const final {
+    return PSTRING() << "Hints search for " << (is_long_query_ ? "long" : "short") << " queries"
+                     << (allow_typos_ ? " with typos" : "");
+  }
+
+  void start_up() final {
+    hints_.set_allow_typos(allow_typos_);
+    td::Random::Xorshift128plus rnd(456);
+    queries_.clear();
+    for (int i = 0; i < 1000; i++) {
+      queries_.push_back(td::utf8_truncate(gen_name(rnd), is_long_query_ ? 8 : 3));
+    }
+  }
+
+  void run(int n) final {
+    size_t total_size = 0;
+    for (int i = 0; i < n; i++) {
+      total_size += hints_.search(queries_[i % queries_.size()], 10).first;
+    }
+    td::do_not_optimize_away(total_size);
+  }
+
+  void tear_down() final {
+    hints_.set_allow_typos(false);
+  }
+
+ private:
+  td::Hints &hints_;
+  bool allow_typos_;
+  bool is_long_query_;
+  td::vector<td::string> queries_;
+};
+
+int main() {
+  SET_VERBOSITY_LEVEL(VERBOSITY_NAME(WARNING));
+
+  auto start_memory = td::mem_stat().move_as_ok().resident_size_;
+  auto start_time = td::Clocks::monotonic();
+  td::Hints hints;
+  fill_hints(hints);
+  auto used_memory = td::mem_stat().move_as_ok().resident_size_ - start_memory;
+  LOG(PLAIN) << "Added " << NAME_COUNT << " names in " << td::Clocks::monotonic() - start_time << " seconds; "
+             << used_memory / NAME_COUNT << " bytes per name";
+
+  td::bench(HintsSearchBench(hints, false, false));
+  td::bench(HintsSearchBench(hints, false, true));
+  td::bench(HintsSearchBench(hints, true, true));
+}
@@ -0,0 +1,119 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/td_api.h"
+#include "td/telegram/td_api_json.h"
+
+#include "td/tl/tl_json.h"
+
+#include "td/utils/benchmark.h"
+#include "td/utils/common.h"
+#include "td/utils/JsonBuilder.h"
+#include "td/utils/logging.h"
+#include "td/utils/SliceBuilder.h"
+#include "td/utils/Status.h"
+#include "td/utils/StringBuilder.h"
+
+static td::string get_formatted_text_json(int entity_count) {
+  td::StringBuilder sb(td::MutableSlice(), true);
+  sb << "{\"@type\":\"formattedText\",\"text\":\"";
+  for (int i = 0; i < entity_count; i++) {
+    sb << "Some \\\"bold\\\" text with \\u00e9scapes and a link to https://telegram.org\\n";
+  }
+  sb << "\",\"entities\":[";
+  for (int i = 0; i < entity_count; i++) {
+    if (i != 0) {
+      sb << ',';
+    }
+    sb << "{\"@type\":\"textEntity\",\"offset\":" << i * 70 + 5 << ",\"length\":10,\"type\":{\"@type\":\""
+       << (i % 2 == 0 ? "textEntityTypeBold" : "textEntityTypeItalic") << "\"}}";
+  }
+  sb << "]}";
+  return sb.as_cslice().str();
+}
+
+static td::string get_send_message_album_json(int message_count, int entity_count) {
+  td::StringBuilder sb(td::MutableSlice(), true);
+  sb << "{\"@type\":\"sendMessageAlbum\",\"@extra\":{\"request\":12345},\"chat_id\":-1001234567890,"
+        "\"input_message_contents\":[";
+  for (int i = 0; i < message_count; i++) {
+    if (i != 0) {
+      sb << ',';
+    }
+    sb << "{\"@type\":\"inputMessagePhoto\",\"photo\":{\"@type\":\"inputFileLocal\",\"path\":\"/tmp/photo" << i
+       << ".jpg\"},\"added_sticker_file_ids\":[1,2,3],\"width\":1280,\"height\":720,\"caption\":"
+       << get_formatted_text_json(entity_count) << "}";
+  }
+  sb << "]}";
+  return sb.as_cslice().str();
+}
+
+static td::string get_set_chat_permissions_json() {
+  return "{\"@type\":\"setChatPermissions\",\"@extra\":7,\"chat_id\":-1001234567890,\"permissions\":{\"@type\":"
+         "\"chatPermissions\",\"can_send_basic_messages\":true,\"can_send_audios\":true,\"can_send_documents\":true,"
+         "\"can_send_photos\":false,\"can_send_videos\":false,\"can_send_video_notes\":true,\"can_send_voice_notes\":"
+         "true,\"can_send_polls\":false,\"can_send_other_messages\":true,\"can_add_web_page_previews\":true,"
+         "\"can_change_info\":false,\"can_invite_users\":true,\"can_pin_messages\":false,\"can_create_topics\":false}}";
+}
+
+static td::Result<td::td_api::object_ptr<td::td_api::Function>> parse_request(const td::string &request,
+                                                                            bool use_streaming_parser) {
+  auto request_str = request;
+  td::td_api::object_ptr<td::td_api::Function> result;
+  if (use_streaming_parser) {
+    td::TlJsonParser parser(request_str);
+    parser.set_saved_field_name("@extra");
+    TRY_STATUS(td::td_api::from_json(result, parser));
+    TRY_STATUS(parser.finish());
+  } else {
+    TRY_RESULT(json_value, td::json_decode(request_str));
+    json_value.get_object().extract_field("@extra");
+    TRY_STATUS(td::td_api::from_json(result, std::move(json_value)));
+  }
+  return std::move(result);
+}
+
+class JsonRequestParseBench final : public td::Benchmark {
+ public:
+  JsonRequestParseBench(td::string name, td::string request, bool use_streaming_parser)
+      : name_(std::move(name)), request_(std::move(request)), use_streaming_parser_(use_streaming_parser) {
+  }
+
+  td::string get_description() const final {
+    return PSTRING() << "Parse " << name_ << " of size " << request_.size() << " using "
+                     << (use_streaming_parser_ ? "TlJsonParser" : "JsonValue");
+  }
+
+  void start_up() final {
+    auto expected = to_string(parse_request(request_, false).move_as_ok());
+    auto received = to_string(parse_request(request_, true).move_as_ok());
+    LOG_CHECK(expected == received) << expected << ' ' << received;
+  }
+
+  void run(int n) final {
+    td::size_t result = 0;
+    for (int i = 0; i < n; i++) {
+      auto r_function = parse_request(request_, use_streaming_parser_);
+      CHECK(r_function.is_ok());
+      result += r_function.ok()->get_id();
+    }
+    td::do_not_optimize_away(result);
+  }
+
+ private:
+  td::string name_;
+  td::string request_;
+  bool use_streaming_parser_;
+};
+
+int main() {
+  SET_VERBOSITY_LEVEL(VERBOSITY_NAME(ERROR));
+  for (auto use_streaming_parser : {false, true}) {
+    td::bench(JsonRequestParseBench("setChatPermissions", get_set_chat_permissions_json(), use_streaming_parser));
+    td::bench(JsonRequestParseBench("sendMessageAlbum", get_send_message_album_json(1, 1), use_streaming_parser));
+    td::bench(JsonRequestParseBench("sendMessageAlbum", get_send_message_album_json(10, 100), use_streaming_parser));
+  }
+}
@@ -0,0 +1,102 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/mtproto/AuthKey.h"
+#include "td/mtproto/PacketInfo.h"
+#include "td/mtproto/ProxySecret.h"
+#include "td/mtproto/TcpTransport.h"
+#include "td/mtproto/Transport.h"
+
+#include "td/utils/benchmark.h"
+#include "td/utils/buffer.h"
+#include "td/utils/common.h"
+#include "td/utils/logging.h"
+#include "td/utils/Random.h"
+#include "td/utils/Slice.h"
+#include "td/utils/SliceBuilder.h"
+#include "td/utils/Storer.h"
+
+#include <utility>
+
+// measures the number of encrypted packets, which can be written to an obfuscated TCP transport per second
+class MtprotoWriteBench final : public td::Benchmark {
+ public:
+  MtprotoWriteBench(size_t packet_size, size_t batch_size, bool emulate_tls)
+      : packet_size_(packet_size), batch_size_(batch_size), emulate_tls_(emulate_tls) {
+  }
+
+ private:
+  size_t packet_size_;
+  size_t batch_size_;
+  bool emulate_tls_;
+  td::string data_;
+  td::mtproto::AuthKey auth_key_;
+
+  td::string get_description() const final {
+    return PSTRING() << "MTProto write: " << (emulate_tls_ ? "TLS, " : "") << "packet size = " << packet_size_
+                     << ", batch size = " << batch_size_;
+  }
+
+  void start_up() final {
+    data_ = td::string(packet_size_, 'a');
+    td::string key(256, '\0');
+    td::Random::secure_bytes(key);
+    auth_key_ = td::mtproto::AuthKey(td::Random::secure_uint64(), std::move(key));
+  }
+
+  void run(int n) final {
+    auto secret = td::mtproto::ProxySecret::from_raw(emulate_tls_ ? td::string("\xee") + data_.substr(0, 16) + "t.me"
+                                                                  : td::string());
+    td::mtproto::tcp::ObfuscatedTransport transport(2, std::move(secret));
+    td::ChainBufferReader input;
+    td::ChainBufferWriter output;
+    auto output_reader = output.extract_reader();
+    transport.init(&input, &output);
+
+    auto storer = td::create_storer(td::Slice(data_));
+    td::vector<std::pair<td::BufferWriter, bool>> packets;
+    size_t chunk_count = 0;
+    for (int i = 0; i < n; i++) {
+      td::mtproto::PacketInfo packet_info;
+      packet_info.version = 2;
+      packet_info.salt = 1;
+      packet_info.session_id = 2;
+      packets.emplace_back(td::mtproto::Transport::write(storer, auth_key_, &packet_info, transport.max_prepend_size(),
+                                                         transport.max_append_size()),
+                           false);
+      if (packets.size() < batch_size_ && i + 1 < n) {
+        continue;
+      }
+
+      if (batch_size_ == 1) {
+        transport.write(std::move(packets[0].first), false);
+      } else {
+        transport.write_batch(std::move(packets));
+      }
+      packets.clear();
+
+      // the chunks would have been passed to writev as separate I/O vectors
+      output_reader.sync_with_writer();
+      while (!output_reader.empty()) {
+        auto slice = output_reader.prepare_read();
+        output_reader.confirm_read(slice.size());
+        chunk_count++;
+      }
+    }
+    CHECK(n == 0 || chunk_count > 0);
+  }
+};
+
+int main() {
+  SET_VERBOSITY_LEVEL(VERBOSITY_NAME(ERROR));
+  for (size_t packet_size : {64, 1024, 32768}) {
+    for (size_t batch_size : {1, 8, 64}) {
+      td::bench(MtprotoWriteBench(packet_size, batch_size, false));
+    }
+  }
+  td::bench(MtprotoWriteBench(1024, 1, true));
+  td::bench(MtprotoWriteBench(1024, 64, true));
+}
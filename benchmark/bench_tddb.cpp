@@ -11,6 +11,8 @@
 #include "td/telegram/ServerMessageId.h"
 #include "td/telegram/UserId.h"
 
+#include "td/db/binlog/Binlog.h"
+#include "td/db/binlog/BinlogEvent.h"
 #include "td/db/DbKey.h"
 #include "td/db/SqliteConnectionSafe.h"
 #include "td/db/SqliteDb.h"
@@ -23,7 +25,10 @@
 #include "td/utils/logging.h"
 #include "td/utils/Promise.h"
 #include "td/utils/Random.h"
+#include "td/utils/SliceBuilder.h"
 #include "td/utils/Status.h"
+#include "td/utils/StorerBase.h"
+#include "td/utils/Storer.h"
 
 #include <memory>
 
@@ -107,7 +112,57 @@ class MessageDbBench final : public td::Benchmark {
   }
 };
 
+template <bool is_encrypted>
+class BinlogLoadBench final : public td::Benchmark {
+ public:
+  td::string get_description() const final {
+    return PSTRING() << "Binlog load " << td::tag("is_encrypted", is_encrypted);
+  }
+  void start_up() final {
+    td::Binlog::destroy(binlog_name_).ignore();
+    td::Binlog binlog;
+    binlog.init(binlog_name_, td::Binlog::Callback(), get_db_key()).ensure();
+    td::string data;
+    for (int i = 0; i < EVENT_COUNT; i++) {
+      data.assign(td::Random::fast(1, 64) * 4, 'a');
+      binlog.add(1, td::create_storer(data));
+      if (i % 10 == 0) {
+        // keep some events rewritten to make the binlog look like a real one
+        binlog.rewrite(binlog.peek_next_event_id() - 1, 1, td::create_storer(data));
+      }
+    }
+    binlog.close().ensure();
+  }
+  void run(int n) final {
+    for (int i = 0; i < n; i++) {
+      td::Binlog binlog;
+      size_t event_count = 0;
+      binlog.init(binlog_name_, [&](const td::BinlogEvent &event) { event_count++; }, get_db_key()).ensure();
+      CHECK(event_count == static_cast<size_t>(EVENT_COUNT));
+      auto info = binlog.get_info();
+      LOG(INFO) << td::tag("load_time", info.load_time) << td::tag("read_time", info.read_time)
+                << td::tag("parse_time", info.parse_time) << td::tag("process_time", info.process_time)
+                << td::tag("replay_time", info.replay_time);
+      binlog.close(false).ensure();
+    }
+  }
+  void tear_down() final {
+    td::Binlog::destroy(binlog_name_).ignore();
+  }
+
+ private:
+  static constexpr int EVENT_COUNT = 500000;
+  td::string binlog_name_ = "test_load.binlog";
+
+  static td::DbKey get_db_key() {
+    // a raw key is used to avoid measuring of key derivation
+    return is_encrypted ? td::DbKey::raw_key("cucumber") : td::DbKey::empty();
+  }
+};
+
 int main() {
   SET_VERBOSITY_LEVEL(VERBOSITY_NAME(WARNING));
   td::bench(MessageDbBench());
+  td::bench(BinlogLoadBench<false>());
+  td::bench(BinlogLoadBench<true>());
 }
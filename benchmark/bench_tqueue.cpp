@@ -0,0 +1,142 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/db/TQueue.h"
+
+#include "td/utils/benchmark.h"
+#include "td/utils/common.h"
+#include "td/utils/FlatHashMap.h"
+#include "td/utils/logging.h"
+#include "td/utils/port/Stat.h"
+#include "td/utils/Random.h"
+#include "td/utils/SliceBuilder.h"
+#include "td/utils/Span.h"
+
+static constexpr td::int32 QUEUE_COUNT = 1000;
+static constexpr td::int32 EXPIRES_AT = 1 << 30;
+
+static td::TQueue::EventId push_event(td::TQueue &queue, td::int64 queue_id) {
+  return queue.push(queue_id, "data", EXPIRES_AT, 0, td::TQueue::EventId()).move_as_ok();
+}
+
+class TQueuePushBench final : public td::Benchmark {
+ public:
+  td::string get_description() const final {
+    return PSTRING() << "TQueue push";
+  }
+
+  void start_up() final {
+    tqueue_ = td::TQueue::create();
+  }
+
+  void run(int n) final {
+    for (int i = 0; i < n; i++) {
+      push_event(*tqueue_, i % QUEUE_COUNT + 1);
+    }
+  }
+
+  void tear_down() final {
+    tqueue_ = nullptr;
+  }
+
+ private:
+  td::unique_ptr<td::TQueue> tqueue_;
+};
+
+// every queue keeps about 100 events; new events are added and the oldest events are received and forgotten
+class TQueueGetBench final : public td::Benchmark {
+ public:
+  td::string get_description() const final {
+    return PSTRING() << "TQueue push and get";
+  }
+
+  void start_up() final {
+    tqueue_ = td::TQueue::create();
+    for (td::int32 queue_id = 1; queue_id <= QUEUE_COUNT; queue_id++) {
+      for (int i = 0; i < 100; i++) {
+        push_event(*tqueue_, queue_id);
+      }
+    }
+  }
+
+  void run(int n) final {
+    td::TQueue::Event events[10];
+    for (int i = 0; i < n; i++) {
+      td::int64 queue_id = i % QUEUE_COUNT + 1;
+      push_event(*tqueue_, queue_id);
+      auto events_span = td::MutableSpan<td::TQueue::Event>(events, 10);
+      auto from_id = tqueue_->get_head(queue_id).next().move_as_ok();
+      tqueue_->get(queue_id, from_id, true, 0, events_span).ensure();
+      CHECK(!events_span.empty());
+    }
+  }
+
+  void tear_down() final {
+    tqueue_ = nullptr;
+  }
+
+ private:
+  td::unique_ptr<td::TQueue> tqueue_;
+};
+
+// events are forgotten in a random order
+class TQueueForgetBench final : public td::Benchmark {
+ public:
+  td::string get_description() const final {
+    return PSTRING() << "TQueue push and forget";
+  }
+
+  void start_up() final {
+    tqueue_ = td::TQueue::create();
+    event_ids_.clear();
+  }
+
+  void run(int n) final {
+    for (int i = 0; i < n; i++) {
+      td::int64 queue_id = i % QUEUE_COUNT + 1;
+      auto &event_ids = event_ids_[queue_id];
+      event_ids.push_back(push_event(*tqueue_, queue_id));
+      if (event_ids.size() > 100) {
+        auto pos = td::Random::fast(0, static_cast<int>(event_ids.size()) - 1);
+        std::swap(event_ids[pos], event_ids.back());
+        tqueue_->forget(queue_id, event_ids.back());
+        event_ids.pop_back();
+      }
+    }
+  }
+
+  void tear_down() final {
+    tqueue_ = nullptr;
+  }
+
+ private:
+  td::unique_ptr<td::TQueue> tqueue_;
+  td::FlatHashMap<td::int64, td::vector<td::TQueue::EventId>> event_ids_;
+};
+
+static void measure_memory() {
+  static constexpr td::int32 EVENT_COUNT = 1000;
+  auto start_memory = td::mem_stat().move_as_ok().resident_size_;
+  {
+    auto tqueue = td::TQueue::create();
+    for (td::int32 queue_id = 1; queue_id <= QUEUE_COUNT; queue_id++) {
+      for (int i = 0; i < EVENT_COUNT; i++) {
+        push_event(*tqueue, queue_id);
+      }
+    }
+    auto used_memory = td::mem_stat().move_as_ok().resident_size_ - start_memory;
+    LOG(PLAIN) << "TQueue: " << used_memory / (QUEUE_COUNT * EVENT_COUNT) << " bytes per event";
+  }
+}
+
+int main() {
+  SET_VERBOSITY_LEVEL(VERBOSITY_NAME(WARNING));
+  measure_memory();
+
+  td::bench(TQueuePushBench());
+  td::bench(TQueueGetBench());
+  td::bench(TQueueForgetBench());
+}
@@ -109,6 +109,40 @@ void gen_from_json_constructor(StringBuilder &sb, const T *constructor, bool is_
     sb << "  return Status::OK();\n";
     sb << "}\n\n";
   }
+
+  sb << "Status from_json(td_api::" << tl::simple::gen_cpp_name(constructor->name) << " &to, TlJsonParser &from)";
+  if (is_header) {
+    sb << ";\n\n";
+    return;
+  }
+  sb << " {\n";
+  sb << "  TRY_RESULT(has_field, from.enter_object());\n";
+  if (!constructor->args.empty()) {
+    CHECK(constructor->args.size() <= 64);
+    sb << "  uint64 parsed_fields = 0;\n";
+  }
+  sb << "  while (has_field) {\n";
+  if (constructor->args.empty()) {
+    sb << "    TRY_STATUS(from.skip_value());\n";
+  } else {
+    sb << "    auto field = from.get_field();\n";
+    sb << "    ";
+    int32 field_index = 0;
+    for (auto &arg : constructor->args) {
+      sb << "if (field == \"" << tl::simple::gen_cpp_name(arg.name)
+         << "\" && TlJsonParser::is_new_field(parsed_fields, " << field_index++ << ")) {\n";
+      sb << "      TRY_STATUS(from_json" << (arg.type->type == tl::simple::Type::Bytes ? "_bytes" : "") << "(to."
+         << tl::simple::gen_cpp_field_name(arg.name) << ", from));\n";
+      sb << "    } else ";
+    }
+    sb << "{\n";
+    sb << "      TRY_STATUS(from.skip_value());\n";
+    sb << "    }\n";
+  }
+  sb << "    TRY_RESULT_ASSIGN(has_field, from.next_field());\n";
+  sb << "  }\n";
+  sb << "  return Status::OK();\n";
+  sb << "}\n\n";
 }
 
 void gen_from_json(StringBuilder &sb, const tl::simple::Schema &schema, bool is_header, Mode mode) {
@@ -221,10 +255,14 @@ void gen_json_converter_file(const tl::simple::Schema &schema, const std::string
     sb << "#include <functional>\n\n";
   }
   sb << "namespace td {\n";
+  if (is_header) {
+    sb << "\nclass TlJsonParser;\n\n";
+  }
   sb << "namespace td_api {\n";
   if (is_header) {
     sb << "\nvoid to_json(JsonValueScope &jv, const tl_object_ptr<Object> &value);\n";
     sb << "\nStatus from_json(tl_object_ptr<Function> &to, td::JsonValue from);\n";
+    sb << "\nStatus from_json(tl_object_ptr<Function> &to, TlJsonParser &from);\n";
     sb << "\nvoid to_json(JsonValueScope &jv, const Object &object);\n";
     sb << "\nvoid to_json(JsonValueScope &jv, const Function &object);\n\n";
   } else {
@@ -237,6 +275,10 @@ Status from_json(tl_object_ptr<Function> &to, td::JsonValue from) {
   return td::from_json(to, std::move(from));
 }
 
+Status from_json(tl_object_ptr<Function> &to, TlJsonParser &from) {
+  return td::from_json(to, from);
+}
+
 template <class T>
 auto lazy_to_json(JsonValueScope &jv, const T &t) -> decltype(td_api::to_json(jv, t)) {
   return td_api::to_json(jv, t);
@@ -12,6 +12,12 @@
 namespace td {
 namespace mtproto {
 
+void IStreamTransport::write_batch(vector<std::pair<BufferWriter, bool>> &&messages) {
+  for (auto &message : messages) {
+    write(std::move(message.first), message.second);
+  }
+}
+
 unique_ptr<IStreamTransport> create_transport(TransportType type) {
   switch (type.type) {
     case TransportType::ObfuscatedTcp:
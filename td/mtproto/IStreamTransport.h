@@ -13,6 +13,8 @@
 #include "td/utils/port/detail/PollableFd.h"
 #include "td/utils/Status.h"
 
+#include <utility>
+
 namespace td {
 namespace mtproto {
 
@@ -25,6 +27,8 @@ class IStreamTransport {
   virtual Result<size_t> read_next(BufferSlice *message, uint32 *quick_ack) = 0;
   virtual bool support_quick_ack() const = 0;
   virtual void write(BufferWriter &&message, bool quick_ack) = 0;
+  // writes the messages in the given order; the result must be the same as after sequential calls to write
+  virtual void write_batch(vector<std::pair<BufferWriter, bool>> &&messages);
   virtual bool can_read() const = 0;
   virtual bool can_write() const = 0;
   virtual void init(ChainBufferReader *input, ChainBufferWriter *output) = 0;
@@ -0,0 +1,43 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include "td/utils/common.h"
+#include "td/utils/StringBuilder.h"
+
+namespace td {
+namespace mtproto {
+
+struct PacketStats {
+  uint64 packet_count = 0;
+  uint64 packet_size = 0;
+  uint64 query_packet_count = 0;
+  uint64 query_count = 0;
+  uint64 ack_count = 0;
+  uint64 piggybacked_ack_count = 0;
+  double total_query_delay = 0.0;
+  double max_query_delay = 0.0;
+
+  PacketStats &operator+=(const PacketStats &other) {
+    packet_count += other.packet_count;
+    packet_size += other.packet_size;
+    query_packet_count += other.query_packet_count;
+    query_count += other.query_count;
+    ack_count += other.ack_count;
+    piggybacked_ack_count += other.piggybacked_ack_count;
+    total_query_delay += other.total_query_delay;
+    if (other.max_query_delay > max_query_delay) {
+      max_query_delay = other.max_query_delay;
+    }
+    return *this;
+  }
+};
+
+StringBuilder &operator<<(StringBuilder &string_builder, const PacketStats &stats);
+
+}  // namespace mtproto
+}  // namespace td
@@ -45,6 +45,8 @@ class RawConnectionDefault final : public RawConnection {
       , stats_callback_(std::move(stats_callback)) {
     LOG(DEBUG) << "Create raw connection " << this;
     transport_->init(&socket_fd_.input_buffer(), &socket_fd_.output_buffer());
+    // HTTP transport can't write the next packet until a response to the previous one is received
+    use_write_batch_ = transport_->get_type().type != TransportType::Http;
   }
 
   void set_connection_token(ConnectionManager::ConnectionToken connection_token) final {
@@ -82,11 +84,18 @@ class RawConnectionDefault final : public RawConnection {
     }
 
     auto packet_size = packet.size();
-    transport_->write(std::move(packet), use_quick_ack);
+    if (use_write_batch_) {
+      // the packet is written to the transport together with other packets sent before the next flush
+      pending_packets_.emplace_back(std::move(packet), use_quick_ack);
+    } else {
+      transport_->write(std::move(packet), use_quick_ack);
+    }
     return packet_size;
   }
 
   void send_no_crypto(const Storer &storer) final {
+    write_pending_packets();
+
     PacketInfo packet_info;
     packet_info.no_crypto_flag = true;
     auto packet = Transport::write(storer, AuthKey(), &packet_info, transport_->max_prepend_size(),
@@ -122,6 +131,7 @@ class RawConnectionDefault final : public RawConnection {
 
   void close() final {
     LOG(DEBUG) << "Close raw connection " << this;
+    pending_packets_.clear();
     transport_.reset();
     socket_fd_.close();
   }
@@ -138,6 +148,8 @@ class RawConnectionDefault final : public RawConnection {
   BufferedFd<SocketFd> socket_fd_;
   unique_ptr<IStreamTransport> transport_;
   FlatHashMap<uint32, uint64> quick_ack_to_token_;
+  vector<std::pair<BufferWriter, bool>> pending_packets_;
+  bool use_write_batch_{false};
   bool has_error_{false};
 
   unique_ptr<StatsCallback> stats_callback_;
@@ -248,7 +260,16 @@ class RawConnectionDefault final : public RawConnection {
     return Status::OK();
   }
 
+  void write_pending_packets() {
+    if (pending_packets_.empty()) {
+      return;
+    }
+    transport_->write_batch(std::move(pending_packets_));
+    pending_packets_.clear();
+  }
+
   Status flush_write() {
+    write_pending_packets();
     TRY_RESULT(size, socket_fd_.flush_write());
     if (size > 0 && stats_callback_) {
       stats_callback_->on_write(size);
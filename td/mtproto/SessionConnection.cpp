@@ -175,6 +175,18 @@ inline StringBuilder &operator<<(StringBuilder &string_builder, const SessionCon
   return string_builder << "with " << info.message_id << " and seq_no " << info.seq_no;
 }
 
+StringBuilder &operator<<(StringBuilder &string_builder, const PacketStats &stats) {
+  string_builder << "[sent " << stats.packet_count << " packets of total size " << stats.packet_size;
+  if (stats.query_packet_count != 0) {
+    auto query_packet_count = static_cast<double>(stats.query_packet_count);
+    string_builder << ", " << stats.query_count << " queries in " << stats.query_packet_count
+                   << " packets with average query delay " << stats.total_query_delay / query_packet_count
+                   << " and maximum query delay " << stats.max_query_delay;
+  }
+  return string_builder << ", " << stats.ack_count << " acks with " << stats.piggybacked_ack_count
+                        << " of them sent along with queries]";
+}
+
 unique_ptr<RawConnection> SessionConnection::move_as_raw_connection() {
   was_moved_ = true;
   return std::move(raw_connection_);
@@ -351,6 +363,7 @@ Status SessionConnection::on_packet(const MsgInfo &info,
       LOG(WARNING) << bad_info << ": MessageId is too high. Session will be closed";
       // All this queries will be re-sent by parent
       to_send_.clear();
+      to_send_size_ = 0;
       reset_server_time_difference(info.message_id);
       callback_->on_session_failed(Status::Error("MessageId is too high"));
       return Status::Error("MessageId is too high");
@@ -802,23 +815,44 @@ void SessionConnection::do_close(Status status) {
   callback_->on_closed(std::move(status));
 }
 
-void SessionConnection::send_crypto(const Storer &storer, uint64 quick_ack_token) {
+size_t SessionConnection::send_crypto(const Storer &storer, uint64 quick_ack_token) {
   CHECK(state_ != Closed);
-  last_write_size_ += raw_connection_->send_crypto(storer, auth_data_->get_session_id(),
-                                                   auth_data_->get_server_salt(Time::now_cached()),
-                                                   auth_data_->get_auth_key(), quick_ack_token);
+  auto packet_size = raw_connection_->send_crypto(storer, auth_data_->get_session_id(),
+                                                  auth_data_->get_server_salt(Time::now_cached()),
+                                                  auth_data_->get_auth_key(), quick_ack_token);
+  last_write_size_ += packet_size;
+  return packet_size;
+}
+
+double SessionConnection::get_query_send_delay(bool is_bulk, bool is_high_priority, size_t pending_query_size,
+                                               double time_since_last_query_packet) {
+  if (is_high_priority || pending_query_size >= MAX_COALESCED_QUERY_SIZE) {
+    return 0.0;
+  }
+  // queries sent in a burst of bulk queries are waited for a bit longer to be packed together,
+  // while all other queries are likely to be interactive and are sent almost immediately
+  if (is_bulk && time_since_last_query_packet < QUERY_BURST_PERIOD) {
+    return MAX_QUERY_DELAY;
+  }
+  return QUERY_DELAY;
 }
 
 Result<MessageId> SessionConnection::send_query(BufferSlice buffer, bool gzip_flag, MessageId message_id,
-                                                vector<MessageId> invoke_after_message_ids, bool use_quick_ack) {
+                                                vector<MessageId> invoke_after_message_ids, bool use_quick_ack,
+                                                bool is_bulk, bool is_high_priority) {
   CHECK(mode_ != Mode::HttpLongPoll);  // "LongPoll connection is only for http_wait"
   if (message_id == MessageId()) {
     message_id = auth_data_->next_message_id(Time::now_cached());
   }
   auto seq_no = auth_data_->next_seq_no(true);
   if (to_send_.empty()) {
-    send_before(Time::now_cached() + QUERY_DELAY);
+    to_send_since_ = Time::now_cached();
   }
+  to_send_size_ += buffer.size();
+  auto time_since_last_query_packet =
+      last_query_packet_at_ == 0 ? QUERY_BURST_PERIOD : Time::now_cached() - last_query_packet_at_;
+  send_before(Time::now_cached() +
+              get_query_send_delay(is_bulk, is_high_priority, to_send_size_, time_since_last_query_packet));
   to_send_.push_back(MtprotoQuery{message_id, seq_no, std::move(buffer), gzip_flag, std::move(invoke_after_message_ids),
                                   use_quick_ack});
   VLOG(mtproto) << "Invoke query with " << message_id << " and seq_no " << seq_no << " of size "
@@ -956,6 +990,8 @@ void SessionConnection::flush_packet() {
     }
   }
   vector<MtprotoQuery> queries;
+  CHECK(to_send_size_ >= send_size);
+  to_send_size_ -= send_size;
   if (send_till == to_send_.size()) {
     queries = std::move(to_send_);
   } else if (send_till != 0) {
@@ -1012,6 +1048,19 @@ void SessionConnection::flush_packet() {
   auto to_ack = cut_tail(to_ack_message_ids_, 8192, "ack");
   MessageId ping_message_id;
 
+  packet_stats_.packet_count++;
+  packet_stats_.ack_count += to_ack.size();
+  if (!queries.empty()) {
+    auto query_delay = Time::now_cached() - to_send_since_;
+    packet_stats_.query_packet_count++;
+    packet_stats_.query_count += queries.size();
+    packet_stats_.piggybacked_ack_count += to_ack.size();
+    packet_stats_.total_query_delay += query_delay;
+    packet_stats_.max_query_delay = max(packet_stats_.max_query_delay, query_delay);
+    last_query_packet_at_ = Time::now_cached();
+    to_send_since_ = Time::now_cached();
+  }
+
   bool use_quick_ack = any_of(queries, [](const auto &query) { return query.use_quick_ack; });
 
   {
@@ -1024,7 +1073,7 @@ void SessionConnection::flush_packet() {
         &ping_message_id, &parent_message_id);
 
     auto quick_ack_token = use_quick_ack ? parent_message_id.get() : 0;
-    send_crypto(storer, quick_ack_token);
+    packet_stats_.packet_size += send_crypto(storer, quick_ack_token);
   }
 
   if (resend_answer_message_id != MessageId()) {
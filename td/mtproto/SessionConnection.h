@@ -9,6 +9,7 @@
 #include "td/mtproto/MessageId.h"
 #include "td/mtproto/MtprotoQuery.h"
 #include "td/mtproto/PacketInfo.h"
+#include "td/mtproto/PacketStats.h"
 #include "td/mtproto/RawConnection.h"
 
 #include "td/utils/buffer.h"
@@ -70,7 +71,8 @@ class SessionConnection final
   // Interface
   Result<MessageId> TD_WARN_UNUSED_RESULT send_query(BufferSlice buffer, bool gzip_flag, MessageId message_id = {},
                                                      vector<MessageId> invoke_after_message_ids = {},
-                                                     bool use_quick_ack = false);
+                                                     bool use_quick_ack = false, bool is_bulk = false,
+                                                     bool is_high_priority = false);
   std::pair<MessageId, BufferSlice> encrypted_bind(int64 perm_key, int64 nonce, int32 expires_at);
 
   void get_state_info(MessageId message_id);
@@ -81,6 +83,23 @@ class SessionConnection final
   void set_online(bool online_flag, bool is_main);
   void force_ack();
 
+  const PacketStats &get_packet_stats() const {
+    return packet_stats_;
+  }
+
+  // returns statistics collected since the previous call
+  PacketStats extract_packet_stats() {
+    auto result = packet_stats_;
+    packet_stats_ = PacketStats();
+    return result;
+  }
+
+  // returns delay before sending of a packet with a new query;
+  // high-priority queries are sent immediately together with all pending queries,
+  // only bulk queries are waited for to be coalesced with subsequent queries of a burst
+  static double get_query_send_delay(bool is_bulk, bool is_high_priority, size_t pending_query_size,
+                                     double time_since_last_query_packet);
+
   class Callback {
    public:
     Callback() = default;
@@ -120,6 +139,11 @@ class SessionConnection final
  private:
   static constexpr int ACK_DELAY = 30;                  // 30s
   static constexpr double QUERY_DELAY = 0.001;          // 0.001s
+  static constexpr double MAX_QUERY_DELAY = 0.005;      // 0.005s
+  static constexpr double QUERY_BURST_PERIOD = 0.05;    // 0.05s
+
+  // queries are sent without waiting for other queries as soon as they fill a packet of a typical MTU size
+  static constexpr size_t MAX_COALESCED_QUERY_SIZE = 1400;
   static constexpr double RESEND_ANSWER_DELAY = 0.001;  // 0.001s
 
   struct MsgInfo {
@@ -161,9 +185,14 @@ class SessionConnection final
   static constexpr int HTTP_MAX_DELAY = 30;  // 0.03s
 
   vector<MtprotoQuery> to_send_;
+  size_t to_send_size_ = 0;
+  double to_send_since_ = 0;
+  double last_query_packet_at_ = 0;
   vector<MessageId> to_ack_message_ids_;
   double force_send_at_ = 0;
 
+  PacketStats packet_stats_;
+
   struct ServiceQuery {
     enum Type { GetStateInfo, ResendAnswer } type_;
     MessageId container_message_id_;
@@ -260,7 +289,7 @@ class SessionConnection final
   void do_close(Status status);
 
   void send_ack(MessageId message_id);
-  void send_crypto(const Storer &storer, uint64 quick_ack_token);
+  size_t send_crypto(const Storer &storer, uint64 quick_ack_token);
   void send_before(double tm);
   bool may_ping() const;
   bool must_ping() const;
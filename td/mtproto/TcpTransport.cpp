@@ -161,6 +161,48 @@ void ObfuscatedTransport::write(BufferWriter &&message, bool quick_ack) {
   }
 }
 
+void ObfuscatedTransport::write_batch(vector<std::pair<BufferWriter, bool>> &&messages) {
+  if (secret_.emulate_tls()) {
+    // keep one TLS record per message
+    return IStreamTransport::write_batch(std::move(messages));
+  }
+
+  // consecutive small messages are copied to a single buffer, so they are encrypted in one pass
+  // and are sent as one chunk of the output buffer instead of a chunk per message
+  size_t begin = 0;
+  while (begin < messages.size()) {
+    size_t end = begin;
+    size_t total_size = 0;
+    while (end < messages.size() && messages[end].first.size() < MAX_BATCHED_MESSAGE_SIZE &&
+           total_size < MAX_BATCH_SIZE) {
+      impl_.write_prepare_inplace(&messages[end].first, messages[end].second);
+      total_size += messages[end].first.size();
+      end++;
+    }
+    if (end <= begin + 1) {
+      if (end == begin) {
+        impl_.write_prepare_inplace(&messages[begin].first, messages[begin].second);
+      }
+      auto &message = messages[begin].first;
+      output_state_.encrypt(message.as_slice(), message.as_mutable_slice());
+      do_write_main(std::move(message));
+      begin++;
+      continue;
+    }
+
+    BufferWriter batch(total_size, max_prepend_size(), 0);
+    auto dest = batch.as_mutable_slice();
+    for (size_t i = begin; i < end; i++) {
+      dest.copy_from(messages[i].first.as_slice());
+      dest.remove_prefix(messages[i].first.size());
+    }
+    output_state_.encrypt(batch.as_slice(), batch.as_mutable_slice());
+    do_write_main(std::move(batch));
+    begin = end;
+  }
+  messages.clear();
+}
+
 void ObfuscatedTransport::do_write_main(BufferWriter &&message) {
   BufferBuilder builder(std::move(message));
   if (!header_.empty()) {
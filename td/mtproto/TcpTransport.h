@@ -20,6 +20,8 @@
 #include "td/utils/Status.h"
 #include "td/utils/UInt.h"
 
+#include <utility>
+
 namespace td {
 namespace mtproto {
 namespace tcp {
@@ -111,6 +113,8 @@ class ObfuscatedTransport final : public IStreamTransport {
 
   void write(BufferWriter &&message, bool quick_ack) final;
 
+  void write_batch(vector<std::pair<BufferWriter, bool>> &&messages) final;
+
   void init(ChainBufferReader *input, ChainBufferWriter *output) final;
 
   bool can_read() const final {
@@ -160,6 +164,8 @@ class ObfuscatedTransport final : public IStreamTransport {
   ChainBufferReader *input_ = nullptr;
 
   static constexpr int32 MAX_TLS_PACKET_LENGTH = 2878;
+  static constexpr size_t MAX_BATCHED_MESSAGE_SIZE = 1 << 12;
+  static constexpr size_t MAX_BATCH_SIZE = 1 << 15;
 
   // TODO: use ByteFlow?
   // One problem is that BufferedFd owns output_buffer_
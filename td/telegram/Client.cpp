@@ -171,7 +171,32 @@ class ClientManager::Impl final {
     return response;
   }
 
+  int32 get_receive_queue_count() const {
+    return 1;
+  }
+
+  int32 get_receive_queue_id(ClientId /*client_id*/) const {
+    return 0;
+  }
+
+  size_t receive(int32 queue_id, double timeout, size_t max_response_count, vector<Response> &responses) {
+    CHECK(queue_id == 0);
+    size_t response_count = 0;
+    while (response_count < max_response_count) {
+      auto response = receive(response_count == 0 ? timeout : 0.0);
+      if (response.object == nullptr) {
+        break;
+      }
+      responses.push_back(std::move(response));
+      response_count++;
+    }
+    return response_count;
+  }
+
   Impl() = default;
+  // all responses are delivered to the same queue, because the scheduler is run in the receiving thread
+  explicit Impl(int32 /*receive_queue_count*/) {
+  }
   Impl(const Impl &) = delete;
   Impl &operator=(const Impl &) = delete;
   Impl(Impl &&) = delete;
@@ -237,17 +262,54 @@ class Client::Impl final {
 
 class MultiTd final : public Actor {
  public:
-  explicit MultiTd(Td::Options options) : options_(std::move(options)) {
+  // database, file GC and slow network schedulers
+  static constexpr int32 SERVICE_SCHEDULER_COUNT = 3;
+
+  MultiTd(Td::Options options, int32 client_scheduler_count, bool share_service_schedulers,
+          int32 database_reader_scheduler_count, int32 file_worker_scheduler_count)
+      : options_(std::move(options))
+      , client_scheduler_count_(client_scheduler_count)
+      , share_service_schedulers_(share_service_schedulers)
+      , database_reader_scheduler_count_(database_reader_scheduler_count)
+      , file_worker_scheduler_count_(file_worker_scheduler_count)
+      , td_counts_(static_cast<size_t>(client_scheduler_count), 0) {
   }
+
+  static int32 get_scheduler_count(int32 client_scheduler_count, bool share_service_schedulers,
+                                   int32 database_reader_scheduler_count, int32 file_worker_scheduler_count) {
+    return client_scheduler_count +
+           (SERVICE_SCHEDULER_COUNT + database_reader_scheduler_count + file_worker_scheduler_count) *
+               (share_service_schedulers ? 1 : client_scheduler_count);
+  }
+
   void create(int32 td_id, unique_ptr<TdCallback> callback) {
     auto &td = tds_[td_id];
     CHECK(td.empty());
 
-    string name = "Td";
+    auto sched_id = static_cast<int32>(std::min_element(td_counts_.begin(), td_counts_.end()) - td_counts_.begin());
+    td_counts_[sched_id]++;
+    td_sched_ids_[td_id] = sched_id;
+
+    auto options = options_;
+    auto service_scheduler_count =
+        SERVICE_SCHEDULER_COUNT + database_reader_scheduler_count_ + file_worker_scheduler_count_;
+    auto service_sched_id =
+        client_scheduler_count_ + (share_service_schedulers_ ? 0 : sched_id * service_scheduler_count);
+    options.database_scheduler_id = service_sched_id;
+    options.gc_scheduler_id = service_sched_id + 1;
+    options.slow_net_scheduler_id = service_sched_id + 2;
+    for (int32 i = 0; i < database_reader_scheduler_count_; i++) {
+      options.database_reader_scheduler_ids.push_back(service_sched_id + SERVICE_SCHEDULER_COUNT + i);
+    }
+    for (int32 i = 0; i < file_worker_scheduler_count_; i++) {
+      options.file_worker_scheduler_ids.push_back(service_sched_id + SERVICE_SCHEDULER_COUNT +
+                                                  database_reader_scheduler_count_ + i);
+    }
+
     auto context = std::make_shared<ActorContext>();
     auto old_context = set_context(context);
     auto old_tag = set_tag(to_string(td_id));
-    td = create_actor<Td>("Td", std::move(callback), options_);
+    td = create_actor_on_scheduler<Td>("Td", sched_id, std::move(callback), std::move(options));
     set_context(std::move(old_context));
     set_tag(std::move(old_tag));
   }
@@ -262,39 +324,70 @@ class MultiTd final : public Actor {
   void close(int32 td_id) {
     size_t erased_count = tds_.erase(td_id);
     CHECK(erased_count > 0);
+
+    auto it = td_sched_ids_.find(td_id);
+    CHECK(it != td_sched_ids_.end());
+    td_counts_[it->second]--;
+    td_sched_ids_.erase(it);
   }
 
  private:
   Td::Options options_;
+  int32 client_scheduler_count_;
+  bool share_service_schedulers_;
+  int32 database_reader_scheduler_count_;
+  int32 file_worker_scheduler_count_;
+  vector<int32> td_counts_;
   FlatHashMap<int32, ActorOwn<Td>> tds_;
+  FlatHashMap<int32, int32> td_sched_ids_;
 };
 
+constexpr int32 MultiTd::SERVICE_SCHEDULER_COUNT;
+
 class TdReceiver {
  public:
-  TdReceiver() {
-    output_queue_ = std::make_shared<OutputQueue>();
-    output_queue_->init();
+  explicit TdReceiver(int32 queue_count = 1) : queues_(static_cast<size_t>(queue_count)) {
+    CHECK(queue_count > 0);
+    for (auto &queue : queues_) {
+      queue = make_unique<ResponseQueue>();
+      queue->output_queue = std::make_shared<OutputQueue>();
+      queue->output_queue->init();
+    }
+  }
+
+  int32 get_queue_count() const {
+    return static_cast<int32>(queues_.size());
+  }
+
+  int32 get_queue_id(ClientManager::ClientId client_id) const {
+    return static_cast<int32>(static_cast<uint32>(client_id) % static_cast<uint32>(queues_.size()));
   }
 
   ClientManager::Response receive(double timeout, bool from_manager) {
     VLOG(td_requests) << "Begin to wait for updates with timeout " << timeout;
-    auto is_locked = receive_lock_.exchange(true);
-    if (is_locked) {
-      if (from_manager) {
-        LOG(FATAL) << "Receive must not be called simultaneously from two different threads, but this has just "
-                      "happened. Call it from a fixed thread, dedicated for updates and response processing.";
-      } else {
-        LOG(FATAL) << "Receive is called after Client destroy, or simultaneously from different threads";
-      }
-    }
-    auto response = receive_unlocked(clamp(timeout, 0.0, 1000000.0));
-    is_locked = receive_lock_.exchange(false);
-    CHECK(is_locked);
+    auto &queue = *queues_[0];
+    lock_queue(queue, from_manager);
+    auto response = receive_unlocked(queue, clamp(timeout, 0.0, 1000000.0));
+    unlock_queue(queue);
     VLOG(td_requests) << "End to wait for updates, returning object " << response.request_id << ' '
                       << response.object.get();
     return response;
   }
 
+  size_t receive(int32 queue_id, double timeout, size_t max_response_count,
+                 vector<ClientManager::Response> &responses) {
+    CHECK(0 <= queue_id && queue_id < get_queue_count());
+    VLOG(td_requests) << "Begin to wait for at most " << max_response_count << " updates in queue " << queue_id
+                      << " with timeout " << timeout;
+    auto &queue = *queues_[queue_id];
+    lock_queue(queue, true);
+    auto response_count = receive_unlocked(queue, clamp(timeout, 0.0, 1000000.0), max_response_count, responses);
+    unlock_queue(queue);
+    VLOG(td_requests) << "End to wait for updates in queue " << queue_id << ", returning " << response_count
+                      << " objects";
+    return response_count;
+  }
+
   unique_ptr<TdCallback> create_callback(ClientManager::ClientId client_id) {
     class Callback final : public TdCallback {
      public:
@@ -319,51 +412,122 @@ class TdReceiver {
       ClientManager::ClientId client_id_;
       std::shared_ptr<OutputQueue> output_queue_;
     };
-    return td::make_unique<Callback>(client_id, output_queue_);
+    return td::make_unique<Callback>(client_id, get_output_queue(client_id));
   }
 
   void add_response(ClientManager::ClientId client_id, uint64 id, td_api::object_ptr<td_api::Object> result) {
-    output_queue_->writer_put({client_id, id, std::move(result)});
+    get_output_queue(client_id)->writer_put({client_id, id, std::move(result)});
   }
 
  private:
   using OutputQueue = MpscPollableQueue<ClientManager::Response>;
-  std::shared_ptr<OutputQueue> output_queue_;
-  int output_queue_ready_cnt_{0};
-  std::atomic<bool> receive_lock_{false};
+  struct ResponseQueue {
+    std::shared_ptr<OutputQueue> output_queue;
+    int output_queue_ready_cnt{0};
+    std::atomic<bool> receive_lock{false};
+  };
+  vector<unique_ptr<ResponseQueue>> queues_;
 
-  ClientManager::Response receive_unlocked(double timeout) {
-    if (output_queue_ready_cnt_ == 0) {
-      output_queue_ready_cnt_ = output_queue_->reader_wait_nonblock();
+  const std::shared_ptr<OutputQueue> &get_output_queue(ClientManager::ClientId client_id) const {
+    return queues_[get_queue_id(client_id)]->output_queue;
+  }
+
+  static void lock_queue(ResponseQueue &queue, bool from_manager) {
+    auto is_locked = queue.receive_lock.exchange(true);
+    if (is_locked) {
+      if (from_manager) {
+        LOG(FATAL) << "Receive must not be called simultaneously from two different threads, but this has just "
+                      "happened. Call it from a fixed thread, dedicated for updates and response processing.";
+      } else {
+        LOG(FATAL) << "Receive is called after Client destroy, or simultaneously from different threads";
+      }
+    }
+  }
+
+  static void unlock_queue(ResponseQueue &queue) {
+    auto is_locked = queue.receive_lock.exchange(false);
+    CHECK(is_locked);
+  }
+
+  static ClientManager::Response receive_unlocked(ResponseQueue &queue, double timeout) {
+    if (queue.output_queue_ready_cnt == 0) {
+      queue.output_queue_ready_cnt = queue.output_queue->reader_wait_nonblock();
     }
-    if (output_queue_ready_cnt_ > 0) {
-      output_queue_ready_cnt_--;
-      return output_queue_->reader_get_unsafe();
+    if (queue.output_queue_ready_cnt > 0) {
+      queue.output_queue_ready_cnt--;
+      return queue.output_queue->reader_get_unsafe();
     }
     if (timeout != 0) {
-      output_queue_->reader_get_event_fd().wait(static_cast<int>(timeout * 1000));
-      return receive_unlocked(0);
+      queue.output_queue->reader_get_event_fd().wait(static_cast<int>(timeout * 1000));
+      return receive_unlocked(queue, 0);
     }
     return {0, 0, nullptr};
   }
+
+  static size_t receive_unlocked(ResponseQueue &queue, double timeout, size_t max_response_count,
+                                 vector<ClientManager::Response> &responses) {
+    if (max_response_count == 0) {
+      return 0;
+    }
+    if (queue.output_queue_ready_cnt == 0) {
+      queue.output_queue_ready_cnt = queue.output_queue->reader_wait_nonblock();
+    }
+    if (queue.output_queue_ready_cnt > 0) {
+      auto response_count = std::min(static_cast<size_t>(queue.output_queue_ready_cnt), max_response_count);
+      for (size_t i = 0; i < response_count; i++) {
+        responses.push_back(queue.output_queue->reader_get_unsafe());
+      }
+      queue.output_queue_ready_cnt -= static_cast<int>(response_count);
+      return response_count;
+    }
+    if (timeout != 0) {
+      queue.output_queue->reader_get_event_fd().wait(static_cast<int>(timeout * 1000));
+      return receive_unlocked(queue, 0, max_response_count, responses);
+    }
+    return 0;
+  }
 };
 
 class MultiImpl {
  public:
-  static constexpr int32 ADDITIONAL_THREAD_COUNT = 3;
-
-  explicit MultiImpl(std::shared_ptr<NetQueryStats> net_query_stats) {
-    concurrent_scheduler_ = std::make_shared<ConcurrentScheduler>(ADDITIONAL_THREAD_COUNT, 0);
+  MultiImpl(std::shared_ptr<NetQueryStats> net_query_stats, const ClientManager::ThreadOptions &thread_options,
+            int32 pool_id) {
+    auto scheduler_count = MultiTd::get_scheduler_count(
+        thread_options.client_thread_count, thread_options.share_service_threads,
+        thread_options.database_reader_thread_count, thread_options.file_worker_thread_count);
+    concurrent_scheduler_ = std::make_shared<ConcurrentScheduler>(scheduler_count - 1, 0);
+    uint64 main_thread_affinity_mask = 0;
+    const auto &masks = thread_options.thread_affinity_masks;
+    if (!masks.empty()) {
+      for (int32 sched_id = 0; sched_id < scheduler_count; sched_id++) {
+        auto mask = masks[static_cast<size_t>(pool_id * scheduler_count + sched_id) % masks.size()];
+        if (sched_id == 0) {
+          main_thread_affinity_mask = mask;
+        } else {
+          concurrent_scheduler_->set_thread_affinity_mask(sched_id, mask);
+        }
+      }
+    }
     concurrent_scheduler_->start();
 
     {
       auto guard = concurrent_scheduler_->get_main_guard();
       Td::Options options;
       options.net_query_stats = std::move(net_query_stats);
-      multi_td_ = create_actor<MultiTd>("MultiTd", std::move(options));
+      multi_td_ = create_actor<MultiTd>("MultiTd", std::move(options), thread_options.client_thread_count,
+                                        thread_options.share_service_threads,
+                                        thread_options.database_reader_thread_count,
+                                        thread_options.file_worker_thread_count);
     }
 
-    scheduler_thread_ = thread([concurrent_scheduler = concurrent_scheduler_] {
+    scheduler_thread_ = thread([concurrent_scheduler = concurrent_scheduler_, main_thread_affinity_mask] {
+#if TD_HAVE_THREAD_AFFINITY
+      if (main_thread_affinity_mask != 0) {
+        thread::set_affinity_mask(this_thread::get_id(), main_thread_affinity_mask).ignore();
+      }
+#else
+      (void)main_thread_affinity_mask;
+#endif
       while (concurrent_scheduler->run_main(10)) {
       }
     });
@@ -423,7 +587,6 @@ class MultiImpl {
   static std::atomic<uint32> current_id_;
 };
 
-constexpr int32 MultiImpl::ADDITIONAL_THREAD_COUNT;
 std::atomic<uint32> MultiImpl::current_id_{1};
 
 class MultiImplPool {
@@ -433,12 +596,18 @@ class MultiImplPool {
     if (impls_.empty()) {
       init_openssl_threads();
 
-      auto max_client_threads = clamp(thread::hardware_concurrency(), 8u, 20u) * 5 / 4;
+      thread_options_ = get_thread_options();
+      auto pool_thread_count = get_pool_thread_count(thread_options_);
+      auto pool_count = static_cast<uint32>(thread_options_.pool_count);
+      if (pool_count == 0) {
+        pool_count = clamp(thread::hardware_concurrency(), 8u, 20u) * 5 / 4;
 #if TD_OPENBSD
-      max_client_threads = td::min(max_client_threads, 4u);
+        pool_count = td::min(pool_count, 4u);
 #endif
-      impls_.resize(max_client_threads);
-      CHECK(impls_.size() * (1 + MultiImpl::ADDITIONAL_THREAD_COUNT + 1 /* IOCP */) < 128);
+        pool_count = clamp(pool_count, 1u, static_cast<uint32>((MAX_THREAD_COUNT - 1) / pool_thread_count));
+      }
+      impls_.resize(pool_count);
+      CHECK(impls_.size() * pool_thread_count < MAX_THREAD_COUNT);
 
       net_query_stats_ = std::make_shared<NetQueryStats>();
     }
@@ -446,12 +615,32 @@ class MultiImplPool {
                                    [](auto &a, auto &b) { return a.lock().use_count() < b.lock().use_count(); });
     auto result = impl.lock();
     if (!result) {
-      result = std::make_shared<MultiImpl>(net_query_stats_);
+      result = std::make_shared<MultiImpl>(net_query_stats_, thread_options_, static_cast<int32>(&impl - &impls_[0]));
       impl = result;
     }
     return result;
   }
 
+  static bool set_thread_options(ClientManager::ThreadOptions options) {
+    if (options.pool_count < 0 || options.client_thread_count <= 0 ||
+        static_cast<size_t>(options.client_thread_count) >= MAX_THREAD_COUNT ||
+        options.database_reader_thread_count < 0 ||
+        static_cast<size_t>(options.database_reader_thread_count) >= MAX_THREAD_COUNT ||
+        options.file_worker_thread_count < 0 ||
+        static_cast<size_t>(options.file_worker_thread_count) >= MAX_THREAD_COUNT) {
+      return false;
+    }
+    auto pool_thread_count = get_pool_thread_count(options);
+    if (pool_thread_count >= MAX_THREAD_COUNT ||
+        static_cast<size_t>(options.pool_count) * pool_thread_count >= MAX_THREAD_COUNT) {
+      return false;
+    }
+
+    std::unique_lock<std::mutex> lock(thread_options_mutex_);
+    thread_options_storage_ = std::move(options);
+    return true;
+  }
+
   void try_clear() {
     std::unique_lock<std::mutex> lock(mutex_);
     if (impls_.empty()) {
@@ -471,11 +660,34 @@ class MultiImplPool {
   }
 
  private:
+  static constexpr size_t MAX_THREAD_COUNT = 128;  // ThreadLocalStorage::MAX_THREAD_ID
+
   std::mutex mutex_;
   std::vector<std::weak_ptr<MultiImpl>> impls_;
   std::shared_ptr<NetQueryStats> net_query_stats_;
+  ClientManager::ThreadOptions thread_options_;
+
+  static std::mutex thread_options_mutex_;
+  static ClientManager::ThreadOptions thread_options_storage_;
+
+  static ClientManager::ThreadOptions get_thread_options() {
+    std::unique_lock<std::mutex> lock(thread_options_mutex_);
+    return thread_options_storage_;
+  }
+
+  // all threads of a pool including the IOCP thread
+  static size_t get_pool_thread_count(const ClientManager::ThreadOptions &options) {
+    return static_cast<size_t>(
+               MultiTd::get_scheduler_count(options.client_thread_count, options.share_service_threads,
+                                            options.database_reader_thread_count, options.file_worker_thread_count)) +
+           1;
+  }
 };
 
+constexpr size_t MultiImplPool::MAX_THREAD_COUNT;
+std::mutex MultiImplPool::thread_options_mutex_;
+ClientManager::ThreadOptions MultiImplPool::thread_options_storage_;
+
 class ClientManager::Impl final {
  public:
   ClientId create_client_id() {
@@ -520,6 +732,38 @@ class ClientManager::Impl final {
 
   Response receive(double timeout) {
     auto response = receiver_.receive(timeout, true);
+    process_response(response);
+    return response;
+  }
+
+  int32 get_receive_queue_count() const {
+    return receiver_.get_queue_count();
+  }
+
+  int32 get_receive_queue_id(ClientId client_id) const {
+    return receiver_.get_queue_id(client_id);
+  }
+
+  size_t receive(int32 queue_id, double timeout, size_t max_response_count, vector<Response> &responses) {
+    auto old_size = responses.size();
+    receiver_.receive(queue_id, timeout, max_response_count, responses);
+
+    // responses about released clients must not be returned
+    auto new_size = old_size;
+    for (size_t i = old_size; i < responses.size(); i++) {
+      process_response(responses[i]);
+      if (responses[i].object != nullptr) {
+        if (i != new_size) {
+          responses[new_size] = std::move(responses[i]);
+        }
+        new_size++;
+      }
+    }
+    responses.erase(responses.begin() + new_size, responses.end());
+    return new_size - old_size;
+  }
+
+  void process_response(Response &response) {
     if (response.request_id == 0 && response.object != nullptr &&
         response.object->get_id() == td_api::updateAuthorizationState::ID &&
         static_cast<const td_api::updateAuthorizationState *>(response.object.get())->authorization_state_->get_id() ==
@@ -546,7 +790,6 @@ class ClientManager::Impl final {
         pool_.try_clear();
       }
     }
-    return response;
   }
 
   void close_impl(ClientId client_id) {
@@ -562,7 +805,8 @@ class ClientManager::Impl final {
     }
   }
 
-  Impl() = default;
+  explicit Impl(int32 receive_queue_count = 1) : receiver_(receive_queue_count) {
+  }
   Impl(const Impl &) = delete;
   Impl &operator=(const Impl &) = delete;
   Impl(Impl &&) = delete;
@@ -575,8 +819,13 @@ class ClientManager::Impl final {
     for (auto &it : impls_) {
       close_impl(it.first);
     }
+    auto queue_count = receiver_.get_queue_count();
+    vector<Response> responses;
     while (!impls_.empty() && !ExitGuard::is_exited()) {
-      receive(0.1);
+      for (int32 queue_id = 0; queue_id < queue_count; queue_id++) {
+        receive(queue_id, 0.1 / queue_count, std::numeric_limits<size_t>::max(), responses);
+        responses.clear();
+      }
     }
   }
 
@@ -667,6 +916,9 @@ Client::~Client() = default;
 ClientManager::ClientManager() : impl_(std::make_unique<Impl>()) {
 }
 
+ClientManager::ClientManager(int32 receive_queue_count) : impl_(std::make_unique<Impl>(max(receive_queue_count, 1))) {
+}
+
 ClientManager::ClientId ClientManager::create_client_id() {
   return impl_->create_client_id();
 }
@@ -675,14 +927,47 @@ void ClientManager::send(ClientId client_id, RequestId request_id, td_api::objec
   impl_->send(client_id, request_id, std::move(request));
 }
 
+static void check_single_receive_queue(int32 receive_queue_count) {
+  if (receive_queue_count != 1) {
+    LOG(FATAL) << "Receive queue identifier must be specified if there are several receive queues";
+  }
+}
+
 ClientManager::Response ClientManager::receive(double timeout) {
+  check_single_receive_queue(impl_->get_receive_queue_count());
   return impl_->receive(timeout);
 }
 
+size_t ClientManager::receive(double timeout, size_t max_response_count, std::vector<Response> &responses) {
+  check_single_receive_queue(impl_->get_receive_queue_count());
+  return impl_->receive(0, timeout, max_response_count, responses);
+}
+
+int32 ClientManager::get_receive_queue_count() const {
+  return impl_->get_receive_queue_count();
+}
+
+int32 ClientManager::get_receive_queue_id(ClientId client_id) const {
+  return impl_->get_receive_queue_id(client_id);
+}
+
+size_t ClientManager::receive(int32 queue_id, double timeout, size_t max_response_count,
+                              std::vector<Response> &responses) {
+  return impl_->receive(queue_id, timeout, max_response_count, responses);
+}
+
 td_api::object_ptr<td_api::Object> ClientManager::execute(td_api::object_ptr<td_api::Function> &&request) {
   return Td::static_request(std::move(request));
 }
 
+bool ClientManager::set_thread_options(ThreadOptions options) {
+#if TD_THREAD_UNSUPPORTED || TD_EVENTFD_UNSUPPORTED
+  return false;
+#else
+  return MultiImplPool::set_thread_options(std::move(options));
+#endif
+}
+
 static std::atomic<ClientManager::LogMessageCallbackPtr> log_message_callback;
 
 static void log_message_callback_wrapper(int verbosity_level, CSlice message) {
@@ -11,8 +11,10 @@
 #include "td/telegram/td_api.h"
 #include "td/telegram/td_api.hpp"
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace td {
 
@@ -24,7 +26,9 @@ namespace td {
  * New updates and responses to requests can be received using the method ClientManager::receive from any thread after
  * the first request has been sent to the client instance. ClientManager::receive must not be called simultaneously from
  * two different threads. Also, note that all updates and responses to requests should be applied in the same order as
- * they were received, to ensure consistency.
+ * they were received, to ensure consistency. If updates need to be processed in parallel, then the client manager can
+ * be created with several receive queues. All updates and responses for a client instance are delivered to the same
+ * queue, and different queues can be processed simultaneously from different threads.
  * Some TDLib requests can be executed synchronously from any thread using the method ClientManager::execute.
  *
  * General pattern of usage:
@@ -59,6 +63,13 @@ class ClientManager final {
    */
   ClientManager();
 
+  /**
+   * Creates a new TDLib client manager with the specified number of independent queues for incoming updates and
+   * responses to requests. All updates and responses for a TDLib client instance are delivered to the same queue.
+   * \param[in] receive_queue_count The number of receive queues. Must be positive.
+   */
+  explicit ClientManager(std::int32_t receive_queue_count);
+
   /**
    * Opaque TDLib client instance identifier.
    */
@@ -108,13 +119,51 @@ class ClientManager final {
 
   /**
    * Receives incoming updates and responses to requests from TDLib. May be called from any thread, but must not be
-   * called simultaneously from two different threads.
+   * called simultaneously from two different threads. Can be used only if the client manager has one receive queue.
    * \param[in] timeout The maximum number of seconds allowed for this function to wait for new data.
    * \return An incoming update or response to a request. The object returned in the response may be a nullptr
    *         if the timeout expires.
    */
   Response receive(double timeout);
 
+  /**
+   * Receives up to max_response_count incoming updates and responses to requests from TDLib and appends them to
+   * responses. Waits only if there are no pending updates and responses. May be called from any thread, but must not
+   * be called simultaneously from two different threads. Can be used only if the client manager has one receive queue.
+   * \param[in] timeout The maximum number of seconds allowed for this function to wait for new data.
+   * \param[in] max_response_count The maximum number of updates and responses to receive.
+   * \param[out] responses Vector to which the received updates and responses are appended.
+   * \return The number of received updates and responses.
+   */
+  std::size_t receive(double timeout, std::size_t max_response_count, std::vector<Response> &responses);
+
+  /**
+   * Returns the number of receive queues of the client manager.
+   * \return The number of receive queues.
+   */
+  std::int32_t get_receive_queue_count() const;
+
+  /**
+   * Returns identifier of the receive queue, to which incoming updates and responses to requests for a TDLib client
+   * instance are delivered.
+   * \param[in] client_id TDLib client instance identifier.
+   * \return Receive queue identifier from 0 to get_receive_queue_count() - 1.
+   */
+  std::int32_t get_receive_queue_id(ClientId client_id) const;
+
+  /**
+   * Receives up to max_response_count incoming updates and responses to requests from the specified receive queue and
+   * appends them to responses. Waits only if there are no pending updates and responses in the queue. May be called
+   * from any thread, but must not be called simultaneously from two different threads for the same queue.
+   * \param[in] queue_id Receive queue identifier from 0 to get_receive_queue_count() - 1.
+   * \param[in] timeout The maximum number of seconds allowed for this function to wait for new data.
+   * \param[in] max_response_count The maximum number of updates and responses to receive.
+   * \param[out] responses Vector to which the received updates and responses are appended.
+   * \return The number of received updates and responses.
+   */
+  std::size_t receive(std::int32_t queue_id, double timeout, std::size_t max_response_count,
+                      std::vector<Response> &responses);
+
   /**
    * Synchronously executes a TDLib request.
    * A request can be executed synchronously, only if it is documented with "Can be called synchronously".
@@ -144,6 +193,58 @@ class ClientManager final {
    */
   static void set_log_message_callback(int max_verbosity_level, LogMessageCallbackPtr callback);
 
+  /**
+   * Options of threads running TDLib client instances.
+   */
+  struct ThreadOptions {
+    /**
+     * The number of thread pools among which TDLib client instances are distributed.
+     * Pass 0 to choose the number automatically based on the number of available CPU cores.
+     */
+    std::int32_t pool_count = 0;
+
+    /**
+     * The number of threads in each pool, which run TDLib client instances. Must be positive.
+     */
+    std::int32_t client_thread_count = 1;
+
+    /**
+     * Pass true to make all TDLib client instances from a pool use the same database, file garbage collection and
+     * slow network threads. Otherwise, each thread running TDLib client instances has its own set of such threads.
+     */
+    bool share_service_threads = false;
+
+    /**
+     * The number of additional threads per database thread, which run read-only database queries in parallel using
+     * separate database connections. Pass 0 to run all database queries on the database thread.
+     */
+    std::int32_t database_reader_thread_count = 0;
+
+    /**
+     * The number of additional threads per slow network thread, which decrypt, check and save downloaded file parts.
+     * Pass 0 to process all file parts on the slow network thread.
+     */
+    std::int32_t file_worker_thread_count = 0;
+
+    /**
+     * CPU affinity masks for the threads. The i-th thread of the j-th pool uses the mask with the index
+     * (j * thread_count_per_pool + i) modulo the number of masks. Zero mask or empty list means no affinity.
+     * Client threads of a pool are numbered first, followed by database, file garbage collection, slow network,
+     * database reader and file worker threads for each client thread, or for the pool if service threads are shared.
+     */
+    std::vector<std::uint64_t> thread_affinity_masks;
+  };
+
+  /**
+   * Changes options of threads running TDLib client instances created by any client manager and by the old Client
+   * interface. The options are applied when the first TDLib client instance is created, or when a new instance is
+   * created after all previous instances were closed, so the method should be called before creation of TDLib client
+   * instances. The total number of threads must be less than 128.
+   * \param[in] options New thread options.
+   * \return True, if the options were changed; false, if the options are invalid or threads aren't supported.
+   */
+  static bool set_thread_options(ThreadOptions options);
+
   /**
    * Destroys the client manager and all TDLib client instances managed by it.
    */
@@ -9,6 +9,8 @@
 #include "td/telegram/td_api.h"
 #include "td/telegram/td_api_json.h"
 
+#include "td/tl/tl_json.h"
+
 #include "td/utils/common.h"
 #include "td/utils/FlatHashMap.h"
 #include "td/utils/JsonBuilder.h"
@@ -17,6 +19,9 @@
 #include "td/utils/StackAllocator.h"
 #include "td/utils/StringBuilder.h"
 
+#include <array>
+#include <atomic>
+#include <mutex>
 #include <utility>
 
 namespace td {
@@ -26,7 +31,7 @@ static td_api::object_ptr<td_api::Function> get_return_error_function(Slice erro
   return td_api::make_object<td_api::testReturnError>(std::move(error));
 }
 
-static std::pair<td_api::object_ptr<td_api::Function>, string> to_request(Slice request) {
+static std::pair<td_api::object_ptr<td_api::Function>, string> decode_request(Slice request) {
   auto request_str = request.str();
   auto r_json_value = json_decode(request_str);
   if (r_json_value.is_error()) {
@@ -53,7 +58,29 @@ static std::pair<td_api::object_ptr<td_api::Function>, string> to_request(Slice
   return std::make_pair(std::move(func), std::move(extra));
 }
 
-static string from_response(const td_api::Object &object, const string &extra, int client_id) {
+static std::pair<td_api::object_ptr<td_api::Function>, string> to_request(Slice request) {
+  auto request_str = request.str();
+  TlJsonParser parser(request_str);
+  if (parser.get_value_type() == JsonValue::Type::Object) {
+    parser.set_saved_field_name("@extra");
+    td_api::object_ptr<td_api::Function> func;
+    if (td_api::from_json(func, parser).is_ok() && parser.finish().is_ok()) {
+      string extra;
+      auto extra_value = parser.get_saved_field_value();
+      if (!extra_value.empty()) {
+        // the value must be returned in the same form as after json_decode
+        auto extra_str = extra_value.str();
+        extra = json_encode<string>(json_decode(extra_str).move_as_ok());
+      }
+      return std::make_pair(std::move(func), std::move(extra));
+    }
+  }
+
+  // the request is invalid; decode it to JsonValue to return the same error as before
+  return decode_request(request);
+}
+
+static void append_response(string &output, const td_api::Object &object, Slice extra, int client_id) {
   auto buf = StackAllocator::alloc(1 << 18);
   JsonBuilder jb(StringBuilder(buf.as_slice(), true), -1);
   jb.enter_value() << ToJson(object);
@@ -68,15 +95,23 @@ static string from_response(const td_api::Object &object, const string &extra, i
     sb << ",\"@client_id\":" << client_id;
   }
   sb << '}';
-  return sb.as_cslice().str();
+  slice = sb.as_cslice();
+  output.append(slice.data(), slice.size() + 1);  // with the terminating null character
 }
 
+// the output buffer is reused between calls in the same thread to avoid reallocations for every response
 static TD_THREAD_LOCAL string *current_output;
 
-static const char *store_string(string str) {
+static string &get_output() {
   init_thread_local<string>(current_output);
-  *current_output = std::move(str);
-  return current_output->c_str();
+  current_output->clear();
+  return *current_output;
+}
+
+static const char *store_response(const td_api::Object &object, Slice extra, int client_id) {
+  auto &output = get_output();
+  append_response(output, object, extra, client_id);
+  return output.c_str();
 }
 
 void ClientJson::send(Slice request) {
@@ -104,21 +139,62 @@ const char *ClientJson::receive(double timeout) {
       extra_.erase(it);
     }
   }
-  return store_string(from_response(*response.object, extra, 0));
+  return store_response(*response.object, extra, 0);
 }
 
 const char *ClientJson::execute(Slice request) {
   auto parsed_request = to_request(request);
-  return store_string(from_response(*Client::execute(Client::Request{0, std::move(parsed_request.first)}).object,
-                                    parsed_request.second, 0));
+  return store_response(*Client::execute(Client::Request{0, std::move(parsed_request.first)}).object,
+                        parsed_request.second, 0);
 }
 
 static ClientManager *get_manager() {
   return ClientManager::get_manager_singleton();
 }
 
-static std::mutex extra_mutex;
-static FlatHashMap<int64, string> extra;
+// @extra of requests is stored in shards chosen by client identifier to avoid contention between different clients
+class JsonExtraStorage {
+ public:
+  void add(int client_id, uint64 request_id, string extra) {
+    auto &shard = get_shard(client_id);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    shard.extra[request_id] = std::move(extra);
+    shard.extra_count.store(shard.extra.size(), std::memory_order_release);
+  }
+
+  string extract(int client_id, uint64 request_id) {
+    auto &shard = get_shard(client_id);
+    // the extra was added before the request was sent, so it is always visible when the response is received
+    if (shard.extra_count.load(std::memory_order_acquire) == 0) {
+      return string();
+    }
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto it = shard.extra.find(request_id);
+    if (it == shard.extra.end()) {
+      return string();
+    }
+    auto result = std::move(it->second);
+    shard.extra.erase(it);
+    shard.extra_count.store(shard.extra.size(), std::memory_order_release);
+    return result;
+  }
+
+ private:
+  static constexpr size_t SHARD_COUNT = 64;
+
+  struct Shard {
+    std::mutex mutex;
+    FlatHashMap<uint64, string> extra;
+    std::atomic<size_t> extra_count{0};
+  };
+  std::array<Shard, SHARD_COUNT> shards_;
+
+  Shard &get_shard(int client_id) {
+    return shards_[static_cast<uint32>(client_id) % SHARD_COUNT];
+  }
+};
+
+static JsonExtraStorage json_extra_storage;
 static std::atomic<uint64> extra_id{1};
 
 int json_create_client_id() {
@@ -129,34 +205,61 @@ void json_send(int client_id, Slice request) {
   auto parsed_request = to_request(request);
   auto request_id = extra_id.fetch_add(1, std::memory_order_relaxed);
   if (!parsed_request.second.empty()) {
-    std::lock_guard<std::mutex> guard(extra_mutex);
-    extra[request_id] = std::move(parsed_request.second);
+    json_extra_storage.add(client_id, request_id, std::move(parsed_request.second));
   }
   get_manager()->send(client_id, request_id, std::move(parsed_request.first));
 }
 
+static void append_response(string &output, const ClientManager::Response &response) {
+  string extra;
+  if (response.request_id != 0) {
+    extra = json_extra_storage.extract(response.client_id, response.request_id);
+  }
+  append_response(output, *response.object, extra, response.client_id);
+}
+
 const char *json_receive(double timeout) {
   auto response = get_manager()->receive(timeout);
   if (!response.object) {
     return nullptr;
   }
 
-  string extra_str;
-  if (response.request_id != 0) {
-    std::lock_guard<std::mutex> guard(extra_mutex);
-    auto it = extra.find(response.request_id);
-    if (it != extra.end()) {
-      extra_str = std::move(it->second);
-      extra.erase(it);
-    }
+  auto &output = get_output();
+  append_response(output, response);
+  return output.c_str();
+}
+
+static TD_THREAD_LOCAL vector<ClientManager::Response> *current_responses;
+
+int json_receive(double timeout, int max_response_count, const char *&result, size_t &result_length) {
+  result = nullptr;
+  result_length = 0;
+  if (max_response_count <= 0) {
+    return 0;
   }
-  return store_string(from_response(*response.object, extra_str, response.client_id));
+
+  init_thread_local<vector<ClientManager::Response>>(current_responses);
+  auto &responses = *current_responses;
+  auto response_count =
+      static_cast<int>(get_manager()->receive(timeout, static_cast<size_t>(max_response_count), responses));
+  if (response_count == 0) {
+    return 0;
+  }
+
+  auto &output = get_output();
+  for (auto &response : responses) {
+    append_response(output, response);
+  }
+  responses.clear();
+
+  result = output.c_str();
+  result_length = output.size();
+  return response_count;
 }
 
 const char *json_execute(Slice request) {
   auto parsed_request = to_request(request);
-  return store_string(
-      from_response(*ClientManager::execute(std::move(parsed_request.first)), parsed_request.second, 0));
+  return store_response(*ClientManager::execute(std::move(parsed_request.first)), parsed_request.second, 0);
 }
 
 }  // namespace td
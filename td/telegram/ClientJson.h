@@ -40,6 +40,9 @@ void json_send(int client_id, Slice request);
 
 const char *json_receive(double timeout);
 
+// receives up to max_response_count responses, which are stored one after another as null-terminated strings
+int json_receive(double timeout, int max_response_count, const char *&result, size_t &result_length);
+
 const char *json_execute(Slice request);
 
 }  // namespace td
@@ -262,6 +262,33 @@ void Global::set_net_query_stats(std::shared_ptr<NetQueryStats> net_query_stats)
       [net_query_stats = std::move(net_query_stats)] { return td::make_unique<NetQueryCreator>(net_query_stats); });
 }
 
+void Global::set_service_scheduler_ids(int32 database_scheduler_id, int32 gc_scheduler_id,
+                                       int32 slow_net_scheduler_id) {
+  auto max_scheduler_id = Scheduler::instance()->sched_count() - 1;
+  CHECK(0 <= database_scheduler_id && database_scheduler_id <= max_scheduler_id);
+  CHECK(0 <= gc_scheduler_id && gc_scheduler_id <= max_scheduler_id);
+  CHECK(0 <= slow_net_scheduler_id && slow_net_scheduler_id <= max_scheduler_id);
+  database_scheduler_id_ = database_scheduler_id;
+  gc_scheduler_id_ = gc_scheduler_id;
+  slow_net_scheduler_id_ = slow_net_scheduler_id;
+}
+
+void Global::set_database_reader_scheduler_ids(vector<int32> database_reader_scheduler_ids) {
+  auto max_scheduler_id = Scheduler::instance()->sched_count() - 1;
+  for (auto scheduler_id : database_reader_scheduler_ids) {
+    CHECK(0 <= scheduler_id && scheduler_id <= max_scheduler_id);
+  }
+  database_reader_scheduler_ids_ = std::move(database_reader_scheduler_ids);
+}
+
+void Global::set_file_worker_scheduler_ids(vector<int32> file_worker_scheduler_ids) {
+  auto max_scheduler_id = Scheduler::instance()->sched_count() - 1;
+  for (auto scheduler_id : file_worker_scheduler_ids) {
+    CHECK(0 <= scheduler_id && scheduler_id <= max_scheduler_id);
+  }
+  file_worker_scheduler_ids_ = std::move(file_worker_scheduler_ids);
+}
+
 void Global::set_net_query_dispatcher(unique_ptr<NetQueryDispatcher> net_query_dispatcher) {
   net_query_dispatcher_ = std::move(net_query_dispatcher);
 }
@@ -134,6 +134,12 @@ class Global final : public ActorContext {
 
   void set_net_query_stats(std::shared_ptr<NetQueryStats> net_query_stats);
 
+  void set_service_scheduler_ids(int32 database_scheduler_id, int32 gc_scheduler_id, int32 slow_net_scheduler_id);
+
+  void set_database_reader_scheduler_ids(vector<int32> database_reader_scheduler_ids);
+
+  void set_file_worker_scheduler_ids(vector<int32> file_worker_scheduler_ids);
+
   void set_net_query_dispatcher(unique_ptr<NetQueryDispatcher> net_query_dispatcher);
 
   NetQueryDispatcher &net_query_dispatcher() {
@@ -589,6 +595,14 @@ class Global final : public ActorContext {
     return slow_net_scheduler_id_;
   }
 
+  const vector<int32> &get_database_reader_scheduler_ids() const {
+    return database_reader_scheduler_ids_;
+  }
+
+  const vector<int32> &get_file_worker_scheduler_ids() const {
+    return file_worker_scheduler_ids_;
+  }
+
   DcId get_webfile_dc_id() const;
 
   std::shared_ptr<DhConfig> get_dh_config() {
@@ -735,6 +749,8 @@ class Global final : public ActorContext {
   int32 database_scheduler_id_ = 0;
   int32 gc_scheduler_id_ = 0;
   int32 slow_net_scheduler_id_ = 0;
+  vector<int32> database_reader_scheduler_ids_;
+  vector<int32> file_worker_scheduler_ids_;
 
   std::atomic<bool> store_all_files_in_files_directory_{false};
 
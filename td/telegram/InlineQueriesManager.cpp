@@ -1164,7 +1164,7 @@ template <>
 td_api::object_ptr<td_api::localFile> copy(const td_api::localFile &obj) {
   return td_api::make_object<td_api::localFile>(
       obj.path_, obj.can_be_downloaded_, obj.can_be_deleted_, obj.is_downloading_active_, obj.is_downloading_completed_,
-      obj.download_offset_, obj.downloaded_prefix_size_, obj.downloaded_size_);
+      obj.download_offset_, obj.downloaded_prefix_size_, obj.downloaded_size_, obj.download_speed_);
 }
 template <>
 td_api::object_ptr<td_api::remoteFile> copy(const td_api::remoteFile &obj) {
@@ -12,11 +12,14 @@
 
 #include "td/db/SqliteConnectionSafe.h"
 #include "td/db/SqliteDb.h"
+#include "td/db/SqliteReaderPool.h"
 #include "td/db/SqliteStatement.h"
 
 #include "td/actor/actor.h"
 #include "td/actor/SchedulerLocalStorage.h"
 
+#include "td/utils/FlatHashMap.h"
+#include "td/utils/FlatHashSet.h"
 #include "td/utils/format.h"
 #include "td/utils/logging.h"
 #include "td/utils/ScopeGuard.h"
@@ -41,6 +44,51 @@ namespace td {
 static constexpr int32 MESSAGE_DB_INDEX_COUNT = 30;
 static constexpr int32 MESSAGE_DB_INDEX_COUNT_OLD = 9;
 
+StringBuilder &operator<<(StringBuilder &string_builder, const MessageDbWriteStatistics &statistics) {
+  auto batch_count = static_cast<double>(statistics.batch_count == 0 ? 1 : statistics.batch_count);
+  return string_builder << "MessageDbWriteStatistics[batches = " << statistics.batch_count
+                        << ", writes = " << statistics.write_count
+                        << ", coalesced writes = " << statistics.coalesced_write_count
+                        << ", batch size limit = " << statistics.batch_size_limit
+                        << ", max batch size = " << statistics.max_batch_size
+                        << ", last batch size = " << statistics.last_batch_size
+                        << ", average batch duration = " << statistics.total_batch_duration / batch_count
+                        << ", last batch duration = " << statistics.last_batch_duration
+                        << ", max batch duration = " << statistics.max_batch_duration << ']';
+}
+
+// if FTS indexing is deferred, search_id of added messages are stored in messages_fts_pending and
+// the messages are added to messages_fts later in batches
+static Status create_fts_triggers(SqliteDb &db, bool use_deferred_fts_indexing) {
+  if (!use_deferred_fts_indexing) {
+    TRY_STATUS(db.exec(
+        "CREATE TRIGGER IF NOT EXISTS trigger_fts_delete BEFORE DELETE ON messages WHEN OLD.search_id IS NOT NULL"
+        " BEGIN INSERT INTO messages_fts(messages_fts, rowid, text) VALUES(\'delete\', OLD.search_id, OLD.text); END"));
+    return db.exec(
+        "CREATE TRIGGER IF NOT EXISTS trigger_fts_insert AFTER INSERT ON messages WHEN NEW.search_id IS NOT NULL"
+        " BEGIN INSERT INTO messages_fts(rowid, text) VALUES(NEW.search_id, NEW.text); END");
+  }
+
+  // messages, which weren't indexed yet, must not be deleted from messages_fts
+  TRY_STATUS(db.exec(
+      "CREATE TRIGGER IF NOT EXISTS trigger_fts_delete BEFORE DELETE ON messages WHEN OLD.search_id IS NOT NULL AND "
+      "NOT EXISTS (SELECT 1 FROM messages_fts_pending WHERE search_id = OLD.search_id)"
+      " BEGIN INSERT INTO messages_fts(messages_fts, rowid, text) VALUES(\'delete\', OLD.search_id, OLD.text); END"));
+  TRY_STATUS(db.exec(
+      "CREATE TRIGGER IF NOT EXISTS trigger_fts_pending_delete AFTER DELETE ON messages WHEN OLD.search_id IS NOT NULL"
+      " BEGIN DELETE FROM messages_fts_pending WHERE search_id = OLD.search_id; END"));
+  return db.exec(
+      "CREATE TRIGGER IF NOT EXISTS trigger_fts_pending_insert AFTER INSERT ON messages WHEN NEW.search_id IS NOT NULL"
+      " BEGIN INSERT OR IGNORE INTO messages_fts_pending VALUES(NEW.search_id); END");
+}
+
+static Status drop_fts_triggers(SqliteDb &db) {
+  TRY_STATUS(db.exec("DROP TRIGGER IF EXISTS trigger_fts_delete"));
+  TRY_STATUS(db.exec("DROP TRIGGER IF EXISTS trigger_fts_insert"));
+  TRY_STATUS(db.exec("DROP TRIGGER IF EXISTS trigger_fts_pending_delete"));
+  return db.exec("DROP TRIGGER IF EXISTS trigger_fts_pending_insert");
+}
+
 // NB: must happen inside a transaction
 Status init_message_db(SqliteDb &db, int32 version) {
   LOG(INFO) << "Init message database " << tag("version", version);
@@ -63,7 +111,11 @@ Status init_message_db(SqliteDb &db, int32 version) {
     return Status::OK();
   };
 
-  auto add_fts = [&db] {
+  auto add_fts_pending_table = [&db] {
+    return db.exec("CREATE TABLE IF NOT EXISTS messages_fts_pending (search_id INTEGER PRIMARY KEY)");
+  };
+
+  auto add_fts = [&db, &add_fts_pending_table] {
     TRY_STATUS(
         db.exec("CREATE INDEX IF NOT EXISTS message_by_search_id ON messages "
                 "(search_id) WHERE search_id IS NOT NULL"));
@@ -71,12 +123,7 @@ Status init_message_db(SqliteDb &db, int32 version) {
     TRY_STATUS(
         db.exec("CREATE VIRTUAL TABLE IF NOT EXISTS messages_fts USING fts5(text, content='messages', "
                 "content_rowid='search_id', tokenize = \"unicode61 remove_diacritics 0 tokenchars '\a'\")"));
-    TRY_STATUS(db.exec(
-        "CREATE TRIGGER IF NOT EXISTS trigger_fts_delete BEFORE DELETE ON messages WHEN OLD.search_id IS NOT NULL"
-        " BEGIN INSERT INTO messages_fts(messages_fts, rowid, text) VALUES(\'delete\', OLD.search_id, OLD.text); END"));
-    TRY_STATUS(db.exec(
-        "CREATE TRIGGER IF NOT EXISTS trigger_fts_insert AFTER INSERT ON messages WHEN NEW.search_id IS NOT NULL"
-        " BEGIN INSERT INTO messages_fts(rowid, text) VALUES(NEW.search_id, NEW.text); END"));
+    TRY_STATUS(create_fts_triggers(db, false));
     //TRY_STATUS(db.exec(
     //"CREATE TRIGGER IF NOT EXISTS trigger_fts_update AFTER UPDATE ON messages WHEN NEW.search_id IS NOT NULL OR "
     //"OLD.search_id IS NOT NULL"
@@ -85,7 +132,7 @@ Status init_message_db(SqliteDb &db, int32 version) {
     //"INSERT INTO messages_fts(rowid, text) VALUES(NEW.search_id, NEW.text); "
     //" END"));
 
-    return Status::OK();
+    return add_fts_pending_table();
   };
   auto add_call_index = [&db] {
     for (int i = static_cast<int>(MessageSearchFilter::Call) - 1; i < static_cast<int>(MessageSearchFilter::MissedCall);
@@ -167,6 +214,9 @@ Status init_message_db(SqliteDb &db, int32 version) {
   if (version < static_cast<int32>(DbVersion::AddMessageThreadSupport)) {
     TRY_STATUS(db.exec("ALTER TABLE messages ADD COLUMN top_thread_message_id INT8"));
   }
+  if (version < static_cast<int32>(DbVersion::AddMessageDbFtsPendingTable)) {
+    TRY_STATUS(add_fts_pending_table());
+  }
   return Status::OK();
 }
 
@@ -174,6 +224,7 @@ Status init_message_db(SqliteDb &db, int32 version) {
 Status drop_message_db(SqliteDb &db, int32 version) {
   LOG(WARNING) << "Drop message database " << tag("version", version)
                << tag("current_db_version", current_db_version());
+  TRY_STATUS(db.exec("DROP TABLE IF EXISTS messages_fts_pending"));
   return db.exec("DROP TABLE IF EXISTS messages");
 }
 
@@ -187,6 +238,18 @@ class MessageDbImpl final : public MessageDbSyncInterface {
     TRY_RESULT_ASSIGN(
         add_message_stmt_,
         db_.get_statement("INSERT OR REPLACE INTO messages VALUES(?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11, ?12)"));
+    {
+      auto sb = StringBuilder({}, true);
+      sb << "INSERT OR REPLACE INTO messages VALUES";
+      for (size_t i = 0; i < MAX_ADD_MESSAGES_BATCH_SIZE; i++) {
+        sb << (i == 0 ? "(" : ", (");
+        for (size_t j = 1; j <= ADD_MESSAGE_ARG_COUNT; j++) {
+          sb << (j == 1 ? "?" : ", ?") << i * ADD_MESSAGE_ARG_COUNT + j;
+        }
+        sb << ')';
+      }
+      TRY_RESULT_ASSIGN(add_messages_stmt_, db_.get_statement(sb.as_cslice()));
+    }
     TRY_RESULT_ASSIGN(delete_message_stmt_,
                       db_.get_statement("DELETE FROM messages WHERE dialog_id = ?1 AND message_id = ?2"));
     TRY_RESULT_ASSIGN(delete_all_dialog_messages_stmt_,
@@ -225,6 +288,29 @@ class MessageDbImpl final : public MessageDbSyncInterface {
                                         "IN (SELECT rowid FROM messages_fts WHERE messages_fts MATCH ?1 AND rowid < ?2 "
                                         "ORDER BY rowid DESC LIMIT ?3) ORDER BY search_id DESC"));
 
+    TRY_STATUS(db_.exec(
+        "CREATE VIRTUAL TABLE IF NOT EXISTS temp.messages_fts_unindexed USING fts5(text, "
+        "tokenize = \"unicode61 remove_diacritics 0 tokenchars '\a'\")"));
+    TRY_RESULT_ASSIGN(has_pending_fts_messages_stmt_,
+                      db_.get_statement("SELECT 1 FROM messages_fts_pending WHERE search_id < ?1 LIMIT 1"));
+    TRY_RESULT_ASSIGN(index_pending_fts_messages_stmt_,
+                      db_.get_statement("INSERT INTO messages_fts(rowid, text) SELECT search_id, text FROM messages "
+                                        "WHERE search_id IN (SELECT search_id FROM messages_fts_pending ORDER BY "
+                                        "search_id DESC LIMIT ?1)"));
+    TRY_RESULT_ASSIGN(delete_pending_fts_messages_stmt_,
+                      db_.get_statement("DELETE FROM messages_fts_pending WHERE search_id IN (SELECT search_id FROM "
+                                        "messages_fts_pending ORDER BY search_id DESC LIMIT ?1)"));
+    TRY_RESULT_ASSIGN(add_unindexed_fts_messages_stmt_,
+                      db_.get_statement("INSERT INTO temp.messages_fts_unindexed(rowid, text) SELECT search_id, text "
+                                        "FROM messages WHERE search_id IN (SELECT search_id FROM messages_fts_pending "
+                                        "WHERE search_id < ?1)"));
+    TRY_RESULT_ASSIGN(delete_unindexed_fts_messages_stmt_, db_.get_statement("DELETE FROM temp.messages_fts_unindexed"));
+    TRY_RESULT_ASSIGN(
+        get_unindexed_messages_fts_stmt_,
+        db_.get_statement("SELECT dialog_id, message_id, data, search_id FROM messages WHERE search_id IN (SELECT rowid "
+                          "FROM temp.messages_fts_unindexed WHERE messages_fts_unindexed MATCH ?1 AND rowid < ?2 ORDER "
+                          "BY rowid DESC LIMIT ?3) ORDER BY search_id DESC"));
+
     for (int32 i = 0; i < MESSAGE_DB_INDEX_COUNT; i++) {
       TRY_RESULT_ASSIGN(
           get_message_ids_stmts_[i],
@@ -290,80 +376,34 @@ class MessageDbImpl final : public MessageDbSyncInterface {
   void add_message(MessageFullId message_full_id, ServerMessageId unique_message_id, DialogId sender_dialog_id,
                    int64 random_id, int32 ttl_expires_at, int32 index_mask, int64 search_id, string text,
                    NotificationId notification_id, MessageId top_thread_message_id, BufferSlice data) final {
-    LOG(INFO) << "Add " << message_full_id << " to database";
-    auto dialog_id = message_full_id.get_dialog_id();
-    auto message_id = message_full_id.get_message_id();
-    LOG_CHECK(dialog_id.is_valid()) << dialog_id << ' ' << message_id << ' ' << message_full_id;
-    CHECK(message_id.is_valid());
+    MessageDbAddMessageQuery query{message_full_id, unique_message_id, sender_dialog_id, random_id, ttl_expires_at,
+                                   index_mask, search_id, std::move(text), notification_id, top_thread_message_id,
+                                   std::move(data)};
     SCOPE_EXIT {
       add_message_stmt_.reset();
     };
-    add_message_stmt_.bind_int64(1, dialog_id.get()).ensure();
-    add_message_stmt_.bind_int64(2, message_id.get()).ensure();
-
-    if (unique_message_id.is_valid()) {
-      add_message_stmt_.bind_int32(3, unique_message_id.get()).ensure();
-    } else {
-      add_message_stmt_.bind_null(3).ensure();
-    }
-
-    if (sender_dialog_id.is_valid()) {
-      add_message_stmt_.bind_int64(4, sender_dialog_id.get()).ensure();
-    } else {
-      add_message_stmt_.bind_null(4).ensure();
-    }
-
-    if (random_id != 0) {
-      add_message_stmt_.bind_int64(5, random_id).ensure();
-    } else {
-      add_message_stmt_.bind_null(5).ensure();
-    }
-
-    add_message_stmt_.bind_blob(6, data.as_slice()).ensure();
-
-    if (ttl_expires_at != 0) {
-      add_message_stmt_.bind_int32(7, ttl_expires_at).ensure();
-    } else {
-      add_message_stmt_.bind_null(7).ensure();
-    }
+    bind_message(add_message_stmt_, 0, query);
+    add_message_stmt_.step().ensure();
+  }
 
-    if (index_mask != 0) {
-      add_message_stmt_.bind_int32(8, index_mask).ensure();
-    } else {
-      add_message_stmt_.bind_null(8).ensure();
-    }
-    if (search_id != 0) {
-      // add dialog_id to text
-      text += PSTRING() << " \a" << dialog_id.get();
-      if (index_mask != 0) {
-        for (int i = 0; i < MESSAGE_DB_INDEX_COUNT; i++) {
-          if ((index_mask & (1 << i))) {
-            text += PSTRING() << " \a\a" << i;
-          }
-        }
+  void add_messages(vector<MessageDbAddMessageQuery> queries) final {
+    size_t pos = 0;
+    for (; pos + MAX_ADD_MESSAGES_BATCH_SIZE <= queries.size(); pos += MAX_ADD_MESSAGES_BATCH_SIZE) {
+      SCOPE_EXIT {
+        add_messages_stmt_.reset();
+      };
+      for (size_t i = 0; i < MAX_ADD_MESSAGES_BATCH_SIZE; i++) {
+        bind_message(add_messages_stmt_, static_cast<int>(i * ADD_MESSAGE_ARG_COUNT), queries[pos + i]);
       }
-      add_message_stmt_.bind_int64(9, search_id).ensure();
-    } else {
-      text = "";
-      add_message_stmt_.bind_null(9).ensure();
-    }
-    if (!text.empty()) {
-      add_message_stmt_.bind_string(10, text).ensure();
-    } else {
-      add_message_stmt_.bind_null(10).ensure();
+      add_messages_stmt_.step().ensure();
     }
-    if (notification_id.is_valid()) {
-      add_message_stmt_.bind_int32(11, notification_id.get()).ensure();
-    } else {
-      add_message_stmt_.bind_null(11).ensure();
+    for (; pos < queries.size(); pos++) {
+      SCOPE_EXIT {
+        add_message_stmt_.reset();
+      };
+      bind_message(add_message_stmt_, 0, queries[pos]);
+      add_message_stmt_.step().ensure();
     }
-    if (top_thread_message_id.is_valid()) {
-      add_message_stmt_.bind_int64(12, top_thread_message_id.get()).ensure();
-    } else {
-      add_message_stmt_.bind_null(12).ensure();
-    }
-
-    add_message_stmt_.step().ensure();
   }
 
   void add_scheduled_message(MessageFullId message_full_id, BufferSlice data) final {
@@ -736,10 +776,6 @@ class MessageDbImpl final : public MessageDbSyncInterface {
   }
 
   MessageDbFtsResult get_messages_fts(MessageDbFtsQuery query) final {
-    SCOPE_EXIT {
-      get_messages_fts_stmt_.reset();
-    };
-
     LOG(INFO) << tag("query", query.query) << query.dialog_id << tag("filter", query.filter)
               << tag("from_search_id", query.from_search_id) << tag("limit", query.limit);
     string words = prepare_query(query.query);
@@ -755,31 +791,74 @@ class MessageDbImpl final : public MessageDbSyncInterface {
       words += PSTRING() << " \"\a\a" << message_search_filter_index(query.filter) << "\"";
     }
 
-    auto &stmt = get_messages_fts_stmt_;
-    stmt.bind_string(1, words).ensure();
     if (query.from_search_id == 0) {
       query.from_search_id = std::numeric_limits<int64>::max();
     }
-    stmt.bind_int64(2, query.from_search_id).ensure();
-    stmt.bind_int32(3, query.limit).ensure();
     MessageDbFtsResult result;
-    auto status = stmt.step();
-    if (status.is_error()) {
-      LOG(ERROR) << status;
+    vector<std::pair<int64, MessageDbMessage>> messages;
+    if (!get_messages_fts_impl(get_messages_fts_stmt_, words, query.from_search_id, query.limit, messages)) {
       return result;
     }
-    while (stmt.has_row()) {
-      DialogId dialog_id(stmt.view_int64(0));
-      MessageId message_id(stmt.view_int64(1));
-      auto data_slice = stmt.view_blob(2);
-      auto search_id = stmt.view_int64(3);
-      result.next_search_id = search_id;
-      result.messages.push_back(MessageDbMessage{dialog_id, message_id, BufferSlice(data_slice)});
-      stmt.step().ensure();
+
+    if (has_pending_fts_messages(query.from_search_id)) {
+      // some messages aren't indexed yet, so index them in a temporary table and search there too
+      SCOPE_EXIT {
+        delete_unindexed_fts_messages_stmt_.step().ensure();
+        delete_unindexed_fts_messages_stmt_.reset();
+      };
+      add_unindexed_fts_messages_stmt_.bind_int64(1, query.from_search_id).ensure();
+      auto status = add_unindexed_fts_messages_stmt_.step();
+      add_unindexed_fts_messages_stmt_.reset();
+      if (status.is_error()) {
+        LOG(ERROR) << status;
+      } else if (get_messages_fts_impl(get_unindexed_messages_fts_stmt_, words, query.from_search_id, query.limit,
+                                       messages)) {
+        std::sort(messages.begin(), messages.end(),
+                  [](const auto &lhs, const auto &rhs) { return lhs.first > rhs.first; });
+        // a re-added message can be found in both tables, because its old text is still in messages_fts
+        messages.erase(std::unique(messages.begin(), messages.end(),
+                                   [](const auto &lhs, const auto &rhs) { return lhs.first == rhs.first; }),
+                       messages.end());
+        if (messages.size() > static_cast<size_t>(query.limit)) {
+          messages.resize(static_cast<size_t>(query.limit));
+        }
+      }
+    }
+
+    for (auto &message : messages) {
+      result.next_search_id = message.first;
+      result.messages.push_back(std::move(message.second));
     }
     return result;
   }
 
+  Status set_use_deferred_fts_indexing(bool use_deferred_fts_indexing) final {
+    TRY_STATUS(drop_fts_triggers(db_));
+    if (!use_deferred_fts_indexing) {
+      TRY_STATUS(
+          db_.exec("INSERT INTO messages_fts(rowid, text) SELECT search_id, text FROM messages WHERE search_id IN "
+                   "(SELECT search_id FROM messages_fts_pending)"));
+      TRY_STATUS(db_.exec("DELETE FROM messages_fts_pending"));
+    }
+    return create_fts_triggers(db_, use_deferred_fts_indexing);
+  }
+
+  bool index_pending_fts_messages(int32 limit) final {
+    index_pending_fts_messages_stmt_.bind_int32(1, limit).ensure();
+    index_pending_fts_messages_stmt_.step().ensure();
+    index_pending_fts_messages_stmt_.reset();
+
+    delete_pending_fts_messages_stmt_.bind_int32(1, limit).ensure();
+    delete_pending_fts_messages_stmt_.step().ensure();
+    delete_pending_fts_messages_stmt_.reset();
+
+    return has_pending_fts_messages();
+  }
+
+  bool has_pending_fts_messages() final {
+    return has_pending_fts_messages(std::numeric_limits<int64>::max());
+  }
+
   vector<MessageDbDialogMessage> get_messages_from_index(DialogId dialog_id, MessageId from_message_id,
                                                          MessageSearchFilter filter, int32 offset, int32 limit) {
     auto &stmt = get_messages_from_index_stmts_[message_search_filter_index(filter)];
@@ -826,7 +905,11 @@ class MessageDbImpl final : public MessageDbSyncInterface {
  private:
   SqliteDb db_;
 
+  static constexpr size_t ADD_MESSAGE_ARG_COUNT = 12;
+  static constexpr size_t MAX_ADD_MESSAGES_BATCH_SIZE = 32;
+
   SqliteStatement add_message_stmt_;
+  SqliteStatement add_messages_stmt_;
 
   SqliteStatement delete_message_stmt_;
   SqliteStatement delete_all_dialog_messages_stmt_;
@@ -850,6 +933,12 @@ class MessageDbImpl final : public MessageDbSyncInterface {
   std::array<SqliteStatement, 2> get_calls_stmts_;
 
   SqliteStatement get_messages_fts_stmt_;
+  SqliteStatement has_pending_fts_messages_stmt_;
+  SqliteStatement index_pending_fts_messages_stmt_;
+  SqliteStatement delete_pending_fts_messages_stmt_;
+  SqliteStatement add_unindexed_fts_messages_stmt_;
+  SqliteStatement delete_unindexed_fts_messages_stmt_;
+  SqliteStatement get_unindexed_messages_fts_stmt_;
 
   SqliteStatement add_scheduled_message_stmt_;
   SqliteStatement get_scheduled_message_stmt_;
@@ -857,6 +946,114 @@ class MessageDbImpl final : public MessageDbSyncInterface {
   SqliteStatement delete_scheduled_message_stmt_;
   SqliteStatement delete_scheduled_server_message_stmt_;
 
+  static void bind_message(SqliteStatement &stmt, int arg_offset, MessageDbAddMessageQuery &query) {
+    auto message_full_id = query.message_full_id;
+    LOG(INFO) << "Add " << message_full_id << " to database";
+    auto dialog_id = message_full_id.get_dialog_id();
+    auto message_id = message_full_id.get_message_id();
+    LOG_CHECK(dialog_id.is_valid()) << dialog_id << ' ' << message_id << ' ' << message_full_id;
+    CHECK(message_id.is_valid());
+    stmt.bind_int64(arg_offset + 1, dialog_id.get()).ensure();
+    stmt.bind_int64(arg_offset + 2, message_id.get()).ensure();
+
+    if (query.unique_message_id.is_valid()) {
+      stmt.bind_int32(arg_offset + 3, query.unique_message_id.get()).ensure();
+    } else {
+      stmt.bind_null(arg_offset + 3).ensure();
+    }
+
+    if (query.sender_dialog_id.is_valid()) {
+      stmt.bind_int64(arg_offset + 4, query.sender_dialog_id.get()).ensure();
+    } else {
+      stmt.bind_null(arg_offset + 4).ensure();
+    }
+
+    if (query.random_id != 0) {
+      stmt.bind_int64(arg_offset + 5, query.random_id).ensure();
+    } else {
+      stmt.bind_null(arg_offset + 5).ensure();
+    }
+
+    stmt.bind_blob(arg_offset + 6, query.data.as_slice()).ensure();
+
+    if (query.ttl_expires_at != 0) {
+      stmt.bind_int32(arg_offset + 7, query.ttl_expires_at).ensure();
+    } else {
+      stmt.bind_null(arg_offset + 7).ensure();
+    }
+
+    auto index_mask = query.index_mask;
+    if (index_mask != 0) {
+      stmt.bind_int32(arg_offset + 8, index_mask).ensure();
+    } else {
+      stmt.bind_null(arg_offset + 8).ensure();
+    }
+    auto &text = query.text;
+    if (query.search_id != 0) {
+      // add dialog_id to text
+      text += PSTRING() << " \a" << dialog_id.get();
+      if (index_mask != 0) {
+        for (int i = 0; i < MESSAGE_DB_INDEX_COUNT; i++) {
+          if ((index_mask & (1 << i))) {
+            text += PSTRING() << " \a\a" << i;
+          }
+        }
+      }
+      stmt.bind_int64(arg_offset + 9, query.search_id).ensure();
+    } else {
+      text = "";
+      stmt.bind_null(arg_offset + 9).ensure();
+    }
+    if (!text.empty()) {
+      stmt.bind_string(arg_offset + 10, text).ensure();
+    } else {
+      stmt.bind_null(arg_offset + 10).ensure();
+    }
+    if (query.notification_id.is_valid()) {
+      stmt.bind_int32(arg_offset + 11, query.notification_id.get()).ensure();
+    } else {
+      stmt.bind_null(arg_offset + 11).ensure();
+    }
+    if (query.top_thread_message_id.is_valid()) {
+      stmt.bind_int64(arg_offset + 12, query.top_thread_message_id.get()).ensure();
+    } else {
+      stmt.bind_null(arg_offset + 12).ensure();
+    }
+  }
+
+  bool has_pending_fts_messages(int64 max_search_id) {
+    SCOPE_EXIT {
+      has_pending_fts_messages_stmt_.reset();
+    };
+    has_pending_fts_messages_stmt_.bind_int64(1, max_search_id).ensure();
+    has_pending_fts_messages_stmt_.step().ensure();
+    return has_pending_fts_messages_stmt_.has_row();
+  }
+
+  static bool get_messages_fts_impl(SqliteStatement &stmt, Slice words, int64 from_search_id, int32 limit,
+                                    vector<std::pair<int64, MessageDbMessage>> &messages) {
+    SCOPE_EXIT {
+      stmt.reset();
+    };
+    stmt.bind_string(1, words).ensure();
+    stmt.bind_int64(2, from_search_id).ensure();
+    stmt.bind_int32(3, limit).ensure();
+    auto status = stmt.step();
+    if (status.is_error()) {
+      LOG(ERROR) << status;
+      return false;
+    }
+    while (stmt.has_row()) {
+      DialogId dialog_id(stmt.view_int64(0));
+      MessageId message_id(stmt.view_int64(1));
+      auto data_slice = stmt.view_blob(2);
+      auto search_id = stmt.view_int64(3);
+      messages.emplace_back(search_id, MessageDbMessage{dialog_id, message_id, BufferSlice(data_slice)});
+      stmt.step().ensure();
+    }
+    return true;
+  }
+
   static vector<MessageDbDialogMessage> get_messages_impl(GetMessagesStmt &stmt, DialogId dialog_id,
                                                           MessageId from_message_id, int32 offset, int32 limit) {
     LOG_CHECK(dialog_id.is_valid()) << dialog_id;
@@ -984,8 +1181,10 @@ std::shared_ptr<MessageDbSyncSafeInterface> create_message_db_sync(
 
 class MessageDbAsync final : public MessageDbAsyncInterface {
  public:
-  MessageDbAsync(std::shared_ptr<MessageDbSyncSafeInterface> sync_db, int32 scheduler_id) {
-    impl_ = create_actor_on_scheduler<Impl>("MessageDbActor", scheduler_id, std::move(sync_db));
+  MessageDbAsync(std::shared_ptr<MessageDbSyncSafeInterface> sync_db, int32 scheduler_id,
+                 vector<int32> reader_scheduler_ids) {
+    impl_ = create_actor_on_scheduler<Impl>("MessageDbActor", scheduler_id, std::move(sync_db),
+                                            std::move(reader_scheduler_ids));
   }
 
   void add_message(MessageFullId message_full_id, ServerMessageId unique_message_id, DialogId sender_dialog_id,
@@ -1055,6 +1254,14 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
     send_closure_later(impl_, &Impl::get_expiring_messages, expires_till, limit, std::move(promise));
   }
 
+  void set_use_deferred_fts_indexing(bool use_deferred_fts_indexing, Promise<> promise) final {
+    send_closure_later(impl_, &Impl::set_use_deferred_fts_indexing, use_deferred_fts_indexing, std::move(promise));
+  }
+
+  void get_write_statistics(Promise<MessageDbWriteStatistics> promise) final {
+    send_closure_later(impl_, &Impl::get_write_statistics, std::move(promise));
+  }
+
   void close(Promise<> promise) final {
     send_closure_later(impl_, &Impl::close, std::move(promise));
   }
@@ -1066,22 +1273,33 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
  private:
   class Impl final : public Actor {
    public:
-    explicit Impl(std::shared_ptr<MessageDbSyncSafeInterface> sync_db_safe) : sync_db_safe_(std::move(sync_db_safe)) {
+    Impl(std::shared_ptr<MessageDbSyncSafeInterface> sync_db_safe, vector<int32> reader_scheduler_ids)
+        : sync_db_safe_(std::move(sync_db_safe)), reader_scheduler_ids_(std::move(reader_scheduler_ids)) {
     }
     void add_message(MessageFullId message_full_id, ServerMessageId unique_message_id, DialogId sender_dialog_id,
                      int64 random_id, int32 ttl_expires_at, int32 index_mask, int64 search_id, string text,
                      NotificationId notification_id, MessageId top_thread_message_id, BufferSlice data,
                      Promise<> promise) {
-      add_write_query([this, message_full_id, unique_message_id, sender_dialog_id, random_id, ttl_expires_at,
-                       index_mask, search_id, text = std::move(text), notification_id, top_thread_message_id,
-                       data = std::move(data), promise = std::move(promise)](Unit) mutable {
-        sync_db_->add_message(message_full_id, unique_message_id, sender_dialog_id, random_id, ttl_expires_at,
-                              index_mask, search_id, std::move(text), notification_id, top_thread_message_id,
-                              std::move(data));
-        on_write_result(std::move(promise));
-      });
+      MessageDbAddMessageQuery query{message_full_id, unique_message_id, sender_dialog_id, random_id, ttl_expires_at,
+                                     index_mask, search_id, std::move(text), notification_id, top_thread_message_id,
+                                     std::move(data)};
+      auto it = pending_add_message_pos_.find(message_full_id);
+      if (it != pending_add_message_pos_.end()) {
+        // the message hasn't been written yet, so it is enough to replace the pending query
+        auto &pending_add_message = pending_add_messages_[it->second];
+        pending_add_message.query = std::move(query);
+        finished_writes_.push_back(std::move(pending_add_message.promise));
+        pending_add_message.promise = std::move(promise);
+        statistics_.coalesced_write_count++;
+        return;
+      }
+      pending_write_dialog_ids_.insert(message_full_id.get_dialog_id());
+      pending_add_message_pos_.emplace(message_full_id, pending_add_messages_.size());
+      pending_add_messages_.push_back(PendingAddMessage{std::move(query), std::move(promise), false});
+      on_write_query_added();
     }
     void add_scheduled_message(MessageFullId message_full_id, BufferSlice data, Promise<> promise) {
+      pending_write_dialog_ids_.insert(message_full_id.get_dialog_id());
       add_write_query([this, message_full_id, promise = std::move(promise), data = std::move(data)](Unit) mutable {
         sync_db_->add_scheduled_message(message_full_id, std::move(data));
         on_write_result(std::move(promise));
@@ -1089,6 +1307,16 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
     }
 
     void delete_message(MessageFullId message_full_id, Promise<> promise) {
+      auto it = pending_add_message_pos_.find(message_full_id);
+      if (it != pending_add_message_pos_.end()) {
+        // pending additions are applied after other pending writes, so the addition must be dropped
+        auto &pending_add_message = pending_add_messages_[it->second];
+        pending_add_message.is_canceled = true;
+        finished_writes_.push_back(std::move(pending_add_message.promise));
+        pending_add_message_pos_.erase(it);
+        statistics_.coalesced_write_count++;
+      }
+      pending_write_dialog_ids_.insert(message_full_id.get_dialog_id());
       add_write_query([this, message_full_id, promise = std::move(promise)](Unit) mutable {
         sync_db_->delete_message(message_full_id);
         on_write_result(std::move(promise));
@@ -1101,77 +1329,118 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
     }
 
     void delete_all_dialog_messages(DialogId dialog_id, MessageId from_message_id, Promise<> promise) {
-      add_read_query();
+      do_flush();
       sync_db_->delete_all_dialog_messages(dialog_id, from_message_id);
       promise.set_value(Unit());
     }
 
     void delete_dialog_messages_by_sender(DialogId dialog_id, DialogId sender_dialog_id, Promise<> promise) {
-      add_read_query();
+      do_flush();
       sync_db_->delete_dialog_messages_by_sender(dialog_id, sender_dialog_id);
       promise.set_value(Unit());
     }
 
     void get_message(MessageFullId message_full_id, Promise<MessageDbDialogMessage> promise) {
-      add_read_query();
-      promise.set_result(sync_db_->get_message(message_full_id));
+      add_read_query(message_full_id.get_dialog_id(),
+                     [message_full_id, promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+                       promise.set_result(sync_db.get_message(message_full_id));
+                     });
     }
     void get_message_by_unique_message_id(ServerMessageId unique_message_id, Promise<MessageDbMessage> promise) {
-      add_read_query();
-      promise.set_result(sync_db_->get_message_by_unique_message_id(unique_message_id));
+      add_read_query(DialogId(),
+                     [unique_message_id, promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+                       promise.set_result(sync_db.get_message_by_unique_message_id(unique_message_id));
+                     });
     }
     void get_message_by_random_id(DialogId dialog_id, int64 random_id, Promise<MessageDbDialogMessage> promise) {
-      add_read_query();
-      promise.set_result(sync_db_->get_message_by_random_id(dialog_id, random_id));
+      add_read_query(dialog_id,
+                     [dialog_id, random_id, promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+                       promise.set_result(sync_db.get_message_by_random_id(dialog_id, random_id));
+                     });
     }
     void get_dialog_message_by_date(DialogId dialog_id, MessageId first_message_id, MessageId last_message_id,
                                     int32 date, Promise<MessageDbDialogMessage> promise) {
-      add_read_query();
-      promise.set_result(sync_db_->get_dialog_message_by_date(dialog_id, first_message_id, last_message_id, date));
+      add_read_query(dialog_id, [dialog_id, first_message_id, last_message_id, date,
+                                 promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+        promise.set_result(sync_db.get_dialog_message_by_date(dialog_id, first_message_id, last_message_id, date));
+      });
     }
 
     void get_dialog_message_calendar(MessageDbDialogCalendarQuery query, Promise<MessageDbCalendar> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_dialog_message_calendar(std::move(query)));
+      auto dialog_id = query.dialog_id;
+      add_read_query(dialog_id,
+                     [query = std::move(query), promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+                       promise.set_value(sync_db.get_dialog_message_calendar(std::move(query)));
+                     });
     }
 
     void get_dialog_sparse_message_positions(MessageDbGetDialogSparseMessagePositionsQuery query,
                                              Promise<MessageDbMessagePositions> promise) {
-      add_read_query();
-      promise.set_result(sync_db_->get_dialog_sparse_message_positions(std::move(query)));
+      auto dialog_id = query.dialog_id;
+      add_read_query(dialog_id,
+                     [query = std::move(query), promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+                       promise.set_result(sync_db.get_dialog_sparse_message_positions(std::move(query)));
+                     });
     }
 
     void get_messages(MessageDbMessagesQuery query, Promise<vector<MessageDbDialogMessage>> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_messages(std::move(query)));
+      auto dialog_id = query.dialog_id;
+      add_read_query(dialog_id,
+                     [query = std::move(query), promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+                       promise.set_value(sync_db.get_messages(std::move(query)));
+                     });
     }
     void get_scheduled_messages(DialogId dialog_id, int32 limit, Promise<vector<MessageDbDialogMessage>> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_scheduled_messages(dialog_id, limit));
+      add_read_query(dialog_id,
+                     [dialog_id, limit, promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+                       promise.set_value(sync_db.get_scheduled_messages(dialog_id, limit));
+                     });
     }
     void get_messages_from_notification_id(DialogId dialog_id, NotificationId from_notification_id, int32 limit,
                                            Promise<vector<MessageDbDialogMessage>> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_messages_from_notification_id(dialog_id, from_notification_id, limit));
+      add_read_query(dialog_id, [dialog_id, from_notification_id, limit,
+                                 promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+        promise.set_value(sync_db.get_messages_from_notification_id(dialog_id, from_notification_id, limit));
+      });
     }
     void get_calls(MessageDbCallsQuery query, Promise<MessageDbCallsResult> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_calls(std::move(query)));
+      add_read_query(DialogId(),
+                     [query = std::move(query), promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+                       promise.set_value(sync_db.get_calls(std::move(query)));
+                     });
     }
     void get_messages_fts(MessageDbFtsQuery query, Promise<MessageDbFtsResult> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_messages_fts(std::move(query)));
+      add_read_query(DialogId(),
+                     [query = std::move(query), promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+                       promise.set_value(sync_db.get_messages_fts(std::move(query)));
+                     });
     }
     void get_expiring_messages(int32 expires_till, int32 limit, Promise<vector<MessageDbMessage>> promise) {
-      add_read_query();
-      promise.set_value(sync_db_->get_expiring_messages(expires_till, limit));
+      add_read_query(DialogId(),
+                     [expires_till, limit, promise = std::move(promise)](MessageDbSyncInterface &sync_db) mutable {
+                       promise.set_value(sync_db.get_expiring_messages(expires_till, limit));
+                     });
+    }
+
+    void set_use_deferred_fts_indexing(bool use_deferred_fts_indexing, Promise<> promise) {
+      do_flush();
+      sync_db_->begin_write_transaction().ensure();
+      sync_db_->set_use_deferred_fts_indexing(use_deferred_fts_indexing).ensure();
+      sync_db_->commit_transaction().ensure();
+      promise.set_value(Unit());
+    }
+
+    void get_write_statistics(Promise<MessageDbWriteStatistics> promise) {
+      auto statistics = statistics_;
+      statistics.batch_size_limit = static_cast<int32>(max_pending_queries_count_);
+      promise.set_value(std::move(statistics));
     }
 
     void close(Promise<> promise) {
       do_flush();
       sync_db_safe_.reset();
       sync_db_ = nullptr;
-      promise.set_value(Unit());
+      reader_pool_.close(std::move(promise));
       stop();
     }
 
@@ -1183,55 +1452,159 @@ class MessageDbAsync final : public MessageDbAsyncInterface {
    private:
     std::shared_ptr<MessageDbSyncSafeInterface> sync_db_safe_;
     MessageDbSyncInterface *sync_db_ = nullptr;
+    vector<int32> reader_scheduler_ids_;
+    SqliteReaderPool<MessageDbSyncSafeInterface> reader_pool_;
 
-    static constexpr size_t MAX_PENDING_QUERIES_COUNT{50};
+    static constexpr size_t MIN_PENDING_QUERIES_COUNT{50};
+    static constexpr size_t MAX_PENDING_QUERIES_COUNT{3200};
     static constexpr double MAX_PENDING_QUERIES_DELAY{0.01};
+    static constexpr int32 MAX_FTS_INDEXING_BATCH_SIZE{1000};
+    static constexpr double FTS_INDEXING_IDLE_DELAY{1.0};
+    static constexpr double FTS_INDEXING_BATCH_DELAY{0.01};
+
+    struct PendingAddMessage {
+      MessageDbAddMessageQuery query;
+      Promise<Unit> promise;
+      bool is_canceled = false;
+    };
 
     //NB: order is important, destructor of pending_writes_ will change finished_writes_
     vector<Promise<Unit>> finished_writes_;
     vector<Promise<Unit>> pending_writes_;  // TODO use Action
+    vector<PendingAddMessage> pending_add_messages_;
+    FlatHashMap<MessageFullId, size_t, MessageFullIdHash> pending_add_message_pos_;
+    FlatHashSet<DialogId, DialogIdHash> pending_write_dialog_ids_;
+    size_t max_pending_queries_count_ = MIN_PENDING_QUERIES_COUNT;
     double wakeup_at_ = 0;
+    bool need_fts_indexing_ = false;
+
+    MessageDbWriteStatistics statistics_;
 
     template <class F>
     void add_write_query(F &&f) {
       pending_writes_.push_back(PromiseCreator::lambda(std::forward<F>(f)));
-      if (pending_writes_.size() > MAX_PENDING_QUERIES_COUNT) {
+      on_write_query_added();
+    }
+    void on_write_query_added() {
+      if (pending_writes_.size() + pending_add_messages_.size() > max_pending_queries_count_) {
+        // the queries come faster than they are written, so make batches bigger to amortize transaction cost
         do_flush();
-        wakeup_at_ = 0;
-      } else if (wakeup_at_ == 0) {
-        wakeup_at_ = Time::now_cached() + MAX_PENDING_QUERIES_DELAY;
+        max_pending_queries_count_ = td::min(max_pending_queries_count_ * 2, MAX_PENDING_QUERIES_COUNT);
+        return;
       }
-      if (wakeup_at_ != 0) {
+      if (wakeup_at_ == 0) {
+        wakeup_at_ = Time::now_cached() + MAX_PENDING_QUERIES_DELAY;
         set_timeout_at(wakeup_at_);
       }
     }
-    void add_read_query() {
-      do_flush();
+    // queries about a dialog without pending writes don't need to wait for the current batch;
+    // other queries commit the batch first, so a reader connection can't miss a previous write
+    template <class F>
+    void add_read_query(DialogId dialog_id, F &&f) {
+      if (!dialog_id.is_valid() || pending_write_dialog_ids_.count(dialog_id) != 0) {
+        do_flush();
+      }
+      if (reader_pool_.empty()) {
+        return f(*sync_db_);
+      }
+      reader_pool_.run(std::forward<F>(f));
+    }
+    void flush_pending_add_messages() {
+      if (pending_add_messages_.empty()) {
+        return;
+      }
+      vector<MessageDbAddMessageQuery> queries;
+      queries.reserve(pending_add_messages_.size());
+      for (auto &pending_add_message : pending_add_messages_) {
+        if (pending_add_message.is_canceled) {
+          continue;
+        }
+        if (pending_add_message.query.search_id != 0) {
+          need_fts_indexing_ = true;
+        }
+        queries.push_back(std::move(pending_add_message.query));
+        finished_writes_.push_back(std::move(pending_add_message.promise));
+      }
+      pending_add_messages_.clear();
+      pending_add_message_pos_.clear();
+      if (!queries.empty()) {
+        sync_db_->add_messages(std::move(queries));
+      }
     }
     void do_flush() {
-      if (pending_writes_.empty()) {
+      auto write_count = pending_writes_.size() + pending_add_messages_.size();
+      if (write_count == 0) {
         return;
       }
+      auto start_time = Time::now();
       sync_db_->begin_write_transaction().ensure();
       set_promises(pending_writes_);
+      flush_pending_add_messages();
       sync_db_->commit_transaction().ensure();
       set_promises(finished_writes_);
-      cancel_timeout();
+      pending_write_dialog_ids_.clear();
+      wakeup_at_ = 0;
+      schedule_fts_indexing(FTS_INDEXING_IDLE_DELAY);
+
+      auto batch_duration = Time::now() - start_time;
+      auto batch_size = static_cast<int32>(write_count);
+      statistics_.batch_count++;
+      statistics_.write_count += batch_size;
+      statistics_.last_batch_size = batch_size;
+      statistics_.max_batch_size = td::max(statistics_.max_batch_size, batch_size);
+      statistics_.last_batch_duration = batch_duration;
+      statistics_.max_batch_duration = td::max(statistics_.max_batch_duration, batch_duration);
+      statistics_.total_batch_duration += batch_duration;
+      LOG(DEBUG) << "Flush " << batch_size << " message database writes in " << batch_duration;
     }
     void timeout_expired() final {
+      if (wakeup_at_ == 0) {
+        return index_fts_messages();
+      }
+      if (pending_writes_.size() + pending_add_messages_.size() <= max_pending_queries_count_ / 4) {
+        // the load has decreased, so return to smaller batches to reduce write latency
+        max_pending_queries_count_ = td::max(max_pending_queries_count_ / 2, MIN_PENDING_QUERIES_COUNT);
+      }
       do_flush();
     }
 
+    void schedule_fts_indexing(double delay) {
+      if (need_fts_indexing_) {
+        set_timeout_in(delay);
+      } else {
+        cancel_timeout();
+      }
+    }
+
+    // messages added with deferred FTS indexing are indexed in background, when there are no writes for some time
+    void index_fts_messages() {
+      if (!need_fts_indexing_) {
+        return;
+      }
+      if (!sync_db_->has_pending_fts_messages()) {
+        need_fts_indexing_ = false;
+        return;
+      }
+      sync_db_->begin_write_transaction().ensure();
+      need_fts_indexing_ = sync_db_->index_pending_fts_messages(MAX_FTS_INDEXING_BATCH_SIZE);
+      sync_db_->commit_transaction().ensure();
+      schedule_fts_indexing(FTS_INDEXING_BATCH_DELAY);
+    }
+
     void start_up() final {
       sync_db_ = &sync_db_safe_->get();
+      reader_pool_ = SqliteReaderPool<MessageDbSyncSafeInterface>(sync_db_safe_, reader_scheduler_ids_);
+      need_fts_indexing_ = true;
+      schedule_fts_indexing(FTS_INDEXING_IDLE_DELAY);
     }
   };
   ActorOwn<Impl> impl_;
 };
 
 std::shared_ptr<MessageDbAsyncInterface> create_message_db_async(std::shared_ptr<MessageDbSyncSafeInterface> sync_db,
-                                                                 int32 scheduler_id) {
-  return std::make_shared<MessageDbAsync>(std::move(sync_db), scheduler_id);
+                                                                 int32 scheduler_id,
+                                                                 vector<int32> reader_scheduler_ids) {
+  return std::make_shared<MessageDbAsync>(std::move(sync_db), scheduler_id, std::move(reader_scheduler_ids));
 }
 
 }  // namespace td
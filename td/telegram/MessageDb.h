@@ -17,6 +17,7 @@
 #include "td/utils/common.h"
 #include "td/utils/Promise.h"
 #include "td/utils/Status.h"
+#include "td/utils/StringBuilder.h"
 
 #include <memory>
 #include <utility>
@@ -26,6 +27,20 @@ namespace td {
 class SqliteConnectionSafe;
 class SqliteDb;
 
+struct MessageDbAddMessageQuery {
+  MessageFullId message_full_id;
+  ServerMessageId unique_message_id;
+  DialogId sender_dialog_id;
+  int64 random_id{0};
+  int32 ttl_expires_at{0};
+  int32 index_mask{0};
+  int64 search_id{0};
+  string text;
+  NotificationId notification_id;
+  MessageId top_thread_message_id;
+  BufferSlice data;
+};
+
 struct MessageDbMessagesQuery {
   DialogId dialog_id;
   MessageSearchFilter filter{MessageSearchFilter::Empty};
@@ -97,6 +112,20 @@ struct MessageDbCallsResult {
   vector<MessageDbMessage> messages;
 };
 
+struct MessageDbWriteStatistics {
+  int64 batch_count{0};
+  int64 write_count{0};
+  int64 coalesced_write_count{0};
+  int32 batch_size_limit{0};
+  int32 max_batch_size{0};
+  int32 last_batch_size{0};
+  double last_batch_duration{0.0};
+  double max_batch_duration{0.0};
+  double total_batch_duration{0.0};
+};
+
+StringBuilder &operator<<(StringBuilder &string_builder, const MessageDbWriteStatistics &statistics);
+
 class MessageDbSyncInterface {
  public:
   MessageDbSyncInterface() = default;
@@ -107,6 +136,7 @@ class MessageDbSyncInterface {
   virtual void add_message(MessageFullId message_full_id, ServerMessageId unique_message_id, DialogId sender_dialog_id,
                            int64 random_id, int32 ttl_expires_at, int32 index_mask, int64 search_id, string text,
                            NotificationId notification_id, MessageId top_thread_message_id, BufferSlice data) = 0;
+  virtual void add_messages(vector<MessageDbAddMessageQuery> queries) = 0;
   virtual void add_scheduled_message(MessageFullId message_full_id, BufferSlice data) = 0;
 
   virtual void delete_message(MessageFullId message_full_id) = 0;
@@ -134,6 +164,12 @@ class MessageDbSyncInterface {
   virtual MessageDbCallsResult get_calls(MessageDbCallsQuery query) = 0;
   virtual MessageDbFtsResult get_messages_fts(MessageDbFtsQuery query) = 0;
 
+  // must be called inside a write transaction
+  virtual Status set_use_deferred_fts_indexing(bool use_deferred_fts_indexing) = 0;
+  virtual bool has_pending_fts_messages() = 0;
+  // returns true, if there are more messages to index
+  virtual bool index_pending_fts_messages(int32 limit) = 0;
+
   virtual Status begin_write_transaction() = 0;
   virtual Status commit_transaction() = 0;
 };
@@ -189,6 +225,10 @@ class MessageDbAsyncInterface {
 
   virtual void get_expiring_messages(int32 expires_till, int32 limit, Promise<vector<MessageDbMessage>> promise) = 0;
 
+  virtual void set_use_deferred_fts_indexing(bool use_deferred_fts_indexing, Promise<> promise) = 0;
+
+  virtual void get_write_statistics(Promise<MessageDbWriteStatistics> promise) = 0;
+
   virtual void close(Promise<> promise) = 0;
   virtual void force_flush() = 0;
 };
@@ -199,7 +239,9 @@ Status drop_message_db(SqliteDb &db, int version) TD_WARN_UNUSED_RESULT;
 std::shared_ptr<MessageDbSyncSafeInterface> create_message_db_sync(
     std::shared_ptr<SqliteConnectionSafe> sqlite_connection);
 
+// read queries are run on reader_scheduler_ids using separate database connections, if the list isn't empty
 std::shared_ptr<MessageDbAsyncInterface> create_message_db_async(std::shared_ptr<MessageDbSyncSafeInterface> sync_db,
-                                                                 int32 scheduler_id = -1);
+                                                                 int32 scheduler_id = -1,
+                                                                 vector<int32> reader_scheduler_ids = {});
 
 }  // namespace td
@@ -14,10 +14,12 @@
 #include "td/telegram/ConfigManager.h"
 #include "td/telegram/CountryInfoManager.h"
 #include "td/telegram/DialogId.h"
+#include "td/telegram/files/FileManager.h"
 #include "td/telegram/GitCommitHash.h"
 #include "td/telegram/Global.h"
 #include "td/telegram/JsonValue.h"
 #include "td/telegram/LanguagePackManager.h"
+#include "td/telegram/MessageDb.h"
 #include "td/telegram/net/MtprotoHeader.h"
 #include "td/telegram/net/NetQueryDispatcher.h"
 #include "td/telegram/NotificationManager.h"
@@ -165,6 +167,10 @@ OptionManager::OptionManager(Td *td)
     update_premium_options();
   }
 
+  if (options.isset("use_deferred_message_search_indexing")) {
+    update_use_deferred_message_search_indexing();
+  }
+
   set_option_empty("archive_and_mute_new_chats_from_unknown_users");
   set_option_empty("business_intro_title_length_max");
   set_option_empty("business_intro_message_length_max");
@@ -343,6 +349,13 @@ void OptionManager::send_unix_time_update() {
   td_->send_update(td_api::make_object<td_api::updateOption>("unix_time", get_unix_time_option_value_object()));
 }
 
+void OptionManager::update_use_deferred_message_search_indexing() {
+  auto message_db = G()->td_db()->get_message_db_async();
+  if (message_db != nullptr) {
+    message_db->set_use_deferred_fts_indexing(get_option_boolean("use_deferred_message_search_indexing"), Auto());
+  }
+}
+
 void OptionManager::on_update_server_time_difference() {
   // can be called from any thread
   if (std::abs(G()->get_server_time_difference() - last_sent_server_time_difference_) < 0.5) {
@@ -583,6 +596,9 @@ void OptionManager::on_option_updated(Slice name) {
       }
       break;
     case 'm':
+      if (name == "max_file_session_count") {
+        G()->net_query_dispatcher().update_max_file_session_count();
+      }
       if (name == "my_phone_number") {
         send_closure(G()->config_manager(), &ConfigManager::reget_config, Promise<Unit>());
       }
@@ -633,6 +649,12 @@ void OptionManager::on_option_updated(Slice name) {
       }
       break;
     case 'u':
+      if (name == "use_deferred_message_search_indexing") {
+        update_use_deferred_message_search_indexing();
+      }
+      if (name == "use_file_deduplication") {
+        td_->file_manager_->update_use_file_deduplication();
+      }
       if (name == "use_pfs") {
         G()->net_query_dispatcher().update_use_pfs();
       }
@@ -905,6 +927,9 @@ void OptionManager::set_option(const string &name, td_api::object_ptr<td_api::Op
       }
       break;
     case 'm':
+      if (set_integer_option("max_file_session_count", 0, 100)) {
+        return;
+      }
       if (set_integer_option("message_unload_delay", 60, 86400)) {
         return;
       }
@@ -941,6 +966,9 @@ void OptionManager::set_option(const string &name, td_api::object_ptr<td_api::Op
         send_closure(td_->state_manager_, &StateManager::on_network_updated);
         return;
       }
+      if (set_integer_option("prewarmed_connection_count", 0, 4)) {
+        return;
+      }
       if (set_boolean_option("process_pinned_messages_as_mentions")) {
         return;
       }
@@ -952,6 +980,9 @@ void OptionManager::set_option(const string &name, td_api::object_ptr<td_api::Op
       }
       break;
     case 's':
+      if (set_string_option("storage_gc_policy", [](Slice value) { return value == "lru" || value == "size"; })) {
+        return;
+      }
       if (set_integer_option("storage_max_files_size")) {
         return;
       }
@@ -974,6 +1005,15 @@ void OptionManager::set_option(const string &name, td_api::object_ptr<td_api::Op
       }
       break;
     case 'u':
+      if (set_boolean_option("use_adaptive_file_download")) {
+        return;
+      }
+      if (set_boolean_option("use_deferred_message_search_indexing")) {
+        return;
+      }
+      if (set_boolean_option("use_file_deduplication")) {
+        return;
+      }
       if (set_boolean_option("use_pfs")) {
         return;
       }
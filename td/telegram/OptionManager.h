@@ -84,6 +84,8 @@ class OptionManager {
 
   void send_unix_time_update();
 
+  void update_use_deferred_message_search_indexing();
+
   Td *td_;
   bool is_td_inited_ = false;
   vector<std::pair<string, Promise<td_api::object_ptr<td_api::OptionValue>>>> pending_get_options_;
@@ -11,6 +11,7 @@
 #include "td/telegram/files/FileStatsWorker.h"
 #include "td/telegram/Global.h"
 #include "td/telegram/logevent/LogEvent.h"
+#include "td/telegram/MessageDb.h"
 #include "td/telegram/MessagesManager.h"
 #include "td/telegram/TdDb.h"
 
@@ -23,6 +24,7 @@
 #include "td/utils/port/Stat.h"
 #include "td/utils/Random.h"
 #include "td/utils/Slice.h"
+#include "td/utils/SliceBuilder.h"
 #include "td/utils/Time.h"
 
 namespace td {
@@ -42,7 +44,8 @@ void StorageManager::start_up() {
   load_fast_stat();
 }
 
-void StorageManager::on_new_file(int64 size, int64 real_size, int32 cnt) {
+void StorageManager::on_new_file(FileType file_type, DialogId owner_dialog_id, int64 size, int64 real_size,
+                                 int32 cnt) {
   LOG(INFO) << "Add " << cnt << " file of size " << size << " with real size " << real_size
             << " to fast storage statistics";
   fast_stat_.cnt += cnt;
@@ -56,14 +59,30 @@ void StorageManager::on_new_file(int64 size, int64 real_size, int32 cnt) {
   if (fast_stat_.cnt < 0 || fast_stat_.size < 0) {
     LOG(ERROR) << "Wrong fast stat after adding size " << add_size << " and cnt " << cnt;
     fast_stat_ = FileTypeStat();
+    file_usage_stats_reconciled_at_ = 0.0;
   }
   save_fast_stat();
+
+  if (file_usage_stats_reconciled_at_ != 0.0) {
+    file_usage_stats_.add_files(file_type, owner_dialog_id, add_size, cnt);
+  }
+
+  if (add_size > 0) {
+    check_files_size_watermark();
+  }
 }
 
-void StorageManager::get_storage_stats(bool need_all_files, int32 dialog_limit, Promise<FileStats> promise) {
+void StorageManager::get_storage_stats(bool need_all_files, int32 dialog_limit, bool can_use_file_usage_stats,
+                                       Promise<FileStats> promise) {
   if (is_closed_) {
     return promise.set_error(Global::request_aborted_error());
   }
+  if (!need_all_files && can_use_file_usage_stats && has_actual_file_usage_stats()) {
+    LOG(INFO) << "Return storage statistics from the file usage index";
+    vector<Promise<FileStats>> promises;
+    promises.push_back(std::move(promise));
+    return send_stats(file_usage_stats_.get_copy_without_files(), dialog_limit, std::move(promises));
+  }
   if (!pending_storage_stats_.empty()) {
     if (stats_dialog_limit_ == dialog_limit && need_all_files == stats_need_all_files_) {
       pending_storage_stats_.emplace_back(std::move(promise));
@@ -80,7 +99,8 @@ void StorageManager::get_storage_stats(bool need_all_files, int32 dialog_limit,
   pending_storage_stats_.emplace_back(std::move(promise));
 
   create_stats_worker();
-  send_closure(stats_worker_, &FileStatsWorker::get_stats, need_all_files, stats_dialog_limit_ != 0,
+  // the statistics are always split by owner dialog to reconcile the file usage index
+  send_closure(stats_worker_, &FileStatsWorker::get_stats, need_all_files, true,
                PromiseCreator::lambda(
                    [actor_id = actor_id(this), stats_generation = stats_generation_](Result<FileStats> file_stats) {
                      send_closure(actor_id, &StorageManager::on_file_stats, std::move(file_stats), stats_generation);
@@ -96,10 +116,20 @@ void StorageManager::get_database_stats(Promise<DatabaseStats> promise) {
   //TODO: use another thread
   auto r_stats = G()->td_db()->get_stats();
   if (r_stats.is_error()) {
-    promise.set_error(r_stats.move_as_error());
-  } else {
-    promise.set_value(DatabaseStats(r_stats.move_as_ok()));
+    return promise.set_error(r_stats.move_as_error());
+  }
+  auto message_db = G()->td_db()->get_message_db_async();
+  if (message_db == nullptr) {
+    return promise.set_value(DatabaseStats(r_stats.move_as_ok()));
   }
+  message_db->get_write_statistics(PromiseCreator::lambda(
+      [stats = r_stats.move_as_ok(),
+       promise = std::move(promise)](Result<MessageDbWriteStatistics> r_write_statistics) mutable {
+        if (r_write_statistics.is_ok()) {
+          stats += PSTRING() << r_write_statistics.ok() << '\n';
+        }
+        promise.set_value(DatabaseStats(std::move(stats)));
+      }));
 }
 
 void StorageManager::update_use_storage_optimizer() {
@@ -118,7 +148,7 @@ void StorageManager::run_gc(FileGcParameters parameters, bool return_deleted_fil
   bool split_by_owner_dialog_id = !parameters.owner_dialog_ids_.empty() ||
                                   !parameters.exclude_owner_dialog_ids_.empty() || parameters.dialog_limit_ != 0;
   get_storage_stats(
-      true /*need_all_files*/, split_by_owner_dialog_id,
+      true /*need_all_files*/, split_by_owner_dialog_id, false /*can_use_file_usage_stats*/,
       PromiseCreator::lambda(
           [actor_id = actor_id(this), parameters = std::move(parameters)](Result<FileStats> file_stats) mutable {
             send_closure(actor_id, &StorageManager::on_all_files, std::move(parameters), std::move(file_stats));
@@ -138,6 +168,7 @@ void StorageManager::on_file_stats(Result<FileStats> r_file_stats, uint32 genera
   }
 
   update_fast_stats(r_file_stats.ok());
+  reconcile_file_usage_stats(r_file_stats.ok());
   send_stats(r_file_stats.move_as_ok(), stats_dialog_limit_, std::move(pending_storage_stats_));
 }
 
@@ -156,14 +187,16 @@ void StorageManager::on_all_files(FileGcParameters gc_parameters, Result<FileSta
     r_file_stats = Global::request_aborted_error();
   }
   if (r_file_stats.is_error()) {
-    return on_gc_finished(dialog_limit, r_file_stats.move_as_error());
+    return on_gc_finished(dialog_limit, gc_generation_, r_file_stats.move_as_error());
   }
 
   create_gc_worker();
 
   send_closure(gc_worker_, &FileGcWorker::run_gc, std::move(gc_parameters), r_file_stats.ok_ref().get_all_files(),
-               PromiseCreator::lambda([actor_id = actor_id(this), dialog_limit](Result<FileGcResult> r_file_gc_result) {
-                 send_closure(actor_id, &StorageManager::on_gc_finished, dialog_limit, std::move(r_file_gc_result));
+               PromiseCreator::lambda([actor_id = actor_id(this), dialog_limit,
+                                       generation = gc_generation_](Result<FileGcResult> r_file_gc_result) {
+                 send_closure(actor_id, &StorageManager::on_gc_finished, dialog_limit, generation,
+                              std::move(r_file_gc_result));
                }));
 }
 
@@ -209,7 +242,11 @@ void StorageManager::create_gc_worker() {
   }
 }
 
-void StorageManager::on_gc_finished(int32 dialog_limit, Result<FileGcResult> r_file_gc_result) {
+void StorageManager::on_gc_finished(int32 dialog_limit, uint32 generation, Result<FileGcResult> r_file_gc_result) {
+  if (generation != gc_generation_) {
+    // the result of a canceled GC, which was already reported
+    return;
+  }
   if (r_file_gc_result.is_error()) {
     if (r_file_gc_result.error().code() != 500) {
       LOG(ERROR) << "GC failed: " << r_file_gc_result.error();
@@ -223,6 +260,7 @@ void StorageManager::on_gc_finished(int32 dialog_limit, Result<FileGcResult> r_f
   }
 
   update_fast_stats(r_file_gc_result.ok().kept_file_stats_);
+  reconcile_file_usage_stats(r_file_gc_result.ok().kept_file_stats_);
 
   auto kept_file_promises = std::move(pending_run_gc_[0]);
   auto removed_file_promises = std::move(pending_run_gc_[1]);
@@ -242,6 +280,16 @@ void StorageManager::load_fast_stat() {
   LOG(INFO) << "Loaded fast storage statistics with " << fast_stat_.cnt << " files of total size " << fast_stat_.size;
 }
 
+bool StorageManager::has_actual_file_usage_stats() const {
+  return file_usage_stats_reconciled_at_ != 0.0 &&
+         Time::now() < file_usage_stats_reconciled_at_ + FILE_USAGE_STATS_MAX_AGE;
+}
+
+void StorageManager::reconcile_file_usage_stats(const FileStats &stats) {
+  file_usage_stats_ = stats.get_copy_without_files();
+  file_usage_stats_reconciled_at_ = Time::now();
+}
+
 void StorageManager::update_fast_stats(const FileStats &stats) {
   fast_stat_ = stats.get_total_nontemp_stat();
   LOG(INFO) << "Recalculate fast storage statistics to " << fast_stat_.cnt << " files of total size "
@@ -298,6 +346,7 @@ void StorageManager::close_gc_worker() {
   pending_run_gc_[0].clear();
   pending_run_gc_[1].clear();
   fail_promises(promises, Global::request_aborted_error());
+  gc_generation_++;
   gc_worker_.reset();
   gc_cancellation_token_source_.cancel();
 }
@@ -320,6 +369,7 @@ void StorageManager::save_last_gc_timestamp() {
 }
 
 void StorageManager::schedule_next_gc() {
+  is_watermark_gc_scheduled_ = false;
   if (!G()->get_option_boolean("use_storage_optimizer")) {
     next_gc_at_ = 0;
     cancel_timeout();
@@ -344,6 +394,50 @@ void StorageManager::schedule_next_gc() {
   set_timeout_at(next_gc_at_);
 }
 
+void StorageManager::on_background_gc_finished(bool is_watermark_gc, Result<FileStats> r_kept_file_stats) {
+  if (r_kept_file_stats.is_error() && r_kept_file_stats.error().code() == 500) {
+    // do not save garbage collection timestamp if request was canceled
+    return schedule_next_gc();
+  }
+  save_last_gc_timestamp();
+
+  if (is_watermark_gc && r_kept_file_stats.is_ok()) {
+    if (r_kept_file_stats.ok().get_total_nontemp_stat().size > get_max_files_size()) {
+      // remaining files are immune to GC, so there is no need to repeat the clean up soon
+      watermark_gc_interval_ = min(watermark_gc_interval_ * 2, WATERMARK_GC_MAX_INTERVAL);
+      LOG(INFO) << "File clean up didn't free enough space; the next one is postponed for " << watermark_gc_interval_;
+    } else {
+      watermark_gc_interval_ = WATERMARK_GC_MIN_INTERVAL;
+    }
+  }
+  schedule_next_gc();
+}
+
+int64 StorageManager::get_max_files_size() {
+  return G()->get_option_integer("storage_max_files_size", 100 << 10) << 10;
+}
+
+void StorageManager::check_files_size_watermark() {
+  if (is_closed_ || next_gc_at_ == 0) {
+    // the storage optimizer is disabled or a file clean up is already running
+    return;
+  }
+  auto max_files_size = get_max_files_size();
+  if (fast_stat_.size <= max_files_size) {
+    return;
+  }
+  auto gc_at = max(Time::now(), last_watermark_gc_at_ + watermark_gc_interval_);
+  if (gc_at >= next_gc_at_) {
+    return;
+  }
+
+  LOG(INFO) << "Schedule file clean up, because total size of files " << fast_stat_.size << " exceeds "
+            << max_files_size;
+  is_watermark_gc_scheduled_ = true;
+  next_gc_at_ = gc_at;
+  set_timeout_at(next_gc_at_);
+}
+
 void StorageManager::timeout_expired() {
   if (next_gc_at_ == 0) {
     return;
@@ -353,12 +447,19 @@ void StorageManager::timeout_expired() {
     return;
   }
   next_gc_at_ = 0;
-  run_gc({}, false, PromiseCreator::lambda([actor_id = actor_id(this)](Result<FileStats> r_stats) {
-           if (!r_stats.is_error() || r_stats.error().code() != 500) {
-             // do not save garbage collection timestamp if request was canceled
-             send_closure(actor_id, &StorageManager::save_last_gc_timestamp);
-           }
-           send_closure(actor_id, &StorageManager::schedule_next_gc);
+  FileGcParameters parameters;
+  parameters.is_background_ = true;
+  bool is_watermark_gc = is_watermark_gc_scheduled_;
+  if (is_watermark_gc) {
+    is_watermark_gc_scheduled_ = false;
+    last_watermark_gc_at_ = Time::now();
+    // free some additional space to not start the next clean up too early
+    parameters.max_files_size_ = parameters.max_files_size_ / 100 * WATERMARK_GC_LOW_WATERMARK_PERCENT;
+  }
+  run_gc(std::move(parameters), false,
+         PromiseCreator::lambda([actor_id = actor_id(this), is_watermark_gc](Result<FileStats> r_kept_file_stats) {
+           send_closure(actor_id, &StorageManager::on_background_gc_finished, is_watermark_gc,
+                        std::move(r_kept_file_stats));
          }));
 }
 
@@ -6,9 +6,11 @@
 //
 #pragma once
 
+#include "td/telegram/DialogId.h"
 #include "td/telegram/files/FileGcWorker.h"
 #include "td/telegram/files/FileStats.h"
 #include "td/telegram/files/FileStatsWorker.h"
+#include "td/telegram/files/FileType.h"
 #include "td/telegram/td_api.h"
 
 #include "td/actor/actor.h"
@@ -32,19 +34,29 @@ struct DatabaseStats {
 class StorageManager final : public Actor {
  public:
   StorageManager(ActorShared<> parent, int32 scheduler_id);
-  void get_storage_stats(bool need_all_files, int32 dialog_limit, Promise<FileStats> promise);
+  void get_storage_stats(bool need_all_files, int32 dialog_limit, bool can_use_file_usage_stats,
+                         Promise<FileStats> promise);
   void get_storage_stats_fast(Promise<FileStatsFast> promise);
   void get_database_stats(Promise<DatabaseStats> promise);
   void run_gc(FileGcParameters parameters, bool return_deleted_file_statistics, Promise<FileStats> promise);
   void update_use_storage_optimizer();
 
-  void on_new_file(int64 size, int64 real_size, int32 cnt);
+  void on_new_file(FileType file_type, DialogId owner_dialog_id, int64 size, int64 real_size, int32 cnt);
 
  private:
   static constexpr int GC_EACH = 60 * 60 * 24;  // 1 day
   static constexpr int GC_DELAY = 60;
   static constexpr int GC_RAND_DELAY = 60 * 15;
 
+  // files are cleaned up as soon as their total size exceeds the limit, but not more often than once in 10 minutes;
+  // the interval is doubled up to 1 day after each clean up, which didn't bring the total size below the limit
+  static constexpr double WATERMARK_GC_MIN_INTERVAL = 60 * 10;
+  static constexpr double WATERMARK_GC_MAX_INTERVAL = GC_EACH;
+  static constexpr int32 WATERMARK_GC_LOW_WATERMARK_PERCENT = 90;
+
+  // the statistics don't include changes of temporary and partially downloaded files, so they can be used only briefly
+  static constexpr double FILE_USAGE_STATS_MAX_AGE = 60 * 5;
+
   ActorShared<> parent_;
 
   int32 scheduler_id_;
@@ -58,6 +70,10 @@ class StorageManager final : public Actor {
 
   FileTypeStat fast_stat_;
 
+  // statistics by owner dialog and file type, which are updated on file changes and reconciled with file system scans
+  FileStats file_usage_stats_{false, true};
+  double file_usage_stats_reconciled_at_ = 0.0;  // time of the last scan or 0 if the statistics are unknown
+
   CancellationTokenSource stats_cancellation_token_source_;
   CancellationTokenSource gc_cancellation_token_source_;
 
@@ -68,6 +84,9 @@ class StorageManager final : public Actor {
 
   void save_fast_stat();
   void load_fast_stat();
+
+  bool has_actual_file_usage_stats() const;
+  void reconcile_file_usage_stats(const FileStats &stats);
   static int64 get_database_size();
   static int64 get_language_pack_database_size();
   static int64 get_log_size();
@@ -84,13 +103,17 @@ class StorageManager final : public Actor {
   // Gc
   ActorOwn<FileGcWorker> gc_worker_;
   std::vector<Promise<FileStats>> pending_run_gc_[2];
+  uint32 gc_generation_{0};
 
   uint32 last_gc_timestamp_ = 0;
   double next_gc_at_ = 0;
+  double last_watermark_gc_at_ = 0;
+  double watermark_gc_interval_ = WATERMARK_GC_MIN_INTERVAL;
+  bool is_watermark_gc_scheduled_ = false;
 
   void on_all_files(FileGcParameters gc_parameters, Result<FileStats> r_file_stats);
   void create_gc_worker();
-  void on_gc_finished(int32 dialog_limit, Result<FileGcResult> r_file_gc_result);
+  void on_gc_finished(int32 dialog_limit, uint32 generation, Result<FileGcResult> r_file_gc_result);
 
   void close_stats_worker();
   void close_gc_worker();
@@ -98,6 +121,9 @@ class StorageManager final : public Actor {
   uint32 load_last_gc_timestamp();
   void save_last_gc_timestamp();
   void schedule_next_gc();
+  void on_background_gc_finished(bool is_watermark_gc, Result<FileStats> r_kept_file_stats);
+  static int64 get_max_files_size();
+  void check_files_size_watermark();
 
   void timeout_expired() final;
 };
@@ -2481,6 +2481,12 @@ void Td::start_up() {
   VLOG(td_init) << "Create Global";
   old_context_ = set_context(std::make_shared<Global>());
   G()->set_net_query_stats(td_options_.net_query_stats);
+  if (td_options_.database_scheduler_id >= 0) {
+    G()->set_service_scheduler_ids(td_options_.database_scheduler_id, td_options_.gc_scheduler_id,
+                                   td_options_.slow_net_scheduler_id);
+  }
+  G()->set_database_reader_scheduler_ids(td_options_.database_reader_scheduler_ids);
+  G()->set_file_worker_scheduler_ids(td_options_.file_worker_scheduler_ids);
   inc_request_actor_refcnt();  // guard
   inc_actor_refcnt();          // guard
 
@@ -3128,8 +3134,9 @@ void Td::init_file_manager() {
       return !td_->auth_manager_->is_bot();
     }
 
-    void on_new_file(int64 size, int64 real_size, int32 cnt) final {
-      send_closure(G()->storage_manager(), &StorageManager::on_new_file, size, real_size, cnt);
+    void on_new_file(FileType file_type, DialogId owner_dialog_id, int64 size, int64 real_size, int32 cnt) final {
+      send_closure(G()->storage_manager(), &StorageManager::on_new_file, file_type, owner_dialog_id, size, real_size,
+                   cnt);
     }
 
     void on_file_updated(FileId file_id) final {
@@ -4252,8 +4259,9 @@ void Td::on_request(uint64 id, td_api::getStorageStatistics &request) {
       promise.set_value(result.ok().get_storage_statistics_object());
     }
   });
+  // file usage statistics are updated only if FileManager notifies about new files
   send_closure(storage_manager_, &StorageManager::get_storage_stats, false /*need_all_files*/, request.chat_limit_,
-               std::move(query_promise));
+               !auth_manager_->is_bot() /*can_use_file_usage_stats*/, std::move(query_promise));
 }
 
 void Td::on_request(uint64 id, td_api::getStorageStatisticsFast &request) {
@@ -7012,6 +7020,12 @@ void Td::on_request(uint64 id, const td_api::getFileDownloadedPrefixSize &reques
                td_api::make_object<td_api::fileDownloadedPrefixSize>(file_view.downloaded_prefix(request.offset_)));
 }
 
+void Td::on_request(uint64 id, const td_api::setFileDownloadReaderOffsets &request) {
+  CREATE_OK_REQUEST_PROMISE();
+  file_manager_->set_download_reader_offsets(FileId(request.file_id_, 0), request.reader_offsets_,
+                                             request.read_ahead_size_, std::move(promise));
+}
+
 void Td::on_request(uint64 id, const td_api::cancelDownloadFile &request) {
   file_manager_->download(FileId(request.file_id_, 0), nullptr, request.only_if_pending_ ? -1 : 0,
                           FileManager::KEEP_DOWNLOAD_OFFSET, FileManager::KEEP_DOWNLOAD_LIMIT,
@@ -130,6 +130,17 @@ class Td final : public Actor {
 
   struct Options {
     std::shared_ptr<NetQueryStats> net_query_stats;
+
+    // schedulers shared with other Td instances; by default, the schedulers following the Td scheduler are used
+    int32 database_scheduler_id = -1;
+    int32 gc_scheduler_id = -1;
+    int32 slow_net_scheduler_id = -1;
+
+    // schedulers running read-only database queries in parallel with the database scheduler
+    vector<int32> database_reader_scheduler_ids;
+
+    // schedulers processing downloaded file parts in parallel with the slow network scheduler
+    vector<int32> file_worker_scheduler_ids;
   };
 
   Td(unique_ptr<TdCallback> callback, Options options);
@@ -1316,6 +1327,8 @@ class Td final : public Actor {
 
   void on_request(uint64 id, const td_api::getFileDownloadedPrefixSize &request);
 
+  void on_request(uint64 id, const td_api::setFileDownloadReaderOffsets &request);
+
   void on_request(uint64 id, const td_api::cancelDownloadFile &request);
 
   void on_request(uint64 id, const td_api::getSuggestedFileName &request);
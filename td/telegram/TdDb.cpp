@@ -481,7 +481,7 @@ Status TdDb::init_sqlite(const Parameters &parameters, const DbKey &key, const D
 
   if (use_message_database) {
     message_db_sync_safe_ = create_message_db_sync(sql_connection_);
-    message_db_async_ = create_message_db_async(message_db_sync_safe_);
+    message_db_async_ = create_message_db_async(message_db_sync_safe_, -1, G()->get_database_reader_scheduler_ids());
   }
 
   if (use_story_database) {
@@ -517,7 +517,10 @@ void TdDb::open_impl(Parameters parameters, Promise<OpenedDatabase> &&promise) {
   VLOG(td_init) << "Start binlog loading";
   TRY_STATUS_PROMISE(promise, init_binlog(*binlog, get_binlog_path(parameters), *binlog_pmc, *config_pmc, result,
                                           std::move(parameters.encryption_key_)));
-  VLOG(td_init) << "Finish binlog loading";
+  auto binlog_info = binlog->get_info();
+  VLOG(td_init) << "Finish binlog loading in " << binlog_info.load_time << " seconds: "
+                << tag("read_time", binlog_info.read_time) << tag("parse_time", binlog_info.parse_time)
+                << tag("process_time", binlog_info.process_time) << tag("replay_time", binlog_info.replay_time);
 
   binlog_pmc->external_init_finish(binlog);
   VLOG(td_init) << "Finish initialization of binlog PMC";
@@ -4025,6 +4025,13 @@ class CliClient final : public Actor {
       for (int32 i = min_file_id; i <= max_file_id; i++) {
         send_request(td_api::make_object<td_api::downloadFile>(i, priority, offset, limit, op == "dfs"));
       }
+    } else if (op == "sfdro") {
+      FileId file_id;
+      int64 read_ahead_size;
+      string reader_offsets;
+      get_args(args, file_id, read_ahead_size, reader_offsets);
+      send_request(td_api::make_object<td_api::setFileDownloadReaderOffsets>(file_id, to_integers<int64>(reader_offsets),
+                                                                             read_ahead_size));
     } else if (op == "cdf") {
       FileId file_id;
       get_args(args, file_id);
@@ -23,12 +23,15 @@
 #include "td/utils/format.h"
 #include "td/utils/logging.h"
 #include "td/utils/misc.h"
+#include "td/utils/port/path.h"
 #include "td/utils/Slice.h"
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/Status.h"
 #include "td/utils/tl_helpers.h"
 #include "td/utils/tl_parsers.h"
 
+#include <atomic>
+
 namespace td {
 
 Status drop_file_db(SqliteDb &db, int32 version) {
@@ -56,6 +59,14 @@ Status init_file_db(SqliteDb &db, int32 version) {
   return Status::OK();
 }
 
+static string get_content_ref_key(const string &path) {
+  return PSTRING() << "content_ref#" << path;
+}
+
+static string get_content_ref_count_key(const string &content_path) {
+  return PSTRING() << "content_ref_count#" << content_path;
+}
+
 class FileDb final : public FileDbInterface {
  public:
   class FileDbActor final : public Actor {
@@ -152,6 +163,57 @@ class FileDb final : public FileDbInterface {
       pmc.commit_transaction().ensure();
     }
 
+    void add_file_content_ref(const string &path, const string &content_path) {
+      auto &pmc = file_pmc();
+      auto ref_key = get_content_ref_key(path);
+      auto old_content_path = pmc.get(ref_key);
+      if (old_content_path == content_path) {
+        return;
+      }
+
+      pmc.begin_write_transaction().ensure();
+      if (!old_content_path.empty()) {
+        // the file was deleted without notification and its path was reused
+        do_remove_file_content_ref(old_content_path);
+      }
+      pmc.set(ref_key, content_path);
+      auto count_key = get_content_ref_count_key(content_path);
+      pmc.set(count_key, to_string(to_integer<int32>(pmc.get(count_key)) + 1));
+      pmc.commit_transaction().ensure();
+    }
+
+    void remove_file_content_ref(const string &path) {
+      auto &pmc = file_pmc();
+      auto ref_key = get_content_ref_key(path);
+      auto content_path = pmc.get(ref_key);
+      if (content_path.empty()) {
+        return;
+      }
+
+      pmc.begin_write_transaction().ensure();
+      pmc.erase(ref_key);
+      do_remove_file_content_ref(content_path);
+      pmc.commit_transaction().ensure();
+    }
+
+    void set_file_content_ref_counts(vector<std::pair<string, int32>> ref_counts) {
+      auto &pmc = file_pmc();
+      pmc.begin_write_transaction().ensure();
+      for (auto &it : ref_counts) {
+        auto count_key = get_content_ref_count_key(it.first);
+        if (it.second <= 0) {
+          pmc.erase(count_key);
+          continue;
+        }
+        auto ref_count = to_string(it.second);
+        if (pmc.get(count_key) != ref_count) {
+          LOG(INFO) << "Fix reference count of stored file " << it.first << " to " << ref_count;
+          pmc.set(count_key, ref_count);
+        }
+      }
+      pmc.commit_transaction().ensure();
+    }
+
    private:
     FileDbId max_file_db_id_;
     std::shared_ptr<SqliteKeyValueSafe> file_kv_safe_;
@@ -160,6 +222,25 @@ class FileDb final : public FileDbInterface {
       return file_kv_safe_->get();
     }
 
+    void do_remove_file_content_ref(const string &content_path) {
+      auto &pmc = file_pmc();
+      auto count_key = get_content_ref_count_key(content_path);
+      auto value = pmc.get(count_key);
+      if (value.empty()) {
+        // the stored file has already been deleted by files GC
+        return;
+      }
+      auto ref_count = to_integer<int32>(value) - 1;
+      if (ref_count > 0) {
+        pmc.set(count_key, to_string(ref_count));
+        return;
+      }
+
+      LOG(INFO) << "Delete unreferenced stored file " << content_path;
+      pmc.erase(count_key);
+      unlink(content_path).ignore();
+    }
+
     void do_store_file_data_ref(FileDbId file_db_id, FileDbId new_file_db_id) {
       file_pmc().set(PSTRING() << "file" << file_db_id.get(), PSTRING() << "@@" << new_file_db_id.get());
     }
@@ -169,6 +250,10 @@ class FileDb final : public FileDbInterface {
     file_kv_safe_ = std::move(kv_safe);
     CHECK(file_kv_safe_);
     max_file_db_id_ = FileDbId(to_integer<uint64>(file_kv_safe_->get().get("file_id")));
+    file_kv_safe_->get().get_by_prefix(get_content_ref_key(string()), [&](Slice key, Slice value) {
+      has_file_content_refs_ = true;
+      return false;
+    });
     file_db_actor_ =
         create_actor_on_scheduler<FileDbActor>("FileDbActor", scheduler_id, max_file_db_id_, file_kv_safe_);
   }
@@ -231,6 +316,28 @@ class FileDb final : public FileDbInterface {
   void set_file_data_ref(FileDbId file_db_id, FileDbId new_file_db_id) final {
     send_closure(file_db_actor_, &FileDbActor::store_file_data_ref, file_db_id, new_file_db_id);
   }
+
+  void add_file_content_ref(string path, string content_path) final {
+    has_file_content_refs_ = true;
+    send_closure(file_db_actor_, &FileDbActor::add_file_content_ref, std::move(path), std::move(content_path));
+  }
+
+  void remove_file_content_ref(string path) final {
+    if (!has_file_content_refs_) {
+      // the content store is empty, so there is nothing to remove
+      return;
+    }
+    send_closure(file_db_actor_, &FileDbActor::remove_file_content_ref, std::move(path));
+  }
+
+  void set_file_content_ref_counts(vector<std::pair<string, int32>> ref_counts) final {
+    send_closure(file_db_actor_, &FileDbActor::set_file_content_ref_counts, std::move(ref_counts));
+  }
+
+  string get_file_content_path_sync(const string &path) final {
+    return file_kv_safe_->get().get(get_content_ref_key(path));
+  }
+
   SqliteKeyValue &pmc() final {
     return file_kv_safe_->get();
   }
@@ -239,6 +346,7 @@ class FileDb final : public FileDbInterface {
   ActorOwn<FileDbActor> file_db_actor_;
   FileDbId max_file_db_id_;
   std::shared_ptr<SqliteKeyValueSafe> file_kv_safe_;
+  std::atomic<bool> has_file_content_refs_{false};
 
   static Result<FileData> load_file_data_impl(ActorId<FileDbActor> file_db_actor_id, SqliteKeyValue &pmc,
                                               const string &key, FileDbId max_file_db_id) {
@@ -17,6 +17,7 @@
 #include "td/utils/tl_storers.h"
 
 #include <memory>
+#include <utility>
 
 namespace td {
 
@@ -80,6 +81,15 @@ class FileDbInterface {
                              bool new_generate) = 0;
   virtual void set_file_data_ref(FileDbId file_db_id, FileDbId new_file_db_id) = 0;
 
+  // the file at path is a hard link to the file at content_path from the content store
+  virtual void add_file_content_ref(string path, string content_path) = 0;
+  // the file at path was deleted; the stored file is deleted together with its last reference
+  virtual void remove_file_content_ref(string path) = 0;
+  // sets reference counts of the stored files to the actual number of links to them
+  virtual void set_file_content_ref_counts(vector<std::pair<string, int32>> ref_counts) = 0;
+  // returns path to the stored file, which is linked to the file at path, or an empty string
+  virtual string get_file_content_path_sync(const string &path) = 0;
+
   // For FileStatsWorker. TODO: remove it
   virtual SqliteKeyValue &pmc() = 0;
 
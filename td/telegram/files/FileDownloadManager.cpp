@@ -25,6 +25,20 @@ void FileDownloadManager::start_up() {
   if (G()->get_option_boolean("is_premium")) {
     max_download_resource_limit_ *= 8;
   }
+  if (G()->get_option_boolean("use_adaptive_file_download")) {
+    download_resource_manager_mode_ = ResourceManager::Mode::Adaptive;
+  }
+  for (auto scheduler_id : G()->get_file_worker_scheduler_ids()) {
+    part_workers_.push_back(create_actor_on_scheduler<FilePartWorker>("FilePartWorker", scheduler_id));
+  }
+  update_use_file_deduplication();
+}
+
+void FileDownloadManager::update_use_file_deduplication() {
+  // references to stored files are kept in the file database;
+  // downloaded files are hashed only by part workers to not block the download scheduler
+  use_file_deduplication_ = G()->use_file_database() && G()->get_option_boolean("use_file_deduplication") &&
+                            !part_workers_.empty();
 }
 
 ActorOwn<ResourceManager> &FileDownloadManager::get_download_resource_manager(bool is_small, DcId dc_id) {
@@ -32,11 +46,19 @@ ActorOwn<ResourceManager> &FileDownloadManager::get_download_resource_manager(bo
   if (actor.empty()) {
     actor = create_actor<ResourceManager>(
         PSLICE() << "DownloadResourceManager " << tag("is_small", is_small) << tag("dc_id", dc_id),
-        max_download_resource_limit_, ResourceManager::Mode::Baseline);
+        max_download_resource_limit_, download_resource_manager_mode_);
   }
   return actor;
 }
 
+ActorId<FilePartWorker> FileDownloadManager::get_part_worker() {
+  if (part_workers_.empty()) {
+    return ActorId<FilePartWorker>();
+  }
+  // all parts of a file are processed by the same worker
+  return part_workers_[next_part_worker_++ % part_workers_.size()].get();
+}
+
 void FileDownloadManager::download(QueryId query_id, const FullRemoteFileLocation &remote_location,
                                    const LocalFileLocation &local, int64 size, string name,
                                    const FileEncryptionKey &encryption_key, bool need_search_file, int64 offset,
@@ -52,7 +74,8 @@ void FileDownloadManager::download(QueryId query_id, const FullRemoteFileLocatio
   bool is_small = size < 20 * 1024;
   node->downloader_ =
       create_actor<FileDownloader>("Downloader", remote_location, local, size, std::move(name), encryption_key,
-                                   is_small, need_search_file, offset, limit, std::move(callback));
+                                   is_small, need_search_file, offset, limit, use_file_deduplication_,
+                                   get_part_worker(), std::move(callback));
   DcId dc_id = remote_location.is_web() ? G()->get_webfile_dc_id() : remote_location.get_dc_id();
   auto &resource_manager = get_download_resource_manager(is_small, dc_id);
   send_closure(resource_manager, &ResourceManager::register_worker,
@@ -117,6 +140,22 @@ void FileDownloadManager::update_downloaded_part(QueryId query_id, int64 offset,
   send_closure(node->downloader_, &FileDownloader::update_downloaded_part, offset, limit, max_download_resource_limit_);
 }
 
+void FileDownloadManager::update_reader_offsets(QueryId query_id, vector<int64> reader_offsets,
+                                                int64 read_ahead_size) {
+  if (stop_flag_) {
+    return;
+  }
+  auto it = query_id_to_node_id_.find(query_id);
+  if (it == query_id_to_node_id_.end()) {
+    return;
+  }
+  auto node = nodes_container_.get(it->second);
+  if (node == nullptr || node->downloader_.empty()) {
+    return;
+  }
+  send_closure(node->downloader_, &FileDownloader::update_reader_offsets, std::move(reader_offsets), read_ahead_size);
+}
+
 void FileDownloadManager::hangup() {
   nodes_container_.for_each([](auto query_id, auto &node) {
     node.downloader_.reset();
@@ -137,14 +176,15 @@ void FileDownloadManager::on_start_download() {
   }
 }
 
-void FileDownloadManager::on_partial_download(PartialLocalFileLocation partial_local, int64 ready_size, int64 size) {
+void FileDownloadManager::on_partial_download(PartialLocalFileLocation partial_local, int64 ready_size, int64 size,
+                                              int64 download_speed) {
   auto node_id = get_link_token();
   auto node = nodes_container_.get(node_id);
   if (node == nullptr) {
     return;
   }
   if (!stop_flag_) {
-    callback_->on_partial_download(node->query_id_, std::move(partial_local), ready_size, size);
+    callback_->on_partial_download(node->query_id_, std::move(partial_local), ready_size, size, download_speed);
   }
 }
 
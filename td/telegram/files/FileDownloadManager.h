@@ -10,6 +10,7 @@
 #include "td/telegram/files/FileEncryptionKey.h"
 #include "td/telegram/files/FileFromBytes.h"
 #include "td/telegram/files/FileLocation.h"
+#include "td/telegram/files/FilePartWorker.h"
 #include "td/telegram/files/FileType.h"
 #include "td/telegram/files/ResourceManager.h"
 #include "td/telegram/net/DcId.h"
@@ -34,7 +35,7 @@ class FileDownloadManager final : public Actor {
     virtual ~Callback();
     virtual void on_start_download(QueryId query_id) = 0;
     virtual void on_partial_download(QueryId query_id, PartialLocalFileLocation partial_local, int64 ready_size,
-                                     int64 size) = 0;
+                                     int64 size, int64 download_speed) = 0;
     virtual void on_download_ok(QueryId query_id, FullLocalFileLocation local, int64 size, bool is_new) = 0;
     virtual void on_error(QueryId query_id, Status status) = 0;
   };
@@ -53,6 +54,10 @@ class FileDownloadManager final : public Actor {
 
   void update_downloaded_part(QueryId query_id, int64 offset, int64 limit);
 
+  void update_reader_offsets(QueryId query_id, vector<int64> reader_offsets, int64 read_ahead_size);
+
+  void update_use_file_deduplication();
+
  private:
   struct Node {
     QueryId query_id_;
@@ -64,11 +69,16 @@ class FileDownloadManager final : public Actor {
   std::map<DcId, ActorOwn<ResourceManager>> download_resource_manager_map_;
   std::map<DcId, ActorOwn<ResourceManager>> download_small_resource_manager_map_;
 
+  vector<ActorOwn<FilePartWorker>> part_workers_;
+  size_t next_part_worker_ = 0;
+
   Container<Node> nodes_container_;
   unique_ptr<Callback> callback_;
   ActorShared<> parent_;
   std::map<QueryId, NodeId> query_id_to_node_id_;
   int64 max_download_resource_limit_ = 1 << 21;
+  ResourceManager::Mode download_resource_manager_mode_ = ResourceManager::Mode::Baseline;
+  bool use_file_deduplication_ = false;
   bool stop_flag_ = false;
 
   void start_up() final;
@@ -81,8 +91,11 @@ class FileDownloadManager final : public Actor {
 
   ActorOwn<ResourceManager> &get_download_resource_manager(bool is_small, DcId dc_id);
 
+  ActorId<FilePartWorker> get_part_worker();
+
   void on_start_download();
-  void on_partial_download(PartialLocalFileLocation partial_local, int64 ready_size, int64 size);
+  void on_partial_download(PartialLocalFileLocation partial_local, int64 ready_size, int64 size,
+                           int64 download_speed);
   void on_ok_download(FullLocalFileLocation local, int64 size, bool is_new);
   void on_error(Status status);
   void on_error_impl(NodeId node_id, Status status);
@@ -98,8 +111,10 @@ class FileDownloadManager final : public Actor {
     void on_start_download() final {
       send_closure(actor_id_, &FileDownloadManager::on_start_download);
     }
-    void on_partial_download(PartialLocalFileLocation partial_local, int64 ready_size, int64 size) final {
-      send_closure(actor_id_, &FileDownloadManager::on_partial_download, std::move(partial_local), ready_size, size);
+    void on_partial_download(PartialLocalFileLocation partial_local, int64 ready_size, int64 size,
+                             int64 download_speed) final {
+      send_closure(actor_id_, &FileDownloadManager::on_partial_download, std::move(partial_local), ready_size, size,
+                   download_speed);
     }
     void on_ok(FullLocalFileLocation full_local, int64 size, bool is_new) final {
       send_closure(std::move(actor_id_), &FileDownloadManager::on_ok_download, std::move(full_local), size, is_new);
@@ -7,11 +7,13 @@
 #include "td/telegram/files/FileDownloader.h"
 
 #include "td/telegram/FileReferenceManager.h"
+#include "td/telegram/files/FileDb.h"
 #include "td/telegram/files/FileLoaderUtils.h"
 #include "td/telegram/files/FileType.h"
 #include "td/telegram/Global.h"
 #include "td/telegram/net/NetQueryDispatcher.h"
 #include "td/telegram/SecureStorage.h"
+#include "td/telegram/TdDb.h"
 #include "td/telegram/telegram_api.h"
 #include "td/telegram/UniqueId.h"
 
@@ -26,6 +28,7 @@
 #include "td/utils/port/Stat.h"
 #include "td/utils/ScopeGuard.h"
 #include "td/utils/SliceBuilder.h"
+#include "td/utils/Time.h"
 #include "td/utils/UInt.h"
 
 #include <tuple>
@@ -34,7 +37,8 @@ namespace td {
 
 FileDownloader::FileDownloader(const FullRemoteFileLocation &remote, const LocalFileLocation &local, int64 size,
                                string name, const FileEncryptionKey &encryption_key, bool is_small,
-                               bool need_search_file, int64 offset, int64 limit, unique_ptr<Callback> callback)
+                               bool need_search_file, int64 offset, int64 limit, bool need_deduplicate,
+                               ActorId<FilePartWorker> part_worker, unique_ptr<Callback> callback)
     : remote_(remote)
     , local_(local)
     , size_(size)
@@ -45,7 +49,9 @@ FileDownloader::FileDownloader(const FullRemoteFileLocation &remote, const Local
     , need_search_file_(need_search_file)
     , ordered_flag_(encryption_key_.is_secret())
     , offset_(offset)
-    , limit_(limit) {
+    , limit_(limit)
+    , need_deduplicate_(need_deduplicate && encryption_key_.empty() && !part_worker.empty())
+    , part_worker_(std::move(part_worker)) {
   if (!encryption_key.empty()) {
     CHECK(offset_ == 0);
   }
@@ -57,6 +63,18 @@ void FileDownloader::on_error(Status status) {
   callback_->on_error(std::move(status));
 }
 
+void FileDownloader::on_file_added_to_content_store(string path, int64 size, Result<string> r_content_path) {
+  if (r_content_path.is_error()) {
+    LOG(INFO) << "Failed to deduplicate file " << path << ": " << r_content_path.error();
+  } else {
+    auto file_db = G()->td_db()->get_file_db_shared();
+    if (file_db != nullptr) {
+      file_db->add_file_content_ref(path, r_content_path.move_as_ok());
+    }
+  }
+  callback_->on_ok(FullLocalFileLocation(remote_.file_type_, std::move(path), 0), size, true);
+}
+
 Result<bool> FileDownloader::should_restart_part(Part part, const NetQueryPtr &net_query) {
   // Check if we should use CDN or reupload file to CDN
 
@@ -205,7 +223,7 @@ Status FileDownloader::check_net_query(NetQueryPtr &net_query) {
   return Status::OK();
 }
 
-Result<size_t> FileDownloader::process_part(Part part, NetQueryPtr net_query) {
+Result<std::pair<BufferSlice, bool>> FileDownloader::fetch_part(Part part, NetQueryPtr net_query) {
   TRY_STATUS(check_net_query(net_query));
 
   BufferSlice bytes;
@@ -245,22 +263,19 @@ Result<size_t> FileDownloader::process_part(Part part, NetQueryPtr net_query) {
   if (bytes.size() > padded_size) {
     return Status::Error("Part size is more than requested");
   }
-  if (bytes.empty()) {
-    return 0;
-  }
+  return std::make_pair(std::move(bytes), need_cdn_decrypt);
+}
 
+bool FileDownloader::need_save_part_on_worker() const {
+  // parts of secret files must be decrypted sequentially
+  return !part_worker_.empty() && !encryption_key_.is_secret() && !only_check_;
+}
+
+Result<size_t> FileDownloader::save_part(Part part, BufferSlice bytes, bool need_cdn_decrypt) {
+  CHECK(!bytes.empty());
   // Encryption
   if (need_cdn_decrypt) {
-    CHECK(part.offset % 16 == 0);
-    auto offset = narrow_cast<uint32>(part.offset / 16);
-    offset =
-        ((offset & 0xff) << 24) | ((offset & 0xff00) << 8) | ((offset & 0xff0000) >> 8) | ((offset & 0xff000000) >> 24);
-
-    AesCtrState ctr_state;
-    string iv = cdn_encryption_iv_;
-    as<uint32>(&iv[12]) = offset;
-    ctr_state.init(cdn_encryption_key_, iv);
-    ctr_state.decrypt(bytes.as_slice(), bytes.as_mutable_slice());
+    FilePartWorker::decrypt_cdn_part(cdn_encryption_key_, cdn_encryption_iv_, part.offset, bytes.as_mutable_slice());
   }
   if (encryption_key_.is_secret()) {
     LOG_CHECK(next_part_ == part.id) << tag("expected part.id", next_part_) << "!=" << tag("part.id", part.id);
@@ -296,10 +311,11 @@ void FileDownloader::on_progress() {
   }
   auto part_size = static_cast<int32>(parts_manager_.get_part_size());
   auto size = parts_manager_.get_size_or_zero();
+  auto download_speed = speed_estimator_.get_speed(Time::now());
   if (encryption_key_.empty() || encryption_key_.is_secure()) {
     callback_->on_partial_download(
         PartialLocalFileLocation{remote_.file_type_, part_size, path_, "", parts_manager_.get_bitmask()}, ready_size,
-        size);
+        size, download_speed);
   } else if (encryption_key_.is_secret()) {
     UInt256 iv;
     auto ready_part_count = parts_manager_.get_ready_prefix_count();
@@ -310,7 +326,7 @@ void FileDownloader::on_progress() {
     }
     callback_->on_partial_download(PartialLocalFileLocation{remote_.file_type_, part_size, path_, as_slice(iv).str(),
                                                             parts_manager_.get_bitmask()},
-                                   ready_size, size);
+                                   ready_size, size, download_speed);
   } else {
     UNREACHABLE();
   }
@@ -324,8 +340,33 @@ Status FileDownloader::process_check_query(NetQueryPtr net_query) {
   return Status::OK();
 }
 
+Status FileDownloader::get_hash_mismatch_error() const {
+  if (only_check_) {
+    return Status::Error("FILE_DOWNLOAD_RESTART");
+  }
+  return Status::Error("Hash mismatch");
+}
+
+void FileDownloader::on_part_hash_checked(int64 end_offset, Result<bool> r_is_valid) {
+  CHECK(is_hash_check_pending_);
+  is_hash_check_pending_ = false;
+  if (stop_flag_) {
+    return;
+  }
+  if (r_is_valid.is_error()) {
+    return on_error(r_is_valid.move_as_error());
+  }
+  if (!r_is_valid.ok()) {
+    return on_error(get_hash_mismatch_error());
+  }
+
+  parts_manager_.set_checked_prefix_size(end_offset);
+  on_progress();
+  loop();
+}
+
 Status FileDownloader::check_loop(int64 checked_prefix_size, int64 ready_prefix_size, bool is_ready) {
-  if (!need_check_) {
+  if (!need_check_ || is_hash_check_pending_) {
     return Status::OK();
   }
   SCOPE_EXIT {
@@ -352,20 +393,19 @@ Status FileDownloader::check_loop(int64 checked_prefix_size, int64 ready_prefix_
         end_offset = ready_prefix_size;
       }
       auto size = narrow_cast<size_t>(end_offset - begin_offset);
-      auto slice = BufferSlice(size);
       TRY_STATUS(acquire_fd());
-      TRY_RESULT(read_size, fd_.pread(slice.as_mutable_slice(), begin_offset));
-      if (size != read_size) {
-        return Status::Error("Failed to read file to check hash");
+      if (!part_worker_.empty()) {
+        // the check will be continued after the hash is checked by the part worker
+        is_hash_check_pending_ = true;
+        send_closure(part_worker_, &FilePartWorker::check_part_hash, path_, begin_offset, size, it->hash,
+                     PromiseCreator::lambda([actor_id = actor_id(this), end_offset](Result<bool> r_is_valid) {
+                       send_closure(actor_id, &FileDownloader::on_part_hash_checked, end_offset, std::move(r_is_valid));
+                     }));
+        break;
       }
-      string hash(32, ' ');
-      sha256(slice.as_slice(), hash);
-
-      if (hash != it->hash) {
-        if (only_check_) {
-          return Status::Error("FILE_DOWNLOAD_RESTART");
-        }
-        return Status::Error("Hash mismatch");
+      TRY_RESULT(is_valid, FilePartWorker::check_file_part_hash(fd_, begin_offset, size, it->hash));
+      if (!is_valid) {
+        return get_hash_mismatch_error();
       }
 
       checked_prefix_size = end_offset;
@@ -477,6 +517,17 @@ void FileDownloader::update_downloaded_part(int64 offset, int64 limit, int64 max
   loop();
 }
 
+void FileDownloader::update_reader_offsets(vector<int64> reader_offsets, int64 read_ahead_size) {
+  if (ordered_flag_ || only_check_) {
+    // parts must be downloaded sequentially
+    return;
+  }
+  VLOG(file_loader) << "Update reader offsets to " << reader_offsets << " with read-ahead size " << read_ahead_size;
+  parts_manager_.set_reader_offsets(std::move(reader_offsets), read_ahead_size);
+  update_estimated_limit();
+  loop();
+}
+
 void FileDownloader::start_up() {
   if (local_.type() == LocalFileLocation::Type::Full) {
     return on_error(Status::Error("File is already downloaded"));
@@ -574,6 +625,7 @@ Status FileDownloader::do_loop() {
   if (parts_manager_.may_finish()) {
     TRY_STATUS(parts_manager_.finish());
     fd_.close();
+    close_part_worker_file();
     auto size = parts_manager_.get_size();
     if (encryption_key_.is_secure()) {
       TRY_RESULT(file_path, open_temp_file(remote_.file_type_));
@@ -591,12 +643,21 @@ Status FileDownloader::do_loop() {
     } else {
       TRY_RESULT_ASSIGN(path, create_from_temp(remote_.file_type_, path_, name_));
     }
-    callback_->on_ok(FullLocalFileLocation(remote_.file_type_, std::move(path), 0), size, !only_check_);
 
     LOG(INFO) << "Bad download order rate: "
               << (debug_total_parts_ == 0 ? 0.0 : 100.0 * debug_bad_part_order_ / debug_total_parts_) << "% "
               << debug_bad_part_order_ << "/" << debug_total_parts_ << " " << format::as_array(debug_bad_parts_);
     stop_flag_ = true;
+    if (need_deduplicate_ && !only_check_ && size >= MIN_DEDUPLICATED_FILE_SIZE) {
+      // the file is hashed by the part worker, the download will be finished after that
+      send_closure(part_worker_, &FilePartWorker::add_file_to_content_store, remote_.file_type_, path,
+                   PromiseCreator::lambda([actor_id = actor_id(this), path, size](Result<string> r_content_path) {
+                     send_closure(actor_id, &FileDownloader::on_file_added_to_content_store, std::move(path), size,
+                                  std::move(r_content_path));
+                   }));
+      return Status::OK();
+    }
+    callback_->on_ok(FullLocalFileLocation(remote_.file_type_, std::move(path), 0), size, !only_check_);
     return Status::OK();
   }
 
@@ -615,6 +676,7 @@ Status FileDownloader::do_loop() {
     TRY_RESULT(query, start_part(part, parts_manager_.get_part_count(), parts_manager_.get_streaming_offset()));
     uint64 unique_id = UniqueId::next();
     part_map_[unique_id] = std::make_pair(part, query->cancel_slot_.get_signal_new());
+    part_start_time_[unique_id] = Time::now();
 
     auto callback = actor_shared(this, unique_id);
     if (delay_dispatcher_.empty()) {
@@ -629,7 +691,14 @@ Status FileDownloader::do_loop() {
   return Status::OK();
 }
 
+void FileDownloader::close_part_worker_file() {
+  if (!part_worker_.empty() && !path_.empty()) {
+    send_closure(part_worker_, &FilePartWorker::close_file, path_);
+  }
+}
+
 void FileDownloader::tear_down() {
+  close_part_worker_file();
   for (auto &it : part_map_) {
     it.second.second.reset();  // cancel_query(it.second.second);
   }
@@ -678,6 +747,19 @@ void FileDownloader::on_result(NetQueryPtr query) {
   CHECK(query->is_ready());
   part_map_.erase(it);
 
+  auto start_time_it = part_start_time_.find(unique_id);
+  CHECK(start_time_it != part_start_time_.end());
+  auto start_time = start_time_it->second;
+  part_start_time_.erase(start_time_it);
+  if (query->is_ok()) {
+    auto now = Time::now();
+    speed_estimator_.on_part_loaded(static_cast<int64>(part.size), now - start_time, now);
+    if (!resource_manager_.empty()) {
+      send_closure(resource_manager_, &ResourceManager::on_part_loaded, static_cast<int64>(part.size),
+                   now - start_time);
+    }
+  }
+
   bool next = false;
   auto status = [&] {
     TRY_RESULT(should_restart, should_restart_part(part, query));
@@ -723,7 +805,45 @@ void FileDownloader::on_part_query(Part part, NetQueryPtr query) {
 }
 
 Status FileDownloader::try_on_part_query(Part part, NetQueryPtr query) {
-  TRY_RESULT(size, process_part(part, std::move(query)));
+  TRY_RESULT(fetched_part, fetch_part(part, std::move(query)));
+  auto &bytes = fetched_part.first;
+  auto need_cdn_decrypt = fetched_part.second;
+  if (bytes.empty()) {
+    return on_part_saved_impl(part, 0);
+  }
+  if (!need_save_part_on_worker()) {
+    TRY_RESULT(size, save_part(part, std::move(bytes), need_cdn_decrypt));
+    return on_part_saved_impl(part, size);
+  }
+
+  // the file must be created before the part is saved on the part worker
+  TRY_STATUS(acquire_fd());
+  CHECK(!path_.empty());
+  send_closure(part_worker_, &FilePartWorker::save_part, path_, part.offset, std::move(bytes),
+               part.size, need_cdn_decrypt ? cdn_encryption_key_ : string(),
+               need_cdn_decrypt ? cdn_encryption_iv_ : string(),
+               PromiseCreator::lambda([actor_id = actor_id(this), part](Result<size_t> r_size) {
+                 send_closure(actor_id, &FileDownloader::on_part_saved, part, std::move(r_size));
+               }));
+  return Status::OK();
+}
+
+void FileDownloader::on_part_saved(Part part, Result<size_t> r_size) {
+  if (stop_flag_) {
+    return;
+  }
+  auto status = [&] {
+    TRY_RESULT(size, std::move(r_size));
+    return on_part_saved_impl(part, size);
+  }();
+  if (status.is_error()) {
+    return on_error(std::move(status));
+  }
+  update_estimated_limit();
+  loop();
+}
+
+Status FileDownloader::on_part_saved_impl(Part part, size_t size) {
   VLOG(file_loader) << "Ok part " << tag("id", part.id) << tag("size", part.size);
   resource_state_.stop_use(static_cast<int64>(part.size));
   auto old_ready_prefix_count = parts_manager_.get_unchecked_ready_prefix_count();
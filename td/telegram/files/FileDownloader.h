@@ -10,6 +10,8 @@
 #include "td/telegram/files/FileEncryptionKey.h"
 #include "td/telegram/files/FileLoaderActor.h"
 #include "td/telegram/files/FileLocation.h"
+#include "td/telegram/files/FilePartWorker.h"
+#include "td/telegram/files/LoadSpeedEstimator.h"
 #include "td/telegram/files/PartsManager.h"
 #include "td/telegram/files/ResourceManager.h"
 #include "td/telegram/files/ResourceState.h"
@@ -19,6 +21,7 @@
 
 #include "td/actor/actor.h"
 
+#include "td/utils/buffer.h"
 #include "td/utils/common.h"
 #include "td/utils/OrderedEventsProcessor.h"
 #include "td/utils/port/FileFd.h"
@@ -38,7 +41,8 @@ class FileDownloader final : public FileLoaderActor {
     Callback(const Callback &) = delete;
     Callback &operator=(const Callback &) = delete;
     virtual void on_start_download() = 0;
-    virtual void on_partial_download(PartialLocalFileLocation partial_local, int64 ready_size, int64 size) = 0;
+    virtual void on_partial_download(PartialLocalFileLocation partial_local, int64 ready_size, int64 size,
+                                     int64 download_speed) = 0;
     virtual void on_ok(FullLocalFileLocation full_local, int64 size, bool is_new) = 0;
     virtual void on_error(Status status) = 0;
     virtual ~Callback() = default;
@@ -46,10 +50,13 @@ class FileDownloader final : public FileLoaderActor {
 
   FileDownloader(const FullRemoteFileLocation &remote, const LocalFileLocation &local, int64 size, string name,
                  const FileEncryptionKey &encryption_key, bool is_small, bool need_search_file, int64 offset,
-                 int64 limit, unique_ptr<Callback> callback);
+                 int64 limit, bool need_deduplicate, ActorId<FilePartWorker> part_worker,
+                 unique_ptr<Callback> callback);
 
   void update_downloaded_part(int64 offset, int64 limit, int64 max_resource_limit);
 
+  void update_reader_offsets(vector<int64> reader_offsets, int64 read_ahead_size);
+
   // Should just implement all parent pure virtual methods.
   // Must not call any of them...
  private:
@@ -74,6 +81,13 @@ class FileDownloader final : public FileLoaderActor {
   int64 offset_ = 0;
   int64 limit_ = 0;
 
+  // the downloaded file is linked to a stored file with the same content if true
+  bool need_deduplicate_ = false;
+  static constexpr int64 MIN_DEDUPLICATED_FILE_SIZE = 1 << 16;
+
+  // decrypts, checks and saves parts of non-secret files if non-empty
+  ActorId<FilePartWorker> part_worker_;
+
   bool use_cdn_ = false;
   DcId cdn_dc_id_;
   string cdn_encryption_key_;
@@ -94,6 +108,7 @@ class FileDownloader final : public FileLoaderActor {
   };
   std::set<HashInfo> hash_info_;
   bool has_hash_query_ = false;
+  bool is_hash_check_pending_ = false;
 
   static constexpr uint8 COMMON_QUERY_KEY = 2;
   bool stop_flag_ = false;
@@ -101,6 +116,8 @@ class FileDownloader final : public FileLoaderActor {
   ResourceState resource_state_;
   PartsManager parts_manager_;
   std::map<uint64, std::pair<Part, ActorShared<>>> part_map_;
+  std::map<uint64, double> part_start_time_;
+  LoadSpeedEstimator speed_estimator_;
   OrderedEventsProcessor<std::pair<Part, NetQueryPtr>> ordered_parts_;
   ActorOwn<DelayDispatcher> delay_dispatcher_;
   double next_delay_ = 0;
@@ -115,6 +132,8 @@ class FileDownloader final : public FileLoaderActor {
 
   void on_error(Status status);
 
+  void on_file_added_to_content_store(string path, int64 size, Result<string> r_content_path);
+
   Result<bool> should_restart_part(Part part, const NetQueryPtr &net_query) TD_WARN_UNUSED_RESULT;
 
   Status process_check_query(NetQueryPtr net_query);
@@ -123,12 +142,26 @@ class FileDownloader final : public FileLoaderActor {
 
   Result<NetQueryPtr> start_part(Part part, int32 part_count, int64 streaming_offset) TD_WARN_UNUSED_RESULT;
 
-  Result<size_t> process_part(Part part, NetQueryPtr net_query) TD_WARN_UNUSED_RESULT;
+  Result<std::pair<BufferSlice, bool>> fetch_part(Part part, NetQueryPtr net_query) TD_WARN_UNUSED_RESULT;
+
+  bool need_save_part_on_worker() const;
+
+  Result<size_t> save_part(Part part, BufferSlice bytes, bool need_cdn_decrypt) TD_WARN_UNUSED_RESULT;
+
+  void on_part_saved(Part part, Result<size_t> r_size);
+
+  Status on_part_saved_impl(Part part, size_t size) TD_WARN_UNUSED_RESULT;
+
+  Status get_hash_mismatch_error() const;
+
+  void on_part_hash_checked(int64 end_offset, Result<bool> r_is_valid);
 
   void add_hash_info(const std::vector<telegram_api::object_ptr<telegram_api::fileHash>> &hashes);
 
   void try_release_fd();
 
+  void close_part_worker_file();
+
   Status acquire_fd() TD_WARN_UNUSED_RESULT;
 
   Status check_net_query(NetQueryPtr &net_query);
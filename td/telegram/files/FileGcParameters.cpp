@@ -13,6 +13,18 @@
 
 namespace td {
 
+StringBuilder &operator<<(StringBuilder &string_builder, FileGcPolicy policy) {
+  switch (policy) {
+    case FileGcPolicy::LeastRecentlyUsed:
+      return string_builder << "LRU";
+    case FileGcPolicy::SizeAware:
+      return string_builder << "SizeAware";
+    default:
+      UNREACHABLE();
+      return string_builder;
+  }
+}
+
 FileGcParameters::FileGcParameters(int64 size, int32 ttl, int32 count, int32 immunity_delay,
                                    vector<FileType> file_types, vector<DialogId> owner_dialog_ids,
                                    vector<DialogId> exclude_owner_dialog_ids, int32 dialog_limit)
@@ -30,6 +42,9 @@ FileGcParameters::FileGcParameters(int64 size, int32 ttl, int32 count, int32 imm
   immunity_delay_ = immunity_delay >= 0
                         ? immunity_delay
                         : narrow_cast<int32>(G()->get_option_integer("storage_immunity_delay", 60 * 60));
+
+  policy_ = G()->get_option_string("storage_gc_policy") == "size" ? FileGcPolicy::SizeAware
+                                                                   : FileGcPolicy::LeastRecentlyUsed;
 }
 
 StringBuilder &operator<<(StringBuilder &string_builder, const FileGcParameters &parameters) {
@@ -40,7 +55,8 @@ StringBuilder &operator<<(StringBuilder &string_builder, const FileGcParameters
                         << tag("file_types", parameters.file_types_)
                         << tag("owner_dialog_ids", parameters.owner_dialog_ids_)
                         << tag("exclude_owner_dialog_ids", parameters.exclude_owner_dialog_ids_)
-                        << tag("dialog_limit", parameters.dialog_limit_) << ']';
+                        << tag("dialog_limit", parameters.dialog_limit_) << tag("policy", parameters.policy_)
+                        << tag("is_background", parameters.is_background_) << ']';
 }
 
 }  // namespace td
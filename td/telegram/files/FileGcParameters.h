@@ -14,6 +14,14 @@
 
 namespace td {
 
+// order in which files are removed to fit in the size and count limits
+enum class FileGcPolicy : int32 {
+  LeastRecentlyUsed,  // the least recently accessed files are removed first
+  SizeAware           // files with the biggest product of size and time since the last access are removed first
+};
+
+StringBuilder &operator<<(StringBuilder &string_builder, FileGcPolicy policy);
+
 struct FileGcParameters {
   FileGcParameters() : FileGcParameters(-1, -1, -1, -1, {}, {}, {}, 0) {
   }
@@ -30,6 +38,11 @@ struct FileGcParameters {
   vector<DialogId> exclude_owner_dialog_ids_;
 
   int32 dialog_limit_;
+
+  FileGcPolicy policy_;
+
+  // background GC removes files in small batches to not saturate disk I/O
+  bool is_background_ = false;
 };
 
 StringBuilder &operator<<(StringBuilder &string_builder, const FileGcParameters &parameters);
@@ -6,10 +6,12 @@
 //
 #include "td/telegram/files/FileGcWorker.h"
 
+#include "td/telegram/files/FileDb.h"
 #include "td/telegram/files/FileLocation.h"
 #include "td/telegram/files/FileManager.h"
 #include "td/telegram/files/FileType.h"
 #include "td/telegram/Global.h"
+#include "td/telegram/TdDb.h"
 
 #include "td/utils/algorithm.h"
 #include "td/utils/format.h"
@@ -17,10 +19,12 @@
 #include "td/utils/misc.h"
 #include "td/utils/port/Clocks.h"
 #include "td/utils/port/path.h"
+#include "td/utils/port/Stat.h"
 #include "td/utils/Time.h"
 
 #include <algorithm>
 #include <array>
+#include <utility>
 
 namespace td {
 
@@ -28,6 +32,7 @@ int VERBOSITY_NAME(file_gc) = VERBOSITY_NAME(INFO);
 
 void FileGcWorker::run_gc(const FileGcParameters &parameters, std::vector<FullFileInfo> files,
                           Promise<FileGcResult> promise) {
+  CHECK(!promise_);
   auto begin_time = Time::now();
   VLOG(file_gc) << "Start files GC with " << parameters;
   // quite stupid implementations
@@ -81,19 +86,38 @@ void FileGcWorker::run_gc(const FileGcParameters &parameters, std::vector<FullFi
     total_size += info.size;
   }
 
-  FileStats new_stats(false, parameters.dialog_limit_ != 0);
-  FileStats removed_stats(false, parameters.dialog_limit_ != 0);
-
-  auto do_remove_file = [&removed_stats](const FullFileInfo &info) {
-    removed_stats.add_copy(info);
-    auto status = unlink(info.path);
-    LOG_IF(WARNING, status.is_error()) << "Failed to unlink file \"" << info.path << "\" during files GC: " << status;
-    send_closure(G()->file_manager(), &FileManager::on_file_unlink,
-                 FullLocalFileLocation(info.file_type, info.path, info.mtime_nsec));
-  };
+  kept_file_stats_ = FileStats(false, true);
+  removed_file_stats_ = FileStats(false, true);
+  files_to_remove_.clear();
+  removed_file_count_ = 0;
 
   double now = Clocks::system();
 
+  // stored files are removed only after all other links to them are removed
+  int32 remove_stored_cnt = 0;
+  vector<std::pair<string, int32>> content_ref_counts;
+  td::remove_if(files, [&](const FullFileInfo &info) {
+    if (!info.is_stored) {
+      return false;
+    }
+    auto ref_count = narrow_cast<int32>(info.link_count - 1);
+    content_ref_counts.emplace_back(info.path, ref_count);
+    if (ref_count == 0) {
+      files_to_remove_.push_back(info);
+      total_removed_size += info.size;
+      remove_stored_cnt++;
+    } else {
+      kept_file_stats_.add_copy(info);
+    }
+    return true;
+  });
+  if (!content_ref_counts.empty() && G()->use_file_database()) {
+    auto file_db = G()->td_db()->get_file_db_shared();
+    if (file_db != nullptr) {
+      file_db->set_file_content_ref_counts(std::move(content_ref_counts));
+    }
+  }
+
   // Remove all suitable files with (atime > now - max_time_from_last_access)
   td::remove_if(files, [&](const FullFileInfo &info) {
     if (token_) {
@@ -101,28 +125,28 @@ void FileGcWorker::run_gc(const FileGcParameters &parameters, std::vector<FullFi
     }
     if (immune_types[narrow_cast<size_t>(info.file_type)]) {
       type_immunity_ignored_cnt++;
-      new_stats.add_copy(info);
+      kept_file_stats_.add_copy(info);
       return true;
     }
     if (td::contains(parameters.exclude_owner_dialog_ids_, info.owner_dialog_id)) {
       exclude_owner_dialog_id_ignored_cnt++;
-      new_stats.add_copy(info);
+      kept_file_stats_.add_copy(info);
       return true;
     }
     if (!parameters.owner_dialog_ids_.empty() && !td::contains(parameters.owner_dialog_ids_, info.owner_dialog_id)) {
       owner_dialog_id_ignored_cnt++;
-      new_stats.add_copy(info);
+      kept_file_stats_.add_copy(info);
       return true;
     }
     if (static_cast<double>(info.mtime_nsec) * 1e-9 > now - parameters.immunity_delay_) {
       // new files are immune to GC
       time_immunity_ignored_cnt++;
-      new_stats.add_copy(info);
+      kept_file_stats_.add_copy(info);
       return true;
     }
 
     if (static_cast<double>(info.atime_nsec) * 1e-9 < now - parameters.max_time_from_last_access_) {
-      do_remove_file(info);
+      files_to_remove_.push_back(info);
       total_removed_size += info.size;
       remove_by_atime_cnt++;
       return true;
@@ -130,11 +154,11 @@ void FileGcWorker::run_gc(const FileGcParameters &parameters, std::vector<FullFi
     return false;
   });
   if (token_) {
+    files_to_remove_.clear();
     return promise.set_error(Global::request_aborted_error());
   }
 
-  // sort by max(atime, mtime)
-  std::sort(files.begin(), files.end(), [](const auto &a, const auto &b) { return a.atime_nsec < b.atime_nsec; });
+  sort_files(parameters.policy_, files, now);
 
   // 1. Total size must be less than parameters.max_files_size_
   // 2. Total file count must be less than parameters.max_file_count_
@@ -149,9 +173,6 @@ void FileGcWorker::run_gc(const FileGcParameters &parameters, std::vector<FullFi
 
   size_t pos = 0;
   while (pos < files.size() && (remove_count > 0 || remove_size > 0)) {
-    if (token_) {
-      return promise.set_error(Global::request_aborted_error());
-    }
     if (remove_count > 0) {
       remove_by_count_cnt++;
     } else {
@@ -164,34 +185,134 @@ void FileGcWorker::run_gc(const FileGcParameters &parameters, std::vector<FullFi
     remove_size -= files[pos].size;
 
     total_removed_size += files[pos].size;
-    do_remove_file(files[pos]);
+    files_to_remove_.push_back(files[pos]);
     pos++;
   }
 
   while (pos < files.size()) {
-    new_stats.add_copy(files[pos]);
+    kept_file_stats_.add_copy(files[pos]);
     pos++;
   }
 
   auto end_time = Time::now();
 
   VLOG(file_gc) << "Finish files GC: " << tag("time", end_time - begin_time) << tag("total", file_cnt)
-                << tag("removed", remove_by_atime_cnt + remove_by_count_cnt + remove_by_size_cnt)
+                << tag("removed", remove_by_atime_cnt + remove_by_count_cnt + remove_by_size_cnt + remove_stored_cnt)
                 << tag("total_size", format::as_size(total_size))
                 << tag("total_removed_size", format::as_size(total_removed_size))
                 << tag("by_atime", remove_by_atime_cnt) << tag("by_count", remove_by_count_cnt)
-                << tag("by_size", remove_by_size_cnt) << tag("type_immunity", type_immunity_ignored_cnt)
+                << tag("by_size", remove_by_size_cnt) << tag("unreferenced_stored", remove_stored_cnt)
+                << tag("type_immunity", type_immunity_ignored_cnt)
                 << tag("time_immunity", time_immunity_ignored_cnt)
                 << tag("owner_dialog_id_immunity", owner_dialog_id_ignored_cnt)
                 << tag("exclude_owner_dialog_id_immunity", exclude_owner_dialog_id_ignored_cnt);
   if (end_time - begin_time > 1.0) {
     LOG(WARNING) << "Finish file GC: " << tag("time", end_time - begin_time) << tag("total", file_cnt)
-                 << tag("removed", remove_by_atime_cnt + remove_by_count_cnt + remove_by_size_cnt)
+                 << tag("removed", remove_by_atime_cnt + remove_by_count_cnt + remove_by_size_cnt + remove_stored_cnt)
                  << tag("total_size", format::as_size(total_size))
                  << tag("total_removed_size", format::as_size(total_removed_size));
   }
 
-  promise.set_value({std::move(new_stats), std::move(removed_stats)});
+  promise_ = std::move(promise);
+  remove_files(parameters.is_background_);
+}
+
+void FileGcWorker::sort_files(FileGcPolicy policy, vector<FullFileInfo> &files, double now) {
+  switch (policy) {
+    case FileGcPolicy::LeastRecentlyUsed:
+      // sort by max(atime, mtime)
+      std::sort(files.begin(), files.end(), [](const auto &a, const auto &b) { return a.atime_nsec < b.atime_nsec; });
+      break;
+    case FileGcPolicy::SizeAware: {
+      // sort by the product of size and time since the last access in descending order,
+      // so a big file is removed before many small files, which were accessed at the same time
+      auto now_nsec = now * 1e9;
+      auto get_score = [now_nsec](const FullFileInfo &info) {
+        auto idle_time = max(now_nsec - static_cast<double>(info.atime_nsec), 1.0);
+        return idle_time * static_cast<double>(max(info.size, static_cast<int64>(1)));
+      };
+      vector<std::pair<double, size_t>> scores;
+      scores.reserve(files.size());
+      for (size_t i = 0; i < files.size(); i++) {
+        scores.emplace_back(-get_score(files[i]), i);
+      }
+      std::sort(scores.begin(), scores.end());
+      vector<FullFileInfo> sorted_files;
+      sorted_files.reserve(files.size());
+      for (auto &score : scores) {
+        sorted_files.push_back(std::move(files[score.second]));
+      }
+      files = std::move(sorted_files);
+      break;
+    }
+    default:
+      UNREACHABLE();
+  }
+}
+
+size_t FileGcWorker::get_remove_step_file_count(bool is_background, size_t left_file_count) {
+  if (is_background) {
+    return min(left_file_count, MAX_BACKGROUND_REMOVED_FILE_COUNT);
+  }
+  return left_file_count;
+}
+
+void FileGcWorker::remove_file(const FullFileInfo &info) {
+  if (info.is_stored) {
+    auto r_stat = stat(info.path);
+    if (r_stat.is_ok() && r_stat.ok().link_count_ > 1) {
+      // the stored file has been linked again after the scan
+      kept_file_stats_.add_copy(info);
+      return;
+    }
+  }
+  removed_file_stats_.add_copy(info);
+  auto status = unlink(info.path);
+  LOG_IF(WARNING, status.is_error()) << "Failed to unlink file \"" << info.path << "\" during files GC: " << status;
+  if (G()->use_file_database() && !info.is_stored) {
+    auto file_db = G()->td_db()->get_file_db_shared();
+    if (file_db != nullptr) {
+      file_db->remove_file_content_ref(info.path);
+    }
+  }
+  send_closure(G()->file_manager(), &FileManager::on_file_unlink,
+               FullLocalFileLocation(info.file_type, info.path, info.mtime_nsec));
+}
+
+void FileGcWorker::remove_files(bool is_background) {
+  CHECK(promise_);
+  auto end =
+      removed_file_count_ + get_remove_step_file_count(is_background, files_to_remove_.size() - removed_file_count_);
+  while (removed_file_count_ < end) {
+    if (token_) {
+      files_to_remove_.clear();
+      return promise_.set_error(Global::request_aborted_error());
+    }
+    remove_file(files_to_remove_[removed_file_count_++]);
+  }
+  if (removed_file_count_ < files_to_remove_.size()) {
+    VLOG(file_gc) << "Removed " << removed_file_count_ << " out of " << files_to_remove_.size() << " files";
+    set_timeout_in(BACKGROUND_REMOVE_DELAY);
+    return;
+  }
+
+  files_to_remove_.clear();
+  promise_.set_value({std::move(kept_file_stats_), std::move(removed_file_stats_)});
+  kept_file_stats_ = FileStats(false, true);
+  removed_file_stats_ = FileStats(false, true);
+}
+
+void FileGcWorker::timeout_expired() {
+  if (promise_) {
+    remove_files(true);
+  }
+}
+
+void FileGcWorker::hangup() {
+  if (promise_) {
+    promise_.set_error(Global::request_aborted_error());
+  }
+  stop();
 }
 
 }  // namespace td
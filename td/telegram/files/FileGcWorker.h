@@ -30,9 +30,34 @@ class FileGcWorker final : public Actor {
   }
   void run_gc(const FileGcParameters &parameters, std::vector<FullFileInfo> files, Promise<FileGcResult> promise);
 
+  static constexpr size_t MAX_BACKGROUND_REMOVED_FILE_COUNT = 50;  // per step
+  static constexpr double BACKGROUND_REMOVE_DELAY = 0.1;
+
+  // sorts files in the order in which they must be removed
+  static void sort_files(FileGcPolicy policy, vector<FullFileInfo> &files, double now);
+
+  // returns number of files to be removed in the next step
+  static size_t get_remove_step_file_count(bool is_background, size_t left_file_count);
+
  private:
   ActorShared<> parent_;
   CancellationToken token_;
+
+  // state of the current GC
+  vector<FullFileInfo> files_to_remove_;
+  size_t removed_file_count_ = 0;
+  // statistics are always split by owner dialog to update the file usage index of StorageManager
+  FileStats kept_file_stats_{false, true};
+  FileStats removed_file_stats_{false, true};
+  Promise<FileGcResult> promise_;
+
+  void remove_file(const FullFileInfo &info);
+
+  void remove_files(bool is_background);
+
+  void timeout_expired() final;
+
+  void hangup() final;
 };
 
 }  // namespace td
@@ -6,8 +6,18 @@
 //
 #include "td/telegram/files/FileLoadManager.h"
 
+#include "td/telegram/files/FileDb.h"
+#include "td/telegram/Global.h"
+#include "td/telegram/TdDb.h"
+
+#include "td/utils/algorithm.h"
 #include "td/utils/filesystem.h"
+#include "td/utils/logging.h"
+#include "td/utils/misc.h"
 #include "td/utils/port/path.h"
+#include "td/utils/port/Stat.h"
+#include "td/utils/Slice.h"
+#include "td/utils/Time.h"
 
 namespace td {
 
@@ -16,11 +26,107 @@ void FileLoadManager::get_content(string file_path, Promise<BufferSlice> promise
 }
 
 void FileLoadManager::read_file_part(string file_path, int64 offset, int64 count, Promise<string> promise) {
-  promise.set_result(read_file_str(file_path, count, offset));
+  auto r_bytes = do_read_file_part(file_path, offset, count);
+  if (r_bytes.is_error()) {
+    // the file could have been changed; it will be opened again next time
+    open_files_.erase(file_path);
+  }
+  promise.set_result(std::move(r_bytes));
+}
+
+Result<string> FileLoadManager::do_read_file_part(const string &file_path, int64 offset, int64 count) {
+  TRY_RESULT(open_file, get_open_file(file_path));
+  auto file_size = open_file->size_;
+  if (offset < 0 || offset > file_size) {
+    return Status::Error("Failed to read file: invalid offset");
+  }
+  if (count < 0 || count > file_size - offset) {
+    count = file_size - offset;
+  }
+  TRY_RESULT(size, narrow_cast_safe<size_t>(count));
+
+  string content(size, '\0');
+  TRY_RESULT(got_size, open_file->fd_.pread(content, offset));
+  if (got_size != size) {
+    return Status::Error("Failed to read file");
+  }
+  return std::move(content);
+}
+
+Result<FileLoadManager::OpenFile *> FileLoadManager::get_open_file(const string &file_path) {
+  auto now = Time::now();
+  TRY_RESULT(path_stat, stat(file_path));
+
+  auto it = open_files_.find(file_path);
+  if (it != open_files_.end()) {
+    // the file must be reopened if it was replaced; if it is being downloaded, then its size changes
+    auto r_fd_stat = it->second->fd_.stat();
+    if (r_fd_stat.is_ok() && r_fd_stat.ok().size_ == path_stat.size_ &&
+        r_fd_stat.ok().mtime_nsec_ == path_stat.mtime_nsec_) {
+      auto *open_file = it->second.get();
+      open_file->size_ = path_stat.size_;
+      open_file->last_access_time_ = now;
+      return open_file;
+    }
+    open_files_.erase(it);
+  }
+
+  TRY_RESULT(fd, FileFd::open(file_path, FileFd::Read));
+  TRY_RESULT(fd_stat, fd.stat());
+  if (open_files_.size() >= MAX_OPEN_FILE_COUNT) {
+    close_least_recently_used_file();
+  }
+  if (open_files_.empty()) {
+    set_timeout_in(OPEN_FILE_TTL);
+  }
+  auto open_file = make_unique<OpenFile>();
+  open_file->fd_ = std::move(fd);
+  open_file->size_ = fd_stat.size_;
+  open_file->last_access_time_ = now;
+  auto *result = open_file.get();
+  open_files_[file_path] = std::move(open_file);
+  return result;
+}
+
+void FileLoadManager::close_least_recently_used_file() {
+  auto lru_it = open_files_.end();
+  for (auto it = open_files_.begin(); it != open_files_.end(); ++it) {
+    if (lru_it == open_files_.end() || it->second->last_access_time_ < lru_it->second->last_access_time_) {
+      lru_it = it;
+    }
+  }
+  CHECK(lru_it != open_files_.end());
+  open_files_.erase(lru_it);
+}
+
+void FileLoadManager::close_open_files(double max_last_access_time) {
+  table_remove_if(open_files_, [max_last_access_time](const auto &it) {
+    return it.second->last_access_time_ <= max_last_access_time;
+  });
+}
+
+void FileLoadManager::timeout_expired() {
+  close_open_files(Time::now() - OPEN_FILE_TTL);
+  if (!open_files_.empty()) {
+    set_timeout_in(OPEN_FILE_TTL);
+  }
+}
+
+void FileLoadManager::tear_down() {
+  open_files_.clear();
+}
+
+void FileLoadManager::close_file(string file_path) {
+  open_files_.erase(file_path);
 }
 
 void FileLoadManager::unlink_file(string file_path, Promise<Unit> promise) {
+  open_files_.erase(file_path);
   unlink(file_path).ignore();
+  auto file_db = G()->td_db()->get_file_db_shared();
+  if (file_db != nullptr) {
+    file_db->remove_file_content_ref(std::move(file_path));
+  }
   promise.set_value(Unit());
 }
 
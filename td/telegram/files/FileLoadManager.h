@@ -13,7 +13,10 @@
 
 #include "td/utils/buffer.h"
 #include "td/utils/common.h"
+#include "td/utils/FlatHashMap.h"
+#include "td/utils/port/FileFd.h"
 #include "td/utils/Promise.h"
+#include "td/utils/Status.h"
 
 namespace td {
 
@@ -25,10 +28,38 @@ class FileLoadManager final : public Actor {
 
   void unlink_file(string file_path, Promise<Unit> promise);
 
+  // must be called after the file was deleted or replaced not through FileLoadManager
+  void close_file(string file_path);
+
   void check_full_local_location(FullLocalLocationInfo local_info, bool skip_file_size_checks,
                                  Promise<FullLocalLocationInfo> promise);
 
   void check_partial_local_location(PartialLocalFileLocation partial, Promise<Unit> promise);
+
+ private:
+  static constexpr size_t MAX_OPEN_FILE_COUNT = 16;
+  static constexpr double OPEN_FILE_TTL = 60.0;
+
+  // recently read file, which is kept open to avoid opening it again for the next part;
+  // files aren't memory-mapped, because access to a mapping of a file truncated by another process causes SIGBUS
+  struct OpenFile {
+    FileFd fd_;
+    int64 size_ = 0;
+    double last_access_time_ = 0.0;
+  };
+  FlatHashMap<string, unique_ptr<OpenFile>> open_files_;
+
+  Result<string> do_read_file_part(const string &file_path, int64 offset, int64 count);
+
+  Result<OpenFile *> get_open_file(const string &file_path);
+
+  void close_least_recently_used_file();
+
+  void close_open_files(double max_last_access_time);
+
+  void timeout_expired() final;
+
+  void tear_down() final;
 };
 
 }  // namespace td
@@ -10,6 +10,7 @@
 #include "td/telegram/TdDb.h"
 
 #include "td/utils/common.h"
+#include "td/utils/crypto.h"
 #include "td/utils/filesystem.h"
 #include "td/utils/format.h"
 #include "td/utils/misc.h"
@@ -257,6 +258,57 @@ string get_files_dir(FileType file_type) {
   return PSTRING() << get_files_base_dir(file_type) << get_file_type_name(file_type) << TD_DIR_SLASH;
 }
 
+string get_files_content_dir(FileType file_type) {
+  return PSTRING() << get_files_base_dir(file_type) << "content" << TD_DIR_SLASH;
+}
+
+Result<string> add_file_to_content_store(CSlice content_dir, CSlice path) {
+  TRY_RESULT(fd, FileFd::open(path, FileFd::Read));
+  TRY_RESULT(size, fd.get_size());
+
+  Sha256State sha256_state;
+  sha256_state.init();
+  BufferSlice buffer(1 << 17);
+  int64 offset = 0;
+  while (offset < size) {
+    auto to_read = static_cast<size_t>(min(size - offset, static_cast<int64>(buffer.size())));
+    TRY_RESULT(read_size, fd.pread(buffer.as_mutable_slice().substr(0, to_read), offset));
+    if (read_size == 0) {
+      return Status::Error("File was truncated");
+    }
+    sha256_state.feed(buffer.as_slice().substr(0, read_size));
+    offset += static_cast<int64>(read_size);
+  }
+  fd.close();
+  string hash(32, '\0');
+  sha256_state.extract(hash, true);
+  auto content_hash = hex_encode(hash);
+
+  string content_path = PSTRING() << content_dir << content_hash;
+  auto r_stat = stat(content_path);
+  if (r_stat.is_error()) {
+    mkdir(content_dir, 0750).ignore();
+    TRY_STATUS(link(path, content_path));
+    LOG(INFO) << "Add file " << path << " to the content store as " << content_hash;
+    return std::move(content_path);
+  }
+  if (!r_stat.ok().is_reg_ || r_stat.ok().size_ != size) {
+    return Status::Error(PSLICE() << "Stored file " << content_path << " has a different size");
+  }
+
+  // atomically replace the file with a hard link to the stored file
+  string link_path = PSTRING() << content_path << '_' << RandSuff{6};
+  TRY_STATUS(link(content_path, link_path));
+  auto status = rename(link_path, path);
+  if (status.is_error()) {
+    unlink(link_path).ignore();
+    return std::move(status);
+  }
+  update_atime(path).ignore();
+  LOG(INFO) << "Replace file " << path << " with a link to the stored file " << content_hash;
+  return std::move(content_path);
+}
+
 bool are_modification_times_equal(int64 old_mtime, int64 new_mtime) {
   if (old_mtime == new_mtime) {
     return true;
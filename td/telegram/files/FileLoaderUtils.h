@@ -38,6 +38,12 @@ string get_files_temp_dir(FileType file_type);
 
 string get_files_dir(FileType file_type);
 
+string get_files_content_dir(FileType file_type);
+
+// replaces the file with a hard link to a stored file with the same content or adds the file to the content store,
+// which must be on the same file system, returns path to the stored file
+Result<string> add_file_to_content_store(CSlice content_dir, CSlice path) TD_WARN_UNUSED_RESULT;
+
 bool are_modification_times_equal(int64 old_mtime, int64 new_mtime);
 
 struct FullLocalLocationInfo {
@@ -432,6 +432,17 @@ void FileNode::set_download_priority(int8 priority) {
     on_info_changed();
   }
   download_priority_ = priority;
+  if (priority == 0) {
+    set_download_speed(0);
+  }
+}
+
+void FileNode::set_download_speed(int64 download_speed) {
+  if (download_speed_ == download_speed) {
+    return;
+  }
+  download_speed_ = download_speed;
+  on_info_changed();
 }
 
 void FileNode::set_upload_priority(int8 priority) {
@@ -1237,7 +1248,14 @@ FileId FileManager::register_empty(FileType type) {
   return register_local(FullLocalFileLocation(type, "", 0), DialogId(), 0, false, true).ok();
 }
 
+void FileManager::update_use_file_deduplication() {
+  send_closure(file_download_manager_, &FileDownloadManager::update_use_file_deduplication);
+}
+
 void FileManager::on_file_unlink(const FullLocalFileLocation &location) {
+  // the file must not be kept open after it was deleted, because it would keep disk space in use
+  send_closure(file_load_manager_, &FileLoadManager::close_file, location.path_);
+
   auto it = local_location_to_file_id_.find(location);
   if (it == local_location_to_file_id_.end()) {
     return;
@@ -2366,7 +2384,8 @@ void FileManager::delete_file(FileId file_id, Promise<Unit> promise, const char
     if (begins_with(file_view.local_location().path_, get_files_dir(file_view.get_type()))) {
       clear_from_pmc(node);
       if (context_->need_notify_on_new_files()) {
-        context_->on_new_file(-file_view.size(), -file_view.get_allocated_local_size(), -1);
+        context_->on_new_file(file_view.get_type(), file_view.owner_dialog_id(), -file_view.size(),
+                              -file_view.get_allocated_local_size(), -1);
       }
       path = std::move(node->local_.full().path_);
     }
@@ -2493,6 +2512,34 @@ void FileManager::download_impl(FileId file_id, std::shared_ptr<DownloadCallback
   promise.set_value(get_file_object(file_id, false));
 }
 
+void FileManager::set_download_reader_offsets(FileId file_id, vector<int64> reader_offsets, int64 read_ahead_size,
+                                              Promise<Unit> promise) {
+  TRY_STATUS_PROMISE(promise, G()->close_status());
+  if (read_ahead_size < 0) {
+    return promise.set_error(Status::Error(400, "Parameter read_ahead_size must be non-negative"));
+  }
+  for (auto reader_offset : reader_offsets) {
+    if (reader_offset < 0 || reader_offset > MAX_FILE_SIZE) {
+      return promise.set_error(Status::Error(400, "Invalid reader offset specified"));
+    }
+  }
+
+  auto node = get_sync_file_node(file_id);
+  if (!node) {
+    return promise.set_error(Status::Error(400, "File not found"));
+  }
+
+  LOG(INFO) << "Set reader offsets of file " << file_id << " to " << reader_offsets << " with read-ahead size "
+            << read_ahead_size;
+  node->download_reader_offsets_ = std::move(reader_offsets);
+  node->download_read_ahead_size_ = read_ahead_size;
+  if (node->download_id_ != 0 && !FileView(node).is_encrypted_any()) {
+    send_closure(file_download_manager_, &FileDownloadManager::update_reader_offsets, node->download_id_,
+                 node->download_reader_offsets_, read_ahead_size);
+  }
+  promise.set_value(Unit());
+}
+
 void FileManager::run_download(FileNodePtr node, bool force_update_priority) {
   int8 priority = 0;
   bool ignore_download_limit = false;
@@ -2625,6 +2672,10 @@ void FileManager::run_download(FileNodePtr node, bool force_update_priority) {
   send_closure(file_download_manager_, &FileDownloadManager::download, query_id, node->remote_.full.value(),
                node->local_, node->size_, node->suggested_path(), node->encryption_key_, node->can_search_locally_,
                download_offset, download_limit, priority);
+  if (!node->download_reader_offsets_.empty() && !file_view.is_encrypted_any()) {
+    send_closure(file_download_manager_, &FileDownloadManager::update_reader_offsets, query_id,
+                 node->download_reader_offsets_, node->download_read_ahead_size_);
+  }
 }
 
 class FileManager::ForceUploadActor final : public Actor {
@@ -3319,7 +3370,7 @@ td_api::object_ptr<td_api::file> FileManager::get_file_object(FileId file_id, bo
       result_file_id.get(), size, expected_size,
       td_api::make_object<td_api::localFile>(std::move(path), can_be_downloaded, can_be_deleted,
                                              file_node->is_downloading(), is_downloading_completed, download_offset,
-                                             local_prefix_size, local_total_size),
+                                             local_prefix_size, local_total_size, file_node->download_speed_),
       td_api::make_object<td_api::remoteFile>(std::move(persistent_file_id), std::move(unique_file_id),
                                               file_node->is_uploading(), is_uploading_completed, remote_size));
 }
@@ -3786,7 +3837,7 @@ void FileManager::on_start_download(FileDownloadManager::QueryId query_id) {
 }
 
 void FileManager::on_partial_download(FileDownloadManager::QueryId query_id, PartialLocalFileLocation partial_local,
-                                      int64 ready_size, int64 size) {
+                                      int64 ready_size, int64 size, int64 download_speed) {
   if (is_closed_) {
     return;
   }
@@ -3812,6 +3863,7 @@ void FileManager::on_partial_download(FileDownloadManager::QueryId query_id, Par
     }
   }
   file_node->set_local_location(LocalFileLocation(std::move(partial_local)), ready_size, -1, -1 /* TODO */);
+  file_node->set_download_speed(download_speed);
   try_flush_node(file_node, "on_partial_download");
 }
 
@@ -3881,7 +3933,9 @@ void FileManager::on_download_ok(FileDownloadManager::QueryId query_id, FullLoca
     status = Status::Error(PSLICE() << "Can't register local file after download: " << r_new_file_id.error().message());
   } else {
     if (is_new && context_->need_notify_on_new_files()) {
-      context_->on_new_file(size, get_file_view(r_new_file_id.ok()).get_allocated_local_size(), 1);
+      auto file_view = get_file_view(r_new_file_id.ok());
+      context_->on_new_file(file_view.get_type(), file_view.owner_dialog_id(), size,
+                            file_view.get_allocated_local_size(), 1);
     }
   }
   if (status.is_error()) {
@@ -4047,7 +4101,8 @@ void FileManager::on_generate_ok(FileGenerateManager::QueryId query_id, FullLoca
   FileView file_view(file_node);
   if (context_->need_notify_on_new_files()) {
     if (!file_view.has_generate_location() || !begins_with(file_view.generate_location().conversion_, "#file_id#")) {
-      context_->on_new_file(file_view.size(), file_view.get_allocated_local_size(), 1);
+      context_->on_new_file(file_view.get_type(), file_view.owner_dialog_id(), file_view.size(),
+                            file_view.get_allocated_local_size(), 1);
     }
   }
 
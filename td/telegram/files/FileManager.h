@@ -111,6 +111,7 @@ class FileNode {
 
   void set_download_offset(int64 download_offset);
   void set_download_limit(int64 download_limit);
+  void set_download_speed(int64 download_speed);
   void set_ignore_download_limit(bool ignore_download_limit);
 
   void on_changed();
@@ -141,6 +142,9 @@ class FileNode {
   int64 private_download_limit_ = 0;
   int64 local_ready_size_ = 0;         // PartialLocal only
   int64 local_ready_prefix_size_ = 0;  // PartialLocal only
+  int64 download_speed_ = 0;           // bytes per second, while downloading only
+  vector<int64> download_reader_offsets_;
+  int64 download_read_ahead_size_ = 0;
 
   NewRemoteFileLocation remote_;
 
@@ -416,7 +420,7 @@ class FileManager final : public Actor {
    public:
     virtual bool need_notify_on_new_files() = 0;
 
-    virtual void on_new_file(int64 size, int64 real_size, int32 cnt) = 0;
+    virtual void on_new_file(FileType file_type, DialogId owner_dialog_id, int64 size, int64 real_size, int32 cnt) = 0;
 
     virtual void on_file_updated(FileId size) = 0;
 
@@ -461,6 +465,8 @@ class FileManager final : public Actor {
 
   void on_file_unlink(const FullLocalFileLocation &location);
 
+  void update_use_file_deduplication();
+
   FileId register_empty(FileType type);
   Result<FileId> register_local(FullLocalFileLocation location, DialogId owner_dialog_id, int64 size,
                                 bool get_by_hash = false, bool force = false, bool skip_file_size_checks = false,
@@ -494,6 +500,8 @@ class FileManager final : public Actor {
 
   void download(FileId file_id, std::shared_ptr<DownloadCallback> callback, int32 new_priority, int64 offset,
                 int64 limit, Promise<td_api::object_ptr<td_api::file>> promise);
+  void set_download_reader_offsets(FileId file_id, vector<int64> reader_offsets, int64 read_ahead_size,
+                                   Promise<Unit> promise);
   void upload(FileId file_id, std::shared_ptr<UploadCallback> callback, int32 new_priority, uint64 upload_order);
   void resume_upload(FileId file_id, vector<int> bad_parts, std::shared_ptr<UploadCallback> callback,
                      int32 new_priority, uint64 upload_order, bool force = false, bool prefer_small = false);
@@ -574,8 +582,9 @@ class FileManager final : public Actor {
     }
 
     void on_partial_download(FileDownloadManager::QueryId query_id, PartialLocalFileLocation partial_local,
-                             int64 ready_size, int64 size) final {
-      send_closure(actor_id_, &FileManager::on_partial_download, query_id, std::move(partial_local), ready_size, size);
+                             int64 ready_size, int64 size, int64 download_speed) final {
+      send_closure(actor_id_, &FileManager::on_partial_download, query_id, std::move(partial_local), ready_size, size,
+                   download_speed);
     }
 
     void on_download_ok(FileDownloadManager::QueryId query_id, FullLocalFileLocation local, int64 size,
@@ -782,7 +791,7 @@ class FileManager final : public Actor {
 
   void on_start_download(FileDownloadManager::QueryId query_id);
   void on_partial_download(FileDownloadManager::QueryId query_id, PartialLocalFileLocation partial_local,
-                           int64 ready_size, int64 size);
+                           int64 ready_size, int64 size, int64 download_speed);
   void on_download_ok(FileDownloadManager::QueryId query_id, FullLocalFileLocation local, int64 size, bool is_new);
   void on_download_error(FileDownloadManager::QueryId query_id, Status status);
   void on_download_error_impl(FileNodePtr node, DownloadQuery::Type type, bool was_active, Status status);
@@ -0,0 +1,138 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/files/FilePartWorker.h"
+
+#include "td/telegram/files/FileLoaderUtils.h"
+
+#include "td/utils/algorithm.h"
+#include "td/utils/as.h"
+#include "td/utils/crypto.h"
+#include "td/utils/logging.h"
+#include "td/utils/misc.h"
+#include "td/utils/port/Stat.h"
+#include "td/utils/Time.h"
+
+namespace td {
+
+void FilePartWorker::save_part(string path, int64 offset, BufferSlice bytes, size_t size, string cdn_encryption_key,
+                               string cdn_encryption_iv, Promise<size_t> promise) {
+  if (!cdn_encryption_key.empty()) {
+    decrypt_cdn_part(cdn_encryption_key, cdn_encryption_iv, offset, bytes.as_mutable_slice());
+  }
+
+  // may write less than part.size, when size of downloadable file is unknown
+  auto slice = bytes.as_slice().substr(0, size);
+  LOG(INFO) << "Receive " << slice.size() << " bytes at offset " << offset << " for \"" << path << '"';
+  TRY_RESULT_PROMISE(promise, fd, get_file_fd(path));
+  auto r_written = write_file_part(*fd, offset, slice);
+  if (r_written.is_error()) {
+    close_file(std::move(path));
+  }
+  promise.set_result(std::move(r_written));
+}
+
+void FilePartWorker::check_part_hash(string path, int64 offset, size_t size, string hash, Promise<bool> promise) {
+  TRY_RESULT_PROMISE(promise, fd, get_file_fd(path));
+  promise.set_result(check_file_part_hash(*fd, offset, size, hash));
+}
+
+void FilePartWorker::close_file(string path) {
+  open_files_.erase(path);
+}
+
+Result<FileFd *> FilePartWorker::get_file_fd(const string &path) {
+  auto now = Time::now();
+  auto it = open_files_.find(path);
+  if (it != open_files_.end()) {
+    // the file must be reopened if it was deleted or replaced
+    auto r_stat = it->second->fd_.stat();
+    if (r_stat.is_ok() && r_stat.ok().link_count_ > 0) {
+      it->second->last_access_time_ = now;
+      return &it->second->fd_;
+    }
+    open_files_.erase(it);
+  }
+
+  TRY_RESULT(fd, FileFd::open(path, FileFd::Read | FileFd::Write));
+  if (open_files_.size() >= MAX_OPEN_FILE_COUNT) {
+    close_least_recently_used_file();
+  }
+  if (open_files_.empty()) {
+    set_timeout_in(OPEN_FILE_TTL);
+  }
+  auto open_file = make_unique<OpenFile>();
+  open_file->fd_ = std::move(fd);
+  open_file->last_access_time_ = now;
+  auto *result = &open_file->fd_;
+  open_files_[path] = std::move(open_file);
+  return result;
+}
+
+void FilePartWorker::close_least_recently_used_file() {
+  auto lru_it = open_files_.end();
+  for (auto it = open_files_.begin(); it != open_files_.end(); ++it) {
+    if (lru_it == open_files_.end() || it->second->last_access_time_ < lru_it->second->last_access_time_) {
+      lru_it = it;
+    }
+  }
+  CHECK(lru_it != open_files_.end());
+  open_files_.erase(lru_it);
+}
+
+void FilePartWorker::timeout_expired() {
+  auto max_last_access_time = Time::now() - OPEN_FILE_TTL;
+  table_remove_if(open_files_, [max_last_access_time](const auto &it) {
+    return it.second->last_access_time_ <= max_last_access_time;
+  });
+  if (!open_files_.empty()) {
+    set_timeout_in(OPEN_FILE_TTL);
+  }
+}
+
+void FilePartWorker::tear_down() {
+  open_files_.clear();
+}
+
+void FilePartWorker::add_file_to_content_store(FileType file_type, string path, Promise<string> promise) {
+  promise.set_result(td::add_file_to_content_store(get_files_content_dir(file_type), path));
+}
+
+void FilePartWorker::decrypt_cdn_part(Slice cdn_encryption_key, Slice cdn_encryption_iv, int64 offset,
+                                      MutableSlice bytes) {
+  CHECK(offset % 16 == 0);
+  auto block_offset = narrow_cast<uint32>(offset / 16);
+  block_offset = ((block_offset & 0xff) << 24) | ((block_offset & 0xff00) << 8) | ((block_offset & 0xff0000) >> 8) |
+                 ((block_offset & 0xff000000) >> 24);
+
+  AesCtrState ctr_state;
+  string iv = cdn_encryption_iv.str();
+  as<uint32>(&iv[12]) = block_offset;
+  ctr_state.init(cdn_encryption_key, iv);
+  ctr_state.decrypt(bytes, bytes);
+}
+
+Result<size_t> FilePartWorker::write_file_part(FileFd &fd, int64 offset, Slice bytes) {
+  TRY_RESULT(written, fd.pwrite(bytes, offset));
+  LOG(INFO) << "Written " << written << " bytes";
+  if (written != bytes.size()) {
+    return Status::Error("Failed to save file part to the file");
+  }
+  return written;
+}
+
+Result<bool> FilePartWorker::check_file_part_hash(FileFd &fd, int64 offset, size_t size, Slice hash) {
+  BufferSlice bytes(size);
+  TRY_RESULT(read_size, fd.pread(bytes.as_mutable_slice(), offset));
+  if (size != read_size) {
+    return Status::Error("Failed to read file to check hash");
+  }
+  string part_hash(32, ' ');
+  sha256(bytes.as_slice(), part_hash);
+  return part_hash == hash;
+}
+
+}  // namespace td
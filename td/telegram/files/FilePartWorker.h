@@ -0,0 +1,65 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include "td/telegram/files/FileType.h"
+
+#include "td/actor/actor.h"
+
+#include "td/utils/buffer.h"
+#include "td/utils/common.h"
+#include "td/utils/FlatHashMap.h"
+#include "td/utils/port/FileFd.h"
+#include "td/utils/Promise.h"
+#include "td/utils/Slice.h"
+#include "td/utils/Status.h"
+
+namespace td {
+
+// decrypts, checks and saves downloaded file parts on a separate scheduler
+class FilePartWorker final : public Actor {
+ public:
+  // decrypts the part if cdn_encryption_key isn't empty and writes its first size bytes to the file at the offset
+  void save_part(string path, int64 offset, BufferSlice bytes, size_t size, string cdn_encryption_key,
+                 string cdn_encryption_iv, Promise<size_t> promise);
+
+  // checks whether SHA-256 hash of the file part is equal to the given hash
+  void check_part_hash(string path, int64 offset, size_t size, string hash, Promise<bool> promise);
+
+  // deduplicates the downloaded file using the content store and returns path to the stored file
+  void add_file_to_content_store(FileType file_type, string path, Promise<string> promise);
+
+  // must be called before the file is renamed or deleted
+  void close_file(string path);
+
+  static void decrypt_cdn_part(Slice cdn_encryption_key, Slice cdn_encryption_iv, int64 offset, MutableSlice bytes);
+
+  static Result<size_t> write_file_part(FileFd &fd, int64 offset, Slice bytes);
+
+  static Result<bool> check_file_part_hash(FileFd &fd, int64 offset, size_t size, Slice hash);
+
+ private:
+  static constexpr size_t MAX_OPEN_FILE_COUNT = 16;
+  static constexpr double OPEN_FILE_TTL = 60.0;
+
+  // file being downloaded, which is kept open to avoid opening it again for each part
+  struct OpenFile {
+    FileFd fd_;
+    double last_access_time_ = 0.0;
+  };
+  FlatHashMap<string, unique_ptr<OpenFile>> open_files_;
+
+  Result<FileFd *> get_file_fd(const string &path);
+
+  void close_least_recently_used_file();
+
+  void timeout_expired() final;
+
+  void tear_down() final;
+};
+
+}  // namespace td
@@ -53,6 +53,21 @@ void FileStats::add(FullFileInfo &&info) {
   }
 }
 
+void FileStats::add_files(FileType file_type, DialogId owner_dialog_id, int64 size, int32 cnt) {
+  auto pos = static_cast<size_t>(file_type);
+  CHECK(pos < stat_by_type_.size());
+  auto &stat = split_by_owner_dialog_id_ ? stat_by_owner_dialog_id_[owner_dialog_id][pos] : stat_by_type_[pos];
+  stat.size += size;
+  stat.cnt += cnt;
+}
+
+FileStats FileStats::get_copy_without_files() const {
+  FileStats result(false, split_by_owner_dialog_id_);
+  result.stat_by_type_ = stat_by_type_;
+  result.stat_by_owner_dialog_id_ = stat_by_owner_dialog_id_;
+  return result;
+}
+
 FileTypeStat FileStats::get_nontemp_stat(const FileStats::StatByType &by_type) {
   FileTypeStat stat;
   for (int32 i = 0; i < MAX_FILE_TYPE; i++) {
@@ -48,6 +48,8 @@ struct FullFileInfo {
   int64 size;
   uint64 atime_nsec;
   uint64 mtime_nsec;
+  int64 link_count = 1;
+  bool is_stored = false;  // the file is in the content store
 };
 
 struct FileStatsFast {
@@ -96,6 +98,12 @@ class FileStats {
 
   void add(FullFileInfo &&info);
 
+  // adds cnt files with total size size; both values can be negative
+  void add_files(FileType file_type, DialogId owner_dialog_id, int64 size, int32 cnt);
+
+  // returns a copy of the statistics without the list of files
+  FileStats get_copy_without_files() const;
+
   void apply_dialog_limit(int32 limit);
 
   void apply_dialog_ids(const vector<DialogId> &dialog_ids);
@@ -18,21 +18,26 @@
 
 #include "td/db/SqliteKeyValue.h"
 
+#include "td/utils/algorithm.h"
 #include "td/utils/common.h"
 #include "td/utils/format.h"
 #include "td/utils/HashTableUtils.h"
 #include "td/utils/logging.h"
 #include "td/utils/misc.h"
 #include "td/utils/PathView.h"
+#include "td/utils/port/config.h"
 #include "td/utils/port/path.h"
 #include "td/utils/port/Stat.h"
+#include "td/utils/port/thread.h"
 #include "td/utils/Slice.h"
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/Time.h"
 #include "td/utils/tl_parsers.h"
 
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
 namespace td {
 namespace {
@@ -98,15 +103,64 @@ struct FsFileInfo {
   int64 size;
   uint64 atime_nsec;
   uint64 mtime_nsec;
+  int64 link_count;
+  bool is_stored;
 };
 
+// calls f(i) for every i in [0, task_count), using several threads if possible
+template <class F>
+void run_parallel(size_t task_count, const F &f) {
+  std::atomic<size_t> next_task{0};
+  auto run_tasks = [&] {
+    for (auto i = next_task.fetch_add(1); i < task_count; i = next_task.fetch_add(1)) {
+      f(i);
+    }
+  };
+#if !TD_THREAD_UNSUPPORTED
+  static constexpr size_t MAX_THREAD_COUNT = 8;
+  auto thread_count = min(min(task_count, MAX_THREAD_COUNT), static_cast<size_t>(thread::hardware_concurrency()));
+  vector<thread> threads;
+  for (size_t i = 1; i < thread_count; i++) {
+    threads.emplace_back(run_tasks);
+  }
+  run_tasks();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+#else
+  run_tasks();
+#endif
+}
+
 template <class CallbackT>
 void scan_fs(CancellationToken &token, CallbackT &&callback) {
+  struct FileDir {
+    FileType file_type;
+    string dir;
+    bool is_stored;
+  };
+  vector<FileDir> file_dirs;
   std::unordered_set<string, Hash<string>> scanned_file_dirs;
-  auto scan_dir = [&](FileType file_type, const string &file_dir) {
-    if (!scanned_file_dirs.insert(file_dir).second) {
-      return;
+  auto add_dir = [&](FileType file_type, string file_dir, bool is_stored = false) {
+    if (scanned_file_dirs.insert(file_dir).second) {
+      file_dirs.push_back({file_type, std::move(file_dir), is_stored});
     }
+  };
+  for (int32 i = 0; i < MAX_FILE_TYPE; i++) {
+    auto file_type = static_cast<FileType>(i);
+    add_dir(get_main_file_type(file_type), get_files_dir(file_type));
+  }
+  add_dir(get_main_file_type(FileType::Temp), get_files_temp_dir(FileType::SecureDecrypted));
+  add_dir(get_main_file_type(FileType::Temp), get_files_temp_dir(FileType::Video));
+  add_dir(get_main_file_type(FileType::Temp), get_files_content_dir(FileType::SecureDecrypted), true);
+  add_dir(get_main_file_type(FileType::Temp), get_files_content_dir(FileType::Video), true);
+
+  // the directories are listed in parallel
+  vector<vector<FsFileInfo>> dir_files(file_dirs.size());
+  run_parallel(file_dirs.size(), [&](size_t dir_pos) {
+    auto file_type = file_dirs[dir_pos].file_type;
+    const auto &file_dir = file_dirs[dir_pos].dir;
+    auto is_stored = file_dirs[dir_pos].is_stored;
     LOG(INFO) << "Scanning directory " << file_dir;
     walk_path(file_dir, [&](CSlice path, WalkPath::Type type) {
       if (token) {
@@ -115,39 +169,65 @@ void scan_fs(CancellationToken &token, CallbackT &&callback) {
       if (type != WalkPath::Type::RegularFile) {
         return WalkPath::Action::Continue;
       }
-      auto r_stat = stat(path);
+      FsFileInfo info;
+      info.path = path.str();
+      info.file_type = guess_file_type_by_path(path, file_type);
+      info.is_stored = is_stored;
+      dir_files[dir_pos].push_back(std::move(info));
+      return WalkPath::Action::Continue;
+    }).ignore();
+  });
+
+  vector<FsFileInfo> files;
+  for (auto &infos : dir_files) {
+    append(files, std::move(infos));
+  }
+  dir_files.clear();
+
+  // stat is the slowest part of the scan, so files are checked in parallel too
+  static constexpr size_t STAT_CHUNK_SIZE = 1024;
+  vector<uint8> is_found(files.size());
+  run_parallel((files.size() + STAT_CHUNK_SIZE - 1) / STAT_CHUNK_SIZE, [&](size_t chunk_pos) {
+    auto end = min(files.size(), (chunk_pos + 1) * STAT_CHUNK_SIZE);
+    for (auto i = chunk_pos * STAT_CHUNK_SIZE; i < end; i++) {
+      if (token) {
+        return;
+      }
+      auto &info = files[i];
+      auto r_stat = stat(info.path);
       if (r_stat.is_error()) {
         LOG(WARNING) << "Stat in files gc failed: " << r_stat.error();
-        return WalkPath::Action::Continue;
+        continue;
       }
       auto stat = r_stat.move_as_ok();
-      if (stat.size_ == 0 && ends_with(path, "/.nomedia")) {
+      if (stat.size_ == 0 && ends_with(info.path, "/.nomedia")) {
         // skip .nomedia file
-        return WalkPath::Action::Continue;
+        continue;
       }
-
-      FsFileInfo info;
-      info.path = path.str();
-      info.size = stat.real_size_;
-      info.file_type = guess_file_type_by_path(path, file_type);
+      // disk space of a hard-linked file is freed only after all links to it are removed,
+      // so the size is split between the links
+      info.link_count = max(stat.link_count_, static_cast<int64>(1));
+      info.size = stat.real_size_ / info.link_count;
       info.atime_nsec = stat.atime_nsec_;
       info.mtime_nsec = stat.mtime_nsec_;
-      callback(info);
-      return WalkPath::Action::Continue;
-    }).ignore();
-  };
-  for (int32 i = 0; i < MAX_FILE_TYPE; i++) {
-    auto file_type = static_cast<FileType>(i);
-    scan_dir(get_main_file_type(file_type), get_files_dir(file_type));
+      is_found[i] = 1;
+    }
+  });
+
+  for (size_t i = 0; i < files.size(); i++) {
+    if (token) {
+      return;
+    }
+    if (is_found[i] != 0) {
+      callback(files[i]);
+    }
   }
-  scan_dir(get_main_file_type(FileType::Temp), get_files_temp_dir(FileType::SecureDecrypted));
-  scan_dir(get_main_file_type(FileType::Temp), get_files_temp_dir(FileType::Video));
 }
 }  // namespace
 
 void FileStatsWorker::get_stats(bool need_all_files, bool split_by_owner_dialog_id, Promise<FileStats> promise) {
   if (!G()->use_file_database()) {
-    FileStats file_stats(need_all_files, false);
+    FileStats file_stats(need_all_files, split_by_owner_dialog_id);
     auto start = Time::now();
     scan_fs(token_, [&](FsFileInfo &fs_info) {
       FullFileInfo info;
@@ -156,6 +236,8 @@ void FileStatsWorker::get_stats(bool need_all_files, bool split_by_owner_dialog_
       info.size = fs_info.size;
       info.atime_nsec = fs_info.atime_nsec;
       info.mtime_nsec = fs_info.mtime_nsec;
+      info.link_count = fs_info.link_count;
+      info.is_stored = fs_info.is_stored;
       file_stats.add(std::move(info));
     });
     auto passed = Time::now() - start;
@@ -175,6 +257,8 @@ void FileStatsWorker::get_stats(bool need_all_files, bool split_by_owner_dialog_
       info.size = fs_info.size;
       info.atime_nsec = fs_info.atime_nsec;
       info.mtime_nsec = fs_info.mtime_nsec;
+      info.link_count = fs_info.link_count;
+      info.is_stored = fs_info.is_stored;
 
       // LOG(INFO) << "Found file of size " << info.size << " at " << info.path;
 
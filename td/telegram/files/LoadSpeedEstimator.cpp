@@ -0,0 +1,65 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/files/LoadSpeedEstimator.h"
+
+#include "td/utils/format.h"
+
+namespace td {
+
+void LoadSpeedEstimator::on_part_loaded(int64 size, double rtt, double now) {
+  if (rtt < 0) {
+    rtt = 0;
+  }
+  if (last_event_time_ == 0 || last_event_time_ + IDLE_PERIOD < now) {
+    // the part was requested after a pause, so the speed is measured from scratch
+    period_start_time_ = now - rtt;
+    period_size_ = 0;
+    speed_ = 0.0;
+  }
+  last_event_time_ = now;
+
+  smoothed_rtt_ = smoothed_rtt_ == 0 ? rtt : smoothed_rtt_ * 0.875 + rtt * 0.125;
+  min_rtt_.add_event(rtt, now);
+
+  period_size_ += size;
+  auto elapsed = now - period_start_time_;
+  if (elapsed >= SPEED_PERIOD) {
+    auto speed = static_cast<double>(period_size_) / elapsed;
+    speed_ = speed_ == 0 ? speed : speed_ * 0.7 + speed * 0.3;
+    period_start_time_ = now;
+    period_size_ = 0;
+  }
+}
+
+int64 LoadSpeedEstimator::get_speed(double now) const {
+  if (last_event_time_ == 0 || last_event_time_ + IDLE_PERIOD < now) {
+    return 0;
+  }
+  if (speed_ == 0) {
+    auto elapsed = last_event_time_ - period_start_time_;
+    if (elapsed <= 0) {
+      return 0;
+    }
+    return static_cast<int64>(static_cast<double>(period_size_) / elapsed);
+  }
+  return static_cast<int64>(speed_);
+}
+
+double LoadSpeedEstimator::get_min_rtt(double now) {
+  auto min_rtt = min_rtt_.get_stat(now).get_stat();
+  if (!min_rtt) {
+    return smoothed_rtt_;
+  }
+  return min_rtt.value();
+}
+
+StringBuilder &operator<<(StringBuilder &string_builder, const LoadSpeedEstimator &estimator) {
+  return string_builder << tag("speed", estimator.get_speed(estimator.last_event_time_))
+                        << tag("smoothed_rtt", estimator.smoothed_rtt_);
+}
+
+}  // namespace td
@@ -0,0 +1,47 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include "td/utils/common.h"
+#include "td/utils/StringBuilder.h"
+#include "td/utils/TimedStat.h"
+
+namespace td {
+
+// estimates throughput and round-trip time of file part queries
+class LoadSpeedEstimator {
+ public:
+  void on_part_loaded(int64 size, double rtt, double now);
+
+  // returns bytes per second, or 0 if nothing was loaded recently
+  int64 get_speed(double now) const;
+
+  // returns minimum round-trip time seen during the last 1-2 minutes, or 0 if unknown
+  double get_min_rtt(double now);
+
+  double get_smoothed_rtt() const {
+    return smoothed_rtt_;
+  }
+
+ private:
+  static constexpr double SPEED_PERIOD = 1.0;
+  static constexpr double IDLE_PERIOD = 5.0;
+  static constexpr double MIN_RTT_PERIOD = 60.0;
+
+  double period_start_time_ = 0.0;
+  int64 period_size_ = 0;
+  double speed_ = 0.0;
+  double last_event_time_ = 0.0;
+  double smoothed_rtt_ = 0.0;
+  TimedStat<MinStat<double>> min_rtt_{MIN_RTT_PERIOD, 0};
+
+  friend StringBuilder &operator<<(StringBuilder &string_builder, const LoadSpeedEstimator &estimator);
+};
+
+StringBuilder &operator<<(StringBuilder &string_builder, const LoadSpeedEstimator &estimator);
+
+}  // namespace td
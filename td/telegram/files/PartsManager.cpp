@@ -8,11 +8,13 @@
 
 #include "td/telegram/files/FileLoaderUtils.h"
 
+#include "td/utils/algorithm.h"
 #include "td/utils/format.h"
 #include "td/utils/logging.h"
 #include "td/utils/misc.h"
 #include "td/utils/SliceBuilder.h"
 
+#include <algorithm>
 #include <limits>
 #include <numeric>
 
@@ -82,6 +84,50 @@ void PartsManager::set_streaming_limit(int64 limit) {
   }
 }
 
+void PartsManager::set_reader_offsets(vector<int64> reader_offsets, int64 read_ahead_size) {
+  if (read_ahead_size <= 0) {
+    read_ahead_size = DEFAULT_READ_AHEAD_SIZE;
+  }
+  td::remove_if(reader_offsets, [](int64 offset) { return offset < 0; });
+  td::unique(reader_offsets);
+  if (reader_offsets.size() > MAX_READER_COUNT) {
+    reader_offsets.resize(MAX_READER_COUNT);
+  }
+  reader_offsets_ = std::move(reader_offsets);
+  read_ahead_size_ = read_ahead_size;
+}
+
+int PartsManager::get_reader_part() {
+  if (reader_offsets_.empty() || need_check_ || unknown_size_flag_ || known_prefix_flag_) {
+    return -1;
+  }
+
+  // choose the empty part, which is the nearest to some reader offset
+  int result = -1;
+  int64 result_distance = 0;
+  auto part_size = static_cast<int64>(part_size_);
+  for (auto reader_offset : reader_offsets_) {
+    if (reader_offset >= size_) {
+      continue;
+    }
+    auto begin_part_id = narrow_cast<int>(reader_offset / part_size);
+    auto end_part_id = narrow_cast<int>(min(calc_part_count(min(reader_offset + read_ahead_size_, size_), part_size),
+                                            static_cast<int64>(part_count_)));
+    for (int part_id = begin_part_id; part_id < end_part_id; part_id++) {
+      if (part_status_[part_id] != PartStatus::Empty || !is_part_in_streaming_limit(part_id)) {
+        continue;
+      }
+      auto distance = max(part_id * part_size - reader_offset, static_cast<int64>(0));
+      if (result == -1 || distance < result_distance) {
+        result = part_id;
+        result_distance = distance;
+      }
+      break;
+    }
+  }
+  return result;
+}
+
 Status PartsManager::init_no_size(size_t part_size, const std::vector<int> &ready_parts) {
   unknown_size_flag_ = true;
   size_ = 0;
@@ -278,6 +324,13 @@ bool PartsManager::is_streaming_limit_reached() {
 
 Result<Part> PartsManager::start_part() {
   update_first_empty_part();
+  auto reader_part_id = get_reader_part();
+  if (reader_part_id != -1) {
+    on_part_start(reader_part_id);
+    return get_part(reader_part_id);
+  }
+
+  // the rest of the file is downloaded only after all read-ahead windows are filled
   auto part_id = first_streaming_empty_part_;
   if (known_prefix_flag_ && part_id >= static_cast<int>(known_prefix_size_ / part_size_)) {
     return Status::Error(-1, "Wait for prefix to be known");
@@ -580,6 +633,8 @@ StringBuilder &operator<<(StringBuilder &string_builder, const PartsManager &par
                         << ", streaming_limit = " << parts_manager.streaming_limit_
                         << ", first_streaming_empty_part = " << parts_manager.first_streaming_empty_part_
                         << ", first_streaming_not_ready_part = " << parts_manager.first_streaming_not_ready_part_
+                        << ", reader_count = " << parts_manager.reader_offsets_.size()
+                        << ", read_ahead_size = " << parts_manager.read_ahead_size_
                         << ", use_part_count_limit = " << parts_manager.use_part_count_limit_
                         << ", part_status_count = " << parts_manager.part_status_.size() << ": "
                         << parts_manager.bitmask_ << ']';
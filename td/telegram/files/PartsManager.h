@@ -38,6 +38,7 @@ class PartsManager {
   void set_checked_prefix_size(int64 size);
   int32 set_streaming_offset(int64 offset, int64 limit);
   void set_streaming_limit(int64 limit);
+  void set_reader_offsets(vector<int64> reader_offsets, int64 read_ahead_size);
 
   int64 get_checked_prefix_size() const;
   int64 get_unchecked_ready_prefix_size();
@@ -59,6 +60,8 @@ class PartsManager {
   static constexpr int MAX_PART_COUNT_PREMIUM = 8000;
   static constexpr size_t MAX_PART_SIZE = 512 << 10;
   static constexpr int64 MAX_FILE_SIZE = static_cast<int64>(MAX_PART_SIZE) * MAX_PART_COUNT_PREMIUM;
+  static constexpr int64 DEFAULT_READ_AHEAD_SIZE = 4 << 20;
+  static constexpr size_t MAX_READER_COUNT = 16;
 
   enum class PartStatus : int32 { Empty, Pending, Ready };
 
@@ -86,6 +89,8 @@ class PartsManager {
   int64 streaming_limit_{0};
   int first_streaming_empty_part_{0};
   int first_streaming_not_ready_part_{0};
+  vector<int64> reader_offsets_;
+  int64 read_ahead_size_{0};
   vector<PartStatus> part_status_;
   Bitmask bitmask_;
   bool use_part_count_limit_{false};
@@ -102,6 +107,8 @@ class PartsManager {
   void update_first_empty_part();
   void update_first_not_ready_part();
 
+  int get_reader_part();
+
   bool is_streaming_limit_reached();
   bool is_part_in_streaming_limit(int part_id) const;
 
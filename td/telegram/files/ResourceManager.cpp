@@ -13,6 +13,7 @@
 #include "td/utils/logging.h"
 #include "td/utils/misc.h"
 #include "td/utils/ScopeGuard.h"
+#include "td/utils/Time.h"
 
 #include <algorithm>
 
@@ -65,6 +66,57 @@ void ResourceManager::update_resources(const ResourceState &resource_state) {
   loop();
 }
 
+void ResourceManager::on_part_loaded(int64 size, double rtt) {
+  if (stop_flag_ || mode_ != Mode::Adaptive || size <= 0) {
+    return;
+  }
+  auto now = Time::now();
+  speed_estimator_.on_part_loaded(size, rtt, now);
+
+  // the limit is changed at most once per round-trip time
+  auto smoothed_rtt = speed_estimator_.get_smoothed_rtt();
+  if (now < last_adaptive_update_time_ + smoothed_rtt || smoothed_rtt <= 0) {
+    return;
+  }
+  last_adaptive_update_time_ = now;
+
+  auto min_rtt = speed_estimator_.get_min_rtt(now);
+  auto old_limit = adaptive_resource_limit_;
+  adaptive_resource_limit_ =
+      get_adaptive_resource_limit(adaptive_resource_limit_, max_resource_limit_, resource_state_.unused(), size,
+                                  speed_estimator_.get_speed(now), min_rtt, smoothed_rtt);
+  if (adaptive_resource_limit_ != old_limit) {
+    VLOG(file_loader) << "Change resource limit from " << old_limit << " to " << adaptive_resource_limit_ << ' '
+                      << tag("min_rtt", min_rtt) << ' ' << speed_estimator_;
+    loop();
+  }
+}
+
+int64 ResourceManager::get_adaptive_resource_limit(int64 resource_limit, int64 max_resource_limit,
+                                                   int64 unused_resource, int64 part_size, int64 speed, double min_rtt,
+                                                   double smoothed_rtt) {
+  // as in TCP Vegas, estimate amount of data queued because the limit exceeds bandwidth-delay product
+  auto queued_size = static_cast<int64>(static_cast<double>(resource_limit) * (1.0 - min_rtt / smoothed_rtt));
+  if (queued_size < 2 * part_size) {
+    // increase the limit only if it is fully used
+    if (unused_resource < part_size) {
+      resource_limit += part_size;
+    }
+  } else if (queued_size > 4 * part_size) {
+    auto bandwidth_delay_product = static_cast<int64>(static_cast<double>(speed) * min_rtt);
+    resource_limit = max(resource_limit - part_size, bandwidth_delay_product);
+  }
+  return clamp(resource_limit, max(max_resource_limit / MIN_ADAPTIVE_RESOURCE_LIMIT_DIVISOR, part_size),
+               max_resource_limit * MAX_ADAPTIVE_RESOURCE_LIMIT_MULTIPLIER);
+}
+
+int64 ResourceManager::get_resource_limit() const {
+  if (mode_ == Mode::Adaptive) {
+    return adaptive_resource_limit_;
+  }
+  return max_resource_limit_;
+}
+
 void ResourceManager::hangup_shared() {
   auto node_id = get_link_token();
   auto node_ptr = nodes_container_.get(node_id);
@@ -115,7 +167,7 @@ bool ResourceManager::satisfy_node(NodeId file_node_id) {
   give = min(need, give);
   give -= give % part_size;
   VLOG(file_loader) << tag("give", give);
-  if (give == 0) {
+  if (give <= 0) {
     return false;
   }
   resource_state_.start_use(give);
@@ -132,7 +184,7 @@ void ResourceManager::loop() {
     return;
   }
   auto active_limit = resource_state_.active_limit();
-  resource_state_.update_limit(max_resource_limit_ - active_limit);
+  resource_state_.update_limit(get_resource_limit() - active_limit);
   LOG(INFO) << tag("unused", resource_state_.unused());
 
   if (mode_ == Mode::Greedy) {
@@ -149,7 +201,7 @@ void ResourceManager::loop() {
     for (auto *node : to_add) {
       add_to_heap(node);
     }
-  } else if (mode_ == Mode::Baseline) {
+  } else if (mode_ == Mode::Baseline || mode_ == Mode::Adaptive) {
     // plain
     for (auto &it : to_xload_) {
       auto file_node_id = it.second;
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "td/telegram/files/FileLoaderActor.h"
+#include "td/telegram/files/LoadSpeedEstimator.h"
 #include "td/telegram/files/ResourceState.h"
 
 #include "td/actor/actor.h"
@@ -21,17 +22,31 @@ namespace td {
 
 class ResourceManager final : public Actor {
  public:
-  enum class Mode : int32 { Baseline, Greedy };
-  ResourceManager(int64 max_resource_limit, Mode mode) : max_resource_limit_(max_resource_limit), mode_(mode) {
+  // in Adaptive mode resources are distributed as in Baseline mode,
+  // but the total limit is adjusted to observed throughput and round-trip time
+  enum class Mode : int32 { Baseline, Greedy, Adaptive };
+  ResourceManager(int64 max_resource_limit, Mode mode)
+      : max_resource_limit_(max_resource_limit), adaptive_resource_limit_(max_resource_limit), mode_(mode) {
   }
   // use through ActorShared
   void update_priority(int8 priority);
   void update_resources(const ResourceState &resource_state);
+  void on_part_loaded(int64 size, double rtt);
 
   void register_worker(ActorShared<FileLoaderActor> callback, int8 priority);
 
+  // returns the new total resource limit in Adaptive mode after a part of the given size was loaded
+  static int64 get_adaptive_resource_limit(int64 resource_limit, int64 max_resource_limit, int64 unused_resource,
+                                           int64 part_size, int64 speed, double min_rtt, double smoothed_rtt);
+
  private:
+  static constexpr int64 MIN_ADAPTIVE_RESOURCE_LIMIT_DIVISOR = 8;
+  static constexpr int64 MAX_ADAPTIVE_RESOURCE_LIMIT_MULTIPLIER = 8;
+
   int64 max_resource_limit_ = 0;
+  int64 adaptive_resource_limit_ = 0;
+  double last_adaptive_update_time_ = 0.0;
+  LoadSpeedEstimator speed_estimator_;
   Mode mode_;
 
   using NodeId = uint64;
@@ -61,6 +76,8 @@ class ResourceManager final : public Actor {
 
   void loop() final;
 
+  int64 get_resource_limit() const;
+
   void add_to_heap(Node *node);
   bool satisfy_node(NodeId file_node_id);
   void add_node(NodeId node_id, int8 priority);
@@ -0,0 +1,34 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/net/ConnectTimeStats.h"
+
+namespace td {
+
+double ConnectTimeStats::get_bucket_bound(size_t pos) {
+  static const double bounds[BUCKET_COUNT - 1] = {0.05, 0.1, 0.2, 0.5, 1.0, 2.0, 5.0};
+  CHECK(pos < BUCKET_COUNT - 1);
+  return bounds[pos];
+}
+
+void ConnectTimeStats::on_connected(double connect_time) {
+  size_t pos = 0;
+  while (pos + 1 < BUCKET_COUNT && connect_time >= get_bucket_bound(pos)) {
+    pos++;
+  }
+  counts_[pos]++;
+}
+
+StringBuilder &operator<<(StringBuilder &string_builder, const ConnectTimeStats &stats) {
+  for (size_t i = 0; i + 1 < ConnectTimeStats::BUCKET_COUNT; i++) {
+    string_builder << '<' << ConnectTimeStats::get_bucket_bound(i) << "s:" << stats.get_count(i) << ' ';
+  }
+  return string_builder << ">=" << ConnectTimeStats::get_bucket_bound(ConnectTimeStats::BUCKET_COUNT - 2)
+                        << "s:" << stats.get_count(ConnectTimeStats::BUCKET_COUNT - 1)
+                        << " failed:" << stats.get_failure_count();
+}
+
+}  // namespace td
@@ -0,0 +1,46 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include "td/utils/common.h"
+#include "td/utils/StringBuilder.h"
+
+#include <array>
+
+namespace td {
+
+// histogram of connect times of raced direct connections to a DC
+class ConnectTimeStats {
+ public:
+  static constexpr size_t BUCKET_COUNT = 8;
+
+  // returns the exclusive upper bound of connect time for all buckets except the last one
+  static double get_bucket_bound(size_t pos);
+
+  void on_connected(double connect_time);
+
+  void on_failed() {
+    failure_count_++;
+  }
+
+  int32 get_count(size_t pos) const {
+    CHECK(pos < BUCKET_COUNT);
+    return counts_[pos];
+  }
+
+  int32 get_failure_count() const {
+    return failure_count_;
+  }
+
+ private:
+  std::array<int32, BUCKET_COUNT> counts_{};
+  int32 failure_count_ = 0;
+};
+
+StringBuilder &operator<<(StringBuilder &string_builder, const ConnectTimeStats &stats);
+
+}  // namespace td
@@ -12,7 +12,9 @@
 #include "td/telegram/logevent/LogEvent.h"
 #include "td/telegram/MessagesManager.h"
 #include "td/telegram/net/MtprotoHeader.h"
+#include "td/telegram/net/NetQueryCreator.h"
 #include "td/telegram/net/NetQueryDispatcher.h"
+#include "td/telegram/net/NetQueryStats.h"
 #include "td/telegram/net/NetType.h"
 #include "td/telegram/net/PublicRsaKeySharedMain.h"
 #include "td/telegram/PromoDataManager.h"
@@ -744,6 +746,7 @@ void ConnectionCreator::request_raw_connection(DcId dc_id, bool allow_media_only
   }
   client.auth_data = std::move(auth_data);
   client.auth_data_generation++;
+  client.last_request_time = Time::now();
   VLOG(connections) << "Request connection for " << tag("client", format::as_hex(client.hash)) << " to " << dc_id << " "
                     << tag("allow_media_only", allow_media_only);
   client.queries.push_back(std::move(promise));
@@ -955,9 +958,20 @@ void ConnectionCreator::client_loop(ClientInfo &client) {
 
   VLOG(connections) << "In client_loop: " << tag("client", format::as_hex(client.hash));
 
+  // Connections are pre-warmed only while the client is online and has recently requested a connection,
+  // otherwise unused pre-warmed connections would be recreated forever, wasting the flood control limit
+  size_t prewarmed_connection_count = 0;
+  if (online_flag_ && client.last_request_time + ClientInfo::PREWARM_IDLE_TIMEOUT > Time::now()) {
+    prewarmed_connection_count =
+        static_cast<size_t>(clamp(G()->get_option_integer("prewarmed_connection_count"), static_cast<int64>(0),
+                                  static_cast<int64>(4)));
+  }
+  double ready_connections_timeout = prewarmed_connection_count != 0 ? ClientInfo::PREWARMED_CONNECTIONS_TIMEOUT
+                                                                     : ClientInfo::READY_CONNECTIONS_TIMEOUT;
+
   // Remove expired ready connections
   td::remove_if(client.ready_connections,
-                [&, expires_at = Time::now_cached() - ClientInfo::READY_CONNECTIONS_TIMEOUT](auto &v) {
+                [&, expires_at = Time::now_cached() - ready_connections_timeout](auto &v) {
                   bool drop = v.second < expires_at;
                   VLOG_IF(connections, drop) << "Drop expired " << tag("connection", v.first.get());
                   return drop;
@@ -982,9 +996,14 @@ void ConnectionCreator::client_loop(ClientInfo &client) {
   bool check_mode = client.checking_connections != 0 && !proxy.use_proxy();
   while (true) {
     // Check if we need new connections
-    if (client.queries.empty()) {
+    size_t wanted_connection_count = client.queries.size();
+    if (!check_mode && prewarmed_connection_count > client.ready_connections.size()) {
+      wanted_connection_count =
+          max(wanted_connection_count, prewarmed_connection_count - client.ready_connections.size());
+    }
+    if (wanted_connection_count == 0) {
       if (!client.ready_connections.empty()) {
-        client_set_timeout_at(client, Time::now() + ClientInfo::READY_CONNECTIONS_TIMEOUT);
+        client_set_timeout_at(client, Time::now() + ready_connections_timeout);
       }
       return;
     }
@@ -993,7 +1012,7 @@ void ConnectionCreator::client_loop(ClientInfo &client) {
         return;
       }
     } else {
-      if (client.pending_connections >= client.queries.size()) {
+      if (client.pending_connections >= wanted_connection_count) {
         return;
       }
     }
@@ -1015,6 +1034,21 @@ void ConnectionCreator::client_loop(ClientInfo &client) {
       client.backoff.add_event(static_cast<int32>(Time::now()));
     }
 
+    // Race direct connections to all suitable addresses of the DC
+    if (!proxy.use_proxy()) {
+      auto candidates = find_race_candidates(client.dc_id, client.allow_media_only);
+      if (candidates.size() >= 2) {
+        flood_control.add_event(Time::now());
+        check_mode |= any_of(candidates, [](const auto &candidate) { return candidate.should_check; });
+        client.pending_connections++;
+        if (check_mode) {
+          client.checking_connections++;
+        }
+        start_connect_race(client, check_mode, std::move(candidates));
+        continue;
+      }
+    }
+
     // Create new RawConnection
     // sync part
     FindConnectionExtra extra;
@@ -1124,6 +1158,144 @@ void ConnectionCreator::client_create_raw_connection(Result<ConnectionData> r_co
   }
 }
 
+vector<ConnectionCreator::RaceCandidate> ConnectionCreator::find_race_candidates(DcId dc_id, bool allow_media_only) {
+#if TD_DARWIN_WATCH_OS
+  return {};
+#else
+  auto r_infos =
+      dc_options_set_.find_connections(dc_id, allow_media_only, false, G()->get_option_boolean("prefer_ipv6"), false);
+  if (r_infos.is_error()) {
+    return {};
+  }
+
+  // interleave address families of the candidates as described in RFC 8305, preserving the order of preference
+  vector<RaceCandidate> candidates[2];
+  bool first_is_ipv6 = false;
+  for (auto &info : r_infos.ok()) {
+    auto r_transport_type = get_transport_type(Proxy(), info);
+    if (r_transport_type.is_error()) {
+      continue;
+    }
+
+    const auto &ip_address = info.option->get_ip_address();
+    bool is_ipv6 = ip_address.is_ipv6();
+    if (candidates[0].empty() && candidates[1].empty()) {
+      first_is_ipv6 = is_ipv6;
+    }
+    auto &family_candidates = candidates[is_ipv6 != first_is_ipv6];
+    if (any_of(family_candidates, [&](const auto &candidate) { return candidate.ip_address == ip_address; })) {
+      continue;
+    }
+
+    RaceCandidate candidate;
+    candidate.ip_address = ip_address;
+    candidate.transport_type = r_transport_type.move_as_ok();
+    candidate.stat = info.stat;
+    candidate.debug_str = PSTRING() << ip_address << " to " << (info.option->is_media_only() ? "MEDIA " : "")
+                                    << dc_id << (info.use_http ? " over HTTP" : "");
+    candidate.should_check = info.should_check;
+    family_candidates.push_back(std::move(candidate));
+  }
+
+  vector<RaceCandidate> result;
+  for (size_t i = 0; result.size() < MAX_RACE_CONNECTION_COUNT; i++) {
+    if (i >= candidates[0].size() && i >= candidates[1].size()) {
+      break;
+    }
+    for (auto &family_candidates : candidates) {
+      if (i < family_candidates.size() && result.size() < MAX_RACE_CONNECTION_COUNT) {
+        result.push_back(std::move(family_candidates[i]));
+      }
+    }
+  }
+  return result;
+#endif
+}
+
+void ConnectionCreator::start_connect_race(ClientInfo &client, bool check_mode, vector<RaceCandidate> candidates) {
+  auto ip_addresses = transform(candidates, [](const auto &candidate) { return candidate.ip_address; });
+  VLOG(connections) << "Race connections to " << format::as_array(ip_addresses) << " for "
+                    << tag("client", format::as_hex(client.hash));
+  auto promise = PromiseCreator::lambda(
+      [actor_id = actor_id(this), hash = client.hash, check_mode, candidates = std::move(candidates),
+       network_generation = network_generation_](Result<ConnectRaceActor::ConnectResult> r_connect_result) mutable {
+        send_closure(actor_id, &ConnectionCreator::on_connect_race_finished, hash, check_mode, std::move(candidates),
+                     std::move(r_connect_result), network_generation);
+      });
+  auto token = next_token();
+  children_[token] = {true, create_actor<ConnectRaceActor>("ConnectRaceActor", std::move(ip_addresses),
+                                                           RACE_ATTEMPT_DELAY, RACE_TIMEOUT, std::move(promise),
+                                                           create_reference(token))};
+}
+
+void ConnectionCreator::on_connect_race_finished(uint32 hash, bool check_mode, vector<RaceCandidate> candidates,
+                                                 Result<ConnectRaceActor::ConnectResult> r_connect_result,
+                                                 uint32 network_generation) {
+  CHECK(!candidates.empty());
+  auto it = clients_.find(hash);
+  CHECK(it != clients_.end());
+  auto &client = it->second;
+  auto net_query_stats = G()->net_query_creator().get_net_query_stats();
+
+  if (r_connect_result.is_error()) {
+    for (auto &candidate : candidates) {
+      candidate.stat->on_error();
+    }
+    if (net_query_stats != nullptr) {
+      net_query_stats->on_connect_failed(client.dc_id.get_raw_id());
+    }
+    LOG(WARNING) << "Failed to connect to " << client.dc_id << ": " << r_connect_result.error();
+    return client_create_raw_connection(r_connect_result.move_as_error(), check_mode,
+                                        std::move(candidates[0].transport_type), hash,
+                                        std::move(candidates[0].debug_str), network_generation);
+  }
+
+  auto connect_result = r_connect_result.move_as_ok();
+  for (auto address_index : connect_result.failed_address_indices) {
+    CHECK(address_index < candidates.size());
+    candidates[address_index].stat->on_error();
+  }
+  if (net_query_stats != nullptr) {
+    net_query_stats->on_connected(client.dc_id.get_raw_id(), connect_result.connect_time);
+  }
+
+  CHECK(connect_result.address_index < candidates.size());
+  auto &candidate = candidates[connect_result.address_index];
+  if (check_mode) {
+    candidate.stat->on_check();
+  }
+
+  auto debug_str = std::move(candidate.debug_str);
+#if !TD_DARWIN_WATCH_OS
+  IPAddress debug_ip;
+  auto debug_ip_status = debug_ip.init_socket_address(connect_result.socket_fd);
+  if (debug_ip_status.is_ok()) {
+    debug_str = PSTRING() << debug_str << " from " << debug_ip;
+  } else {
+    LOG(ERROR) << debug_ip_status;
+  }
+#endif
+  VLOG(connections) << "Connected in " << format::as_time(connect_result.connect_time) << ": " << debug_str;
+
+  auto promise = PromiseCreator::lambda(
+      [actor_id = actor_id(this), check_mode, transport_type = candidate.transport_type, hash, debug_str,
+       network_generation](Result<ConnectionData> r_connection_data) mutable {
+        send_closure(actor_id, &ConnectionCreator::client_create_raw_connection, std::move(r_connection_data),
+                     check_mode, std::move(transport_type), hash, std::move(debug_str), network_generation);
+      });
+
+  auto stats_callback =
+      td::make_unique<detail::StatsCallback>(client.is_media ? media_net_stats_callback_ : common_net_stats_callback_,
+                                             actor_id(this), hash, candidate.stat);
+  auto token = next_token();
+  auto ref = prepare_connection(candidate.ip_address, std::move(connect_result.socket_fd), Proxy(), IPAddress(),
+                                candidate.transport_type, Slice(), debug_str, std::move(stats_callback),
+                                create_reference(token), true, std::move(promise));
+  if (!ref.empty()) {
+    children_[token] = {true, std::move(ref)};
+  }
+}
+
 void ConnectionCreator::client_set_timeout_at(ClientInfo &client, double wakeup_at) {
   if (!client.slot.has_event()) {
     client.slot.set_event(self_closure(this, &ConnectionCreator::client_wakeup, client.hash));
@@ -19,6 +19,7 @@
 #include "td/mtproto/RawConnection.h"
 #include "td/mtproto/TransportType.h"
 
+#include "td/net/ConnectRaceActor.h"
 #include "td/net/NetStats.h"
 
 #include "td/actor/actor.h"
@@ -143,18 +144,33 @@ class ConnectionCreator final : public NetQueryCallback {
     std::vector<Promise<unique_ptr<mtproto::RawConnection>>> queries;
 
     static constexpr double READY_CONNECTIONS_TIMEOUT = 10;
+    static constexpr double PREWARMED_CONNECTIONS_TIMEOUT = 30;
+    static constexpr double PREWARM_IDLE_TIMEOUT = 60;  // connections aren't pre-warmed for idle clients
 
     bool inited{false};
     uint32 hash{0};
     DcId dc_id;
     bool allow_media_only{false};
     bool is_media{false};
+    double last_request_time{0};
     std::set<uint64> session_ids_;
     unique_ptr<mtproto::AuthData> auth_data;
     uint64 auth_data_generation{0};
   };
   std::map<uint32, ClientInfo> clients_;
 
+  static constexpr size_t MAX_RACE_CONNECTION_COUNT = 3;
+  static constexpr double RACE_ATTEMPT_DELAY = 0.25;
+  static constexpr double RACE_TIMEOUT = 10.0;
+
+  struct RaceCandidate {
+    IPAddress ip_address;
+    mtproto::TransportType transport_type;
+    DcOptionsSet::Stat *stat{nullptr};
+    string debug_str;
+    bool should_check{false};
+  };
+
   std::shared_ptr<NetStatsCallback> media_net_stats_callback_;
   std::shared_ptr<NetStatsCallback> common_net_stats_callback_;
 
@@ -233,6 +249,11 @@ class ConnectionCreator final : public NetQueryCallback {
                              uint64 auth_data_generation, uint64 session_id);
   void client_set_timeout_at(ClientInfo &client, double wakeup_at);
 
+  vector<RaceCandidate> find_race_candidates(DcId dc_id, bool allow_media_only);
+  void start_connect_race(ClientInfo &client, bool check_mode, vector<RaceCandidate> candidates);
+  void on_connect_race_finished(uint32 hash, bool check_mode, vector<RaceCandidate> candidates,
+                                Result<ConnectRaceActor::ConnectResult> r_connect_result, uint32 network_generation);
+
   void on_proxy_resolved(Result<IPAddress> ip_address, bool dummy);
 
   struct FindConnectionExtra {
@@ -136,8 +136,9 @@ vector<DcOptionsSet::ConnectionInfo> DcOptionsSet::find_all_connections(DcId dc_
   return options;
 }
 
-Result<DcOptionsSet::ConnectionInfo> DcOptionsSet::find_connection(DcId dc_id, bool allow_media_only, bool use_static,
-                                                                   bool prefer_ipv6, bool only_http) {
+Result<vector<DcOptionsSet::ConnectionInfo>> DcOptionsSet::find_connections(DcId dc_id, bool allow_media_only,
+                                                                             bool use_static, bool prefer_ipv6,
+                                                                             bool only_http) {
   auto options = find_all_connections(dc_id, allow_media_only, use_static, prefer_ipv6, only_http);
 
   if (options.empty()) {
@@ -151,7 +152,7 @@ Result<DcOptionsSet::ConnectionInfo> DcOptionsSet::find_connection(DcId dc_id, b
                          return a_option.stat->error_at > b_option.stat->error_at;
                        })->stat->error_at;
 
-  auto result = *std::min_element(options.begin(), options.end(), [](const auto &a_option, const auto &b_option) {
+  std::stable_sort(options.begin(), options.end(), [](const auto &a_option, const auto &b_option) {
     auto &a = *a_option.stat;
     auto &b = *b_option.stat;
     auto a_state = a.state();
@@ -169,8 +170,16 @@ Result<DcOptionsSet::ConnectionInfo> DcOptionsSet::find_connection(DcId dc_id, b
     }
     return a_option.order < b_option.order;
   });
-  result.should_check = !result.stat->is_ok() || result.use_http || last_error_at > Time::now_cached() - 10;
-  return result;
+  for (auto &option : options) {
+    option.should_check = !option.stat->is_ok() || option.use_http || last_error_at > Time::now_cached() - 10;
+  }
+  return std::move(options);
+}
+
+Result<DcOptionsSet::ConnectionInfo> DcOptionsSet::find_connection(DcId dc_id, bool allow_media_only, bool use_static,
+                                                                   bool prefer_ipv6, bool only_http) {
+  TRY_RESULT(options, find_connections(dc_id, allow_media_only, use_static, prefer_ipv6, only_http));
+  return options[0];
 }
 
 void DcOptionsSet::reset() {
@@ -64,6 +64,10 @@ class DcOptionsSet {
   vector<ConnectionInfo> find_all_connections(DcId dc_id, bool allow_media_only, bool use_static, bool prefer_ipv6,
                                               bool only_http);
 
+  // returns all suitable connections, the most preferred first
+  Result<vector<ConnectionInfo>> find_connections(DcId dc_id, bool allow_media_only, bool use_static, bool prefer_ipv6,
+                                                  bool only_http);
+
   Result<ConnectionInfo> find_connection(DcId dc_id, bool allow_media_only, bool use_static, bool prefer_ipv6,
                                          bool only_http);
   void reset();
@@ -83,13 +83,17 @@ NetQueryPtr NetQueryCreator::create(uint64 id, const telegram_api::object_ptr<te
   }
 
   auto gzip_flag = slice.size() < min_gzipped_size ? NetQuery::GzipFlag::Off : NetQuery::GzipFlag::On;
-  if (slice.size() >= 16384) {
+  if (gzip_flag == NetQuery::GzipFlag::On && !need_gzip(tl_constructor)) {
+    gzip_flag = NetQuery::GzipFlag::Off;
+  }
+  if (gzip_flag == NetQuery::GzipFlag::On && slice.size() >= 16384) {
     // test compression ratio for the middle part
     // if it is less than 0.9, then try to compress the whole request
     size_t TESTED_SIZE = 1024;
     BufferSlice compressed_part = gzencode(slice.as_slice().substr((slice.size() - TESTED_SIZE) / 2, TESTED_SIZE), 0.9);
     if (compressed_part.empty()) {
       gzip_flag = NetQuery::GzipFlag::Off;
+      on_gzip_result(tl_constructor, false);
     }
   }
   if (gzip_flag == NetQuery::GzipFlag::On) {
@@ -99,6 +103,7 @@ NetQueryPtr NetQueryCreator::create(uint64 id, const telegram_api::object_ptr<te
     } else {
       slice = std::move(compressed);
     }
+    on_gzip_result(tl_constructor, gzip_flag == NetQuery::GzipFlag::On);
   }
 
   auto query = object_pool_.create(id, std::move(slice), dc_id, type, auth_flag, gzip_flag, tl_constructor,
@@ -107,4 +112,28 @@ NetQueryPtr NetQueryCreator::create(uint64 id, const telegram_api::object_ptr<te
   return query;
 }
 
+bool NetQueryCreator::need_gzip(int32 tl_constructor) {
+  auto &stats = gzip_stats_[tl_constructor];
+  if (stats.attempt_count < MIN_GZIP_ATTEMPT_COUNT || stats.success_count * 16 >= stats.attempt_count) {
+    return true;
+  }
+
+  // compression almost never helps for the query, but it is still tried from time to time
+  stats.skip_count++;
+  return stats.skip_count % SKIPPED_GZIP_RECHECK_PERIOD == 0;
+}
+
+void NetQueryCreator::on_gzip_result(int32 tl_constructor, bool is_compressed) {
+  auto &stats = gzip_stats_[tl_constructor];
+  if (stats.attempt_count == MAX_GZIP_ATTEMPT_COUNT) {
+    // forget old results to adapt to changes in query content
+    stats.attempt_count /= 2;
+    stats.success_count /= 2;
+  }
+  stats.attempt_count++;
+  if (is_compressed) {
+    stats.success_count++;
+  }
+}
+
 }  // namespace td
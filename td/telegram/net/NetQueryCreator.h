@@ -13,6 +13,7 @@
 #include "td/telegram/UniqueId.h"
 
 #include "td/utils/common.h"
+#include "td/utils/FlatHashMap.h"
 #include "td/utils/ObjectPool.h"
 
 #include <memory>
@@ -31,6 +32,10 @@ class NetQueryCreator {
     object_pool_.set_check_empty(false);
   }
 
+  NetQueryStats *get_net_query_stats() {
+    return net_query_stats_.get();
+  }
+
   NetQueryPtr create(const telegram_api::Function &function, vector<ChainId> chain_ids = {}, DcId dc_id = DcId::main(),
                      NetQuery::Type type = NetQuery::Type::Common);
 
@@ -47,9 +52,27 @@ class NetQueryCreator {
                      NetQuery::Type type, NetQuery::AuthFlag auth_flag);
 
  private:
+  static constexpr uint32 MIN_GZIP_ATTEMPT_COUNT = 16;
+  static constexpr uint32 MAX_GZIP_ATTEMPT_COUNT = 1024;
+  static constexpr uint32 SKIPPED_GZIP_RECHECK_PERIOD = 64;
+
+  // results of compression attempts for queries of the same type;
+  // NetQueryCreator is scheduler-local, so no synchronization is needed
+  struct GzipStats {
+    uint32 attempt_count = 0;
+    uint32 success_count = 0;
+    uint32 skip_count = 0;
+  };
+
   std::shared_ptr<NetQueryStats> net_query_stats_;
   ObjectPool<NetQuery> object_pool_;
   int32 current_scheduler_id_ = 0;
+
+  FlatHashMap<int32, GzipStats> gzip_stats_;
+
+  bool need_gzip(int32 tl_constructor);
+
+  void on_gzip_result(int32 tl_constructor, bool is_compressed);
 };
 
 }  // namespace td
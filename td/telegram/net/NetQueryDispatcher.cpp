@@ -220,18 +220,19 @@ Status NetQueryDispatcher::wait_dc_init(DcId dc_id, bool force) {
     int32 upload_session_count = (raw_dc_id != 2 && raw_dc_id != 4) || is_premium ? 8 : 4;
     int32 download_session_count = is_premium ? 8 : 2;
     int32 download_small_session_count = is_premium ? 8 : 2;
+    int32 max_file_session_count = get_max_file_session_count();
     dc.main_session_ = create_actor_on_scheduler<SessionMultiProxy>(
         PSLICE() << "SessionMultiProxy:" << raw_dc_id << ":main", get_main_session_scheduler_id(), session_count,
-        auth_data, true, raw_dc_id == main_dc_id_, use_pfs, false, false, is_cdn);
+        session_count, auth_data, true, raw_dc_id == main_dc_id_, use_pfs, false, false, is_cdn);
     dc.upload_session_ = create_actor_on_scheduler<SessionMultiProxy>(
         PSLICE() << "SessionMultiProxy:" << raw_dc_id << ":upload", slow_net_scheduler_id, upload_session_count,
-        auth_data, false, false, use_pfs, false, true, is_cdn);
+        max_file_session_count, auth_data, false, false, use_pfs, false, true, is_cdn);
     dc.download_session_ = create_actor_on_scheduler<SessionMultiProxy>(
         PSLICE() << "SessionMultiProxy:" << raw_dc_id << ":download", slow_net_scheduler_id, download_session_count,
-        auth_data, false, false, use_pfs, true, true, is_cdn);
+        max_file_session_count, auth_data, false, false, use_pfs, true, true, is_cdn);
     dc.download_small_session_ = create_actor_on_scheduler<SessionMultiProxy>(
         PSLICE() << "SessionMultiProxy:" << raw_dc_id << ":download_small", slow_net_scheduler_id,
-        download_small_session_count, auth_data, false, false, use_pfs, true, true, is_cdn);
+        download_small_session_count, max_file_session_count, auth_data, false, false, use_pfs, true, true, is_cdn);
     dc.is_inited_ = true;
     if (dc_id.is_internal()) {
       send_closure_later(dc_auth_manager_, &DcAuthManager::add_dc, std::move(auth_data));
@@ -285,6 +286,22 @@ void NetQueryDispatcher::update_session_count() {
     }
   }
 }
+
+void NetQueryDispatcher::update_max_file_session_count() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  int32 max_file_session_count = get_max_file_session_count();
+  for (int32 i = 1; i < DcId::MAX_RAW_DC_ID; i++) {
+    if (is_dc_inited(i)) {
+      send_closure_later(dcs_[i - 1].upload_session_, &SessionMultiProxy::update_max_session_count,
+                         max_file_session_count);
+      send_closure_later(dcs_[i - 1].download_session_, &SessionMultiProxy::update_max_session_count,
+                         max_file_session_count);
+      send_closure_later(dcs_[i - 1].download_small_session_, &SessionMultiProxy::update_max_session_count,
+                         max_file_session_count);
+    }
+  }
+}
+
 void NetQueryDispatcher::destroy_auth_keys(Promise<> promise) {
   for (int32 i = 1; i < DcId::MAX_RAW_DC_ID && i <= 5; i++) {
     auto dc_id = DcId::internal(i);
@@ -337,6 +354,10 @@ int32 NetQueryDispatcher::get_session_count() {
   return max(narrow_cast<int32>(G()->get_option_integer("session_count")), 1);
 }
 
+int32 NetQueryDispatcher::get_max_file_session_count() {
+  return max(narrow_cast<int32>(G()->get_option_integer("max_file_session_count")), 1);
+}
+
 bool NetQueryDispatcher::get_use_pfs() {
   return G()->get_option_boolean("use_pfs") || get_session_count() > 1;
 }
@@ -46,6 +46,7 @@ class NetQueryDispatcher {
   void stop();
 
   void update_session_count();
+  void update_max_file_session_count();
   void destroy_auth_keys(Promise<> promise);
   void update_use_pfs();
   void update_mtproto_header();
@@ -91,6 +92,7 @@ class NetQueryDispatcher {
 
   static int32 get_main_session_scheduler_id();
   static int32 get_session_count();
+  static int32 get_max_file_session_count();
   static bool get_use_pfs();
 
   static void complete_net_query(NetQueryPtr net_query);
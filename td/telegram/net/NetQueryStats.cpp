@@ -20,9 +20,38 @@ uint64 NetQueryStats::get_count() const {
   return count_.load(std::memory_order_relaxed);
 }
 
+void NetQueryStats::add_packet_stats(const mtproto::PacketStats &stats) {
+  std::lock_guard<std::mutex> guard(packet_stats_mutex_);
+  packet_stats_ += stats;
+}
+
+mtproto::PacketStats NetQueryStats::get_packet_stats() const {
+  std::lock_guard<std::mutex> guard(packet_stats_mutex_);
+  return packet_stats_;
+}
+
+void NetQueryStats::on_connected(int32 raw_dc_id, double connect_time) {
+  std::lock_guard<std::mutex> guard(connect_time_stats_mutex_);
+  connect_time_stats_[raw_dc_id].on_connected(connect_time);
+}
+
+void NetQueryStats::on_connect_failed(int32 raw_dc_id) {
+  std::lock_guard<std::mutex> guard(connect_time_stats_mutex_);
+  connect_time_stats_[raw_dc_id].on_failed();
+}
+
+std::map<int32, ConnectTimeStats> NetQueryStats::get_connect_time_stats() const {
+  std::lock_guard<std::mutex> guard(connect_time_stats_mutex_);
+  return connect_time_stats_;
+}
+
 void NetQueryStats::dump_pending_network_queries() {
   auto n = get_count();
   LOG(WARNING) << tag("pending net queries", n);
+  LOG(WARNING) << "Network connections " << get_packet_stats();
+  for (const auto &it : get_connect_time_stats()) {
+    LOG(WARNING) << "Connect time to DC" << it.first << ": " << it.second;
+  }
 
   if (!use_list_) {
     return;
@@ -53,4 +82,5 @@ void NetQueryStats::dump_pending_network_queries() {
     }
   }
 }
+
 }  // namespace td
@@ -6,12 +6,17 @@
 //
 #pragma once
 
+#include "td/telegram/net/ConnectTimeStats.h"
 #include "td/telegram/net/NetQueryCounter.h"
 
+#include "td/mtproto/PacketStats.h"
+
 #include "td/utils/common.h"
 #include "td/utils/TsList.h"
 
 #include <atomic>
+#include <map>
+#include <mutex>
 
 namespace td {
 
@@ -40,10 +45,28 @@ class NetQueryStats {
 
   void dump_pending_network_queries();
 
+  // statistics of packets sent by all MTProto connections, which are reported by sessions from different schedulers
+  void add_packet_stats(const mtproto::PacketStats &stats);
+
+  mtproto::PacketStats get_packet_stats() const;
+
+  // statistics of raced direct connections to DCs, which are reported by ConnectionCreator
+  void on_connected(int32 raw_dc_id, double connect_time);
+
+  void on_connect_failed(int32 raw_dc_id);
+
+  std::map<int32, ConnectTimeStats> get_connect_time_stats() const;
+
  private:
   NetQueryCounter::Counter count_{0};
   std::atomic<bool> use_list_{true};
   TsList<NetQueryDebug> list_;
+
+  mutable std::mutex packet_stats_mutex_;
+  mtproto::PacketStats packet_stats_;
+
+  mutable std::mutex connect_time_stats_mutex_;
+  std::map<int32, ConnectTimeStats> connect_time_stats_;
 };
 
 }  // namespace td
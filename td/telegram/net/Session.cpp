@@ -12,7 +12,9 @@
 #include "td/telegram/net/DcId.h"
 #include "td/telegram/net/MtprotoHeader.h"
 #include "td/telegram/net/NetQuery.h"
+#include "td/telegram/net/NetQueryCreator.h"
 #include "td/telegram/net/NetQueryDispatcher.h"
+#include "td/telegram/net/NetQueryStats.h"
 #include "td/telegram/net/NetType.h"
 #include "td/telegram/StateManager.h"
 #include "td/telegram/telegram_api.h"
@@ -624,6 +626,9 @@ void Session::on_closed(Status status) {
   if (!close_flag_ && is_main_) {
     connection_token_.reset();
   }
+  LOG(INFO) << "Connection " << static_cast<int32>(current_info_->connection_id_) << " is closed after it "
+            << current_info_->connection_->get_packet_stats();
+  report_packet_stats(current_info_);
   auto raw_connection = current_info_->connection_->move_as_raw_connection();
   Scheduler::unsubscribe_before_close(raw_connection->get_poll_info().get_pollable_fd_ref());
   raw_connection->close();
@@ -1157,7 +1162,8 @@ void Session::connection_send_query(ConnectionInfo *info, NetQueryPtr &&net_quer
     net_query->debug(PSTRING() << get_name() << ": send to an MTProto connection");
     auto r_message_id = info->connection_->send_query(
         net_query->query().clone(), net_query->gzip_flag() == NetQuery::GzipFlag::On, message_id,
-        invoke_after_message_ids, static_cast<bool>(net_query->quick_ack_promise_));
+        invoke_after_message_ids, static_cast<bool>(net_query->quick_ack_promise_),
+        net_query->type() != NetQuery::Type::Common, net_query->priority() > 0);
 
     net_query->on_net_write(net_query->query().size());
 
@@ -1307,6 +1313,7 @@ void Session::connection_open_finish(ConnectionInfo *info,
   info->state_ = ConnectionInfo::State::Ready;
   info->created_at_ = Time::now();
   info->wakeup_at_ = info->created_at_ + 10;
+  info->packet_stats_reported_at_ = info->created_at_;
   if (unknown_queries_.size() > MAX_INFLIGHT_QUERIES) {
     LOG(ERROR) << "With current limits `Too many queries with unknown state` error must be impossible";
     on_session_failed(Status::Error("Too many queries with unknown state"));
@@ -1328,6 +1335,20 @@ void Session::connection_flush(ConnectionInfo *info) {
   CHECK(info->state_ == ConnectionInfo::State::Ready);
   current_info_ = info;
   info->wakeup_at_ = info->connection_->flush(static_cast<mtproto::SessionConnection::Callback *>(this));
+  if (info->state_ == ConnectionInfo::State::Ready &&
+      info->packet_stats_reported_at_ + PACKET_STATS_REPORT_PERIOD < Time::now_cached()) {
+    report_packet_stats(info);
+  }
+}
+
+void Session::report_packet_stats(ConnectionInfo *info) {
+  CHECK(info->connection_ != nullptr);
+  info->packet_stats_reported_at_ = Time::now();
+  auto packet_stats = info->connection_->extract_packet_stats();
+  auto net_query_stats = G()->net_query_creator().get_net_query_stats();
+  if (net_query_stats != nullptr && packet_stats.packet_count != 0) {
+    net_query_stats->add_packet_stats(packet_stats);
+  }
 }
 
 void Session::connection_close(ConnectionInfo *info) {
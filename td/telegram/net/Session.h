@@ -160,6 +160,7 @@ class Session final
     bool ask_info_ = false;
     double wakeup_at_ = 0;
     double created_at_ = 0;
+    double packet_stats_reported_at_ = 0;
   };
 
   ConnectionInfo *current_info_;
@@ -179,6 +180,7 @@ class Session final
 
   static constexpr double ACTIVITY_TIMEOUT = 60 * 5;
   static constexpr size_t MAX_INFLIGHT_QUERIES = 1024;
+  static constexpr double PACKET_STATS_REPORT_PERIOD = 60;
 
   struct ContainerInfo {
     size_t ref_cnt;
@@ -262,6 +264,7 @@ class Session final
   void connection_online_update(double now, bool force);
   void connection_close(ConnectionInfo *info);
   void connection_flush(ConnectionInfo *info);
+  void report_packet_stats(ConnectionInfo *info);
   void connection_send_query(ConnectionInfo *info, NetQueryPtr &&net_query, mtproto::MessageId message_id = {});
   bool need_send_bind_key() const;
   bool need_send_query() const;
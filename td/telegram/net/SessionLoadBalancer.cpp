@@ -0,0 +1,151 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/net/SessionLoadBalancer.h"
+
+#include "td/utils/logging.h"
+#include "td/utils/misc.h"
+#include "td/utils/Random.h"
+
+namespace td {
+
+SessionLoadBalancer::SessionLoadBalancer(int32 min_session_count, int32 max_session_count)
+    : min_session_count_(max(min_session_count, 1)), max_session_count_(max(max_session_count, min_session_count_)) {
+  sessions_.resize(static_cast<size_t>(min_session_count_));
+}
+
+void SessionLoadBalancer::set_max_session_count(int32 max_session_count) {
+  max_session_count_ = max(max_session_count, min_session_count_);
+}
+
+double SessionLoadBalancer::get_expected_delay(const SessionInfo &session, int64 query_size) const {
+  auto delay = static_cast<double>(session.query_size + query_size) / ESTIMATED_SPEED;
+  if (session.query_count > 0) {
+    // round-trip time of an idle session is unimportant, and it will be measured again after the query is sent
+    delay += session.rtt;
+  }
+  return delay;
+}
+
+int32 SessionLoadBalancer::choose_session(int64 query_size) const {
+  CHECK(!sessions_.empty());
+  size_t pos = 0;
+  size_t equal_count = 1;
+  double min_delay = get_expected_delay(sessions_[0], query_size);
+  for (size_t i = 1; i < sessions_.size(); i++) {
+    auto delay = get_expected_delay(sessions_[i], query_size);
+    if (delay < min_delay || (delay == min_delay && sessions_[i].query_count < sessions_[pos].query_count)) {
+      pos = i;
+      min_delay = delay;
+      equal_count = 1;
+    } else if (delay == min_delay && sessions_[i].query_count == sessions_[pos].query_count) {
+      equal_count++;
+      if (Random::fast_uint32() % equal_count == 0) {
+        pos = i;
+      }
+    }
+  }
+  return static_cast<int32>(pos);
+}
+
+void SessionLoadBalancer::on_query_sent(uint64 query_id, int32 session_id, int64 query_size, double now) {
+  CHECK(static_cast<size_t>(session_id) < sessions_.size());
+  auto &query = sent_queries_[query_id];
+  if (query.send_time != 0.0) {
+    // the query was resent before the previous attempt was reported as finished
+    remove_query(query);
+  }
+  query.session_id = session_id;
+  query.query_size = query_size;
+  query.send_time = now;
+
+  auto &session = sessions_[session_id];
+  session.query_count++;
+  session.query_size += query_size;
+  if (is_overloaded()) {
+    last_overload_time_ = now;
+  }
+}
+
+void SessionLoadBalancer::on_query_finished(uint64 query_id, double now) {
+  auto it = sent_queries_.find(query_id);
+  if (it == sent_queries_.end()) {
+    return;
+  }
+  auto query = it->second;
+  sent_queries_.erase(it);
+  remove_query(query);
+
+  if (static_cast<size_t>(query.session_id) < sessions_.size()) {
+    auto &session = sessions_[query.session_id];
+    auto rtt = max(now - query.send_time, 0.0);
+    session.rtt = session.rtt == 0.0 ? rtt : session.rtt * 0.8 + rtt * 0.2;
+  }
+}
+
+void SessionLoadBalancer::remove_query(const SentQuery &query) {
+  if (static_cast<size_t>(query.session_id) >= sessions_.size()) {
+    // the session has already been closed
+    return;
+  }
+  auto &session = sessions_[query.session_id];
+  session.query_count = max(session.query_count - 1, 0);
+  session.query_size = max(session.query_size - query.query_size, static_cast<int64>(0));
+}
+
+bool SessionLoadBalancer::is_overloaded() const {
+  for (auto &session : sessions_) {
+    if (session.query_count < MAX_SESSION_QUERY_COUNT && session.query_size < MAX_SESSION_QUERY_SIZE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int32 SessionLoadBalancer::get_wanted_session_count(double now) const {
+  auto session_count = get_session_count();
+  if (session_count > max_session_count_) {
+    return max_session_count_;
+  }
+  if (now < last_resize_time_ + RESIZE_DELAY) {
+    return session_count;
+  }
+  if (session_count < max_session_count_ && is_overloaded()) {
+    return session_count + 1;
+  }
+  if (session_count > min_session_count_ && sessions_.back().query_count == 0 &&
+      now > last_overload_time_ + IDLE_PERIOD) {
+    return session_count - 1;
+  }
+  return session_count;
+}
+
+void SessionLoadBalancer::set_session_count(int32 session_count, double now) {
+  session_count = clamp(session_count, min_session_count_, max_session_count_);
+  if (session_count == get_session_count()) {
+    return;
+  }
+  LOG(INFO) << "Change session count from " << sessions_.size() << " to " << session_count;
+  sessions_.resize(static_cast<size_t>(session_count));
+  last_resize_time_ = now;
+}
+
+int32 SessionLoadBalancer::get_query_count(int32 session_id) const {
+  CHECK(static_cast<size_t>(session_id) < sessions_.size());
+  return sessions_[session_id].query_count;
+}
+
+int64 SessionLoadBalancer::get_query_size(int32 session_id) const {
+  CHECK(static_cast<size_t>(session_id) < sessions_.size());
+  return sessions_[session_id].query_size;
+}
+
+double SessionLoadBalancer::get_rtt(int32 session_id) const {
+  CHECK(static_cast<size_t>(session_id) < sessions_.size());
+  return sessions_[session_id].rtt;
+}
+
+}  // namespace td
@@ -0,0 +1,80 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include "td/utils/common.h"
+#include "td/utils/FlatHashMap.h"
+
+namespace td {
+
+// chooses a session for a query by outstanding bytes and observed round-trip time of the sessions
+// and decides when the number of sessions needs to be changed within [min_session_count, max_session_count]
+class SessionLoadBalancer {
+ public:
+  SessionLoadBalancer(int32 min_session_count, int32 max_session_count);
+
+  int32 get_session_count() const {
+    return static_cast<int32>(sessions_.size());
+  }
+
+  int32 get_min_session_count() const {
+    return min_session_count_;
+  }
+
+  void set_max_session_count(int32 max_session_count);
+
+  // returns the session, which is expected to answer a new query of the given size first
+  int32 choose_session(int64 query_size) const;
+
+  void on_query_sent(uint64 query_id, int32 session_id, int64 query_size, double now);
+
+  void on_query_finished(uint64 query_id, double now);
+
+  // returns the number of sessions needed to handle the current load
+  int32 get_wanted_session_count(double now) const;
+
+  void set_session_count(int32 session_count, double now);
+
+  int32 get_query_count(int32 session_id) const;
+
+  int64 get_query_size(int32 session_id) const;
+
+  double get_rtt(int32 session_id) const;
+
+ private:
+  static constexpr int32 MAX_SESSION_QUERY_COUNT = 8;
+  static constexpr int64 MAX_SESSION_QUERY_SIZE = 1 << 20;
+  static constexpr double ESTIMATED_SPEED = static_cast<double>(1 << 20);  // bytes per second
+  static constexpr double RESIZE_DELAY = 1.0;
+  static constexpr double IDLE_PERIOD = 30.0;
+
+  struct SessionInfo {
+    int32 query_count = 0;
+    int64 query_size = 0;
+    double rtt = 0.0;
+  };
+  struct SentQuery {
+    int32 session_id = 0;
+    int64 query_size = 0;
+    double send_time = 0.0;
+  };
+
+  int32 min_session_count_ = 1;
+  int32 max_session_count_ = 1;
+  vector<SessionInfo> sessions_;
+  FlatHashMap<uint64, SentQuery> sent_queries_;
+  double last_resize_time_ = 0.0;
+  double last_overload_time_ = 0.0;
+
+  double get_expected_delay(const SessionInfo &session, int64 query_size) const;
+
+  void remove_query(const SentQuery &query);
+
+  bool is_overloaded() const;
+};
+
+}  // namespace td
@@ -7,23 +7,26 @@
 #include "td/telegram/net/SessionMultiProxy.h"
 
 #include "td/telegram/net/SessionProxy.h"
+#include "td/telegram/telegram_api.h"
 
+#include "td/utils/as.h"
 #include "td/utils/common.h"
 #include "td/utils/format.h"
 #include "td/utils/logging.h"
 #include "td/utils/misc.h"
-#include "td/utils/Random.h"
 #include "td/utils/Slice.h"
 #include "td/utils/SliceBuilder.h"
+#include "td/utils/Time.h"
 
 namespace td {
 
 SessionMultiProxy::~SessionMultiProxy() = default;
 
-SessionMultiProxy::SessionMultiProxy(int32 session_count, std::shared_ptr<AuthDataShared> shared_auth_data,
-                                     bool is_primary, bool is_main, bool use_pfs, bool allow_media_only, bool is_media,
-                                     bool is_cdn)
+SessionMultiProxy::SessionMultiProxy(int32 session_count, int32 max_session_count,
+                                     std::shared_ptr<AuthDataShared> shared_auth_data, bool is_primary, bool is_main,
+                                     bool use_pfs, bool allow_media_only, bool is_media, bool is_cdn)
     : session_count_(session_count)
+    , max_session_count_(max_session_count)
     , auth_data_(std::move(shared_auth_data))
     , is_primary_(is_primary)
     , is_main_(is_main)
@@ -36,39 +39,47 @@ SessionMultiProxy::SessionMultiProxy(int32 session_count, std::shared_ptr<AuthDa
   }
 }
 
+// the load of a download query is determined by the size of the expected answer instead of the query size
+static int64 get_query_load(const NetQuery &query) {
+  auto query_size = static_cast<int64>(query.query().size());
+  auto tl_constructor = query.tl_constructor();
+  if ((tl_constructor == telegram_api::upload_getFile::ID || tl_constructor == telegram_api::upload_getCdnFile::ID) &&
+      query.gzip_flag() == NetQuery::GzipFlag::Off && query_size >= 4) {
+    // limit is the last field of both queries
+    auto limit = as<int32>(query.query().as_slice().substr(query.query().size() - 4).ubegin());
+    if (limit > 0) {
+      return limit;
+    }
+  }
+  return query_size;
+}
+
 void SessionMultiProxy::send(NetQueryPtr query) {
-  size_t pos = 0;
+  int32 pos = 0;
+  auto query_size = get_query_load(*query);
   if (query->auth_flag() == NetQuery::AuthFlag::On) {
     size_t session_rand = query->session_rand();
     if (session_rand) {
-      pos = session_rand % sessions_.size();
+      // queries from the same chain must be sent through the same session, so only permanent sessions are used
+      pos = static_cast<int32>(session_rand % static_cast<size_t>(load_balancer_.get_min_session_count()));
     } else {
-      size_t equal_count = 1;
-      int min_query_count = sessions_[pos].query_count;
-      for (size_t i = 1; i < sessions_.size(); i++) {
-        if (sessions_[i].query_count < min_query_count) {
-          pos = i;
-          min_query_count = sessions_[pos].query_count;
-          equal_count = 1;
-        } else if (sessions_[i].query_count == min_query_count) {
-          equal_count++;
-          if (Random::fast_uint32() % equal_count == 0) {
-            pos = i;
-          }
-        }
-      }
+      pos = load_balancer_.choose_session(query_size);
     }
   }
   // query->debug(PSTRING() << get_name() << ": send to proxy #" << pos);
-  sessions_[pos].query_count++;
-  send_closure(sessions_[pos].proxy, &SessionProxy::send, std::move(query));
+  load_balancer_.on_query_sent(query->id(), pos, query_size, Time::now());
+  send_closure(sessions_[pos], &SessionProxy::send, std::move(query));
+
+  if (max_session_count_ > session_count_) {
+    update_session_pool();
+  }
 }
 
 void SessionMultiProxy::update_main_flag(bool is_main) {
   LOG(INFO) << "Update is_main to " << is_main;
   is_main_ = is_main;
   for (auto &session : sessions_) {
-    send_closure(session.proxy, &SessionProxy::update_main_flag, is_main);
+    send_closure(session, &SessionProxy::update_main_flag, is_main);
   }
 }
 
@@ -80,6 +91,17 @@ void SessionMultiProxy::update_session_count(int32 session_count) {
   update_options(session_count, use_pfs_, need_destroy_auth_key_);
 }
 
+void SessionMultiProxy::update_max_session_count(int32 max_session_count) {
+  max_session_count = clamp(max_session_count, 1, 100);
+  if (max_session_count == max_session_count_) {
+    return;
+  }
+  LOG(INFO) << "Update max_session_count to " << max_session_count;
+  max_session_count_ = max_session_count;
+  load_balancer_.set_max_session_count(is_primary_ ? session_count_ : max_session_count_);
+  update_session_pool();
+}
+
 void SessionMultiProxy::update_use_pfs(bool use_pfs) {
   update_options(session_count_, use_pfs, need_destroy_auth_key_);
 }
@@ -121,7 +143,7 @@ void SessionMultiProxy::update_options(int32 session_count, bool use_pfs, bool n
 
 void SessionMultiProxy::update_mtproto_header() {
   for (auto &session : sessions_) {
-    send_closure_later(session.proxy, &SessionProxy::update_mtproto_header);
+    send_closure_later(session, &SessionProxy::update_mtproto_header);
   }
 }
 
@@ -139,41 +161,62 @@ void SessionMultiProxy::init() {
   if (is_main_ && session_count_ > 1) {
     LOG(WARNING) << tag("session_count", session_count_);
   }
+  // sessions of the primary proxy are never added automatically, because updates are received through them
+  load_balancer_ = SessionLoadBalancer(session_count_, is_primary_ ? session_count_ : max_session_count_);
   for (int32 i = 0; i < session_count_; i++) {
-    string name = PSTRING() << "Session" << get_name().substr(Slice("SessionMulti").size())
-                            << format::cond(session_count_ > 1, format::concat("#", i));
-
-    SessionInfo info;
-    class Callback final : public SessionProxy::Callback {
-     public:
-      Callback(ActorId<SessionMultiProxy> parent, uint32 generation, int32 session_id)
-          : parent_(parent), generation_(generation), session_id_(session_id) {
-      }
-      void on_query_finished() final {
-        send_closure(parent_, &SessionMultiProxy::on_query_finished, generation_, session_id_);
-      }
-
-     private:
-      ActorId<SessionMultiProxy> parent_;
-      uint32 generation_;
-      int32 session_id_;
-    };
-    info.proxy =
-        create_actor<SessionProxy>(name, make_unique<Callback>(actor_id(this), sessions_generation_, i), auth_data_,
-                                   is_primary_, is_main_, allow_media_only_, is_media_, get_pfs_flag(),
-                                   session_count_ > 1 && is_primary_, is_cdn_, need_destroy_auth_key_ && i == 0);
-    sessions_.push_back(std::move(info));
-  }
-}
-
-void SessionMultiProxy::on_query_finished(uint32 generation, int session_id) {
+    sessions_.push_back(create_session(i));
+  }
+}
+
+ActorOwn<SessionProxy> SessionMultiProxy::create_session(int32 session_id) {
+  bool has_several_sessions = session_count_ > 1 || (!is_primary_ && max_session_count_ > 1);
+  string name = PSTRING() << "Session" << get_name().substr(Slice("SessionMulti").size())
+                          << format::cond(has_several_sessions, format::concat("#", session_id));
+
+  class Callback final : public SessionProxy::Callback {
+   public:
+    Callback(ActorId<SessionMultiProxy> parent, uint32 generation) : parent_(parent), generation_(generation) {
+    }
+    void on_query_finished(uint64 query_id) final {
+      send_closure(parent_, &SessionMultiProxy::on_query_finished, generation_, query_id);
+    }
+
+   private:
+    ActorId<SessionMultiProxy> parent_;
+    uint32 generation_;
+  };
+  return create_actor<SessionProxy>(name, make_unique<Callback>(actor_id(this), sessions_generation_), auth_data_,
+                                    is_primary_, is_main_, allow_media_only_, is_media_, get_pfs_flag(),
+                                    session_count_ > 1 && is_primary_, is_cdn_,
+                                    need_destroy_auth_key_ && session_id == 0);
+}
+
+void SessionMultiProxy::update_session_pool() {
+  auto now = Time::now();
+  auto session_count = load_balancer_.get_wanted_session_count(now);
+  if (session_count != load_balancer_.get_session_count()) {
+    load_balancer_.set_session_count(session_count, now);
+    session_count = load_balancer_.get_session_count();
+    while (static_cast<int32>(sessions_.size()) < session_count) {
+      sessions_.push_back(create_session(static_cast<int32>(sessions_.size())));
+    }
+    // the last sessions are closed if they aren't needed anymore
+    sessions_.resize(static_cast<size_t>(session_count));
+  }
+  if (load_balancer_.get_session_count() > load_balancer_.get_min_session_count()) {
+    set_timeout_in(SESSION_POOL_CHECK_DELAY);
+  }
+}
+
+void SessionMultiProxy::timeout_expired() {
+  update_session_pool();
+}
+
+void SessionMultiProxy::on_query_finished(uint32 generation, uint64 query_id) {
   if (generation != sessions_generation_) {
     return;
   }
-  CHECK(static_cast<size_t>(session_id) < sessions_.size());
-  auto &query_count = sessions_[session_id].query_count;
-  CHECK(query_count > 0);
-  query_count--;
+  load_balancer_.on_query_finished(query_id, Time::now());
 }
 
 }  // namespace td
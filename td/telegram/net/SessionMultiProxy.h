@@ -8,6 +8,7 @@
 
 #include "td/telegram/net/AuthDataShared.h"
 #include "td/telegram/net/NetQuery.h"
+#include "td/telegram/net/SessionLoadBalancer.h"
 
 #include "td/actor/actor.h"
 
@@ -19,8 +20,8 @@ class SessionProxy;
 
 class SessionMultiProxy final : public Actor {
  public:
-  SessionMultiProxy(int32 session_count, std::shared_ptr<AuthDataShared> shared_auth_data, bool is_primary,
-                    bool is_main, bool use_pfs, bool allow_media_only, bool is_media, bool is_cdn);
+  SessionMultiProxy(int32 session_count, int32 max_session_count, std::shared_ptr<AuthDataShared> shared_auth_data,
+                    bool is_primary, bool is_main, bool use_pfs, bool allow_media_only, bool is_media, bool is_cdn);
   SessionMultiProxy(const SessionMultiProxy &) = delete;
   SessionMultiProxy &operator=(const SessionMultiProxy &) = delete;
   ~SessionMultiProxy() final;
@@ -29,6 +30,7 @@ class SessionMultiProxy final : public Actor {
   void update_main_flag(bool is_main);
 
   void update_session_count(int32 session_count);
+  void update_max_session_count(int32 max_session_count);
   void update_use_pfs(bool use_pfs);
   void update_options(int32 session_count, bool use_pfs, bool need_destroy_auth_key);
   void update_mtproto_header();
@@ -37,6 +39,8 @@ class SessionMultiProxy final : public Actor {
 
  private:
   int32 session_count_ = 0;
+  // additional sessions are opened under load if max_session_count_ > session_count_
+  int32 max_session_count_ = 0;
   std::shared_ptr<AuthDataShared> auth_data_;
   const bool is_primary_;
   bool is_main_ = false;
@@ -45,19 +49,23 @@ class SessionMultiProxy final : public Actor {
   bool is_media_ = false;
   bool is_cdn_ = false;
   bool need_destroy_auth_key_ = false;
-  struct SessionInfo {
-    ActorOwn<SessionProxy> proxy;
-    int query_count{0};
-  };
+  static constexpr double SESSION_POOL_CHECK_DELAY = 5.0;
+
   uint32 sessions_generation_{0};
-  std::vector<SessionInfo> sessions_;
+  std::vector<ActorOwn<SessionProxy>> sessions_;
+  SessionLoadBalancer load_balancer_{1, 1};
 
   void start_up() final;
+  void timeout_expired() final;
   void init();
 
+  ActorOwn<SessionProxy> create_session(int32 session_id);
+
+  void update_session_pool();
+
   bool get_pfs_flag() const;
 
-  void on_query_finished(uint32 generation, int session_id);
+  void on_query_finished(uint32 generation, uint64 query_id);
 };
 
 }  // namespace td
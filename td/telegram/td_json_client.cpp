@@ -43,6 +43,19 @@ const char *td_receive(double timeout) {
   return td::json_receive(timeout);
 }
 
+int td_receive_many(double timeout, int max_response_count, const char **result, size_t *result_length) {
+  const char *received_result = nullptr;
+  size_t received_result_length = 0;
+  auto response_count = td::json_receive(timeout, max_response_count, received_result, received_result_length);
+  if (result != nullptr) {
+    *result = received_result;
+  }
+  if (result_length != nullptr) {
+    *result_length = received_result_length;
+  }
+  return response_count;
+}
+
 const char *td_execute(const char *request) {
   return td::json_execute(td::Slice(request == nullptr ? "" : request));
 }
@@ -50,6 +50,8 @@
 
 #include "td/telegram/tdjson_export.h"
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -70,16 +72,30 @@ TDJSON_EXPORT void td_send(int client_id, const char *request);
 
 /**
  * Receives incoming updates and request responses. Must not be called simultaneously from two different threads.
- * The returned pointer can be used until the next call to td_receive or td_execute, after which it will be deallocated by TDLib.
+ * The returned pointer can be used until the next call to td_receive, td_receive_many or td_execute, after which it will be deallocated by TDLib.
  * \param[in] timeout The maximum number of seconds allowed for this function to wait for new data.
  * \return JSON-serialized null-terminated incoming update or request response. May be NULL if the timeout expires.
  */
 TDJSON_EXPORT const char *td_receive(double timeout);
 
+/**
+ * Receives up to max_response_count incoming updates and request responses at once. Waits only if there are no pending
+ * updates and responses. Must not be called simultaneously from two different threads, or together with td_receive.
+ * The received objects are stored one after another as JSON-serialized null-terminated strings in a buffer, which
+ * can be used until the next call to td_receive, td_receive_many or td_execute in the same thread, after which
+ * it will be reused by TDLib.
+ * \param[in] timeout The maximum number of seconds allowed for this function to wait for new data.
+ * \param[in] max_response_count The maximum number of objects to receive.
+ * \param[out] result Pointer to the first received object. Is set to NULL if no objects were received.
+ * \param[out] result_length Total length of the received objects including their terminating null characters.
+ * \return The number of received objects. May be 0 if the timeout expires.
+ */
+TDJSON_EXPORT int td_receive_many(double timeout, int max_response_count, const char **result, size_t *result_length);
+
 /**
  * Synchronously executes a TDLib request.
  * A request can be executed synchronously, only if it is documented with "Can be called synchronously".
- * The returned pointer can be used until the next call to td_receive or td_execute, after which it will be deallocated by TDLib.
+ * The returned pointer can be used until the next call to td_receive, td_receive_many or td_execute, after which it will be deallocated by TDLib.
  * \param[in] request JSON-serialized null-terminated request to TDLib.
  * \return JSON-serialized null-terminated request response.
  */
@@ -199,4 +199,346 @@ std::enable_if_t<std::is_constructible<T>::value, Status> from_json(tl_object_pt
   return from_json(*to, from.get_object());
 }
 
+// parses JSON-serialized TL objects directly from the string without construction of JsonValue
+// strings are decoded in place, so the same JSON can't be parsed twice
+class TlJsonParser {
+ public:
+  static constexpr int32 DEFAULT_MAX_DEPTH = 100;
+
+  explicit TlJsonParser(MutableSlice json, int32 max_depth = DEFAULT_MAX_DEPTH) : parser_(json), max_depth_(max_depth) {
+  }
+
+  // raw value of the first top-level field with the given name, which isn't a field of the parsed object, is saved
+  void set_saved_field_name(Slice name) {
+    saved_field_name_ = name;
+  }
+
+  Slice get_saved_field_value() const {
+    return saved_field_value_;
+  }
+
+  JsonValue::Type get_value_type() {
+    parser_.skip_whitespaces();
+    switch (parser_.peek_char()) {
+      case '{':
+        return JsonValue::Type::Object;
+      case '[':
+        return JsonValue::Type::Array;
+      case '"':
+        return JsonValue::Type::String;
+      case 'n':
+        return JsonValue::Type::Null;
+      case 't':
+      case 'f':
+        return JsonValue::Type::Boolean;
+      default:
+        return JsonValue::Type::Number;
+    }
+  }
+
+  // for an Object or an Array returns an empty value of the same type, which can be used only to check the type
+  Result<JsonValue> get_scalar_value() {
+    auto type = get_value_type();
+    if (type == JsonValue::Type::Object || type == JsonValue::Type::Array) {
+      TRY_STATUS(skip_value());
+      if (type == JsonValue::Type::Object) {
+        return JsonValue::make_object(JsonObject());
+      }
+      return JsonValue::create_array(JsonArray());
+    }
+    return do_json_decode(parser_, 0);
+  }
+
+  Status skip_value() {
+    auto begin = parser_.ptr();
+    TRY_STATUS(do_json_skip(parser_, max_depth_ - depth_));
+    if (depth_ == 1 && saved_field_value_.empty() && !saved_field_name_.empty() && field_ == saved_field_name_) {
+      saved_field_value_ = Slice(begin, parser_.ptr());
+    }
+    return Status::OK();
+  }
+
+  // returns value of the field "@type" of the next value, which must be an Object, without parsing the Object
+  Result<JsonValue> get_object_type() {
+    Parser parser(parser_.data());
+    parser.skip_whitespaces();
+    if (!parser.try_skip('{')) {
+      return Status::Error("'{' expected");
+    }
+    parser.skip_whitespaces();
+    if (parser.try_skip('}')) {
+      return Status::Error(400, "Can't find field \"@type\"");
+    }
+    while (true) {
+      if (parser.empty()) {
+        return Status::Error("Unexpected string end");
+      }
+      TRY_RESULT(is_type_field, skip_string(parser, "@type"));
+      parser.skip_whitespaces();
+      if (!parser.try_skip(':')) {
+        return Status::Error("':' expected");
+      }
+      parser.skip_whitespaces();
+      if (is_type_field) {
+        switch (parser.peek_char()) {
+          case '"': {
+            auto begin = parser.ptr();
+            TRY_STATUS(json_string_skip(parser));
+            MutableSlice value(begin + 1, parser.ptr() - 1);
+            if (value.find('\\') != Slice::npos) {
+              type_buffer_.assign(begin, parser.ptr());
+              Parser type_parser(type_buffer_);
+              TRY_RESULT_ASSIGN(value, json_string_decode(type_parser));
+            }
+            return JsonValue::create_string(value);
+          }
+          case '{':
+            return JsonValue::make_object(JsonObject());
+          case '[':
+            return JsonValue::create_array(JsonArray());
+          default:
+            return do_json_decode(parser, 0);
+        }
+      }
+      TRY_STATUS(do_json_skip(parser, max_depth_ - depth_ - 1));
+
+      parser.skip_whitespaces();
+      if (parser.try_skip('}')) {
+        return Status::Error(400, "Can't find field \"@type\"");
+      }
+      if (!parser.try_skip(',')) {
+        return Status::Error("Unexpected symbol while parsing JSON Object");
+      }
+      parser.skip_whitespaces();
+    }
+  }
+
+  // returns whether the Object has fields; if so, get_field returns name of the first field
+  Result<bool> enter_object() {
+    parser_.skip_whitespaces();
+    if (!parser_.try_skip('{')) {
+      return Status::Error("'{' expected");
+    }
+    parser_.skip_whitespaces();
+    if (parser_.try_skip('}')) {
+      return false;
+    }
+    TRY_STATUS(enter_container());
+    TRY_STATUS(read_field());
+    return true;
+  }
+
+  Slice get_field() const {
+    return field_;
+  }
+
+  // must be called after the value of the current field is parsed
+  Result<bool> next_field() {
+    parser_.skip_whitespaces();
+    if (parser_.try_skip('}')) {
+      depth_--;
+      return false;
+    }
+    if (!parser_.try_skip(',')) {
+      if (parser_.empty()) {
+        return Status::Error("Unexpected string end");
+      }
+      return Status::Error("Unexpected symbol while parsing JSON Object");
+    }
+    parser_.skip_whitespaces();
+    TRY_STATUS(read_field());
+    return true;
+  }
+
+  // returns whether the Array has elements
+  Result<bool> enter_array() {
+    parser_.skip_whitespaces();
+    if (!parser_.try_skip('[')) {
+      return Status::Error("'[' expected");
+    }
+    parser_.skip_whitespaces();
+    if (parser_.try_skip(']')) {
+      return false;
+    }
+    TRY_STATUS(enter_container());
+    return true;
+  }
+
+  // must be called after the current element is parsed
+  Result<bool> next_element() {
+    parser_.skip_whitespaces();
+    if (parser_.try_skip(']')) {
+      depth_--;
+      return false;
+    }
+    if (!parser_.try_skip(',')) {
+      if (parser_.empty()) {
+        return Status::Error("Unexpected string end");
+      }
+      return Status::Error("Unexpected symbol while parsing JSON Array");
+    }
+    return true;
+  }
+
+  Status finish() {
+    CHECK(depth_ == 0);
+    parser_.skip_whitespaces();
+    if (!parser_.empty()) {
+      return Status::Error("Expected string end");
+    }
+    return Status::OK();
+  }
+
+  // used to ignore all but the first occurrence of a field in an Object
+  static bool is_new_field(uint64 &parsed_fields, int32 field_index) {
+    auto mask = static_cast<uint64>(1) << field_index;
+    if ((parsed_fields & mask) != 0) {
+      return false;
+    }
+    parsed_fields |= mask;
+    return true;
+  }
+
+ private:
+  Parser parser_;
+  int32 max_depth_;
+  int32 depth_ = 0;
+  MutableSlice field_;
+  Slice saved_field_name_;
+  Slice saved_field_value_;
+  string type_buffer_;
+
+  Status enter_container() {
+    if (depth_ >= max_depth_) {
+      return Status::Error("Too big object depth");
+    }
+    depth_++;
+    return Status::OK();
+  }
+
+  Status read_field() {
+    if (parser_.empty()) {
+      return Status::Error("Unexpected string end");
+    }
+    TRY_RESULT_ASSIGN(field_, json_string_decode(parser_));
+    parser_.skip_whitespaces();
+    if (!parser_.try_skip(':')) {
+      return Status::Error("':' expected");
+    }
+    return Status::OK();
+  }
+
+  static Result<bool> skip_string(Parser &parser, Slice expected_value) {
+    auto begin = parser.ptr();
+    TRY_STATUS(json_string_skip(parser));
+    Slice value(begin + 1, parser.ptr() - 1);
+    if (value.find('\\') == Slice::npos) {
+      return value == expected_value;
+    }
+    string buffer(begin, parser.ptr());
+    Parser string_parser(buffer);
+    TRY_RESULT(decoded_value, json_string_decode(string_parser));
+    return decoded_value == expected_value;
+  }
+};
+
+inline Status from_json(int32 &to, TlJsonParser &from) {
+  TRY_RESULT(value, from.get_scalar_value());
+  return from_json(to, std::move(value));
+}
+
+inline Status from_json(bool &to, TlJsonParser &from) {
+  TRY_RESULT(value, from.get_scalar_value());
+  return from_json(to, std::move(value));
+}
+
+inline Status from_json(int64 &to, TlJsonParser &from) {
+  TRY_RESULT(value, from.get_scalar_value());
+  return from_json(to, std::move(value));
+}
+
+inline Status from_json(double &to, TlJsonParser &from) {
+  TRY_RESULT(value, from.get_scalar_value());
+  return from_json(to, std::move(value));
+}
+
+inline Status from_json(string &to, TlJsonParser &from) {
+  TRY_RESULT(value, from.get_scalar_value());
+  return from_json(to, std::move(value));
+}
+
+inline Status from_json_bytes(string &to, TlJsonParser &from) {
+  TRY_RESULT(value, from.get_scalar_value());
+  return from_json_bytes(to, std::move(value));
+}
+
+template <class T>
+Status from_json(std::vector<T> &to, TlJsonParser &from) {
+  auto type = from.get_value_type();
+  if (type != JsonValue::Type::Array) {
+    if (type == JsonValue::Type::Null) {
+      return from.skip_value();
+    }
+    return Status::Error(PSLICE() << "Expected Array, but receive " << type);
+  }
+  to.clear();
+  TRY_RESULT(has_element, from.enter_array());
+  while (has_element) {
+    to.emplace_back();
+    TRY_STATUS(from_json(to.back(), from));
+    TRY_RESULT_ASSIGN(has_element, from.next_element());
+  }
+  return Status::OK();
+}
+
+template <class T>
+std::enable_if_t<!std::is_constructible<T>::value, Status> from_json(tl_object_ptr<T> &to, TlJsonParser &from) {
+  auto type = from.get_value_type();
+  if (type != JsonValue::Type::Object) {
+    if (type == JsonValue::Type::Null) {
+      to = nullptr;
+      return from.skip_value();
+    }
+    return Status::Error(PSLICE() << "Expected Object, but receive " << type);
+  }
+
+  TRY_RESULT(constructor_value, from.get_object_type());
+  int32 constructor = 0;
+  if (constructor_value.type() == JsonValue::Type::Number) {
+    constructor = to_integer<int32>(constructor_value.get_number());
+  } else if (constructor_value.type() == JsonValue::Type::String) {
+    TRY_RESULT_ASSIGN(constructor, tl_constructor_from_string(to.get(), constructor_value.get_string().str()));
+  } else {
+    return Status::Error(PSLICE() << "Expected String or Integer, but receive " << constructor_value.type());
+  }
+
+  TlDowncastHelper<T> helper(constructor);
+  Status status;
+  bool ok = downcast_call(static_cast<T &>(helper), [&](auto &dummy) {
+    auto result = make_tl_object<std::decay_t<decltype(dummy)>>();
+    status = from_json(*result, from);
+    to = std::move(result);
+  });
+  TRY_STATUS(std::move(status));
+  if (!ok) {
+    return Status::Error(PSLICE() << "Unknown constructor " << format::as_hex(constructor));
+  }
+
+  return Status::OK();
+}
+
+template <class T>
+std::enable_if_t<std::is_constructible<T>::value, Status> from_json(tl_object_ptr<T> &to, TlJsonParser &from) {
+  auto type = from.get_value_type();
+  if (type != JsonValue::Type::Object) {
+    if (type == JsonValue::Type::Null) {
+      to = nullptr;
+      return from.skip_value();
+    }
+    return Status::Error(PSLICE() << "Expected Object, but receive " << type);
+  }
+  to = make_tl_object<T>();
+  return from_json(*to, from);
+}
+
 }  // namespace td
@@ -62,6 +62,34 @@ ConcurrentScheduler::ConcurrentScheduler(int32 additional_thread_count, uint64 t
   state_ = State::Start;
 }
 
+void ConcurrentScheduler::enable_work_stealing() {
+  CHECK(state_ == State::Start);
+#if !TD_THREAD_UNSUPPORTED && !TD_EVENTFD_UNSUPPORTED
+  work_stealing_state_ = std::make_shared<Scheduler::WorkStealingState>();
+  for (size_t i = 0; i + extra_scheduler_ < schedulers_.size(); i++) {
+    schedulers_[i]->enable_work_stealing(work_stealing_state_);
+  }
+#endif
+}
+
+uint64 ConcurrentScheduler::get_stolen_actor_count() const {
+  if (work_stealing_state_ == nullptr) {
+    return 0;
+  }
+  return work_stealing_state_->stolen_actor_count.load(std::memory_order_relaxed);
+}
+
+void ConcurrentScheduler::set_thread_affinity_mask(int32 sched_id, uint64 thread_affinity_mask) {
+  CHECK(state_ == State::Start);
+  CHECK(0 < sched_id && sched_id < static_cast<int32>(schedulers_.size()));
+#if !TD_THREAD_UNSUPPORTED && !TD_EVENTFD_UNSUPPORTED
+  if (scheduler_thread_affinity_masks_.empty()) {
+    scheduler_thread_affinity_masks_.resize(schedulers_.size());
+  }
+  scheduler_thread_affinity_masks_[sched_id] = thread_affinity_mask;
+#endif
+}
+
 void ConcurrentScheduler::test_one_thread_run() {
   do {
     for (auto &sched : schedulers_) {
@@ -84,7 +112,11 @@ void ConcurrentScheduler::start() {
 #if !TD_THREAD_UNSUPPORTED && !TD_EVENTFD_UNSUPPORTED
   for (size_t i = 1; i + extra_scheduler_ < schedulers_.size(); i++) {
     auto &sched = schedulers_[i];
-    threads_.push_back(td::thread([&, thread_affinity_mask = thread_affinity_mask_] {
+    auto thread_affinity_mask = thread_affinity_mask_;
+    if (i < scheduler_thread_affinity_masks_.size() && scheduler_thread_affinity_masks_[i] != 0) {
+      thread_affinity_mask = scheduler_thread_affinity_masks_[i];
+    }
+    threads_.push_back(td::thread([&, thread_affinity_mask] {
 #if TD_PORT_WINDOWS
       detail::Iocp::Guard iocp_guard(iocp_.get());
 #endif
@@ -19,6 +19,7 @@
 
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <utility>
 
@@ -44,6 +45,16 @@ class ConcurrentScheduler final : private Scheduler::Callback {
     return schedulers_.back()->get_const_guard();
   }
 
+  // allows idle schedulers to take over ready actors with ActorTraits::is_stealable from busy ones
+  // must be called before start()
+  void enable_work_stealing();
+
+  uint64 get_stolen_actor_count() const;
+
+  // overrides thread affinity mask for the thread of the scheduler; must be called before start()
+  // the main scheduler is run by the caller of run_main, so the mask can't be set for it
+  void set_thread_affinity_mask(int32 sched_id, uint64 thread_affinity_mask);
+
   void test_one_thread_run();
 
   bool is_finished() const {
@@ -98,9 +109,11 @@ class ConcurrentScheduler final : private Scheduler::Callback {
   vector<std::function<void()>> at_finish_;  // can be used during destruction by Scheduler destructors
   vector<unique_ptr<Scheduler>> schedulers_;
   std::atomic<bool> is_finished_{false};
+  std::shared_ptr<Scheduler::WorkStealingState> work_stealing_state_;
 #if !TD_THREAD_UNSUPPORTED && !TD_EVENTFD_UNSUPPORTED
   vector<td::thread> threads_;
   uint64 thread_affinity_mask_ = 0;
+  vector<uint64> scheduler_thread_affinity_masks_;
 #endif
 #if TD_PORT_WINDOWS
   unique_ptr<detail::Iocp> iocp_;
@@ -97,6 +97,7 @@ class ActorTraits<MultiPromiseActor> {
  public:
   static constexpr bool need_context = false;
   static constexpr bool need_start_up = true;
+  static constexpr bool is_stealable = false;
 };
 
 class MultiPromiseActorSafe final : public MultiPromiseInterface {
@@ -86,6 +86,7 @@ class ActorTraits<FutureActor<T>> {
  public:
   static constexpr bool need_context = false;
   static constexpr bool need_start_up = false;
+  static constexpr bool is_stealable = false;
 };
 
 template <class T>
@@ -36,6 +36,7 @@ class ActorTraits<SleepActor> {
  public:
   static constexpr bool need_context = false;
   static constexpr bool need_start_up = true;
+  static constexpr bool is_stealable = false;
 };
 
 }  // namespace td
@@ -116,6 +116,8 @@ class ActorTraits {
  public:
   static constexpr bool need_context = true;
   static constexpr bool need_start_up = true;
+  // actor doesn't own file descriptors and timeouts and can be moved to an idle scheduler in work-stealing mode
+  static constexpr bool is_stealable = false;
 };
 
 }  // namespace td
@@ -63,7 +63,7 @@ class ActorInfo final
   ActorInfo &operator=(const ActorInfo &) = delete;
 
   void init(int32 sched_id, Slice name, ObjectPool<ActorInfo>::OwnerPtr &&this_ptr, Actor *actor_ptr, Deleter deleter,
-            bool need_context, bool need_start_up);
+            bool need_context, bool need_start_up, bool is_stealable);
   void on_actor_moved(Actor *actor_new_ptr);
 
   template <class ActorT>
@@ -107,11 +107,13 @@ class ActorInfo final
 
   bool need_context() const;
   bool need_start_up() const;
+  bool is_stealable() const;
 
  private:
   Deleter deleter_ = Deleter::None;
   bool need_context_ = true;
   bool need_start_up_ = true;
+  bool is_stealable_ = false;
   bool is_running_ = false;
 
   std::atomic<int32> sched_id_{0};
@@ -31,7 +31,7 @@ inline StringBuilder &operator<<(StringBuilder &sb, const ActorInfo &info) {
 }
 
 inline void ActorInfo::init(int32 sched_id, Slice name, ObjectPool<ActorInfo>::OwnerPtr &&this_ptr, Actor *actor_ptr,
-                            Deleter deleter, bool need_context, bool need_start_up) {
+                            Deleter deleter, bool need_context, bool need_start_up, bool is_stealable) {
   CHECK(!is_running());
   CHECK(!is_migrating());
   sched_id_.store(sched_id, std::memory_order_relaxed);
@@ -49,6 +49,7 @@ inline void ActorInfo::init(int32 sched_id, Slice name, ObjectPool<ActorInfo>::O
   deleter_ = deleter;
   need_context_ = need_context;
   need_start_up_ = need_start_up;
+  is_stealable_ = is_stealable;
   is_running_ = false;
 }
 
@@ -60,6 +61,10 @@ inline bool ActorInfo::need_start_up() const {
   return need_start_up_;
 }
 
+inline bool ActorInfo::is_stealable() const {
+  return is_stealable_;
+}
+
 inline void ActorInfo::on_actor_moved(Actor *actor_new_ptr) {
   actor_ = actor_new_ptr;
 }
@@ -28,6 +28,7 @@
 #include "td/utils/Time.h"
 #include "td/utils/type_traits.h"
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <type_traits>
@@ -69,6 +70,12 @@ class Scheduler {
     virtual void on_finish() = 0;
     virtual void register_at_finish(std::function<void()>) = 0;
   };
+  // state shared between schedulers, which exchange stealable actors
+  struct WorkStealingState {
+    std::atomic<uint64> idle_scheduler_mask{0};
+    std::atomic<uint64> stolen_actor_count{0};
+  };
+
   Scheduler() = default;
   Scheduler(const Scheduler &) = delete;
   Scheduler &operator=(const Scheduler &) = delete;
@@ -78,6 +85,8 @@ class Scheduler {
 
   void init(int32 id, std::vector<std::shared_ptr<MpscPollableQueue<EventFull>>> outbound, Callback *callback);
 
+  void enable_work_stealing(std::shared_ptr<WorkStealingState> state);
+
   int32 sched_id() const;
   int32 sched_count() const;
 
@@ -212,6 +221,9 @@ class Scheduler {
 
   void send_later_impl(const ActorId<> &actor_id, Event &&event);
 
+  void set_idle(bool is_idle);
+  void share_ready_actors(ListNode &actors_list);
+
   Timestamp run_timeout();
   void run_mailbox();
   Timestamp run_events(Timestamp timeout);
@@ -248,6 +260,9 @@ class Scheduler {
 
   std::shared_ptr<ActorContext> save_context_;
 
+  std::shared_ptr<WorkStealingState> work_stealing_state_;
+  uint64 work_stealing_bit_ = 0;
+
   struct EventContext {
     int32 dest_sched_id{0};
     enum Flags { Stop = 1, Migrate = 2 };
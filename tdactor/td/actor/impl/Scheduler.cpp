@@ -233,6 +233,13 @@ void Scheduler::init(int32 id, std::vector<std::shared_ptr<MpscPollableQueue<Eve
   register_actor(PSLICE() << "ServiceActor" << id, &service_actor_).release();
 }
 
+void Scheduler::enable_work_stealing(std::shared_ptr<WorkStealingState> state) {
+  CHECK(state != nullptr);
+  work_stealing_state_ = std::move(state);
+  // idle state is tracked in a bit mask, so only first 64 schedulers can steal actors
+  work_stealing_bit_ = sched_id_ < 64 ? static_cast<uint64>(1) << sched_id_ : 0;
+}
+
 void Scheduler::clear() {
   if (service_actor_.empty()) {
     return;
@@ -244,6 +251,19 @@ void Scheduler::clear() {
   if (!service_actor_.empty()) {
     service_actor_.do_stop();
   }
+#if !TD_THREAD_UNSUPPORTED && !TD_EVENTFD_UNSUPPORTED
+  if (inbound_queue_) {
+    // actors, which were migrated to the scheduler, but weren't registered yet, must be stopped too
+    int ready_n = inbound_queue_->reader_wait_nonblock();
+    while (ready_n-- > 0) {
+      EventFull event = inbound_queue_->reader_get_unsafe();
+      if (event.actor_id().empty() && !event.data().empty()) {
+        register_migrated_actor(static_cast<ActorInfo *>(event.data().data.ptr));
+      }
+    }
+    inbound_queue_->reader_flush();
+  }
+#endif
   while (!pending_actors_list_.empty()) {
     auto actor_info = ActorInfo::from_list_node(pending_actors_list_.get());
     do_stop_actor(actor_info);
@@ -533,9 +553,66 @@ void Scheduler::flush_mailbox(ActorInfo *actor_info) {
   mailbox.erase(mailbox.begin(), mailbox.begin() + i);
 }
 
+void Scheduler::set_idle(bool is_idle) {
+  if (work_stealing_bit_ == 0) {
+    return;
+  }
+  auto &idle_scheduler_mask = work_stealing_state_->idle_scheduler_mask;
+  if (is_idle) {
+    idle_scheduler_mask.fetch_or(work_stealing_bit_, std::memory_order_relaxed);
+  } else if ((idle_scheduler_mask.load(std::memory_order_relaxed) & work_stealing_bit_) != 0) {
+    idle_scheduler_mask.fetch_and(~work_stealing_bit_, std::memory_order_relaxed);
+  }
+}
+
+void Scheduler::share_ready_actors(ListNode &actors_list) {
+  auto &idle_scheduler_mask = work_stealing_state_->idle_scheduler_mask;
+  auto other_idle_mask = idle_scheduler_mask.load(std::memory_order_relaxed) & ~work_stealing_bit_;
+  if (other_idle_mask == 0) {
+    return;
+  }
+
+  // actors are run starting from the list end, so the last actor is always kept
+  vector<ActorInfo *> actor_infos;
+  for (ListNode *it = actors_list.begin(); it != actors_list.end() && it != actors_list.get_prev();
+       it = it->get_next()) {
+    auto actor_info = ActorInfo::from_list_node(it);
+    if (actor_info->is_stealable() && !actor_info->is_running() && !actor_info->get_heap_node()->in_heap()) {
+      actor_infos.push_back(actor_info);
+    }
+  }
+  if (actor_infos.size() < 2) {
+    return;
+  }
+
+  // an idle scheduler is claimed by clearing its bit, so it isn't flooded by several busy schedulers simultaneously
+  vector<int32> dest_sched_ids;
+  for (int32 sched_id = 0; sched_id < sched_n_ && sched_id < 64 && dest_sched_ids.size() < actor_infos.size() / 2;
+       sched_id++) {
+    auto bit = static_cast<uint64>(1) << sched_id;
+    if ((other_idle_mask & bit) != 0 && (idle_scheduler_mask.fetch_and(~bit, std::memory_order_relaxed) & bit) != 0) {
+      dest_sched_ids.push_back(sched_id);
+    }
+  }
+  if (dest_sched_ids.empty()) {
+    return;
+  }
+
+  // keep a fair share of the actors on the current scheduler
+  auto shared_count = actor_infos.size() * dest_sched_ids.size() / (dest_sched_ids.size() + 1);
+  VLOG(actor) << "Share " << shared_count << " ready actors with " << dest_sched_ids.size() << " idle schedulers";
+  for (size_t i = 0; i < shared_count; i++) {
+    do_migrate_actor(actor_infos[i], dest_sched_ids[i % dest_sched_ids.size()]);
+  }
+  work_stealing_state_->stolen_actor_count.fetch_add(shared_count, std::memory_order_relaxed);
+}
+
 void Scheduler::run_mailbox() {
   VLOG(actor) << "Run mailbox : begin";
   ListNode actors_list = std::move(ready_actors_list_);
+  if (work_stealing_state_ != nullptr) {
+    share_ready_actors(actors_list);
+  }
   while (!actors_list.empty()) {
     ListNode *node = actors_list.get();
     CHECK(node);
@@ -594,7 +671,14 @@ void Scheduler::run_no_guard(Timestamp timeout) {
   if (yield_flag_) {
     return;
   }
+  bool is_idle = ready_actors_list_.empty();
+  if (is_idle) {
+    set_idle(true);
+  }
   run_poll(timeout);
+  if (is_idle) {
+    set_idle(false);
+  }
   run_events(timeout);
 }
 
@@ -103,7 +103,8 @@ ActorOwn<ActorT> Scheduler::register_actor_impl(Slice name, ActorT *actor_ptr, A
   auto weak_info = info.get_weak();
   auto actor_info = info.get();
   actor_info->init(sched_id_, name, std::move(info), static_cast<Actor *>(actor_ptr), deleter,
-                   ActorTraits<ActorT>::need_context, ActorTraits<ActorT>::need_start_up);
+                   ActorTraits<ActorT>::need_context, ActorTraits<ActorT>::need_start_up,
+                   ActorTraits<ActorT>::is_stealable);
   VLOG(actor) << "Create actor " << *actor_info << " (actor_count = " << actor_count_ << ')';
 
   ActorId<ActorT> actor_id = weak_info->actor_id(actor_ptr);
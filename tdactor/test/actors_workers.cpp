@@ -12,6 +12,8 @@
 #include "td/utils/tests.h"
 #include "td/utils/Time.h"
 
+#include <atomic>
+
 class PowerWorker final : public td::Actor {
  public:
   class Callback {
@@ -186,3 +188,78 @@ TEST(Actors, send_closure_while_finish) {
   }
   sched.finish();
 }
+
+class StealingManager;
+
+class StealableWorker final : public td::Actor {
+ public:
+  StealableWorker(td::ActorId<StealingManager> manager, std::atomic<bool> *stop_flag)
+      : manager_(manager), stop_flag_(stop_flag) {
+  }
+
+ private:
+  td::ActorId<StealingManager> manager_;
+  std::atomic<bool> *stop_flag_;
+
+  void loop() final;
+};
+
+namespace td {
+template <>
+class ActorTraits<StealableWorker> {
+ public:
+  static constexpr bool need_context = true;
+  static constexpr bool need_start_up = true;
+  static constexpr bool is_stealable = true;
+};
+}  // namespace td
+
+class StealingManager final : public td::Actor {
+ public:
+  explicit StealingManager(int workers_n) : left_workers_n_(workers_n) {
+  }
+
+  void on_worker_finished() {
+    if (--left_workers_n_ == 0) {
+      td::Scheduler::instance()->finish();
+      stop();
+    }
+  }
+
+ private:
+  int left_workers_n_;
+};
+
+void StealableWorker::loop() {
+  if (stop_flag_->load(std::memory_order_relaxed)) {
+    td::send_closure(manager_, &StealingManager::on_worker_finished);
+    stop();
+    return;
+  }
+  yield();
+}
+
+TEST(Actors, work_stealing) {
+  int threads_n = 3;
+  int workers_n = 20;
+  td::ConcurrentScheduler sched(threads_n, 0);
+  sched.enable_work_stealing();
+
+  std::atomic<bool> stop_flag{false};
+  auto manager = sched.create_actor_unsafe<StealingManager>(0, "StealingManager", workers_n).release();
+  for (int i = 0; i < workers_n; i++) {
+    sched.create_actor_unsafe<StealableWorker>(1, PSLICE() << "worker" << i, manager, &stop_flag).release();
+  }
+
+  sched.start();
+  auto end_time = td::Time::now() + 10;
+  while (sched.get_stolen_actor_count() == 0 && td::Time::now() < end_time) {
+    sched.run_main(0.01);
+  }
+  stop_flag = true;
+  while (sched.run_main(10)) {
+    // empty
+  }
+  sched.finish();
+  ASSERT_TRUE(sched.get_stolen_actor_count() > 0);
+}
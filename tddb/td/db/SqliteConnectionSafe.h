@@ -23,6 +23,7 @@ class SqliteConnectionSafe {
   SqliteConnectionSafe() = default;
   SqliteConnectionSafe(string path, DbKey key, optional<int32> cipher_version = {});
 
+  // returns connection of the current scheduler; the connection is opened on first use
   SqliteDb &get();
   void set(SqliteDb &&db);
 
@@ -0,0 +1,93 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include "td/actor/actor.h"
+#include "td/actor/MultiPromise.h"
+
+#include "td/utils/common.h"
+#include "td/utils/Promise.h"
+#include "td/utils/Status.h"
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace td {
+
+// Runs read-only queries to a database on several schedulers in parallel.
+// SqliteConnectionSafe opens a separate connection for every scheduler, so with WAL journal the readers
+// don't block each other and the writer. A query must be sent to the pool only after all preceding writes
+// are committed; the queries are distributed among the readers in a round-robin manner.
+template <class SyncSafeT>
+class SqliteReaderPool {
+  using SyncT = std::remove_reference_t<decltype(std::declval<SyncSafeT &>().get())>;
+
+  class Reader final : public Actor {
+   public:
+    explicit Reader(std::shared_ptr<SyncSafeT> sync_db_safe) : sync_db_safe_(std::move(sync_db_safe)) {
+    }
+
+    void run(Promise<SyncT *> query) {
+      CHECK(sync_db_safe_ != nullptr);
+      query.set_value(&sync_db_safe_->get());
+    }
+
+    void close(Promise<Unit> promise) {
+      sync_db_safe_.reset();
+      promise.set_value(Unit());
+      stop();
+    }
+
+   private:
+    std::shared_ptr<SyncSafeT> sync_db_safe_;
+  };
+
+ public:
+  SqliteReaderPool() = default;
+
+  SqliteReaderPool(const std::shared_ptr<SyncSafeT> &sync_db_safe, const vector<int32> &scheduler_ids) {
+    for (auto scheduler_id : scheduler_ids) {
+      readers_.push_back(create_actor_on_scheduler<Reader>("SqliteReader", scheduler_id, sync_db_safe));
+    }
+  }
+
+  bool empty() const {
+    return readers_.empty();
+  }
+
+  // f is called with SyncT & on a reader scheduler
+  template <class F>
+  void run(F &&f) {
+    CHECK(!readers_.empty());
+    auto query = PromiseCreator::lambda([f = std::forward<F>(f)](Result<SyncT *> r_sync_db) mutable {
+      if (r_sync_db.is_ok()) {
+        f(*r_sync_db.ok());
+      }
+    });
+    send_closure(readers_[next_reader_++ % readers_.size()], &Reader::run, std::move(query));
+  }
+
+  // promise is set after all previously sent queries are finished and the readers have released the database
+  void close(Promise<Unit> promise) {
+    MultiPromiseActorSafe mpas{"SqliteReaderPoolCloseMultiPromiseActor"};
+    mpas.add_promise(std::move(promise));
+    auto lock = mpas.get_promise();
+    for (auto &reader : readers_) {
+      send_closure(reader, &Reader::close, mpas.get_promise());
+      reader.release();
+    }
+    readers_.clear();
+    lock.set_value(Unit());
+  }
+
+ private:
+  vector<ActorOwn<Reader>> readers_;
+  size_t next_reader_ = 0;
+};
+
+}  // namespace td
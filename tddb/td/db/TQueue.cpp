@@ -21,7 +21,8 @@
 #include "td/utils/tl_parsers.h"
 #include "td/utils/tl_storers.h"
 
-#include <set>
+#include <algorithm>
+#include <map>
 
 namespace td {
 
@@ -82,6 +83,201 @@ bool EventId::is_valid_id(int32 id) {
   return 0 <= id && id < MAX_ID;
 }
 
+// events of a queue ordered by their identifiers; identifiers only grow, so the events are stored contiguously
+// and a removed event is only marked as removed, unless it is the first or the last one
+class TQueueEventList {
+  using EventId = TQueue::EventId;
+  using RawEvent = TQueue::RawEvent;
+
+ public:
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  // positions are invalidated only by erase and pop_front, which return or preserve position of the next event
+  size_t begin() const {
+    return begin_;
+  }
+
+  size_t end() const {
+    return events_.size();
+  }
+
+  size_t next(size_t pos) const {
+    do {
+      pos++;
+    } while (pos < events_.size() && is_removed(events_[pos]));
+    return pos;
+  }
+
+  size_t prev(size_t pos) const {
+    do {
+      CHECK(pos > begin_);
+      pos--;
+    } while (is_removed(events_[pos]));
+    return pos;
+  }
+
+  RawEvent &operator[](size_t pos) {
+    return events_[pos];
+  }
+
+  const RawEvent &front() const {
+    CHECK(!empty());
+    return events_[begin_];
+  }
+
+  RawEvent &front() {
+    CHECK(!empty());
+    return events_[begin_];
+  }
+
+  const RawEvent &back() const {
+    CHECK(!empty());
+    return events_.back();
+  }
+
+  RawEvent &back() {
+    CHECK(!empty());
+    return events_.back();
+  }
+
+  size_t lower_bound(EventId event_id) const {
+    if (empty() || !(front().event_id < event_id)) {
+      return begin_;
+    }
+    if (removed_count_ == 0) {
+      // identifiers are usually consecutive
+      auto offset = static_cast<size_t>(event_id.value() - front().event_id.value());
+      if (offset < size_ && events_[begin_ + offset].event_id == event_id) {
+        return begin_ + offset;
+      }
+    }
+    auto it = std::lower_bound(events_.begin() + begin_, events_.end(), event_id,
+                               [](const RawEvent &event, EventId event_id) { return event.event_id < event_id; });
+    auto pos = static_cast<size_t>(it - events_.begin());
+    if (pos < events_.size() && is_removed(events_[pos])) {
+      pos = next(pos);
+    }
+    return pos;
+  }
+
+  size_t find(EventId event_id) const {
+    auto pos = lower_bound(event_id);
+    if (pos == events_.size() || events_[pos].event_id != event_id) {
+      return events_.size();
+    }
+    return pos;
+  }
+
+  void push_back(RawEvent &&event) {
+    CHECK(empty() || back().event_id < event.event_id);
+    events_.push_back(std::move(event));
+    size_++;
+  }
+
+  void pop_front() {
+    erase(begin_);
+  }
+
+  void pop_back() {
+    erase(events_.size() - 1);
+  }
+
+  // returns position of the next event
+  size_t erase(size_t pos) {
+    CHECK(begin_ <= pos && pos < events_.size());
+    CHECK(!is_removed(events_[pos]));
+    size_--;
+    if (size_ == 0) {
+      clear();
+      return events_.size();
+    }
+
+    if (pos + 1 == events_.size()) {
+      events_.pop_back();
+      while (is_removed(events_.back())) {
+        events_.pop_back();
+        removed_count_--;
+      }
+      return events_.size();
+    }
+
+    // keep event_id to preserve the order
+    auto &event = events_[pos];
+    event.log_event_id = 0;
+    event.expires_at = 0;
+    event.data = string();
+    if (pos == begin_) {
+      begin_ = next(begin_);
+      removed_count_ -= begin_ - pos - 1;
+      return compact(begin_);
+    }
+    removed_count_++;
+    return compact(next(pos));
+  }
+
+ private:
+  vector<RawEvent> events_;
+  size_t begin_ = 0;
+  size_t size_ = 0;
+  size_t removed_count_ = 0;
+
+  // stored events always have positive expires_at
+  static bool is_removed(const RawEvent &event) {
+    return event.expires_at == 0;
+  }
+
+  void clear() {
+    if (events_.capacity() > MAX_UNUSED_CAPACITY) {
+      events_ = vector<RawEvent>();
+    } else {
+      events_.clear();
+    }
+    begin_ = 0;
+    removed_count_ = 0;
+  }
+
+  // removes unused space if it takes more than half of the storage; returns new value of the position
+  size_t compact(size_t pos) {
+    auto unused_count = begin_ + removed_count_;
+    if (unused_count < MAX_UNUSED_CAPACITY || unused_count < size_) {
+      return pos;
+    }
+
+    size_t new_pos = 0;
+    size_t to = 0;
+    for (size_t from = begin_; from < events_.size(); from++) {
+      if (from == pos) {
+        new_pos = to;
+      }
+      if (!is_removed(events_[from])) {
+        if (to != from) {
+          events_[to] = std::move(events_[from]);
+        }
+        to++;
+      }
+    }
+    if (pos == events_.size()) {
+      new_pos = to;
+    }
+    CHECK(to == size_);
+    events_.erase(events_.begin() + to, events_.end());
+    if (events_.capacity() > 2 * size_ + MAX_UNUSED_CAPACITY) {
+      events_.shrink_to_fit();
+    }
+    begin_ = 0;
+    removed_count_ = 0;
+    return new_pos;
+  }
+
+  static constexpr size_t MAX_UNUSED_CAPACITY = 16;
+};
+
 class TQueueImpl final : public TQueue {
   static constexpr size_t MAX_EVENT_LENGTH = 65536 * 8;
   static constexpr size_t MAX_QUEUE_EVENTS = 100000;
@@ -112,25 +308,29 @@ class TQueueImpl final : public TQueue {
     }
 
     if (!q.events.empty()) {
-      auto it = q.events.end();
-      --it;
-      if (it->second.data.empty()) {
-        if (callback_ != nullptr && it->second.log_event_id != 0) {
-          callback_->pop(it->second.log_event_id);
+      auto &last_event = q.events.back();
+      if (last_event.data.empty()) {
+        if (callback_ != nullptr && last_event.log_event_id != 0) {
+          callback_->pop(last_event.log_event_id);
         }
-        q.events.erase(it);
+        q.events.pop_back();
+        event_count_--;
       }
     }
-    if (q.events.empty() && !raw_event.data.empty()) {
-      schedule_queue_gc(queue_id, q, raw_event.expires_at);
-    }
 
     if (raw_event.log_event_id == 0 && callback_ != nullptr) {
       raw_event.log_event_id = callback_->push(queue_id, raw_event);
     }
+    if (!raw_event.data.empty()) {
+      add_to_gc_index(queue_id, raw_event);
+    }
     q.tail_id = event_id.next().move_as_ok();
     q.total_event_length += raw_event.data.size();
-    q.events.emplace(event_id, std::move(raw_event));
+    q.events.push_back(std::move(raw_event));
+    event_count_++;
+    if (gc_index_size_ > 2 * event_count_ + MIN_GC_INDEX_REBUILD_SIZE) {
+      rebuild_gc_index();
+    }
     return true;
   }
 
@@ -171,8 +371,8 @@ class TQueueImpl final : public TQueue {
       if (event_id.next().is_ok()) {
         break;
       }
-      for (auto it = q.events.begin(); it != q.events.end();) {
-        pop(q, queue_id, it, {});
+      for (auto pos = q.events.begin(); pos != q.events.end();) {
+        pop(q, queue_id, pos, {});
       }
       q.tail_id = EventId();
       CHECK(hint_new_id.next().is_ok());
@@ -211,11 +411,11 @@ class TQueueImpl final : public TQueue {
       return;
     }
     auto &q = q_it->second;
-    auto it = q.events.find(event_id);
-    if (it == q.events.end()) {
+    auto pos = q.events.find(event_id);
+    if (pos == q.events.end()) {
       return;
     }
-    pop(q, queue_id, it, q.tail_id);
+    pop(q, queue_id, pos, q.tail_id);
   }
 
   std::map<EventId, RawEvent> clear(QueueId queue_id, size_t keep_count) final {
@@ -232,15 +432,15 @@ class TQueueImpl final : public TQueue {
     auto start_time = Time::now();
     auto total_event_length = q.total_event_length;
 
-    auto end_it = q.events.end();
+    auto end_pos = q.events.end();
     for (size_t i = 0; i < keep_count; i++) {
-      --end_it;
+      end_pos = q.events.prev(end_pos);
     }
     if (keep_count == 0) {
-      --end_it;
-      auto &event = end_it->second;
+      end_pos = q.events.prev(end_pos);
+      auto &event = q.events[end_pos];
       if (callback_ == nullptr || event.log_event_id == 0) {
-        ++end_it;
+        end_pos = q.events.next(end_pos);
       } else if (!event.data.empty()) {
         clear_event_data(q, event);
         callback_->push(queue_id, event);
@@ -251,8 +451,8 @@ class TQueueImpl final : public TQueue {
     if (callback_ != nullptr) {
       vector<uint64> deleted_log_event_ids;
       deleted_log_event_ids.reserve(size - keep_count);
-      for (auto it = q.events.begin(); it != end_it; ++it) {
-        auto &event = it->second;
+      for (auto pos = q.events.begin(); pos != end_pos; pos = q.events.next(pos)) {
+        auto &event = q.events[pos];
         if (event.log_event_id != 0) {
           deleted_log_event_ids.push_back(event.log_event_id);
         }
@@ -263,22 +463,13 @@ class TQueueImpl final : public TQueue {
     auto callback_clear_time = Time::now() - start_time;
 
     std::map<EventId, RawEvent> deleted_events;
-    if (keep_count > size / 2) {
-      for (auto it = q.events.begin(); it != end_it;) {
-        q.total_event_length -= it->second.data.size();
-        bool is_inserted = deleted_events.emplace(it->first, std::move(it->second)).second;
-        CHECK(is_inserted);
-        it = q.events.erase(it);
-      }
-    } else {
-      q.total_event_length = 0;
-      for (auto it = end_it; it != q.events.end();) {
-        q.total_event_length += it->second.data.size();
-        bool is_inserted = deleted_events.emplace(it->first, std::move(it->second)).second;
-        CHECK(is_inserted);
-        it = q.events.erase(it);
-      }
-      std::swap(deleted_events, q.events);
+    auto end_event_id = end_pos == q.events.end() ? EventId() : q.events[end_pos].event_id;
+    while (!q.events.empty() && (end_event_id.empty() || q.events.front().event_id < end_event_id)) {
+      auto &event = q.events.front();
+      q.total_event_length -= event.data.size();
+      deleted_events.emplace_hint(deleted_events.end(), event.event_id, std::move(event));
+      q.events.pop_front();
+      event_count_--;
     }
 
     auto clear_time = Time::now() - start_time;
@@ -313,49 +504,64 @@ class TQueueImpl final : public TQueue {
   }
 
   std::pair<int64, bool> run_gc(int32 unix_time_now) final {
-    int64 deleted_events = 0;
+    int64 deleted_event_count = 0;
+    int64 deleted_data_size = 0;
+    vector<uint64> deleted_log_event_ids;
     auto max_finish_time = Time::now() + 0.05;
     int64 counter = 0;
-    while (!queue_gc_at_.empty()) {
-      auto it = queue_gc_at_.begin();
-      if (it->first >= unix_time_now) {
-        break;
-      }
-      auto queue_id = it->second;
-      auto &q = queues_[queue_id];
-      CHECK(q.gc_at == it->first);
-      int32 new_gc_at = 0;
-
-      if (!q.events.empty()) {
-        size_t size_before = get_size(q);
-        for (auto event_it = q.events.begin(); event_it != q.events.end();) {
-          auto &event = event_it->second;
-          if ((++counter & 128) == 0 && Time::now() >= max_finish_time) {
-            if (new_gc_at == 0) {
-              new_gc_at = event.expires_at;
-            }
-            break;
-          }
-          if (event.expires_at < unix_time_now || event.data.empty()) {
-            pop(q, queue_id, event_it, q.tail_id);
-          } else {
-            if (new_gc_at != 0) {
-              break;
-            }
-            new_gc_at = event.expires_at;
-            ++event_it;
-          }
+    bool is_finished = true;
+    while (!gc_index_.empty() && gc_index_.begin()->first < unix_time_now) {
+      auto &entries = gc_index_.begin()->second;
+      while (!entries.empty()) {
+        if ((++counter & 127) == 0 && Time::now() >= max_finish_time) {
+          is_finished = false;
+          break;
         }
-        size_t size_after = get_size(q);
-        CHECK(size_after <= size_before);
-        deleted_events += size_before - size_after;
+        auto entry = entries.back();
+        entries.pop_back();
+        gc_index_size_--;
+
+        // the entry is stale if the event was already deleted
+        auto queue_it = queues_.find(entry.queue_id);
+        if (queue_it == queues_.end()) {
+          continue;
+        }
+        auto &q = queue_it->second;
+        auto pos = q.events.find(entry.event_id);
+        if (pos == q.events.end()) {
+          continue;
+        }
+        auto &event = q.events[pos];
+        if (event.expires_at >= unix_time_now || event.data.empty()) {
+          continue;
+        }
+
+        deleted_event_count++;
+        deleted_data_size += static_cast<int64>(event.data.size());
+        if (callback_ == nullptr || event.log_event_id == 0) {
+          remove_event(q, pos);
+        } else if (event.event_id.next().ok() == q.tail_id) {
+          // the last event is kept to store tail_id
+          clear_event_data(q, event);
+          callback_->push(entry.queue_id, event);
+        } else {
+          deleted_log_event_ids.push_back(event.log_event_id);
+          remove_event(q, pos);
+        }
+      }
+      if (!is_finished) {
+        break;
       }
-      schedule_queue_gc(queue_id, q, new_gc_at);
-      if (Time::now() >= max_finish_time) {
-        return {deleted_events, false};
+      gc_index_.erase(gc_index_.begin());
+    }
+
+    if (callback_ != nullptr && deleted_event_count > 0) {
+      if (!deleted_log_event_ids.empty()) {
+        callback_->pop_batch(std::move(deleted_log_event_ids));
       }
+      callback_->on_gc(deleted_event_count, deleted_data_size);
     }
-    return {deleted_events, true};
+    return {deleted_event_count, is_finished};
   }
 
   size_t get_size(QueueId queue_id) const final {
@@ -376,20 +582,28 @@ class TQueueImpl final : public TQueue {
  private:
   struct Queue {
     EventId tail_id;
-    std::map<EventId, RawEvent> events;
+    TQueueEventList events;
     size_t total_event_length = 0;
-    int32 gc_at = 0;
   };
 
+  // events with data in the order of their expiration; entries of deleted events are removed lazily
+  struct GcEntry {
+    QueueId queue_id;
+    EventId event_id;
+  };
+  static constexpr size_t MIN_GC_INDEX_REBUILD_SIZE = 1000;
+
   FlatHashMap<QueueId, Queue> queues_;
-  std::set<std::pair<int32, QueueId>> queue_gc_at_;
+  size_t event_count_ = 0;
+  std::map<int32, vector<GcEntry>> gc_index_;
+  size_t gc_index_size_ = 0;
   unique_ptr<StorageCallback> callback_;
 
   static EventId get_queue_head(const Queue &q) {
     if (q.events.empty()) {
       return q.tail_id;
     }
-    return q.events.begin()->first;
+    return q.events.front().event_id;
   }
 
   static size_t get_size(const Queue &q) {
@@ -397,13 +611,13 @@ class TQueueImpl final : public TQueue {
       return 0;
     }
 
-    return q.events.size() - (q.events.rbegin()->second.data.empty() ? 1 : 0);
+    return q.events.size() - (q.events.back().data.empty() ? 1 : 0);
   }
 
-  void pop(Queue &q, QueueId queue_id, std::map<EventId, RawEvent>::iterator &it, EventId tail_id) {
-    auto &event = it->second;
+  void pop(Queue &q, QueueId queue_id, size_t &pos, EventId tail_id) {
+    auto &event = q.events[pos];
     if (callback_ == nullptr || event.log_event_id == 0) {
-      remove_event(q, it);
+      remove_event(q, pos);
       return;
     }
 
@@ -412,16 +626,17 @@ class TQueueImpl final : public TQueue {
         clear_event_data(q, event);
         callback_->push(queue_id, event);
       }
-      ++it;
+      pos = q.events.next(pos);
     } else {
       callback_->pop(event.log_event_id);
-      remove_event(q, it);
+      remove_event(q, pos);
     }
   }
 
-  static void remove_event(Queue &q, std::map<EventId, RawEvent>::iterator &it) {
-    q.total_event_length -= it->second.data.size();
-    it = q.events.erase(it);
+  void remove_event(Queue &q, size_t &pos) {
+    q.total_event_length -= q.events[pos].data.size();
+    pos = q.events.erase(pos);
+    event_count_--;
   }
 
   static void clear_event_data(Queue &q, RawEvent &event) {
@@ -432,16 +647,16 @@ class TQueueImpl final : public TQueue {
   void do_get(QueueId queue_id, Queue &q, EventId from_id, bool forget_previous, int32 unix_time_now,
               MutableSpan<Event> &result_events) {
     if (forget_previous) {
-      for (auto it = q.events.begin(); it != q.events.end() && it->first < from_id;) {
-        pop(q, queue_id, it, q.tail_id);
+      for (auto pos = q.events.begin(); pos != q.events.end() && q.events[pos].event_id < from_id;) {
+        pop(q, queue_id, pos, q.tail_id);
       }
     }
 
     size_t ready_n = 0;
-    for (auto it = q.events.lower_bound(from_id); it != q.events.end();) {
-      auto &event = it->second;
+    for (auto pos = q.events.lower_bound(from_id); pos != q.events.end();) {
+      auto &event = q.events[pos];
       if (event.expires_at < unix_time_now || event.data.empty()) {
-        pop(q, queue_id, it, q.tail_id);
+        pop(q, queue_id, pos, q.tail_id);
       } else {
         CHECK(!(event.event_id < from_id));
         if (ready_n == result_events.size()) {
@@ -454,22 +669,30 @@ class TQueueImpl final : public TQueue {
         to.expires_at = event.expires_at;
         to.extra = event.extra;
         ready_n++;
-        ++it;
+        pos = q.events.next(pos);
       }
     }
 
     result_events.truncate(ready_n);
   }
 
-  void schedule_queue_gc(QueueId queue_id, Queue &q, int32 gc_at) {
-    if (q.gc_at != 0) {
-      bool is_deleted = queue_gc_at_.erase({q.gc_at, queue_id}) > 0;
-      CHECK(is_deleted);
-    }
-    q.gc_at = gc_at;
-    if (q.gc_at != 0) {
-      bool is_inserted = queue_gc_at_.emplace(gc_at, queue_id).second;
-      CHECK(is_inserted);
+  void add_to_gc_index(QueueId queue_id, const RawEvent &event) {
+    gc_index_[event.expires_at].push_back(GcEntry{queue_id, event.event_id});
+    gc_index_size_++;
+  }
+
+  // drops entries of deleted events when they become the majority
+  void rebuild_gc_index() {
+    gc_index_.clear();
+    gc_index_size_ = 0;
+    for (auto &it : queues_) {
+      auto &q = it.second;
+      for (auto pos = q.events.begin(); pos != q.events.end(); pos = q.events.next(pos)) {
+        auto &event = q.events[pos];
+        if (!event.data.empty()) {
+          add_to_gc_index(it.first, event);
+        }
+      }
     }
   }
 };
@@ -550,6 +773,14 @@ void TQueueBinlog<BinlogT>::pop_batch(std::vector<uint64> log_event_ids) {
   binlog_->erase_batch(std::move(log_event_ids));
 }
 
+template <class BinlogT>
+void TQueueBinlog<BinlogT>::on_gc(int64 deleted_event_count, int64 deleted_data_size) {
+  gc_deleted_event_count_ += deleted_event_count;
+  gc_deleted_data_size_ += deleted_data_size;
+  LOG(DEBUG) << "Garbage collection deleted " << deleted_event_count << " TQueue events with total size "
+             << deleted_data_size;
+}
+
 template <class BinlogT>
 Status TQueueBinlog<BinlogT>::replay(const BinlogEvent &binlog_event, TQueue &q) const {
   TQueueLogEvent event;
@@ -610,4 +841,7 @@ void TQueue::StorageCallback::pop_batch(std::vector<uint64> log_event_ids) {
     pop(id);
   }
 }
+
+void TQueue::StorageCallback::on_gc(int64 deleted_event_count, int64 deleted_data_size) {
+}
 }  // namespace td
@@ -84,6 +84,9 @@ class TQueue {
     virtual void pop(uint64 log_event_id) = 0;
     virtual void close(Promise<> promise) = 0;
     virtual void pop_batch(std::vector<uint64> log_event_ids);
+
+    // called after run_gc has deleted expired events
+    virtual void on_gc(int64 deleted_event_count, int64 deleted_data_size);
   };
 
   static unique_ptr<TQueue> create();
@@ -130,6 +133,7 @@ class TQueueBinlog final : public TQueue::StorageCallback {
   uint64 push(QueueId queue_id, const RawEvent &event) final;
   void pop(uint64 log_event_id) final;
   void pop_batch(std::vector<uint64> log_event_ids) final;
+  void on_gc(int64 deleted_event_count, int64 deleted_data_size) final;
   Status replay(const BinlogEvent &binlog_event, TQueue &q) const TD_WARN_UNUSED_RESULT;
 
   void set_binlog(std::shared_ptr<BinlogT> binlog) {
@@ -137,8 +141,17 @@ class TQueueBinlog final : public TQueue::StorageCallback {
   }
   void close(Promise<> promise) final;
 
+  int64 get_gc_deleted_event_count() const {
+    return gc_deleted_event_count_;
+  }
+  int64 get_gc_deleted_data_size() const {
+    return gc_deleted_data_size_;
+  }
+
  private:
   std::shared_ptr<BinlogT> binlog_;
+  int64 gc_deleted_event_count_ = 0;
+  int64 gc_deleted_data_size_ = 0;
   static constexpr int32 BINLOG_EVENT_TYPE = 2314;
 };
 
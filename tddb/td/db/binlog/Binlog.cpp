@@ -13,11 +13,13 @@
 #include "td/utils/format.h"
 #include "td/utils/misc.h"
 #include "td/utils/port/Clocks.h"
+#include "td/utils/port/config.h"
 #include "td/utils/port/FileFd.h"
 #include "td/utils/port/path.h"
 #include "td/utils/port/PollFlags.h"
 #include "td/utils/port/sleep.h"
 #include "td/utils/port/Stat.h"
+#include "td/utils/port/thread.h"
 #include "td/utils/Random.h"
 #include "td/utils/ScopeGuard.h"
 #include "td/utils/SliceBuilder.h"
@@ -25,6 +27,11 @@
 #include "td/utils/Time.h"
 #include "td/utils/tl_helpers.h"
 #include "td/utils/tl_parsers.h"
+#include "td/utils/VectorQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 namespace td {
 namespace detail {
@@ -109,6 +116,9 @@ class BinlogReader {
   int64 offset() const {
     return offset_;
   }
+  void set_offset(int64 offset) {
+    offset_ = offset;
+  }
   Result<size_t> read_next(BinlogEvent *event) {
     if (state_ == State::ReadLength) {
       if (input_->size() < 4) {
@@ -158,6 +168,147 @@ class BinlogReader {
   bool is_encrypted_{false};
 };
 
+#if !TD_THREAD_UNSUPPORTED
+// binlogs smaller than this are loaded in the calling thread
+static constexpr int64 PIPELINED_LOAD_MIN_SIZE = 1 << 20;
+static constexpr size_t PIPELINED_LOAD_CHUNK_SIZE = 1 << 18;
+static constexpr size_t PIPELINED_LOAD_MAX_CHUNK_COUNT = 16;
+static constexpr size_t PIPELINED_LOAD_EVENT_BATCH_SIZE = 1024;
+static constexpr size_t PIPELINED_LOAD_MAX_EVENT_BATCH_COUNT = 16;
+
+// bounded blocking queue between stages of pipelined binlog loading
+template <class T>
+class BinlogLoadQueue {
+ public:
+  explicit BinlogLoadQueue(size_t max_size) : max_size_(max_size) {
+  }
+
+  // returns false if the consumer has stopped
+  bool push(T &&value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_variable_.wait(lock, [&] { return is_closed_ || queue_.size() < max_size_; });
+    if (is_closed_) {
+      return false;
+    }
+    queue_.push(std::move(value));
+    condition_variable_.notify_all();
+    return true;
+  }
+
+  // returns false if the producer has finished and all values were received
+  bool pop(T &value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_variable_.wait(lock, [&] { return is_finished_ || is_closed_ || !queue_.empty(); });
+    if (is_closed_ || queue_.empty()) {
+      return false;
+    }
+    value = queue_.pop();
+    condition_variable_.notify_all();
+    return true;
+  }
+
+  // called by the producer
+  void finish() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    is_finished_ = true;
+    condition_variable_.notify_all();
+  }
+
+  // called by the consumer
+  void close() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    is_closed_ = true;
+    condition_variable_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+  VectorQueue<T> queue_;
+  size_t max_size_;
+  bool is_finished_ = false;
+  bool is_closed_ = false;
+};
+#endif
+
+// writes a compacted copy of the binlog to a new file in a separate thread
+class BinlogCompaction {
+ public:
+  string path_;
+  FileFd fd_;
+  int64 old_size_ = 0;
+  uint64 old_events_ = 0;
+  double start_time_ = 0;
+
+  string header_event_;
+  vector<string> events_;      // snapshot of alive events, written by the compaction thread
+  vector<string> new_events_;  // events added after the snapshot, written by the binlog thread at the end
+  bool is_encrypted_ = false;
+  AesCtrState aes_ctr_state_;
+
+  int64 size_ = 0;
+  uint64 event_count_ = 0;
+  Status status_;
+  std::atomic<bool> is_finished_{false};
+  std::atomic<bool> is_canceled_{false};
+  bool is_finishing_ = false;  // accessed only by the binlog thread
+#if !TD_THREAD_UNSUPPORTED
+  td::thread thread_;
+#endif
+
+  void run() {
+    status_ = [&] {
+      if (!header_event_.empty()) {
+        TRY_STATUS(write(header_event_));
+        event_count_++;
+      }
+      TRY_STATUS(write_events(events_));
+      // sync the bulk of the data now to make the final sync in the binlog thread cheap
+      return fd_.sync_barrier();
+    }();
+    events_ = vector<string>();
+    is_finished_.store(true, std::memory_order_release);
+  }
+
+  Status write_events(const vector<string> &events) {
+    static constexpr size_t MAX_BUFFER_SIZE = 1 << 20;
+    string buffer;
+    for (size_t i = 0; i <= events.size(); i++) {
+      if (i == events.size() || buffer.size() >= MAX_BUFFER_SIZE) {
+        if (is_canceled_.load(std::memory_order_relaxed)) {
+          return Status::Error("Compaction was canceled");
+        }
+        if (is_encrypted_) {
+          aes_ctr_state_.encrypt(buffer, MutableSlice(buffer));
+        }
+        TRY_STATUS(write(buffer));
+        buffer.clear();
+      }
+      if (i < events.size()) {
+        buffer += events[i];
+        event_count_++;
+      }
+    }
+    return Status::OK();
+  }
+
+  void destroy_file() {
+    fd_.lock(FileFd::LockFlags::Unlock, path_, 1).ignore();
+    fd_.close();
+    unlink(path_).ignore();
+  }
+
+ private:
+  Status write(Slice data) {
+    while (!data.empty()) {
+      TRY_RESULT(written, fd_.write(data));
+      data.remove_prefix(written);
+      size_ += static_cast<int64>(written);
+    }
+    return Status::OK();
+  }
+};
+
 static int64 file_size(CSlice path) {
   auto r_stat = stat(path);
   if (r_stat.is_error()) {
@@ -239,6 +390,11 @@ void Binlog::add_event(BinlogEvent &&event) {
   lazy_flush();
 
   if (state_ == State::Run) {
+    try_finish_compaction();
+    if (compaction_ != nullptr) {
+      return;
+    }
+
     auto fd_size = fd_size_;
     if (events_buffer_) {
       fd_size += events_buffer_->size();
@@ -246,10 +402,11 @@ void Binlog::add_event(BinlogEvent &&event) {
     auto need_reindex = [&](int64 min_size, int rate) {
       return fd_size > min_size && fd_size / rate > processor_->total_raw_events_size();
     };
-    if (need_reindex(50000, 5) || need_reindex(100000, 4) || need_reindex(300000, 3) || need_reindex(500000, 2)) {
+    if ((need_reindex(50000, 5) || need_reindex(100000, 4) || need_reindex(300000, 3) || need_reindex(500000, 2)) &&
+        Time::now() >= next_compaction_time_) {
       LOG(INFO) << tag("fd_size", format::as_size(fd_size))
                 << tag("total events size", format::as_size(processor_->total_raw_events_size()));
-      do_reindex();
+      start_compaction();
     }
   }
 }
@@ -285,6 +442,7 @@ Status Binlog::close(bool need_sync) {
   if (fd_.empty()) {
     return Status::OK();
   }
+  cancel_compaction();
   if (need_sync) {
     sync("close");
   } else {
@@ -335,6 +493,9 @@ void Binlog::do_event(BinlogEvent &&event) {
     VLOG(binlog) << "Write binlog event: " << format::cond(state_ == State::Reindex, "[reindex] ")
                  << event.public_to_string();
     buffer_writer_.append(as_slice(event.raw_event_));
+    if (compaction_ != nullptr) {
+      compaction_->new_events_.push_back(event.raw_event_);
+    }
   }
 
   if (event.type_ < 0) {
@@ -443,6 +604,10 @@ void Binlog::flush(const char *source) {
     update_write_encryption();
     next_buffer_flush_time_ = Time::now() + 1.0;
   }
+
+  if (state_ == State::Run) {
+    try_finish_compaction();
+  }
 }
 
 void Binlog::lazy_flush() {
@@ -503,6 +668,7 @@ void Binlog::update_write_encryption() {
 
 Status Binlog::load_binlog(const Callback &callback, const Callback &debug_callback) {
   state_ = State::Load;
+  auto start_time = Clocks::monotonic();
 
   buffer_writer_ = ChainBufferWriter();
   buffer_reader_ = buffer_writer_.extract_reader();
@@ -512,25 +678,20 @@ Status Binlog::load_binlog(const Callback &callback, const Callback &debug_callb
 
   update_read_encryption();
 
+  bool use_pipeline = false;
+#if !TD_THREAD_UNSUPPORTED
+  TRY_RESULT(file_size, fd_.get_size());
+  use_pipeline = file_size >= detail::PIPELINED_LOAD_MIN_SIZE;
+#endif
+  bool is_pipelined = false;
+
   fd_.get_poll_info().add_flags(PollFlags::Read());
   info_.wrong_password = false;
   while (true) {
     BinlogEvent event;
     auto r_need_size = reader.read_next(&event);
     if (r_need_size.is_error()) {
-      if (r_need_size.error().code() == -2) {
-        auto old_size = detail::file_size(path_);
-        auto offset = reader.offset();
-        auto data = debug_get_binlog_data(offset, old_size);
-        fd_.seek(offset).ensure();
-        fd_.truncate_to_current_position(offset).ensure();
-        if (data.empty()) {
-          break;
-        }
-        LOG(FATAL) << "Truncate binlog \"" << path_ << "\" from size " << old_size << " to size " << offset
-                   << " due to error: " << r_need_size.error() << " after reading " << data;
-      }
-      LOG(ERROR) << r_need_size.error();
+      on_load_error(reader.offset(), r_need_size.error());
       break;
     }
     auto need_size = r_need_size.move_as_ok();
@@ -539,30 +700,46 @@ Status Binlog::load_binlog(const Callback &callback, const Callback &debug_callb
       if (debug_callback) {
         debug_callback(event);
       }
+      auto process_start_time = Clocks::monotonic();
       do_add_event(std::move(event));
+      info_.process_time += Clocks::monotonic() - process_start_time;
       if (info_.wrong_password) {
         return Status::OK();
       }
+      if (use_pipeline) {
+        // the first event can enable encryption, so other events are read only after it is processed
+        is_pipelined = true;
+        break;
+      }
     } else {
+      auto read_start_time = Clocks::monotonic();
       TRY_STATUS(fd_.flush_read(max(need_size, static_cast<size_t>(4096))));
       buffer_reader_.sync_with_writer();
       if (byte_flow_flag_) {
         byte_flow_source_.wakeup();
       }
+      info_.read_time += Clocks::monotonic() - read_start_time;
       if (reader.input()->size() < need_size) {
         break;
       }
     }
   }
+  if (is_pipelined) {
+    TRY_STATUS(load_events_pipelined(reader.offset(), debug_callback));
+  } else {
+    info_.parse_time = Clocks::monotonic() - start_time - info_.read_time - info_.process_time;
+  }
 
   auto offset = processor_->offset();
   CHECK(offset >= 0);
+  auto replay_start_time = Clocks::monotonic();
   processor_->for_each([&](BinlogEvent &event) {
     VLOG(binlog) << "Replay binlog event: " << event.public_to_string();
     if (callback) {
       callback(event);
     }
   });
+  info_.replay_time = Clocks::monotonic() - replay_start_time;
 
   TRY_RESULT(fd_size, fd_.get_size());
   if (offset != fd_size) {
@@ -578,15 +755,184 @@ Status Binlog::load_binlog(const Callback &callback, const Callback &debug_callb
   buffer_writer_ = ChainBufferWriter();
   buffer_reader_ = buffer_writer_.extract_reader();
 
-  // reuse aes_ctr_state_
-  if (encryption_type_ == EncryptionType::AesCtr) {
+  // reuse aes_ctr_state_; after pipelined loading it is already there
+  if (encryption_type_ == EncryptionType::AesCtr && !is_pipelined) {
     aes_ctr_state_ = aes_xcode_byte_flow_.move_aes_ctr_state();
   }
   update_write_encryption();
 
+  info_.load_time = Clocks::monotonic() - start_time;
+  [&](Slice msg) {
+    if (info_.load_time > 1) {
+      LOG(WARNING) << "Slow " << msg;
+    } else {
+      LOG(INFO) << msg;
+    }
+  }(PSLICE() << "Load binlog " << tag("name", path_) << tag("size", format::as_size(fd_size_))
+             << tag("events", fd_events_) << tag("is_pipelined", is_pipelined)
+             << tag("time", format::as_time(info_.load_time)) << tag("read", format::as_time(info_.read_time))
+             << tag("parse", format::as_time(info_.parse_time)) << tag("process", format::as_time(info_.process_time))
+             << tag("replay", format::as_time(info_.replay_time)));
+
   return Status::OK();
 }
 
+Status Binlog::load_events_pipelined(int64 offset, const Callback &debug_callback) {
+#if TD_THREAD_UNSUPPORTED
+  UNREACHABLE();
+  return Status::OK();
+#else
+  // read-ahead and decryption are done in one thread, splitting into events and their validation in another,
+  // and the events are processed in the calling thread in the same order as in the sequential loading
+  TRY_RESULT(file_size, fd_.get_size());
+  bool is_encrypted = encryption_type_ == EncryptionType::AesCtr;
+  AesCtrState aes_ctr_state;
+  if (is_encrypted) {
+    aes_ctr_state = aes_xcode_byte_flow_.move_aes_ctr_state();
+  }
+
+  detail::BinlogLoadQueue<BufferSlice> chunks(detail::PIPELINED_LOAD_MAX_CHUNK_COUNT);
+  detail::BinlogLoadQueue<vector<BinlogEvent>> event_batches(detail::PIPELINED_LOAD_MAX_EVENT_BATCH_COUNT);
+
+  Status read_status;
+  double read_time = 0.0;
+  td::thread read_thread([&] {
+    auto thread_start_time = Clocks::monotonic();
+    double wait_time = 0.0;
+    auto read_offset = offset;
+    while (true) {
+      BufferSlice chunk(detail::PIPELINED_LOAD_CHUNK_SIZE);
+      auto r_size = fd_.pread(chunk.as_mutable_slice(), read_offset);
+      if (r_size.is_error()) {
+        read_status = r_size.move_as_error();
+        break;
+      }
+      auto size = r_size.ok();
+      if (size == 0) {
+        break;
+      }
+      chunk.truncate(size);
+      if (is_encrypted) {
+        aes_ctr_state.decrypt(chunk.as_slice(), chunk.as_mutable_slice());
+      }
+      read_offset += static_cast<int64>(size);
+
+      auto wait_start_time = Clocks::monotonic();
+      bool is_sent = chunks.push(std::move(chunk));
+      wait_time += Clocks::monotonic() - wait_start_time;
+      if (!is_sent) {
+        break;
+      }
+    }
+    chunks.finish();
+    read_time = Clocks::monotonic() - thread_start_time - wait_time;
+  });
+
+  Status parse_status;
+  int64 parse_offset = offset;
+  double parse_time = 0.0;
+  td::thread parse_thread([&] {
+    auto thread_start_time = Clocks::monotonic();
+    double wait_time = 0.0;
+    ChainBufferWriter writer;
+    auto input = writer.extract_reader();
+    detail::BinlogReader reader{nullptr};
+    reader.set_input(&input, is_encrypted, file_size);
+    reader.set_offset(offset);
+
+    vector<BinlogEvent> events;
+    auto send_events = [&] {
+      if (events.empty()) {
+        return;
+      }
+      auto wait_start_time = Clocks::monotonic();
+      event_batches.push(std::move(events));
+      wait_time += Clocks::monotonic() - wait_start_time;
+      events = vector<BinlogEvent>();
+    };
+    while (true) {
+      BinlogEvent event;
+      auto r_need_size = reader.read_next(&event);
+      if (r_need_size.is_error()) {
+        parse_status = r_need_size.move_as_error();
+        break;
+      }
+      if (r_need_size.ok() == 0) {
+        events.push_back(std::move(event));
+        if (events.size() >= detail::PIPELINED_LOAD_EVENT_BATCH_SIZE) {
+          send_events();
+        }
+        continue;
+      }
+
+      // don't hold parsed events while waiting for the next chunk
+      send_events();
+      BufferSlice chunk;
+      auto wait_start_time = Clocks::monotonic();
+      bool is_received = chunks.pop(chunk);
+      wait_time += Clocks::monotonic() - wait_start_time;
+      if (!is_received) {
+        // the end of the file; an incomplete last event will be truncated
+        break;
+      }
+      writer.append(std::move(chunk));
+      input.sync_with_writer();
+    }
+    send_events();
+    parse_offset = reader.offset();
+    chunks.close();
+    event_batches.finish();
+    parse_time = Clocks::monotonic() - thread_start_time - wait_time;
+  });
+
+  vector<BinlogEvent> events;
+  while (event_batches.pop(events)) {
+    auto process_start_time = Clocks::monotonic();
+    for (auto &event : events) {
+      LOG_CHECK(event.type_ != BinlogEvent::ServiceTypes::AesCtrEncryption)
+          << "Unexpected encryption event at offset " << event.offset_;
+      if (debug_callback) {
+        debug_callback(event);
+      }
+      do_add_event(std::move(event));
+    }
+    info_.process_time += Clocks::monotonic() - process_start_time;
+  }
+
+  parse_thread.join();
+  read_thread.join();
+  info_.read_time += read_time;
+  info_.parse_time += parse_time;
+
+  TRY_STATUS(std::move(read_status));
+  if (parse_status.is_error()) {
+    on_load_error(parse_offset, parse_status);
+  }
+  if (is_encrypted) {
+    aes_ctr_state_ = std::move(aes_ctr_state);
+  }
+
+  // the file was read with pread, so the write position must be moved to the end of the file explicitly
+  TRY_RESULT(new_file_size, fd_.get_size());
+  return fd_.seek(new_file_size);
+#endif
+}
+
+void Binlog::on_load_error(int64 offset, const Status &error) {
+  if (error.code() == -2) {
+    auto old_size = detail::file_size(path_);
+    auto data = debug_get_binlog_data(offset, old_size);
+    fd_.seek(offset).ensure();
+    fd_.truncate_to_current_position(offset).ensure();
+    if (data.empty()) {
+      return;
+    }
+    LOG(FATAL) << "Truncate binlog \"" << path_ << "\" from size " << old_size << " to size " << offset
+               << " due to error: " << error << " after reading " << data;
+  }
+  LOG(ERROR) << error;
+}
+
 void Binlog::update_encryption(Slice key, Slice iv) {
   as_mutable_slice(aes_ctr_key_).copy_from(key);
   UInt128 aes_ctr_iv;
@@ -627,6 +973,7 @@ void Binlog::reset_encryption() {
 }
 
 void Binlog::do_reindex() {
+  cancel_compaction();
   flush_events_buffer(true);
   // start reindex
   CHECK(state_ == State::Run);
@@ -644,7 +991,7 @@ void Binlog::do_reindex() {
   auto r_opened_file = open_binlog(new_path, FileFd::Flags::Write | FileFd::Flags::Create | FileFd::Truncate);
   if (r_opened_file.is_error()) {
     LOG(ERROR) << "Can't open new binlog for regenerate: " << r_opened_file.error();
-    return;
+    return on_compaction_failed();
   }
   auto old_fd = std::move(fd_);  // can't close fd_ now, because it will release file lock
   fd_ = BufferedFdBase<FileFd>(r_opened_file.move_as_ok());
@@ -677,6 +1024,8 @@ void Binlog::do_reindex() {
   status = rename(new_path, path_);
   FileFd::remove_local_lock(new_path);  // now we can release local lock for temporary file
   LOG_IF(FATAL, status.is_error()) << "Failed to rename binlog: " << status;
+  compaction_retry_delay_ = 0;
+  info_.compaction_count++;
 
   auto finish_time = Clocks::monotonic();
   auto finish_size = fd_size_;
@@ -718,6 +1067,132 @@ void Binlog::do_reindex() {
   update_write_encryption();
 }
 
+void Binlog::start_compaction() {
+#if TD_THREAD_UNSUPPORTED
+  do_reindex();
+#else
+  CHECK(state_ == State::Run);
+  CHECK(compaction_ == nullptr);
+  bool is_encrypted = encryption_type_ == EncryptionType::AesCtr;
+  if (is_encrypted == db_key_.is_empty() || (is_encrypted && aes_ctr_key_salt_.empty())) {
+    // encryption key must be changed, which is done only by the synchronous reindex
+    return do_reindex();
+  }
+
+  // the current file remains valid and is appended as usual while the compacted copy is written,
+  // then the events added meanwhile are appended to the copy, which replaces the current file
+  auto compaction = make_unique<detail::BinlogCompaction>();
+  compaction->path_ = path_ + ".new";
+  auto r_opened_file =
+      open_binlog(compaction->path_, FileFd::Flags::Write | FileFd::Flags::Create | FileFd::Truncate);
+  if (r_opened_file.is_error()) {
+    LOG(ERROR) << "Can't open new binlog for compaction: " << r_opened_file.error();
+    return on_compaction_failed();
+  }
+  compaction->fd_ = r_opened_file.move_as_ok();
+  compaction->old_size_ = fd_size_;
+  compaction->old_events_ = fd_events_;
+  compaction->start_time_ = Clocks::monotonic();
+
+  if (is_encrypted) {
+    using EncryptionEvent = detail::AesCtrEncryptionEvent;
+    EncryptionEvent event;
+    event.key_salt_ = aes_ctr_key_salt_;
+    event.iv_.resize(EncryptionEvent::iv_size());
+    Random::secure_bytes(event.iv_);
+    event.key_hash_ = EncryptionEvent::generate_hash(as_slice(aes_ctr_key_));
+    compaction->header_event_ =
+        BinlogEvent::create_raw(0, BinlogEvent::ServiceTypes::AesCtrEncryption, 0, create_default_storer(event))
+            .as_slice()
+            .str();
+    compaction->is_encrypted_ = true;
+    compaction->aes_ctr_state_.init(as_slice(aes_ctr_key_), event.iv_);
+  }
+  processor_->for_each([&](BinlogEvent &event) { compaction->events_.push_back(event.raw_event_); });
+
+  auto compaction_ptr = compaction.get();
+  compaction->thread_ = td::thread([compaction_ptr] { compaction_ptr->run(); });
+  compaction_ = std::move(compaction);
+#endif
+}
+
+void Binlog::try_finish_compaction() {
+  if (compaction_ == nullptr || compaction_->is_finishing_ ||
+      !compaction_->is_finished_.load(std::memory_order_acquire)) {
+    return;
+  }
+#if !TD_THREAD_UNSUPPORTED
+  compaction_->thread_.join();
+#endif
+  if (compaction_->status_.is_ok()) {
+    // all events must be written to the current file before it is replaced;
+    // the compaction must be still active to receive the buffered events written by the flush
+    compaction_->is_finishing_ = true;
+    flush("try_finish_compaction");
+  }
+  auto compaction = std::move(compaction_);
+
+  auto status = std::move(compaction->status_);
+  if (status.is_ok()) {
+    status = compaction->write_events(compaction->new_events_);
+  }
+  if (status.is_ok()) {
+    status = compaction->fd_.sync_barrier();
+  }
+  if (status.is_error()) {
+    LOG(ERROR) << "Failed to compact binlog: " << status;
+    compaction->destroy_file();
+    return on_compaction_failed();
+  }
+
+  auto old_fd = std::move(fd_);  // can't close fd_ now, because it will release file lock
+  fd_ = BufferedFdBase<FileFd>(std::move(compaction->fd_));
+  status = unlink(path_);
+  LOG_IF(FATAL, status.is_error()) << "Failed to unlink old binlog: " << status;
+  old_fd.close();  // now we can close old file and release the system lock
+  status = rename(compaction->path_, path_);
+  FileFd::remove_local_lock(compaction->path_);  // now we can release local lock for temporary file
+  LOG_IF(FATAL, status.is_error()) << "Failed to rename binlog: " << status;
+
+  fd_size_ = compaction->size_;
+  fd_events_ = compaction->event_count_;
+  need_sync_ = false;
+  compaction_retry_delay_ = 0;
+  info_.compaction_count++;
+
+  auto finish_time = Clocks::monotonic();
+  LOG(INFO) << "Compact binlog " << tag("name", path_)
+            << tag("time", format::as_time(finish_time - compaction->start_time_))
+            << tag("before_size", format::as_size(compaction->old_size_))
+            << tag("after_size", format::as_size(fd_size_)) << tag("before_events", compaction->old_events_)
+            << tag("after_events", fd_events_) << tag("new_events", compaction->new_events_.size());
+
+  buffer_writer_ = ChainBufferWriter();
+  buffer_reader_ = buffer_writer_.extract_reader();
+  if (encryption_type_ == EncryptionType::AesCtr) {
+    aes_ctr_state_ = std::move(compaction->aes_ctr_state_);
+  }
+  update_write_encryption();
+}
+
+void Binlog::on_compaction_failed() {
+  // don't retry the compaction on every added event
+  compaction_retry_delay_ = clamp(compaction_retry_delay_ * 2, 1.0, 600.0);
+  next_compaction_time_ = Time::now() + compaction_retry_delay_;
+}
+
+void Binlog::cancel_compaction() {
+  if (compaction_ == nullptr) {
+    return;
+  }
+  auto compaction = std::move(compaction_);
+  compaction->is_canceled_.store(true, std::memory_order_relaxed);
+#if !TD_THREAD_UNSUPPORTED
+  compaction->thread_.join();
+#endif
+  compaction->destroy_file();
+}
+
 string Binlog::debug_get_binlog_data(int64 begin_offset, int64 end_offset) {
   if (begin_offset > end_offset) {
     return "Begin offset is bigger than end_offset";
@@ -35,12 +35,22 @@ struct BinlogInfo {
   bool is_encrypted{false};
   bool wrong_password{false};
   bool is_opened{false};
+
+  // time spent in different phases of the binlog loading; with pipelined loading the phases overlap
+  double read_time{0};     // reading and decryption of the file
+  double parse_time{0};    // splitting into events and their validation
+  double process_time{0};  // building of the event index
+  double replay_time{0};   // replay callbacks
+  double load_time{0};     // total time of the loading
+
+  uint32 compaction_count{0};  // number of compactions finished since the binlog was opened
 };
 
 namespace detail {
 class BinlogReader;
 class BinlogEventsProcessor;
 class BinlogEventsBuffer;
+class BinlogCompaction;
 }  // namespace detail
 
 class Binlog {
@@ -158,11 +168,14 @@ class Binlog {
   vector<BinlogEvent> pending_events_;
   unique_ptr<detail::BinlogEventsProcessor> processor_;
   unique_ptr<detail::BinlogEventsBuffer> events_buffer_;
+  unique_ptr<detail::BinlogCompaction> compaction_;
   bool in_flush_events_buffer_{false};
   uint64 last_event_id_{0};
   double need_flush_since_ = 0;
   double next_buffer_flush_time_ = 0;
   bool need_sync_{false};
+  double next_compaction_time_ = 0;
+  double compaction_retry_delay_ = 0;
   enum class State { Empty, Load, Reindex, Run } state_{State::Empty};
 
   static Result<FileFd> open_binlog(const string &path, int32 flags);
@@ -170,8 +183,15 @@ class Binlog {
   void do_add_event(BinlogEvent &&event);
   void do_event(BinlogEvent &&event);
   Status load_binlog(const Callback &callback, const Callback &debug_callback = Callback()) TD_WARN_UNUSED_RESULT;
+  Status load_events_pipelined(int64 offset, const Callback &debug_callback) TD_WARN_UNUSED_RESULT;
+  void on_load_error(int64 offset, const Status &error);
   void do_reindex();
 
+  void start_compaction();
+  void try_finish_compaction();
+  void cancel_compaction();
+  void on_compaction_failed();
+
   void update_encryption(Slice key, Slice iv);
   void reset_encryption();
   void update_read_encryption();
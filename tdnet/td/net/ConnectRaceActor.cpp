@@ -0,0 +1,151 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/net/ConnectRaceActor.h"
+
+#include "td/net/TransparentProxy.h"
+
+#include "td/utils/logging.h"
+#include "td/utils/port/detail/PollableFd.h"
+#include "td/utils/SliceBuilder.h"
+#include "td/utils/Time.h"
+
+namespace td {
+
+ConnectRaceActor::ConnectRaceActor(vector<IPAddress> ip_addresses, double attempt_delay, double timeout,
+                                   Promise<ConnectResult> promise, ActorShared<> parent)
+    : ip_addresses_(std::move(ip_addresses))
+    , attempt_delay_(attempt_delay)
+    , timeout_(timeout)
+    , promise_(std::move(promise))
+    , parent_(std::move(parent)) {
+}
+
+void ConnectRaceActor::start_up() {
+  start_time_ = Time::now();
+  start_next_attempt();
+  if (attempts_.empty()) {
+    return on_error(last_error_.is_error() ? std::move(last_error_) : Status::Error("No addresses to connect"));
+  }
+  loop();
+}
+
+void ConnectRaceActor::tear_down() {
+  for (auto &attempt : attempts_) {
+    close_attempt(attempt);
+  }
+  attempts_.clear();
+}
+
+void ConnectRaceActor::hangup() {
+  on_error(Status::Error("Canceled"));
+}
+
+void ConnectRaceActor::start_next_attempt() {
+  while (next_address_index_ < ip_addresses_.size()) {
+    auto address_index = next_address_index_++;
+    VLOG(proxy) << "Begin to connect to " << ip_addresses_[address_index];
+    auto r_socket_fd = SocketFd::open(ip_addresses_[address_index]);
+    if (r_socket_fd.is_error()) {
+      on_attempt_failed(address_index, r_socket_fd.move_as_error());
+      continue;
+    }
+
+    Attempt attempt;
+    attempt.address_index = address_index;
+    attempt.socket_fd = r_socket_fd.move_as_ok();
+    Scheduler::subscribe(attempt.socket_fd.get_poll_info().extract_pollable_fd(this));
+    attempts_.push_back(std::move(attempt));
+    next_attempt_time_ = Time::now() + attempt_delay_;
+    break;
+  }
+  update_timeout();
+}
+
+void ConnectRaceActor::on_attempt_failed(size_t address_index, Status status) {
+  VLOG(proxy) << "Failed to connect to " << ip_addresses_[address_index] << ": " << status;
+  failed_address_indices_.push_back(address_index);
+  last_error_ = std::move(status);
+}
+
+void ConnectRaceActor::close_attempt(Attempt &attempt) {
+  Scheduler::unsubscribe_before_close(attempt.socket_fd.get_poll_info().get_pollable_fd_ref());
+  attempt.socket_fd.close();
+}
+
+void ConnectRaceActor::update_timeout() {
+  auto wakeup_at = start_time_ + timeout_;
+  if (next_address_index_ < ip_addresses_.size() && next_attempt_time_ < wakeup_at) {
+    wakeup_at = next_attempt_time_;
+  }
+  set_timeout_at(wakeup_at);
+}
+
+void ConnectRaceActor::loop() {
+  bool has_failed_attempt = false;
+  for (size_t i = 0; i < attempts_.size();) {
+    auto &socket_fd = attempts_[i].socket_fd;
+    sync_with_poll(socket_fd);
+    auto status = socket_fd.get_pending_error();
+    if (status.is_ok() && can_close_local(socket_fd)) {
+      status = Status::Error("Connection closed");
+    }
+    if (status.is_error()) {
+      on_attempt_failed(attempts_[i].address_index, std::move(status));
+      close_attempt(attempts_[i]);
+      attempts_.erase(attempts_.begin() + i);
+      has_failed_attempt = true;
+      continue;
+    }
+    if (can_write_local(socket_fd)) {
+      return on_connected(i);
+    }
+    i++;
+  }
+
+  if (has_failed_attempt) {
+    // don't wait for the attempt delay after a failure
+    start_next_attempt();
+  }
+  if (attempts_.empty()) {
+    on_error(std::move(last_error_));
+  }
+}
+
+void ConnectRaceActor::timeout_expired() {
+  if (Time::now() >= start_time_ + timeout_) {
+    return on_error(Status::Error("Connection timeout expired"));
+  }
+  if (Time::now() >= next_attempt_time_) {
+    start_next_attempt();
+  } else {
+    update_timeout();
+  }
+}
+
+void ConnectRaceActor::on_connected(size_t attempt_pos) {
+  auto &attempt = attempts_[attempt_pos];
+  VLOG(proxy) << "Connected to " << ip_addresses_[attempt.address_index];
+  ConnectResult result;
+  result.address_index = attempt.address_index;
+  Scheduler::unsubscribe(attempt.socket_fd.get_poll_info().get_pollable_fd_ref());
+  result.socket_fd = std::move(attempt.socket_fd);
+  result.connect_time = Time::now() - start_time_;
+  result.failed_address_indices = std::move(failed_address_indices_);
+  attempts_.erase(attempts_.begin() + attempt_pos);
+
+  promise_.set_value(std::move(result));
+  stop();
+}
+
+void ConnectRaceActor::on_error(Status status) {
+  CHECK(status.is_error());
+  promise_.set_error(Status::Error(PSLICE() << "Failed to connect to " << ip_addresses_.size()
+                                            << " addresses: " << status.message()));
+  stop();
+}
+
+}  // namespace td
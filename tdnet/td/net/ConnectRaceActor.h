@@ -0,0 +1,72 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include "td/actor/actor.h"
+
+#include "td/utils/common.h"
+#include "td/utils/port/IPAddress.h"
+#include "td/utils/port/SocketFd.h"
+#include "td/utils/Promise.h"
+#include "td/utils/Status.h"
+
+namespace td {
+
+// connects to the first reachable address from the list sorted in the order of preference
+// the next connection attempt is started after attempt_delay or as soon as an attempt fails;
+// the first established connection wins and all other attempts are aborted as described in RFC 8305
+class ConnectRaceActor final : public Actor {
+ public:
+  struct ConnectResult {
+    size_t address_index = 0;
+    SocketFd socket_fd;
+    double connect_time = 0.0;
+    vector<size_t> failed_address_indices;
+  };
+
+  ConnectRaceActor(vector<IPAddress> ip_addresses, double attempt_delay, double timeout,
+                   Promise<ConnectResult> promise, ActorShared<> parent);
+
+ private:
+  struct Attempt {
+    size_t address_index = 0;
+    SocketFd socket_fd;
+  };
+
+  vector<IPAddress> ip_addresses_;
+  double attempt_delay_;
+  double timeout_;
+  Promise<ConnectResult> promise_;
+  ActorShared<> parent_;
+
+  vector<Attempt> attempts_;
+  size_t next_address_index_ = 0;
+  vector<size_t> failed_address_indices_;
+  Status last_error_;
+  double start_time_ = 0.0;
+  double next_attempt_time_ = 0.0;
+
+  void start_up() final;
+  void tear_down() final;
+  void hangup() final;
+  void loop() final;
+  void timeout_expired() final;
+
+  void start_next_attempt();
+
+  void on_attempt_failed(size_t address_index, Status status);
+
+  void close_attempt(Attempt &attempt);
+
+  void update_timeout();
+
+  void on_connected(size_t attempt_pos);
+
+  void on_error(Status status);
+};
+
+}  // namespace td
@@ -9,6 +9,7 @@
 char disable_linker_warning_about_empty_file_gzip_cpp TD_UNUSED;
 
 #if TD_HAVE_ZLIB
+#include "td/utils/port/thread_local.h"
 #include "td/utils/SliceBuilder.h"
 
 #include <cstring>
@@ -33,6 +34,12 @@ class Gzip::Impl {
 };
 
 Status Gzip::init_encode() {
+  if (is_reusable_) {
+    if (mode_ == Mode::Encode) {
+      return reset();
+    }
+    clear();
+  }
   CHECK(mode_ == Mode::Empty);
   init_common();
   mode_ = Mode::Encode;
@@ -44,6 +51,12 @@ Status Gzip::init_encode() {
 }
 
 Status Gzip::init_decode() {
+  if (is_reusable_) {
+    if (mode_ == Mode::Decode) {
+      return reset();
+    }
+    clear();
+  }
   CHECK(mode_ == Mode::Empty);
   init_common();
   mode_ = Mode::Decode;
@@ -87,7 +100,9 @@ Result<Gzip::State> Gzip::run() {
     }
     if (ret == Z_STREAM_END) {
       // TODO(now): fail if input is not empty;
-      clear();
+      if (!is_reusable_) {
+        clear();
+      }
       return State::Done;
     }
     clear();
@@ -118,6 +133,25 @@ void Gzip::init_common() {
   close_input_flag_ = false;
 }
 
+Status Gzip::reset() {
+  impl_->stream_.avail_in = 0;
+  impl_->stream_.next_in = nullptr;
+  impl_->stream_.avail_out = 0;
+  impl_->stream_.next_out = nullptr;
+
+  input_size_ = 0;
+  output_size_ = 0;
+
+  close_input_flag_ = false;
+
+  int ret = mode_ == Mode::Decode ? inflateReset(&impl_->stream_) : deflateReset(&impl_->stream_);
+  if (ret != Z_OK) {
+    clear();
+    return Status::Error(PSLICE() << "zlib reset failed: " << ret);
+  }
+  return Status::OK();
+}
+
 void Gzip::clear() {
   if (mode_ == Mode::Decode) {
     inflateEnd(&impl_->stream_);
@@ -147,6 +181,7 @@ void Gzip::swap(Gzip &other) {
   swap(input_size_, other.input_size_);
   swap(output_size_, other.output_size_);
   swap(close_input_flag_, other.close_input_flag_);
+  swap(is_reusable_, other.is_reusable_);
   swap(mode_, other.mode_);
 }
 
@@ -154,8 +189,49 @@ Gzip::~Gzip() {
   clear();
 }
 
+// zlib stream states are expensive to create, so they are kept for the current thread
+static Gzip &get_thread_gzip(Gzip::Mode mode) {
+  static TD_THREAD_LOCAL Gzip *encoder;  // static zero-initialized
+  static TD_THREAD_LOCAL Gzip *decoder;  // static zero-initialized
+  auto &gzip = mode == Gzip::Mode::Encode ? encoder : decoder;
+  if (init_thread_local<Gzip>(gzip)) {
+    gzip->set_reusable(true);
+  }
+  return *gzip;
+}
+
+// returns the uncompressed size stored in the gzip trailer, or 0 if it is unknown
+static size_t get_gzip_uncompressed_size(Slice s) {
+  if (s.size() < 18 || s.ubegin()[0] != 0x1f || s.ubegin()[1] != 0x8b) {
+    return 0;
+  }
+  auto trailer = s.ubegin() + s.size() - 4;
+  auto size = static_cast<size_t>(trailer[0]) | (static_cast<size_t>(trailer[1]) << 8) |
+              (static_cast<size_t>(trailer[2]) << 16) | (static_cast<size_t>(trailer[3]) << 24);
+  // the size is stored modulo 2^32 and deflate can't compress data more than 1032 times
+  if (size / 1032 > s.size()) {
+    return 0;
+  }
+  return size;
+}
+
 BufferSlice gzdecode(Slice s) {
-  Gzip gzip;
+  auto &gzip = get_thread_gzip(Gzip::Mode::Decode);
+
+  auto uncompressed_size = get_gzip_uncompressed_size(s);
+  if (uncompressed_size != 0) {
+    // decode directly to the buffer of the expected size
+    gzip.init_decode().ensure();
+    gzip.set_input(s);
+    gzip.close_input();
+    BufferSlice result(uncompressed_size);
+    gzip.set_output(result.as_mutable_slice());
+    auto r_state = gzip.run();
+    if (r_state.is_ok() && r_state.ok() == Gzip::State::Done && gzip.flush_output() == uncompressed_size) {
+      return result;
+    }
+  }
+
   gzip.init_decode().ensure();
   ChainBufferWriter message;
   gzip.set_input(s);
@@ -185,7 +261,7 @@ BufferSlice gzdecode(Slice s) {
 }
 
 BufferSlice gzencode(Slice s, double max_compression_ratio) {
-  Gzip gzip;
+  auto &gzip = get_thread_gzip(Gzip::Mode::Encode);
   gzip.init_encode().ensure();
   gzip.set_input(s);
   gzip.close_input();
@@ -39,6 +39,11 @@ class Gzip {
 
   Status init_decode() TD_WARN_UNUSED_RESULT;
 
+  // keep zlib state after the end of a stream, so that the next initialization in the same mode is cheap
+  void set_reusable(bool is_reusable) {
+    is_reusable_ = is_reusable;
+  }
+
   void set_input(Slice input);
 
   void set_output(MutableSlice output);
@@ -89,9 +94,11 @@ class Gzip {
   size_t input_size_ = 0;
   size_t output_size_ = 0;
   bool close_input_flag_ = false;
+  bool is_reusable_ = false;
   Mode mode_ = Mode::Empty;
 
   void init_common();
+  Status reset();
   void clear();
 
   void swap(Gzip &other);
@@ -10,10 +10,12 @@
 #include "td/utils/logging.h"
 #include "td/utils/misc.h"
 #include "td/utils/Slice.h"
+#include "td/utils/SliceBuilder.h"
 #include "td/utils/translit.h"
 #include "td/utils/utf8.h"
 
 #include <algorithm>
+#include <utility>
 
 namespace td {
 
@@ -40,22 +42,184 @@ vector<string> Hints::get_words(Slice name) {
   return fix_words(utf8_get_search_words(name));
 }
 
-void Hints::add_word(const string &word, KeyT key, std::map<string, vector<KeyT>> &word_to_keys) {
-  vector<KeyT> &keys = word_to_keys[word];
+Slice Hints::WordIndex::get_word(size_t pos) const {
+  return Slice(words_).substr(word_offsets_[pos], word_offsets_[pos + 1] - word_offsets_[pos]);
+}
+
+std::pair<size_t, size_t> Hints::WordIndex::get_prefix_range(Slice prefix) const {
+  size_t left = 0;
+  size_t right = get_word_count();
+  while (left < right) {
+    auto middle = left + (right - left) / 2;
+    if (get_word(middle) < prefix) {
+      left = middle + 1;
+    } else {
+      right = middle;
+    }
+  }
+  auto begin = left;
+
+  // words starting with prefix follow the prefix
+  right = get_word_count();
+  while (left < right) {
+    auto middle = left + (right - left) / 2;
+    if (begins_with(get_word(middle), prefix)) {
+      left = middle + 1;
+    } else {
+      right = middle;
+    }
+  }
+  return {begin, left};
+}
+
+void Hints::WordIndex::add(const string &word, KeyT key) {
+  vector<KeyT> &keys = new_word_to_keys_[word];
   CHECK(!td::contains(keys, key));
   keys.push_back(key);
+  on_changed();
 }
 
-void Hints::delete_word(const string &word, KeyT key, std::map<string, vector<KeyT>> &word_to_keys) {
-  vector<KeyT> &keys = word_to_keys[word];
-  auto key_it = std::find(keys.begin(), keys.end(), key);
-  CHECK(key_it != keys.end());
-  if (keys.size() == 1) {
-    word_to_keys.erase(word);
-  } else {
-    CHECK(keys.size() > 1);
-    *key_it = keys.back();
-    keys.pop_back();
+void Hints::WordIndex::remove(const string &word, KeyT key) {
+  auto it = new_word_to_keys_.find(word);
+  if (it != new_word_to_keys_.end()) {
+    auto &keys = it->second;
+    auto key_it = std::find(keys.begin(), keys.end(), key);
+    if (key_it != keys.end()) {
+      if (keys.size() == 1) {
+        new_word_to_keys_.erase(it);
+      } else {
+        *key_it = keys.back();
+        keys.pop_back();
+      }
+      on_changed();
+      return;
+    }
+  }
+
+  auto range = get_prefix_range(word);
+  CHECK(range.first < range.second && get_word(range.first) == word);
+  auto pos = range.first;
+  auto keys_begin = keys_.begin() + key_offsets_[pos];
+  auto keys_end = keys_begin + key_counts_[pos];
+  auto key_it = std::find(keys_begin, keys_end, key);
+  CHECK(key_it != keys_end);
+  *key_it = *(keys_end - 1);
+  key_counts_[pos]--;
+  on_changed();
+}
+
+void Hints::WordIndex::on_changed() {
+  change_count_++;
+  if (change_count_ > max(MIN_REBUILD_CHANGE_COUNT, keys_.size() / 4)) {
+    rebuild();
+  }
+}
+
+void Hints::WordIndex::rebuild() {
+  string words;
+  vector<uint32> word_offsets;
+  vector<uint32> key_offsets;
+  vector<uint32> key_counts;
+  vector<KeyT> keys;
+  size_t total_key_count = 0;
+  for (auto count : key_counts_) {
+    total_key_count += count;
+  }
+  for (auto &it : new_word_to_keys_) {
+    total_key_count += it.second.size();
+  }
+  keys.reserve(total_key_count);
+
+  auto add_keys = [&](Slice word, const KeyT *begin, const KeyT *end) {
+    if (begin == end) {
+      return;
+    }
+    if (word_offsets.empty() || Slice(words).substr(word_offsets.back()) != word) {
+      word_offsets.push_back(narrow_cast<uint32>(words.size()));
+      words.append(word.begin(), word.size());
+      key_offsets.push_back(narrow_cast<uint32>(keys.size()));
+      key_counts.push_back(0);
+    }
+    keys.insert(keys.end(), begin, end);
+    key_counts.back() += narrow_cast<uint32>(end - begin);
+  };
+
+  // merge the snapshot with the new words
+  size_t pos = 0;
+  auto it = new_word_to_keys_.begin();
+  while (pos < get_word_count() || it != new_word_to_keys_.end()) {
+    if (it == new_word_to_keys_.end() || (pos < get_word_count() && !(Slice(it->first) < get_word(pos)))) {
+      auto keys_begin = keys_.data() + key_offsets_[pos];
+      add_keys(get_word(pos), keys_begin, keys_begin + key_counts_[pos]);
+      pos++;
+    } else {
+      add_keys(it->first, it->second.data(), it->second.data() + it->second.size());
+      ++it;
+    }
+  }
+  word_offsets.push_back(narrow_cast<uint32>(words.size()));
+
+  words.shrink_to_fit();
+  word_offsets.shrink_to_fit();
+  key_offsets.shrink_to_fit();
+  key_counts.shrink_to_fit();
+  words_ = std::move(words);
+  word_offsets_ = std::move(word_offsets);
+  key_offsets_ = std::move(key_offsets);
+  key_counts_ = std::move(key_counts);
+  keys_ = std::move(keys);
+  new_word_to_keys_.clear();
+  change_count_ = 0;
+}
+
+void Hints::WordIndex::add_search_results(vector<KeyT> &results, Slice prefix) const {
+  LOG(DEBUG) << "Search for word " << prefix;
+  auto range = get_prefix_range(prefix);
+  for (auto pos = range.first; pos < range.second; pos++) {
+    auto keys_begin = keys_.begin() + key_offsets_[pos];
+    results.insert(results.end(), keys_begin, keys_begin + key_counts_[pos]);
+  }
+
+  auto it = new_word_to_keys_.lower_bound(prefix.str());
+  while (it != new_word_to_keys_.end() && begins_with(it->first, prefix)) {
+    append(results, it->second);
+    ++it;
+  }
+}
+
+void Hints::WordIndex::add_next_characters(vector<string> &characters, Slice prefix) const {
+  auto get_next_character = [&](Slice word) {
+    CHECK(word.size() > prefix.size());
+    auto begin = word.ubegin() + prefix.size();
+    uint32 code;
+    auto end = next_utf8_unsafe(begin, &code);
+    return word.substr(prefix.size(), static_cast<size_t>(end - begin));
+  };
+
+  // all words starting with prefix + character are skipped at once
+  auto range = get_prefix_range(prefix);
+  auto pos = range.first;
+  while (pos < range.second) {
+    auto word = get_word(pos);
+    if (word.size() == prefix.size()) {
+      pos++;
+      continue;
+    }
+    auto character = get_next_character(word);
+    characters.push_back(character.str());
+    pos = get_prefix_range(PSLICE() << prefix << character).second;
+  }
+
+  auto it = new_word_to_keys_.lower_bound(prefix.str());
+  while (it != new_word_to_keys_.end() && begins_with(it->first, prefix)) {
+    if (it->first.size() == prefix.size()) {
+      ++it;
+      continue;
+    }
+    auto character = get_next_character(it->first);
+    characters.push_back(character.str());
+    // UTF-8 strings never contain the byte 0xFF
+    it = new_word_to_keys_.lower_bound(PSTRING() << prefix << character << '\xFF');
   }
 }
 
@@ -68,7 +232,7 @@ void Hints::add(KeyT key, Slice name) {
     }
     vector<string> old_transliterations;
     for (auto &old_word : get_words(it->second)) {
-      delete_word(old_word, key, word_to_keys_);
+      word_index_.remove(old_word, key);
 
       for (auto &w : get_word_transliterations(old_word, false)) {
         if (w != old_word) {
@@ -77,7 +241,7 @@ void Hints::add(KeyT key, Slice name) {
       }
     }
     for (auto &word : fix_words(old_transliterations)) {
-      delete_word(word, key, translit_word_to_keys_);
+      translit_word_index_.remove(word, key);
     }
   }
   if (name.empty()) {
@@ -90,7 +254,7 @@ void Hints::add(KeyT key, Slice name) {
 
   vector<string> transliterations;
   for (auto &word : get_words(name)) {
-    add_word(word, key, word_to_keys_);
+    word_index_.add(word, key);
 
     for (auto &w : get_word_transliterations(word, false)) {
       if (w != word) {
@@ -99,7 +263,7 @@ void Hints::add(KeyT key, Slice name) {
     }
   }
   for (auto &word : fix_words(transliterations)) {
-    add_word(word, key, translit_word_to_keys_);
+    translit_word_index_.add(word, key);
   }
 
   key_to_name_[key] = name.str();
@@ -110,27 +274,105 @@ void Hints::set_rating(KeyT key, RatingT rating) {
   key_to_rating_[key] = rating;
 }
 
-void Hints::add_search_results(vector<KeyT> &results, const string &word,
-                               const std::map<string, vector<KeyT>> &word_to_keys) {
-  LOG(DEBUG) << "Search for word " << word;
-  auto it = word_to_keys.lower_bound(word);
-  while (it != word_to_keys.end() && begins_with(it->first, word)) {
-    append(results, it->second);
-    ++it;
+vector<string> Hints::get_typo_variants(const string &word) const {
+  vector<Slice> characters;
+  auto ptr = Slice(word).ubegin();
+  auto end = Slice(word).uend();
+  while (ptr != end) {
+    uint32 code;
+    auto next_ptr = next_utf8_unsafe(ptr, &code);
+    characters.emplace_back(ptr, next_ptr);
+    ptr = next_ptr;
+  }
+  if (characters.size() < MIN_TYPO_WORD_LENGTH) {
+    return {};
+  }
+
+  auto join = [&](size_t begin, size_t end) {
+    string result;
+    for (size_t i = begin; i < end; i++) {
+      result.append(characters[i].begin(), characters[i].size());
+    }
+    return result;
+  };
+
+  // the first character is assumed to be typed correctly
+  vector<string> variants;
+  for (size_t i = 1; i < characters.size(); i++) {
+    auto prefix = join(0, i);
+    auto suffix = join(i + 1, characters.size());
+
+    // an extra character
+    variants.push_back(prefix + suffix);
+
+    // swapped adjacent characters
+    if (i + 1 < characters.size()) {
+      variants.push_back(PSTRING() << prefix << characters[i + 1] << characters[i] << join(i + 2, characters.size()));
+    }
+
+    vector<string> next_characters;
+    word_index_.add_next_characters(next_characters, prefix);
+    translit_word_index_.add_next_characters(next_characters, prefix);
+    td::unique(next_characters);
+    for (auto &character : next_characters) {
+      // a wrong character
+      if (character != characters[i]) {
+        variants.push_back(PSTRING() << prefix << character << suffix);
+      }
+
+      // a missing character
+      variants.push_back(PSTRING() << prefix << character << characters[i] << suffix);
+    }
   }
+  td::unique(variants);
+  return variants;
 }
 
 vector<Hints::KeyT> Hints::search_word(const string &word) const {
   vector<KeyT> results;
-  add_search_results(results, word, translit_word_to_keys_);
+  translit_word_index_.add_search_results(results, word);
   for (const auto &w : get_word_transliterations(word, true)) {
-    add_search_results(results, w, word_to_keys_);
+    word_index_.add_search_results(results, w);
+  }
+  if (allow_typos_) {
+    for (const auto &w : get_typo_variants(word)) {
+      word_index_.add_search_results(results, w);
+      translit_word_index_.add_search_results(results, w);
+    }
   }
 
   td::unique(results);
   return results;
 }
 
+Hints::RatingT Hints::get_rating(KeyT key) const {
+  auto it = key_to_rating_.find(key);
+  if (it == key_to_rating_.end()) {
+    return RatingT();
+  }
+  return it->second;
+}
+
+void Hints::sort_by_rating(vector<KeyT> &keys, size_t limit) const {
+  // find ratings only once instead of on every comparison
+  vector<std::pair<RatingT, KeyT>> rated_keys;
+  rated_keys.reserve(keys.size());
+  for (auto key : keys) {
+    rated_keys.emplace_back(get_rating(key), key);
+  }
+  if (limit < rated_keys.size()) {
+    std::partial_sort(rated_keys.begin(), rated_keys.begin() + limit, rated_keys.end());
+    rated_keys.resize(limit);
+  } else {
+    std::sort(rated_keys.begin(), rated_keys.end());
+  }
+
+  keys.resize(rated_keys.size());
+  for (size_t i = 0; i < rated_keys.size(); i++) {
+    keys[i] = rated_keys[i].second;
+  }
+}
+
 std::pair<size_t, vector<Hints::KeyT>> Hints::search(Slice query, int32 limit, bool return_all_for_empty_query) const {
   // LOG(ERROR) << "Search " << query;
   vector<KeyT> results;
@@ -173,12 +415,7 @@ std::pair<size_t, vector<Hints::KeyT>> Hints::search(Slice query, int32 limit, b
   }
 
   auto total_size = results.size();
-  if (total_size < static_cast<size_t>(limit)) {
-    std::sort(results.begin(), results.end(), CompareByRating(key_to_rating_));
-  } else {
-    std::partial_sort(results.begin(), results.begin() + limit, results.end(), CompareByRating(key_to_rating_));
-    results.resize(limit);
-  }
+  sort_by_rating(results, static_cast<size_t>(limit));
 
   return {total_size, std::move(results)};
 }
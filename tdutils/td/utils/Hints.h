@@ -30,6 +30,11 @@ class Hints {
 
   void set_rating(KeyT key, RatingT rating);
 
+  // allows one typo in query words of at least MIN_TYPO_WORD_LENGTH characters
+  void set_allow_typos(bool allow_typos) {
+    allow_typos_ = allow_typos;
+  }
+
   std::pair<size_t, vector<KeyT>> search(
       Slice query, int32 limit,
       bool return_all_for_empty_query = false) const;  // TODO sort by name instead of sort by rating
@@ -45,43 +50,62 @@ class Hints {
   static vector<string> fix_words(vector<string> words);
 
  private:
-  std::map<string, vector<KeyT>> word_to_keys_;
-  std::map<string, vector<KeyT>> translit_word_to_keys_;
-  std::unordered_map<KeyT, string, Hash<KeyT>> key_to_name_;
-  std::unordered_map<KeyT, RatingT, Hash<KeyT>> key_to_rating_;
+  static constexpr size_t MIN_TYPO_WORD_LENGTH = 4;
 
-  static void add_word(const string &word, KeyT key, std::map<string, vector<KeyT>> &word_to_keys);
-  static void delete_word(const string &word, KeyT key, std::map<string, vector<KeyT>> &word_to_keys);
+  // maps words to keys of names containing them
+  // most words are kept in a compact snapshot sorted by the words, which is rebuilt after enough changes;
+  // keys added since the last rebuild are kept in a map, and removed keys are deleted from the snapshot in place
+  class WordIndex {
+   public:
+    void add(const string &word, KeyT key);
 
-  static vector<string> get_words(Slice name);
+    void remove(const string &word, KeyT key);
 
-  static void add_search_results(vector<KeyT> &results, const string &word,
-                                 const std::map<string, vector<KeyT>> &word_to_keys);
+    void add_search_results(vector<KeyT> &results, Slice prefix) const;
 
-  vector<KeyT> search_word(const string &word) const;
+    // adds all characters following the prefix in the words
+    void add_next_characters(vector<string> &characters, Slice prefix) const;
 
-  class CompareByRating {
-    const std::unordered_map<KeyT, RatingT, Hash<KeyT>> &key_to_rating_;
+   private:
+    static constexpr size_t MIN_REBUILD_CHANGE_COUNT = 1000;
 
-    RatingT get_rating(const KeyT &key) const {
-      auto it = key_to_rating_.find(key);
-      if (it == key_to_rating_.end()) {
-        return RatingT();
-      }
-      return it->second;
-    }
+    string words_;                 // concatenated snapshot words in lexicographical order
+    vector<uint32> word_offsets_;  // i-th word is words_[word_offsets_[i], word_offsets_[i + 1])
+    vector<uint32> key_offsets_;   // keys of i-th word are keys_[key_offsets_[i], key_offsets_[i] + key_counts_[i])
+    vector<uint32> key_counts_;
+    vector<KeyT> keys_;
 
-   public:
-    explicit CompareByRating(const std::unordered_map<KeyT, RatingT, Hash<KeyT>> &key_to_rating)
-        : key_to_rating_(key_to_rating) {
-    }
+    std::map<string, vector<KeyT>> new_word_to_keys_;
+    size_t change_count_ = 0;
 
-    bool operator()(const KeyT &lhs, const KeyT &rhs) const {
-      auto lhs_rating = get_rating(lhs);
-      auto rhs_rating = get_rating(rhs);
-      return lhs_rating < rhs_rating || (lhs_rating == rhs_rating && lhs < rhs);
+    size_t get_word_count() const {
+      return key_counts_.size();
     }
+
+    Slice get_word(size_t pos) const;
+
+    std::pair<size_t, size_t> get_prefix_range(Slice prefix) const;
+
+    void on_changed();
+
+    void rebuild();
   };
+
+  WordIndex word_index_;
+  WordIndex translit_word_index_;
+  std::unordered_map<KeyT, string, Hash<KeyT>> key_to_name_;
+  std::unordered_map<KeyT, RatingT, Hash<KeyT>> key_to_rating_;
+  bool allow_typos_ = false;
+
+  static vector<string> get_words(Slice name);
+
+  vector<string> get_typo_variants(const string &word) const;
+
+  vector<KeyT> search_word(const string &word) const;
+
+  RatingT get_rating(KeyT key) const;
+
+  void sort_by_rating(vector<KeyT> &keys, size_t limit) const;
 };
 
 }  // namespace td
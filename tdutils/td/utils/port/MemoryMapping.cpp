@@ -25,6 +25,15 @@ namespace td {
 class MemoryMapping::Impl {
  public:
   Impl(MutableSlice data, int64 offset) : data_(data), offset_(offset) {
+  }
+  Impl(const Impl &) = delete;
+  Impl &operator=(const Impl &) = delete;
+  Impl(Impl &&) = delete;
+  Impl &operator=(Impl &&) = delete;
+  ~Impl() {
+#if !TD_WINDOWS
+    munmap(data_.data(), data_.size());
+#endif
   }
   Slice as_slice() const {
     return data_.substr(narrow_cast<size_t>(offset_));
@@ -69,11 +78,15 @@ Result<MemoryMapping> MemoryMapping::create_from_file(const FileFd &file_fd, con
     return Status::Error(PSLICE() << "Can't create memory mapping: negative offset " << options.offset);
   }
 
-  int64 end;
-  if (options.size < 0) {
-    end = stat.size_;
-  } else {
-    end = begin + stat.size_;
+  if (begin >= stat.size_) {
+    return Status::Error(PSLICE() << "Can't create memory mapping: offset " << begin << " is beyond file size "
+                                  << stat.size_);
+  }
+
+  // pages after the end of the file can't be accessed
+  int64 end = stat.size_;
+  if (options.size >= 0 && options.size < end - begin) {
+    end = begin + options.size;
   }
 
   TRY_RESULT(page_size, get_page_size());
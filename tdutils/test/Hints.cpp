@@ -0,0 +1,163 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/utils/tests.h"
+
+#include "td/utils/algorithm.h"
+#include "td/utils/common.h"
+#include "td/utils/Hints.h"
+#include "td/utils/misc.h"
+#include "td/utils/Random.h"
+#include "td/utils/Slice.h"
+#include "td/utils/translit.h"
+#include "td/utils/utf8.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+// straightforward implementation of the search without any index
+class NaiveHints {
+ public:
+  void add(td::int64 key, td::Slice name) {
+    if (name.empty()) {
+      names_.erase(key);
+      ratings_.erase(key);
+      return;
+    }
+
+    auto &words = names_[key];
+    words.first = td::Hints::fix_words(td::utf8_get_search_words(name));
+    words.second.clear();
+    for (auto &word : words.first) {
+      for (auto &w : td::get_word_transliterations(word, false)) {
+        if (w != word) {
+          words.second.push_back(w);
+        }
+      }
+    }
+  }
+
+  void set_rating(td::int64 key, td::int64 rating) {
+    ratings_[key] = rating;
+  }
+
+  std::pair<size_t, td::vector<td::int64>> search(td::Slice query, td::int32 limit) const {
+    auto query_words = td::Hints::fix_words(td::utf8_get_search_words(query));
+    td::vector<std::pair<td::int64, td::int64>> results;
+    td::vector<td::vector<td::string>> query_transliterations;
+    for (auto &query_word : query_words) {
+      query_transliterations.push_back(td::get_word_transliterations(query_word, true));
+    }
+    for (auto &it : names_) {
+      auto &words = it.second.first;
+      auto &translit_words = it.second.second;
+      bool is_found = true;
+      for (size_t i = 0; i < query_words.size() && is_found; i++) {
+        auto &query_word = query_words[i];
+        bool is_word_found =
+            td::any_of(translit_words, [&](const td::string &w) { return td::begins_with(w, query_word); });
+        for (auto &query_w : query_transliterations[i]) {
+          is_word_found |= td::any_of(words, [&](const td::string &w) { return td::begins_with(w, query_w); });
+        }
+        is_found &= is_word_found;
+      }
+      if (is_found && !query_words.empty()) {
+        auto rating_it = ratings_.find(it.first);
+        results.emplace_back(rating_it == ratings_.end() ? 0 : rating_it->second, it.first);
+      }
+    }
+    std::sort(results.begin(), results.end());
+
+    td::vector<td::int64> keys;
+    for (size_t i = 0; i < results.size() && i < static_cast<size_t>(limit); i++) {
+      keys.push_back(results[i].second);
+    }
+    return {results.size(), std::move(keys)};
+  }
+
+ private:
+  // words and their transliterations
+  std::map<td::int64, std::pair<td::vector<td::string>, td::vector<td::string>>> names_;
+  std::map<td::int64, td::int64> ratings_;
+};
+
+TEST(Hints, random) {
+  td::Random::Xorshift128plus rnd(123);
+  td::vector<td::string> syllables{"a", "al", "ex", "and", "er", "ma", "ri", "ya", "ан", "др", "ей", "ки", "ta", "x"};
+  auto gen_word = [&] {
+    td::string word;
+    auto length = rnd.fast(1, 4);
+    for (int i = 0; i < length; i++) {
+      word += syllables[rnd.fast(0, static_cast<int>(syllables.size()) - 1)];
+    }
+    return word;
+  };
+  auto gen_name = [&] {
+    td::string name;
+    auto word_count = rnd.fast(1, 3);
+    for (int i = 0; i < word_count; i++) {
+      if (!name.empty()) {
+        name += ' ';
+      }
+      name += gen_word();
+    }
+    return name;
+  };
+
+  td::Hints hints;
+  NaiveHints naive_hints;
+  auto add = [&] {
+    auto key = rnd.fast(-2000, 2000);
+    auto name = rnd.fast(0, 5) == 0 ? td::string() : gen_name();
+    hints.add(key, name);
+    naive_hints.add(key, name);
+  };
+  auto set_rating = [&] {
+    auto key = rnd.fast(-2000, 2000);
+    auto rating = rnd.fast(-10, 10);
+    hints.set_rating(key, rating);
+    naive_hints.set_rating(key, rating);
+  };
+  auto search = [&] {
+    auto query = rnd.fast(0, 1) == 0 ? gen_word() : gen_name();
+    query.resize(rnd.fast(0, static_cast<int>(query.size())));
+    if (!td::check_utf8(query)) {
+      return;
+    }
+    auto limit = rnd.fast(0, 20);
+    ASSERT_EQ(naive_hints.search(query, limit), hints.search(query, limit));
+  };
+  td::RandomSteps steps({{add, 10}, {set_rating, 3}, {search, 1}});
+  for (int i = 0; i < 50000; i++) {
+    steps.step(rnd);
+  }
+}
+
+TEST(Hints, typos) {
+  td::Hints hints;
+  hints.add(1, "Alexander Smith");
+  hints.add(2, "Maria Ivanova");
+  hints.add(3, "Alexey");
+  hints.set_rating(3, -1);
+
+  auto search = [&](td::Slice query) {
+    return hints.search(query, 10).second;
+  };
+  ASSERT_TRUE(search("alexnader").empty());
+  ASSERT_TRUE(search("mraia").empty());
+
+  hints.set_allow_typos(true);
+  ASSERT_EQ(td::vector<td::int64>{1}, search("alexnader"));
+  ASSERT_EQ(td::vector<td::int64>{1}, search("alexandr"));
+  ASSERT_EQ(td::vector<td::int64>{1}, search("alexamder"));
+  ASSERT_EQ(td::vector<td::int64>{1}, search("alexxander"));
+  ASSERT_EQ(td::vector<td::int64>{2}, search("mraia"));
+  ASSERT_EQ(td::vector<td::int64>{2}, search("ivanvoa"));
+  ASSERT_EQ((td::vector<td::int64>{3, 1}), search("alexy"));
+  ASSERT_TRUE(search("blexander").empty());
+  ASSERT_TRUE(search("axd").empty());
+}
@@ -6,11 +6,13 @@
 //
 #include "td/utils/algorithm.h"
 #include "td/utils/common.h"
+#include "td/utils/filesystem.h"
 #include "td/utils/logging.h"
 #include "td/utils/misc.h"
 #include "td/utils/port/EventFd.h"
 #include "td/utils/port/FileFd.h"
 #include "td/utils/port/IoSlice.h"
+#include "td/utils/port/MemoryMapping.h"
 #include "td/utils/port/path.h"
 #include "td/utils/port/signals.h"
 #include "td/utils/port/sleep.h"
@@ -109,6 +111,33 @@ TEST(Port, files) {
   td::rmrf(main_dir).ensure();
 }
 
+TEST(Port, HardLinks) {
+  td::CSlice main_dir = "test_hard_links_dir";
+  td::rmrf(main_dir).ignore();
+  td::mkdir(main_dir).ensure();
+  td::string path = PSTRING() << main_dir << TD_DIR_SLASH << "file";
+  td::string link_path = PSTRING() << main_dir << TD_DIR_SLASH << "link";
+  td::write_file(path, "Hello world!").ensure();
+
+  td::link(path, link_path).ensure();
+  ASSERT_TRUE(td::link(path, link_path).is_error());
+  ASSERT_TRUE(td::link(PSLICE() << main_dir << TD_DIR_SLASH << "none", link_path).is_error());
+  ASSERT_EQ(2, td::stat(path).ok().link_count_);
+  ASSERT_EQ(2, td::stat(link_path).ok().link_count_);
+  ASSERT_EQ("Hello world!", td::read_file_str(link_path).ok());
+
+  // the links share the content
+  auto fd = td::FileFd::open(link_path, td::FileFd::Write).move_as_ok();
+  ASSERT_EQ(4u, fd.pwrite("abcd", 1).move_as_ok());
+  fd.close();
+  ASSERT_EQ("Habcd world!", td::read_file_str(path).ok());
+
+  td::unlink(path).ensure();
+  ASSERT_EQ(1, td::stat(link_path).ok().link_count_);
+  ASSERT_EQ("Habcd world!", td::read_file_str(link_path).ok());
+  td::rmrf(main_dir).ensure();
+}
+
 TEST(Port, SparseFiles) {
   td::CSlice path = "sparse.txt";
   td::unlink(path).ignore();
@@ -148,6 +177,41 @@ TEST(Port, LargeFiles) {
   td::unlink(path).ensure();
 }
 
+#if TD_PORT_POSIX
+TEST(Port, MemoryMapping) {
+  td::CSlice path = "mapping.txt";
+  td::unlink(path).ignore();
+  td::string content(100000, 'a');
+  for (size_t i = 0; i < content.size(); i++) {
+    content[i] = static_cast<char>('a' + i % 26);
+  }
+  td::write_file(path, content).ensure();
+
+  auto fd = td::FileFd::open(path, td::FileFd::Read).move_as_ok();
+  {
+    auto mapping = td::MemoryMapping::create_from_file(fd).move_as_ok();
+    ASSERT_STREQ(content, mapping.as_slice());
+    ASSERT_TRUE(mapping.as_mutable_slice().empty());
+  }
+  {
+    auto mapping =
+        td::MemoryMapping::create_from_file(fd, td::MemoryMapping::Options().with_offset(5000).with_size(100))
+            .move_as_ok();
+    ASSERT_STREQ(td::Slice(content).substr(5000, 100), mapping.as_slice());
+  }
+  {
+    auto mapping =
+        td::MemoryMapping::create_from_file(fd, td::MemoryMapping::Options().with_offset(99990).with_size(100))
+            .move_as_ok();
+    ASSERT_STREQ(td::Slice(content).substr(99990), mapping.as_slice());
+  }
+  ASSERT_TRUE(
+      td::MemoryMapping::create_from_file(fd, td::MemoryMapping::Options().with_offset(100000)).is_error());
+  fd.close();
+  td::unlink(path).ensure();
+}
+#endif
+
 TEST(Port, Writev) {
   td::vector<td::IoSlice> vec;
   td::CSlice test_file_path = "test.txt";
@@ -6,6 +6,14 @@
 //
 #include "data.h"
 
+#include "td/telegram/DialogId.h"
+#include "td/telegram/MessageDb.h"
+#include "td/telegram/MessageFullId.h"
+#include "td/telegram/MessageId.h"
+#include "td/telegram/NotificationId.h"
+#include "td/telegram/ServerMessageId.h"
+#include "td/telegram/Version.h"
+
 #include "td/db/binlog/BinlogHelper.h"
 #include "td/db/binlog/ConcurrentBinlog.h"
 #include "td/db/BinlogKeyValue.h"
@@ -21,18 +29,25 @@
 #include "td/actor/ConcurrentScheduler.h"
 
 #include "td/utils/base64.h"
+#include "td/utils/buffer.h"
 #include "td/utils/common.h"
 #include "td/utils/filesystem.h"
 #include "td/utils/FlatHashMap.h"
 #include "td/utils/logging.h"
+#include "td/utils/misc.h"
 #include "td/utils/port/FileFd.h"
+#include "td/utils/port/sleep.h"
 #include "td/utils/port/thread.h"
+#include "td/utils/Promise.h"
 #include "td/utils/Random.h"
 #include "td/utils/Slice.h"
+#include "td/utils/SliceBuilder.h"
 #include "td/utils/Status.h"
 #include "td/utils/StringBuilder.h"
 #include "td/utils/tests.h"
+#include "td/utils/Time.h"
 
+#include <atomic>
 #include <limits>
 #include <map>
 #include <memory>
@@ -138,6 +153,91 @@ TEST(DB, binlog_encryption) {
   td::Binlog::destroy(binlog_name).ignore();
 }
 
+TEST(DB, binlog_large) {
+  td::CSlice binlog_name = "test_binlog";
+
+  for (auto db_key : {td::DbKey::empty(), td::DbKey::raw_key(td::string(32, 'A'))}) {
+    td::Binlog::destroy(binlog_name).ignore();
+    td::vector<td::string> events;
+    {
+      td::Binlog binlog;
+      binlog.init(binlog_name.str(), [](const td::BinlogEvent &x) {}, db_key).ensure();
+      for (int i = 0; i < 30000; i++) {
+        // the binlog must be big enough to be loaded by several threads
+        events.push_back(td::string(td::Random::fast(1, 50) * 4, static_cast<char>('a' + i % 26)));
+        binlog.add_raw_event(td::BinlogEvent::create_raw(binlog.next_event_id(), 1, 0, td::create_storer(events.back())),
+                             td::BinlogDebugInfo{__FILE__, __LINE__});
+      }
+      binlog.close().ensure();
+    }
+
+    // an incomplete event must be truncated
+    auto fd = td::FileFd::open(binlog_name, td::FileFd::Flags::Write | td::FileFd::Flags::Append).move_as_ok();
+    fd.write("aba").ensure();
+    fd.close();
+
+    for (int i = 0; i < 2; i++) {
+      td::vector<td::string> v;
+      td::Binlog binlog;
+      binlog
+          .init(
+              binlog_name.str(), [&](const td::BinlogEvent &x) { v.push_back(x.get_data().str()); }, db_key)
+          .ensure();
+      ASSERT_TRUE(v == events);
+
+      // new events must be readable after the restart
+      events.push_back("CCCC");
+      binlog.add_raw_event(td::BinlogEvent::create_raw(binlog.next_event_id(), 1, 0, td::create_storer("CCCC")),
+                           td::BinlogDebugInfo{__FILE__, __LINE__});
+      binlog.close().ensure();
+    }
+  }
+
+  td::Binlog::destroy(binlog_name).ignore();
+}
+
+TEST(DB, binlog_compaction) {
+  td::CSlice binlog_name = "test_binlog";
+
+  for (auto db_key : {td::DbKey::empty(), td::DbKey::raw_key(td::string(32, 'A'))}) {
+    td::Binlog::destroy(binlog_name).ignore();
+    std::map<td::uint64, td::string> events;
+    for (int restart = 0; restart < 3; restart++) {
+      std::map<td::uint64, td::string> v;
+      td::Binlog binlog;
+      binlog
+          .init(
+              binlog_name.str(), [&](const td::BinlogEvent &x) { v[x.id_] = x.get_data().str(); }, db_key)
+          .ensure();
+      ASSERT_TRUE(v == events);
+
+      // erased events make the binlog to be compacted many times in background
+      for (int i = 0; i < 20000; i++) {
+        if (!events.empty() && td::Random::fast_bool()) {
+          auto it = events.lower_bound(td::Random::fast_uint64() % binlog.peek_next_event_id());
+          if (it == events.end()) {
+            it = events.begin();
+          }
+          binlog.erase(it->first);
+          events.erase(it);
+        } else {
+          auto data = td::string(td::Random::fast(1, 100) * 4, static_cast<char>('a' + i % 26));
+          events[binlog.add(1, td::create_storer(data))] = data;
+        }
+      }
+      for (int i = 0; i < 1000 && binlog.get_info().compaction_count == 0; i++) {
+        // the last compaction may be still running in background
+        td::usleep_for(1000);
+        binlog.flush("binlog_compaction");
+      }
+      ASSERT_TRUE(binlog.get_info().compaction_count > 0);
+      binlog.close().ensure();
+    }
+  }
+
+  td::Binlog::destroy(binlog_name).ignore();
+}
+
 TEST(DB, sqlite_lfs) {
   td::string path = "test_sqlite_db";
   td::SqliteDb::destroy(path).ignore();
@@ -807,3 +907,298 @@ TEST(DB, persistent_key_value) {
   }
   td::SqliteDb::destroy(path).ignore();
 }
+
+static std::shared_ptr<td::MessageDbSyncSafeInterface> open_message_db(td::CSlice path) {
+  auto sql_connection = std::make_shared<td::SqliteConnectionSafe>(path.str(), td::DbKey::empty());
+  sql_connection->set(td::SqliteDb::open_with_key(path, true, td::DbKey::empty()).move_as_ok());
+  auto &db = sql_connection->get();
+  db.exec("PRAGMA journal_mode=WAL").ensure();
+  db.exec("BEGIN TRANSACTION").ensure();
+  td::init_message_db(db, td::current_db_version()).ensure();
+  db.exec("COMMIT TRANSACTION").ensure();
+  return td::create_message_db_sync(std::move(sql_connection));
+}
+
+static td::MessageFullId get_test_message_full_id(td::int32 server_message_id) {
+  return td::MessageFullId(td::DialogId(static_cast<td::int64>(1000)),
+                           td::MessageId(td::ServerMessageId(server_message_id)));
+}
+
+static void add_test_message(td::MessageDbSyncInterface &message_db, td::int32 server_message_id, td::string text) {
+  message_db.begin_write_transaction().ensure();
+  message_db.add_message(get_test_message_full_id(server_message_id), td::ServerMessageId(), td::DialogId(), 0, 0, 0,
+                         server_message_id, std::move(text), td::NotificationId(), td::MessageId(),
+                         td::BufferSlice("data"));
+  message_db.commit_transaction().ensure();
+}
+
+static td::vector<td::int64> search_test_messages(td::MessageDbSyncInterface &message_db, td::string query) {
+  td::MessageDbFtsQuery fts_query;
+  fts_query.query = std::move(query);
+  td::vector<td::int64> result;
+  for (auto &message : message_db.get_messages_fts(std::move(fts_query)).messages) {
+    result.push_back(message.message_id.get_server_message_id().get());
+  }
+  return result;
+}
+
+TEST(DB, message_db_deferred_fts_indexing) {
+  td::CSlice path = "test_message_db.sqlite";
+  td::SqliteDb::destroy(path).ignore();
+
+  td::ConcurrentScheduler sched(0, 0);
+  sched.start();
+  {
+    auto guard = sched.get_main_guard();
+    auto message_db_safe = open_message_db(path);
+    auto &message_db = message_db_safe->get();
+    message_db.begin_write_transaction().ensure();
+    message_db.set_use_deferred_fts_indexing(true).ensure();
+    message_db.commit_transaction().ensure();
+
+    // pending messages are found before they are indexed
+    add_test_message(message_db, 1, "hello world");
+    ASSERT_TRUE(message_db.has_pending_fts_messages());
+    ASSERT_EQ(td::vector<td::int64>{1}, search_test_messages(message_db, "hello"));
+    ASSERT_TRUE(search_test_messages(message_db, "unknown").empty());
+
+    message_db.begin_write_transaction().ensure();
+    ASSERT_TRUE(!message_db.index_pending_fts_messages(1000));
+    message_db.commit_transaction().ensure();
+    ASSERT_TRUE(!message_db.has_pending_fts_messages());
+    ASSERT_EQ(td::vector<td::int64>{1}, search_test_messages(message_db, "hello"));
+
+    // the re-added message is both in the index and in the pending list, but must be returned once
+    add_test_message(message_db, 1, "hello again");
+    add_test_message(message_db, 2, "hello there");
+    ASSERT_TRUE(message_db.has_pending_fts_messages());
+    ASSERT_EQ((td::vector<td::int64>{2, 1}), search_test_messages(message_db, "hello"));
+    ASSERT_EQ(td::vector<td::int64>{1}, search_test_messages(message_db, "again"));
+
+    message_db.begin_write_transaction().ensure();
+    ASSERT_TRUE(!message_db.index_pending_fts_messages(1000));
+    message_db.commit_transaction().ensure();
+    ASSERT_EQ((td::vector<td::int64>{2, 1}), search_test_messages(message_db, "hello"));
+    ASSERT_EQ(td::vector<td::int64>{2}, search_test_messages(message_db, "there"));
+
+    message_db_safe.reset();
+  }
+  sched.finish();
+  td::SqliteDb::destroy(path).ignore();
+}
+
+template <class T, class F>
+static td::Result<T> run_message_db_query(td::ConcurrentScheduler &sched, F &&f) {
+  bool is_ready = false;
+  td::Result<T> result;
+  {
+    auto guard = sched.get_main_guard();
+    f(td::PromiseCreator::lambda([&is_ready, &result](td::Result<T> r_result) {
+      result = std::move(r_result);
+      is_ready = true;
+    }));
+  }
+  while (!is_ready) {
+    sched.run_main(0.1);
+  }
+  return result;
+}
+
+static void add_test_message_async(td::MessageDbAsyncInterface &message_db, td::int32 server_message_id,
+                                   td::Slice data, td::Promise<td::Unit> promise) {
+  message_db.add_message(get_test_message_full_id(server_message_id), td::ServerMessageId(), td::DialogId(), 0, 0, 0,
+                         0, td::string(), td::NotificationId(), td::MessageId(), td::BufferSlice(data),
+                         std::move(promise));
+}
+
+TEST(DB, message_db_group_commit) {
+  td::CSlice path = "test_message_db.sqlite";
+  td::CSlice copy_path = "test_message_db_copy.sqlite";
+  td::SqliteDb::destroy(path).ignore();
+  td::SqliteDb::destroy(copy_path).ignore();
+
+  td::ConcurrentScheduler sched(0, 0);
+  sched.start();
+  std::shared_ptr<td::MessageDbSyncSafeInterface> message_db_sync;
+  std::shared_ptr<td::MessageDbAsyncInterface> message_db;
+  {
+    auto guard = sched.get_main_guard();
+    message_db_sync = open_message_db(path);
+    message_db = td::create_message_db_async(message_db_sync, 0);
+  }
+  auto get_write_statistics = [&] {
+    return run_message_db_query<td::MessageDbWriteStatistics>(sched, [&](auto promise) {
+             message_db->get_write_statistics(std::move(promise));
+           })
+        .move_as_ok();
+  };
+  auto add_messages = [&](td::int32 from_server_message_id, td::int32 count) {
+    auto promise_count = 0;
+    {
+      auto guard = sched.get_main_guard();
+      for (td::int32 i = 0; i < count; i++) {
+        add_test_message_async(*message_db, from_server_message_id + i, "data",
+                               td::PromiseCreator::lambda([&promise_count](td::Unit) { promise_count++; }));
+      }
+    }
+    while (promise_count < count) {
+      sched.run_main(0.1);
+    }
+  };
+
+  // a single write is flushed by timeout
+  auto start_time = td::Time::now();
+  add_messages(1, 1);
+  ASSERT_TRUE(td::Time::now() - start_time >= 0.005);
+  auto statistics = get_write_statistics();
+  ASSERT_EQ(1, statistics.batch_count);
+  ASSERT_EQ(1, statistics.last_batch_size);
+  ASSERT_EQ(50, statistics.batch_size_limit);
+
+  // a full batch is flushed immediately and the batch size limit grows
+  add_messages(100, 51);
+  statistics = get_write_statistics();
+  ASSERT_EQ(2, statistics.batch_count);
+  ASSERT_EQ(52, statistics.write_count);
+  ASSERT_EQ(51, statistics.max_batch_size);
+  ASSERT_EQ(100, statistics.batch_size_limit);
+
+  // the limit shrinks back after a small batch is flushed by timeout
+  add_messages(200, 2);
+  statistics = get_write_statistics();
+  ASSERT_EQ(3, statistics.batch_count);
+  ASSERT_EQ(2, statistics.last_batch_size);
+  ASSERT_EQ(50, statistics.batch_size_limit);
+
+  // a pending message is returned by a read query
+  auto r_message = run_message_db_query<td::MessageDbDialogMessage>(sched, [&](auto promise) {
+    add_test_message_async(*message_db, 300, "pending data", td::Promise<td::Unit>());
+    message_db->get_message(get_test_message_full_id(300), std::move(promise));
+  });
+  ASSERT_TRUE(r_message.is_ok());
+  ASSERT_EQ("pending data", r_message.ok().data.as_slice());
+
+  // a crash loses only pending writes
+  {
+    auto guard = sched.get_main_guard();
+    add_test_message_async(*message_db, 400, "data", td::Promise<td::Unit>());
+    for (auto suffix : {"", "-wal"}) {
+      auto data = td::read_file_str(PSLICE() << path << suffix).move_as_ok();
+      td::write_file(PSLICE() << copy_path << suffix, data).ensure();
+    }
+  }
+  {
+    auto guard = sched.get_main_guard();
+    auto copy_message_db = open_message_db(copy_path);
+    ASSERT_TRUE(copy_message_db->get().get_message(get_test_message_full_id(300)).is_ok());
+    ASSERT_TRUE(copy_message_db->get().get_message(get_test_message_full_id(400)).is_error());
+  }
+
+  // pending writes are committed on close
+  auto promise_count = 0;
+  bool is_closed = false;
+  {
+    auto guard = sched.get_main_guard();
+    for (td::int32 i = 0; i < 10; i++) {
+      add_test_message_async(*message_db, 500 + i, "data",
+                             td::PromiseCreator::lambda([&promise_count](td::Unit) { promise_count++; }));
+    }
+    message_db->close(td::PromiseCreator::lambda([&is_closed](td::Unit) { is_closed = true; }));
+  }
+  while (!is_closed) {
+    sched.run_main(0.1);
+  }
+  ASSERT_EQ(10, promise_count);
+  {
+    auto guard = sched.get_main_guard();
+    message_db.reset();
+    message_db_sync.reset();
+    message_db_sync = open_message_db(path);
+    for (td::int32 i = 0; i < 10; i++) {
+      ASSERT_TRUE(message_db_sync->get().get_message(get_test_message_full_id(500 + i)).is_ok());
+    }
+    ASSERT_TRUE(message_db_sync->get().get_message(get_test_message_full_id(400)).is_ok());
+    message_db_sync.reset();
+  }
+  sched.finish();
+  td::SqliteDb::destroy(path).ignore();
+  td::SqliteDb::destroy(copy_path).ignore();
+}
+
+TEST(DB, message_db_read_after_write) {
+  td::CSlice path = "test_message_db.sqlite";
+  td::SqliteDb::destroy(path).ignore();
+
+  td::ConcurrentScheduler sched(2, 0);
+  sched.start();
+  std::shared_ptr<td::MessageDbSyncSafeInterface> message_db_sync;
+  std::shared_ptr<td::MessageDbAsyncInterface> message_db;
+  {
+    auto guard = sched.get_main_guard();
+    message_db_sync = open_message_db(path);
+    message_db = td::create_message_db_async(message_db_sync, 0, {1, 2});
+  }
+
+  // read queries are run on reader schedulers, so they can see later writes, but never miss a previous write
+  constexpr int WRITE_COUNT = 300;
+  constexpr int MESSAGE_COUNT = 10;
+  td::vector<int> read_versions(WRITE_COUNT, -1);
+  td::vector<int> is_deleted(MESSAGE_COUNT);
+  std::atomic<int> result_count{0};
+  for (int i = 0; i < WRITE_COUNT; i++) {
+    auto guard = sched.get_main_guard();
+    auto server_message_id = i % MESSAGE_COUNT + 1;
+    add_test_message_async(*message_db, server_message_id, td::to_string(i), td::Promise<td::Unit>());
+    if (i % 3 == 0) {
+      // a pending write to another dialog must not affect the query
+      message_db->add_message(
+          td::MessageFullId(td::DialogId(static_cast<td::int64>(2000)), td::MessageId(td::ServerMessageId(i + 1))),
+          td::ServerMessageId(), td::DialogId(), 0, 0, 0, 0, td::string(), td::NotificationId(), td::MessageId(),
+          td::BufferSlice("other"), td::Promise<td::Unit>());
+    }
+    message_db->get_message(get_test_message_full_id(server_message_id),
+                            td::PromiseCreator::lambda([&, i](td::Result<td::MessageDbDialogMessage> r_message) {
+                              if (r_message.is_ok()) {
+                                read_versions[i] = td::to_integer<int>(r_message.ok().data.as_slice());
+                              }
+                              result_count++;
+                            }));
+  }
+  {
+    auto guard = sched.get_main_guard();
+    for (int i = 0; i < MESSAGE_COUNT; i++) {
+      auto message_full_id = get_test_message_full_id(i + 1);
+      message_db->delete_message(message_full_id, td::Promise<td::Unit>());
+      message_db->get_message(message_full_id,
+                              td::PromiseCreator::lambda([&, i](td::Result<td::MessageDbDialogMessage> r_message) {
+                                is_deleted[i] = r_message.is_error() ? 1 : 0;
+                                result_count++;
+                              }));
+    }
+  }
+  while (result_count.load() < WRITE_COUNT + MESSAGE_COUNT) {
+    sched.run_main(0.1);
+  }
+  for (int i = 0; i < WRITE_COUNT; i++) {
+    ASSERT_TRUE(read_versions[i] >= i);
+  }
+  for (int i = 0; i < MESSAGE_COUNT; i++) {
+    ASSERT_EQ(1, is_deleted[i]);
+  }
+
+  std::atomic<bool> is_closed{false};
+  {
+    auto guard = sched.get_main_guard();
+    message_db->close(td::PromiseCreator::lambda([&is_closed](td::Unit) { is_closed = true; }));
+  }
+  while (!is_closed.load()) {
+    sched.run_main(0.1);
+  }
+  {
+    auto guard = sched.get_main_guard();
+    message_db.reset();
+    message_db_sync.reset();
+  }
+  sched.finish();
+  td::SqliteDb::destroy(path).ignore();
+}
@@ -0,0 +1,595 @@
+//
+// Copyright Aliaksei Levin (levlam@telegram.org), Arseny Smirnov (arseny30@gmail.com) 2014-2024
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "td/telegram/DialogId.h"
+#include "td/telegram/files/FileData.h"
+#include "td/telegram/files/FileDb.h"
+#include "td/telegram/files/FileGcParameters.h"
+#include "td/telegram/files/FileGcWorker.h"
+#include "td/telegram/files/FileLoadManager.h"
+#include "td/telegram/files/FileLoaderUtils.h"
+#include "td/telegram/files/FileLocation.h"
+#include "td/telegram/files/FilePartWorker.h"
+#include "td/telegram/files/FileStats.h"
+#include "td/telegram/files/FileType.h"
+#include "td/telegram/files/LoadSpeedEstimator.h"
+#include "td/telegram/files/ResourceManager.h"
+
+#include "td/db/DbKey.h"
+#include "td/db/SqliteConnectionSafe.h"
+
+#include "td/actor/actor.h"
+#include "td/actor/ConcurrentScheduler.h"
+
+#include "td/utils/algorithm.h"
+#include "td/utils/as.h"
+#include "td/utils/buffer.h"
+#include "td/utils/common.h"
+#include "td/utils/crypto.h"
+#include "td/utils/filesystem.h"
+#include "td/utils/port/FileFd.h"
+#include "td/utils/port/path.h"
+#include "td/utils/port/Stat.h"
+#include "td/utils/Promise.h"
+#include "td/utils/SliceBuilder.h"
+#include "td/utils/Status.h"
+#include "td/utils/tests.h"
+
+#include <memory>
+
+static td::FullFileInfo get_test_file_info(td::string path, td::int64 size, double idle_time, double now,
+                                           td::FileType file_type = td::FileType::Document,
+                                           td::DialogId owner_dialog_id = td::DialogId()) {
+  td::FullFileInfo info;
+  info.file_type = file_type;
+  info.path = std::move(path);
+  info.owner_dialog_id = owner_dialog_id;
+  info.size = size;
+  info.atime_nsec = static_cast<td::uint64>((now - idle_time) * 1e9);
+  info.mtime_nsec = info.atime_nsec;
+  return info;
+}
+
+static td::vector<td::string> get_sorted_file_paths(td::FileGcPolicy policy, td::vector<td::FullFileInfo> files,
+                                                    double now) {
+  td::FileGcWorker::sort_files(policy, files, now);
+  return td::transform(files, [](const td::FullFileInfo &info) { return info.path; });
+}
+
+TEST(Files, FileGcPolicy) {
+  double now = 1700000000.0;
+  td::vector<td::FullFileInfo> files;
+  files.push_back(get_test_file_info("small_old", 1000, 3000.0, now));
+  files.push_back(get_test_file_info("big_recent", 1000000, 1000.0, now));
+  files.push_back(get_test_file_info("small_recent", 1000, 1000.0, now));
+  files.push_back(get_test_file_info("medium_oldest", 100000, 4000.0, now));
+
+  // the least recently accessed files are removed first
+  ASSERT_EQ(td::vector<td::string>({"medium_oldest", "small_old", "big_recent", "small_recent"}),
+            get_sorted_file_paths(td::FileGcPolicy::LeastRecentlyUsed, files, now));
+
+  // a big file is removed before smaller files, which were accessed earlier,
+  // but of files of the same size the least recently accessed file is removed first
+  ASSERT_EQ(td::vector<td::string>({"big_recent", "medium_oldest", "small_old", "small_recent"}),
+            get_sorted_file_paths(td::FileGcPolicy::SizeAware, files, now));
+
+  // empty files and files accessed in the future are still ordered
+  files.push_back(get_test_file_info("empty_old", 0, 5000.0, now));
+  files.push_back(get_test_file_info("small_future", 1000, -1000.0, now));
+  auto paths = get_sorted_file_paths(td::FileGcPolicy::SizeAware, files, now);
+  ASSERT_EQ(files.size(), paths.size());
+  ASSERT_EQ("big_recent", paths[0]);
+  ASSERT_EQ("small_future", paths.back());
+}
+
+TEST(Files, FileGcBackgroundRemoveSteps) {
+  auto batch_size = td::FileGcWorker::MAX_BACKGROUND_REMOVED_FILE_COUNT;
+  ASSERT_TRUE(batch_size > 0u);
+  ASSERT_TRUE(td::FileGcWorker::BACKGROUND_REMOVE_DELAY > 0.0);
+
+  // foreground GC removes all files at once
+  ASSERT_EQ(0u, td::FileGcWorker::get_remove_step_file_count(false, 0));
+  ASSERT_EQ(batch_size * 10, td::FileGcWorker::get_remove_step_file_count(false, batch_size * 10));
+
+  // background GC removes files in steps of limited size
+  ASSERT_EQ(0u, td::FileGcWorker::get_remove_step_file_count(true, 0));
+  ASSERT_EQ(1u, td::FileGcWorker::get_remove_step_file_count(true, 1));
+  ASSERT_EQ(batch_size, td::FileGcWorker::get_remove_step_file_count(true, batch_size));
+  ASSERT_EQ(batch_size, td::FileGcWorker::get_remove_step_file_count(true, batch_size + 1));
+
+  size_t file_count = batch_size * 5 + 7;
+  size_t removed_file_count = 0;
+  int step_count = 0;
+  while (removed_file_count < file_count) {
+    auto step_file_count = td::FileGcWorker::get_remove_step_file_count(true, file_count - removed_file_count);
+    ASSERT_TRUE(step_file_count > 0u);
+    ASSERT_TRUE(step_file_count <= batch_size);
+    removed_file_count += step_file_count;
+    step_count++;
+  }
+  ASSERT_EQ(file_count, removed_file_count);
+  ASSERT_EQ(6, step_count);
+}
+
+TEST(Files, FileUsageStats) {
+  double now = 1700000000.0;
+  td::DialogId first_dialog_id(static_cast<td::int64>(1000));
+  td::DialogId second_dialog_id(static_cast<td::int64>(2000));
+
+  // statistics collected by a scan
+  td::FileStats stats(false, true);
+  stats.add_copy(get_test_file_info("a", 100, 1.0, now, td::FileType::Photo, first_dialog_id));
+  stats.add_copy(get_test_file_info("b", 200, 1.0, now, td::FileType::Document, first_dialog_id));
+  stats.add_copy(get_test_file_info("c", 300, 1.0, now, td::FileType::Video, second_dialog_id));
+  stats.add_copy(get_test_file_info("d", 5000, 1.0, now, td::FileType::Temp, td::DialogId()));
+  ASSERT_EQ(600, stats.get_total_nontemp_stat().size);
+  ASSERT_EQ(3, stats.get_total_nontemp_stat().cnt);
+
+  // incremental updates of the index
+  auto index = stats.get_copy_without_files();
+  ASSERT_TRUE(index.get_all_files().empty());
+  ASSERT_EQ(600, index.get_total_nontemp_stat().size);
+  index.add_files(td::FileType::Video, second_dialog_id, 1000, 1);
+  index.add_files(td::FileType::Photo, first_dialog_id, -100, -1);
+  ASSERT_EQ(1500, index.get_total_nontemp_stat().size);
+  ASSERT_EQ(3, index.get_total_nontemp_stat().cnt);
+
+  // temporary files are kept in the index, but aren't counted in the total size
+  index.add_files(td::FileType::Temp, td::DialogId(), 7000, 1);
+  ASSERT_EQ(1500, index.get_total_nontemp_stat().size);
+
+  auto dialog_ids = index.get_dialog_ids();
+  ASSERT_TRUE(td::contains(dialog_ids, first_dialog_id));
+  ASSERT_TRUE(td::contains(dialog_ids, second_dialog_id));
+
+  // the index is independent of the statistics it was copied from
+  ASSERT_EQ(600, stats.get_total_nontemp_stat().size);
+}
+
+TEST(Files, LoadSpeedEstimator) {
+  td::LoadSpeedEstimator estimator;
+  double now = 1000.0;
+  ASSERT_EQ(0, estimator.get_speed(now));
+  ASSERT_EQ(0.0, estimator.get_min_rtt(now));
+
+  // 10 parts of 100000 bytes per second with round-trip time 0.2
+  for (int i = 0; i < 50; i++) {
+    now += 0.1;
+    estimator.on_part_loaded(100000, 0.2, now);
+  }
+  auto speed = estimator.get_speed(now);
+  ASSERT_TRUE(speed > 900000);
+  ASSERT_TRUE(speed < 1100000);
+  ASSERT_EQ(0.2, estimator.get_smoothed_rtt());
+  ASSERT_EQ(0.2, estimator.get_min_rtt(now));
+
+  // the speed changes smoothly
+  for (int i = 0; i < 10; i++) {
+    now += 0.1;
+    estimator.on_part_loaded(300000, 0.5, now);
+  }
+  auto new_speed = estimator.get_speed(now);
+  ASSERT_TRUE(new_speed > speed);
+  ASSERT_TRUE(new_speed < 3000000);
+  ASSERT_TRUE(estimator.get_smoothed_rtt() > 0.2);
+  ASSERT_TRUE(estimator.get_smoothed_rtt() < 0.5);
+  ASSERT_EQ(0.2, estimator.get_min_rtt(now));
+
+  // the minimum round-trip time is forgotten in at most 2 minutes
+  for (int i = 0; i < 1200; i++) {
+    now += 0.1;
+    estimator.on_part_loaded(300000, 0.5, now);
+  }
+  ASSERT_EQ(0.5, estimator.get_min_rtt(now));
+
+  // the speed is unknown after a pause and is measured from scratch after it
+  now += 10.0;
+  ASSERT_EQ(0, estimator.get_speed(now));
+  estimator.on_part_loaded(50000, 0.5, now);
+  speed = estimator.get_speed(now);
+  ASSERT_TRUE(speed > 0);
+  ASSERT_TRUE(speed <= 100000);
+}
+
+TEST(Files, AdaptiveResourceLimit) {
+  const td::int64 max_limit = 1 << 20;
+  const td::int64 part_size = 1 << 12;
+  auto get_limit = [&](td::int64 limit, td::int64 unused, td::int64 speed, double min_rtt, double smoothed_rtt) {
+    return td::ResourceManager::get_adaptive_resource_limit(limit, max_limit, unused, part_size, speed, min_rtt,
+                                                            smoothed_rtt);
+  };
+
+  // the limit grows while there is no queueing and it is fully used
+  auto limit = max_limit;
+  for (int i = 0; i < 10; i++) {
+    auto new_limit = get_limit(limit, 0, 0, 0.1, 0.1);
+    ASSERT_EQ(limit + part_size, new_limit);
+    limit = new_limit;
+  }
+
+  // the limit doesn't grow if it isn't used
+  ASSERT_EQ(limit, get_limit(limit, part_size, 0, 0.1, 0.1));
+
+  // the limit doesn't change if a small amount of data is queued
+  ASSERT_EQ(max_limit, get_limit(max_limit, 0, 0, 0.1, 0.1 / (1.0 - 3.0 * part_size / max_limit)));
+
+  // the limit shrinks if many parts are queued, but not below bandwidth-delay product
+  ASSERT_EQ(limit - part_size, get_limit(limit, 0, 0, 0.1, 0.2));
+  ASSERT_EQ(limit - part_size / 2, get_limit(limit, 0, (limit - part_size / 2) * 10, 0.1, 0.2));
+
+  // the limit is kept between max_limit / 8 and max_limit * 8
+  ASSERT_EQ(max_limit / 8, get_limit(max_limit / 8, 0, 0, 0.1, 1.0));
+  ASSERT_EQ(max_limit * 8, get_limit(max_limit * 8, 0, 0, 0.1, 0.1));
+  limit = max_limit;
+  for (int i = 0; i < 300; i++) {
+    limit = get_limit(limit, 0, 0, 0.1, 1.0);
+  }
+  ASSERT_EQ(max_limit / 8, limit);
+  for (int i = 0; i < 3000; i++) {
+    limit = get_limit(limit, 0, 0, 0.1, 0.1);
+  }
+  ASSERT_EQ(max_limit * 8, limit);
+}
+
+static td::Result<td::string> read_test_file_part(td::ConcurrentScheduler &sched,
+                                                  td::ActorId<td::FileLoadManager> file_load_manager,
+                                                  td::string file_path, td::int64 offset, td::int64 count) {
+  bool is_ready = false;
+  td::Result<td::string> result;
+  {
+    auto guard = sched.get_main_guard();
+    send_closure(file_load_manager, &td::FileLoadManager::read_file_part, std::move(file_path), offset, count,
+                 td::PromiseCreator::lambda([&is_ready, &result](td::Result<td::string> r_bytes) {
+                   result = std::move(r_bytes);
+                   is_ready = true;
+                 }));
+  }
+  while (!is_ready) {
+    sched.run_main(0.1);
+  }
+  return result;
+}
+
+TEST(Files, FileLoadManager) {
+  td::ConcurrentScheduler sched(0, 0);
+  auto file_load_manager = sched.create_actor_unsafe<td::FileLoadManager>(0, "FileLoadManager");
+  sched.start();
+  auto read_part = [&](const td::string &file_path, td::int64 offset, td::int64 count) {
+    return read_test_file_part(sched, file_load_manager.get(), file_path, offset, count);
+  };
+
+  td::string file_path = "test_file_load_manager.txt";
+  td::string content = "0123456789abcdefghijklmnopqrstuvwxyz";
+  td::write_file(file_path, content).ensure();
+
+  ASSERT_EQ(content.substr(10, 5), read_part(file_path, 10, 5).ok());
+  ASSERT_EQ(content.substr(30), read_part(file_path, 30, 100).ok());
+  ASSERT_EQ("", read_part(file_path, 0, 0).ok());
+  ASSERT_EQ(content, read_part(file_path, 0, -1).ok());
+  ASSERT_EQ("", read_part(file_path, static_cast<td::int64>(content.size()), 10).ok());
+  ASSERT_TRUE(read_part(file_path, static_cast<td::int64>(content.size()) + 1, 10).is_error());
+  ASSERT_TRUE(read_part(file_path, -1, 10).is_error());
+
+  // the file is appended as if it is being downloaded
+  content += "ABCDEFGHIJ";
+  td::write_file(file_path, content).ensure();
+  ASSERT_EQ(content.substr(30), read_part(file_path, 30, 100).ok());
+
+  // the file is truncated by another process
+  content = "short";
+  td::write_file(file_path, content).ensure();
+  ASSERT_EQ(content, read_part(file_path, 0, 100).ok());
+  ASSERT_TRUE(read_part(file_path, 30, 10).is_error());
+
+  // the file is deleted not through FileLoadManager
+  {
+    auto guard = sched.get_main_guard();
+    send_closure(file_load_manager, &td::FileLoadManager::close_file, file_path);
+  }
+  td::unlink(file_path).ensure();
+  ASSERT_TRUE(read_part(file_path, 0, 100).is_error());
+
+  // more files than can be kept open are read in turn
+  td::vector<td::string> file_paths;
+  for (int i = 0; i < 40; i++) {
+    file_paths.push_back(PSTRING() << "test_file_load_manager_" << i << ".txt");
+    td::write_file(file_paths.back(), PSLICE() << "content " << i).ensure();
+  }
+  for (int t = 0; t < 3; t++) {
+    for (int i = 0; i < 40; i++) {
+      ASSERT_EQ(PSTRING() << "content " << i, read_part(file_paths[i], 0, 100).ok());
+    }
+  }
+  for (auto &path : file_paths) {
+    td::unlink(path).ensure();
+  }
+
+  {
+    auto guard = sched.get_main_guard();
+    file_load_manager.reset();
+  }
+  sched.finish();
+}
+
+TEST(Files, FileContentStore) {
+  td::string dir = PSTRING() << "test_file_content_store" << TD_DIR_SLASH;
+  td::rmrf(dir).ignore();
+  td::mkdir(dir).ensure();
+  td::string content_dir = PSTRING() << dir << "content" << TD_DIR_SLASH;
+  td::string first_path = dir + "first";
+  td::string second_path = dir + "second";
+  td::string other_path = dir + "other";
+  auto content = td::rand_string('a', 'z', 100000);
+  td::write_file(first_path, content).ensure();
+  td::write_file(second_path, content).ensure();
+  td::write_file(other_path, content + "!").ensure();
+
+  auto content_path = td::add_file_to_content_store(content_dir, first_path).move_as_ok();
+  ASSERT_EQ(2, td::stat(content_path).ok().link_count_);
+
+  // the same content downloaded twice shares one inode
+  ASSERT_EQ(content_path, td::add_file_to_content_store(content_dir, second_path).ok());
+  ASSERT_EQ(3, td::stat(content_path).ok().link_count_);
+  ASSERT_EQ(3, td::stat(first_path).ok().link_count_);
+  ASSERT_EQ(3, td::stat(second_path).ok().link_count_);
+  ASSERT_EQ(content, td::read_file_str(second_path).ok());
+
+  // different content is stored separately
+  auto other_content_path = td::add_file_to_content_store(content_dir, other_path).move_as_ok();
+  ASSERT_TRUE(other_content_path != content_path);
+  ASSERT_EQ(2, td::stat(other_content_path).ok().link_count_);
+  ASSERT_EQ(3, td::stat(content_path).ok().link_count_);
+
+  // removing one link keeps the stored file and the other links
+  td::unlink(first_path).ensure();
+  ASSERT_EQ(2, td::stat(content_path).ok().link_count_);
+  ASSERT_EQ(content, td::read_file_str(second_path).ok());
+  ASSERT_EQ(content, td::read_file_str(content_path).ok());
+
+  td::rmrf(dir).ensure();
+}
+
+TEST(Files, FileDbContentRefs) {
+  td::string dir = PSTRING() << "test_file_db_content_refs" << TD_DIR_SLASH;
+  td::rmrf(dir).ignore();
+  td::mkdir(dir).ensure();
+  td::string content_path = dir + "stored";
+  td::string first_path = dir + "first";
+  td::string second_path = dir + "second";
+  td::write_file(content_path, "content").ensure();
+
+  td::ConcurrentScheduler sched(0, 0);
+  sched.start();
+  std::shared_ptr<td::FileDbInterface> file_db;
+  {
+    auto guard = sched.get_main_guard();
+    auto sql_connection = std::make_shared<td::SqliteConnectionSafe>(dir + "db.sqlite", td::DbKey::empty());
+    td::init_file_db(sql_connection->get(), 0).ensure();
+    file_db = td::create_file_db(std::move(sql_connection));
+  }
+  // all previous requests to the database are processed before get_file_data
+  auto wait_file_db = [&] {
+    bool is_ready = false;
+    {
+      auto guard = sched.get_main_guard();
+      file_db->get_file_data(td::FullLocalFileLocation(td::FileType::Temp, dir + "none", 0),
+                             td::PromiseCreator::lambda([&is_ready](td::Result<td::FileData> r_file_data) {
+                               is_ready = true;
+                             }));
+    }
+    while (!is_ready) {
+      sched.run_main(0.1);
+    }
+  };
+  auto add_ref = [&](const td::string &path) {
+    auto guard = sched.get_main_guard();
+    file_db->add_file_content_ref(path, content_path);
+  };
+  auto remove_ref = [&](const td::string &path) {
+    auto guard = sched.get_main_guard();
+    file_db->remove_file_content_ref(path);
+  };
+
+  add_ref(first_path);
+  add_ref(second_path);
+  add_ref(second_path);
+  wait_file_db();
+  ASSERT_EQ(content_path, file_db->get_file_content_path_sync(first_path));
+  ASSERT_EQ(content_path, file_db->get_file_content_path_sync(second_path));
+
+  // the stored file is kept until the last reference is removed
+  remove_ref(first_path);
+  wait_file_db();
+  ASSERT_TRUE(file_db->get_file_content_path_sync(first_path).empty());
+  ASSERT_TRUE(td::stat(content_path).is_ok());
+
+  // repeated removal of a reference is ignored
+  remove_ref(first_path);
+  wait_file_db();
+  ASSERT_TRUE(td::stat(content_path).is_ok());
+
+  remove_ref(second_path);
+  wait_file_db();
+  ASSERT_TRUE(file_db->get_file_content_path_sync(second_path).empty());
+  ASSERT_TRUE(td::stat(content_path).is_error());
+
+  // reference counts are fixed by files GC
+  td::write_file(content_path, "content").ensure();
+  add_ref(first_path);
+  {
+    auto guard = sched.get_main_guard();
+    file_db->set_file_content_ref_counts({{content_path, 2}});
+  }
+  remove_ref(first_path);
+  wait_file_db();
+  ASSERT_TRUE(td::stat(content_path).is_ok());
+
+  // a stale reference to a stored file deleted by files GC must not delete a new stored file
+  add_ref(second_path);
+  {
+    auto guard = sched.get_main_guard();
+    file_db->set_file_content_ref_counts({{content_path, 0}});
+  }
+  wait_file_db();
+  td::write_file(content_path, "new content").ensure();
+  remove_ref(second_path);
+  wait_file_db();
+  ASSERT_TRUE(td::stat(content_path).is_ok());
+
+  bool is_closed = false;
+  {
+    auto guard = sched.get_main_guard();
+    file_db->close(td::PromiseCreator::lambda([&is_closed](td::Unit) { is_closed = true; }));
+  }
+  while (!is_closed) {
+    sched.run_main(0.1);
+  }
+  {
+    auto guard = sched.get_main_guard();
+    file_db.reset();
+  }
+  sched.finish();
+  td::rmrf(dir).ensure();
+}
+
+TEST(Files, DecryptCdnPart) {
+  auto key = td::rand_string('a', 'z', 32);
+  // the last 4 bytes of the IV are a big-endian block counter
+  auto iv = td::rand_string('a', 'z', 12) + td::string(4, '\0');
+  auto data = td::rand_string(0, 255, 16 * 1000);
+
+  td::string encrypted(data.size(), '\0');
+  td::AesCtrState encrypt_state;
+  encrypt_state.init(key, iv);
+  encrypt_state.encrypt(data, encrypted);
+
+  for (td::int64 offset : {0, 16, 160, 16 * 999}) {
+    auto size = static_cast<size_t>(16 * 1000 - offset);
+    td::string part = encrypted.substr(static_cast<size_t>(offset));
+    td::FilePartWorker::decrypt_cdn_part(key, iv, offset, part);
+    ASSERT_EQ(data.substr(static_cast<size_t>(offset)), part);
+
+    // the same as the decryption, which was done before by FileDownloader
+    auto block_offset = static_cast<td::uint32>(offset / 16);
+    block_offset = ((block_offset & 0xff) << 24) | ((block_offset & 0xff00) << 8) |
+                   ((block_offset & 0xff0000) >> 8) | ((block_offset & 0xff000000) >> 24);
+    td::string expected(size, '\0');
+    td::AesCtrState ctr_state;
+    td::string part_iv = iv;
+    td::as<td::uint32>(&part_iv[12]) = block_offset;
+    ctr_state.init(key, part_iv);
+    ctr_state.decrypt(td::Slice(encrypted).substr(static_cast<size_t>(offset)), expected);
+    ASSERT_EQ(expected, part);
+  }
+}
+
+TEST(Files, FilePartHelpers) {
+  td::string file_path = "test_file_part_helpers.txt";
+  td::string content = td::rand_string('a', 'z', 1000);
+  td::write_file(file_path, content).ensure();
+
+  td::string hash(32, '\0');
+  td::sha256(td::Slice(content).substr(100, 200), hash);
+  {
+    auto fd = td::FileFd::open(file_path, td::FileFd::Read).move_as_ok();
+    ASSERT_TRUE(td::FilePartWorker::check_file_part_hash(fd, 100, 200, hash).move_as_ok());
+    ASSERT_TRUE(!td::FilePartWorker::check_file_part_hash(fd, 101, 200, hash).move_as_ok());
+    ASSERT_TRUE(td::FilePartWorker::check_file_part_hash(fd, 900, 200, hash).is_error());
+
+    // the file isn't writable
+    ASSERT_TRUE(td::FilePartWorker::write_file_part(fd, 0, "abcd").is_error());
+  }
+  {
+    auto fd = td::FileFd::open(file_path, td::FileFd::Write).move_as_ok();
+    ASSERT_EQ(4u, td::FilePartWorker::write_file_part(fd, 998, "abcd").move_as_ok());
+  }
+  ASSERT_EQ(content.substr(0, 998) + "abcd", td::read_file_str(file_path).move_as_ok());
+  td::unlink(file_path).ensure();
+}
+
+template <class T, class F>
+static td::Result<T> run_file_part_worker_query(td::ConcurrentScheduler &sched, F &&f) {
+  bool is_ready = false;
+  td::Result<T> result;
+  {
+    auto guard = sched.get_main_guard();
+    f(td::PromiseCreator::lambda([&is_ready, &result](td::Result<T> r_value) {
+      result = std::move(r_value);
+      is_ready = true;
+    }));
+  }
+  while (!is_ready) {
+    sched.run_main(0.1);
+  }
+  return result;
+}
+
+TEST(Files, FilePartWorker) {
+  td::ConcurrentScheduler sched(0, 0);
+  auto part_worker = sched.create_actor_unsafe<td::FilePartWorker>(0, "FilePartWorker");
+  sched.start();
+  auto save_part = [&](const td::string &path, td::int64 offset, td::string bytes, size_t size,
+                       const td::string &key = td::string(), const td::string &iv = td::string()) {
+    return run_file_part_worker_query<size_t>(sched, [&](td::Promise<size_t> promise) {
+      send_closure(part_worker, &td::FilePartWorker::save_part, path, offset, td::BufferSlice(bytes), size, key, iv,
+                   std::move(promise));
+    });
+  };
+  auto check_part_hash = [&](const td::string &path, td::int64 offset, size_t size, td::string hash) {
+    return run_file_part_worker_query<bool>(sched, [&](td::Promise<bool> promise) {
+      send_closure(part_worker, &td::FilePartWorker::check_part_hash, path, offset, size, std::move(hash),
+                   std::move(promise));
+    });
+  };
+
+  td::string file_path = "test_file_part_worker.txt";
+  td::write_file(file_path, "").ensure();
+
+  // parts are saved in any order
+  ASSERT_EQ(4u, save_part(file_path, 16, "efgh", 4).move_as_ok());
+  ASSERT_EQ(16u, save_part(file_path, 0, "0123456789abcdef", 16).move_as_ok());
+  // the last part of a file of unknown size is truncated
+  ASSERT_EQ(2u, save_part(file_path, 20, "ijkl", 2).move_as_ok());
+  ASSERT_EQ("0123456789abcdefefghij", td::read_file_str(file_path).move_as_ok());
+
+  // CDN parts are decrypted before they are saved
+  auto key = td::rand_string('a', 'z', 32);
+  auto iv = td::rand_string('a', 'z', 12) + td::string(4, '\0');
+  auto data = td::rand_string('a', 'z', 64);
+  td::string encrypted(data.size(), '\0');
+  td::AesCtrState encrypt_state;
+  encrypt_state.init(key, iv);
+  encrypt_state.encrypt(data, encrypted);
+  ASSERT_EQ(32u, save_part(file_path, 32, encrypted.substr(32), 32, key, iv).move_as_ok());
+  ASSERT_EQ(32u, save_part(file_path, 0, encrypted.substr(0, 32), 32, key, iv).move_as_ok());
+  ASSERT_EQ(data, td::read_file_str(file_path).move_as_ok());
+
+  td::string hash(32, '\0');
+  td::sha256(td::Slice(data).substr(16, 32), hash);
+  ASSERT_TRUE(check_part_hash(file_path, 16, 32, hash).move_as_ok());
+  ASSERT_TRUE(!check_part_hash(file_path, 0, 32, hash).move_as_ok());
+  ASSERT_TRUE(check_part_hash(file_path, 48, 32, hash).is_error());
+
+  // the file is replaced while it is kept open
+  td::unlink(file_path).ensure();
+  td::write_file(file_path, "").ensure();
+  ASSERT_EQ(4u, save_part(file_path, 0, "abcd", 4).move_as_ok());
+  ASSERT_EQ("abcd", td::read_file_str(file_path).move_as_ok());
+
+  {
+    auto guard = sched.get_main_guard();
+    send_closure(part_worker, &td::FilePartWorker::close_file, file_path);
+  }
+  td::unlink(file_path).ensure();
+  ASSERT_TRUE(save_part(file_path, 0, "abcd", 4).is_error());
+  ASSERT_TRUE(check_part_hash(file_path, 0, 4, hash).is_error());
+
+  {
+    auto guard = sched.get_main_guard();
+    part_worker.reset();
+  }
+  sched.finish();
+}
@@ -266,6 +266,22 @@ TEST(Http, gzip) {
   ASSERT_EQ(413, r_state.error().code());
 }
 
+TEST(Http, gzip_reuse) {
+  for (int i = 0; i < 100; i++) {
+    auto str = td::rand_string('a', 'd', td::Random::fast(1, 10000));
+    auto compressed = td::gzencode(str, 2.0);
+    ASSERT_TRUE(!compressed.empty());
+    ASSERT_EQ(str, td::gzdecode(compressed.as_slice()).as_slice());
+
+    // the uncompressed size in the trailer must not be trusted
+    auto broken = compressed.as_slice().str();
+    broken[broken.size() - 4] = static_cast<char>(broken[broken.size() - 4] ^ td::Random::fast(1, 255));
+    ASSERT_TRUE(td::gzdecode(broken).empty());
+
+    ASSERT_TRUE(td::gzdecode(compressed.as_slice().substr(0, compressed.size() / 2)).empty());
+  }
+}
+
 TEST(Http, aes_ctr_encode_decode_flow) {
   auto str = td::rand_string('a', 'z', 1000000);
   auto parts = td::rand_split(str);
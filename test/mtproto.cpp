@@ -5,8 +5,10 @@
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 //
 #include "td/telegram/ConfigManager.h"
+#include "td/telegram/net/ConnectTimeStats.h"
 #include "td/telegram/net/PublicRsaKeySharedMain.h"
 #include "td/telegram/net/Session.h"
+#include "td/telegram/net/SessionLoadBalancer.h"
 #include "td/telegram/NotificationManager.h"
 #include "td/telegram/telegram_api.h"
 
@@ -15,14 +17,18 @@
 #include "td/mtproto/DhHandshake.h"
 #include "td/mtproto/Handshake.h"
 #include "td/mtproto/HandshakeActor.h"
+#include "td/mtproto/PacketStats.h"
 #include "td/mtproto/Ping.h"
 #include "td/mtproto/PingConnection.h"
 #include "td/mtproto/ProxySecret.h"
 #include "td/mtproto/RawConnection.h"
 #include "td/mtproto/RSA.h"
+#include "td/mtproto/SessionConnection.h"
+#include "td/mtproto/TcpTransport.h"
 #include "td/mtproto/TlsInit.h"
 #include "td/mtproto/TransportType.h"
 
+#include "td/net/ConnectRaceActor.h"
 #include "td/net/GetHostByNameActor.h"
 #include "td/net/Socks5.h"
 #include "td/net/TransparentProxy.h"
@@ -30,7 +36,9 @@
 #include "td/actor/actor.h"
 #include "td/actor/ConcurrentScheduler.h"
 
+#include "td/utils/as.h"
 #include "td/utils/base64.h"
+#include "td/utils/buffer.h"
 #include "td/utils/BufferedFd.h"
 #include "td/utils/common.h"
 #include "td/utils/crypto.h"
@@ -38,6 +46,7 @@
 #include "td/utils/logging.h"
 #include "td/utils/port/Clocks.h"
 #include "td/utils/port/IPAddress.h"
+#include "td/utils/port/ServerSocketFd.h"
 #include "td/utils/port/SocketFd.h"
 #include "td/utils/Promise.h"
 #include "td/utils/Random.h"
@@ -48,6 +57,7 @@
 #include "td/utils/Time.h"
 
 #include <memory>
+#include <utility>
 
 TEST(Mtproto, GetHostByNameActor) {
   int threads_n = 1;
@@ -494,6 +504,69 @@ TEST(Mtproto, socks5) {
   sched.finish();
 }
 
+static td::ServerSocketFd open_local_listener(td::IPAddress &ip_address) {
+  while (true) {
+    auto port = td::Random::fast(20000, 60000);
+    auto r_server_socket_fd = td::ServerSocketFd::open(port, "127.0.0.1");
+    if (r_server_socket_fd.is_ok()) {
+      ip_address.init_ipv4_port("127.0.0.1", port).ensure();
+      return r_server_socket_fd.move_as_ok();
+    }
+  }
+}
+
+static td::Result<td::ConnectRaceActor::ConnectResult> run_connect_race(td::vector<td::IPAddress> ip_addresses,
+                                                                        double attempt_delay) {
+  td::Result<td::ConnectRaceActor::ConnectResult> result;
+  td::ConcurrentScheduler sched(0, 0);
+  sched
+      .create_actor_unsafe<td::ConnectRaceActor>(
+          0, "ConnectRaceActor", std::move(ip_addresses), attempt_delay, 5.0,
+          td::PromiseCreator::lambda([&result](td::Result<td::ConnectRaceActor::ConnectResult> r_result) {
+            result = std::move(r_result);
+            td::Scheduler::instance()->finish();
+          }),
+          td::ActorShared<>())
+      .release();
+  sched.start();
+  while (sched.run_main(10)) {
+    // empty
+  }
+  sched.finish();
+  return result;
+}
+
+TEST(Mtproto, ConnectRaceActor) {
+  td::IPAddress listener_ip_address;
+  auto listener = open_local_listener(listener_ip_address);
+
+  td::IPAddress closed_ip_address;
+  open_local_listener(closed_ip_address).close();
+
+  {
+    // a failed attempt must not delay the next one
+    auto r_result = run_connect_race({closed_ip_address, listener_ip_address}, 100.0);
+    ASSERT_TRUE(r_result.is_ok());
+    auto result = r_result.move_as_ok();
+    ASSERT_EQ(1u, result.address_index);
+    ASSERT_TRUE(result.failed_address_indices == td::vector<size_t>{0});
+    ASSERT_TRUE(result.connect_time < 5.0);
+    td::IPAddress peer_ip_address;
+    peer_ip_address.init_peer_address(result.socket_fd).ensure();
+    ASSERT_EQ(listener_ip_address.get_port(), peer_ip_address.get_port());
+  }
+  {
+    auto r_result = run_connect_race({listener_ip_address, closed_ip_address}, 0.25);
+    ASSERT_TRUE(r_result.is_ok());
+    ASSERT_EQ(0u, r_result.ok().address_index);
+  }
+  {
+    auto r_result = run_connect_race({closed_ip_address, closed_ip_address}, 0.25);
+    ASSERT_TRUE(r_result.is_error());
+  }
+  ASSERT_TRUE(run_connect_race({}, 0.25).is_error());
+}
+
 TEST(Mtproto, notifications) {
   td::vector<td::string> pushes = {
       "eyJwIjoiSkRnQ3NMRWxEaWhyVWRRN1pYM3J1WVU4TlRBMFhMb0N6UWRNdzJ1cWlqMkdRbVR1WXVvYXhUeFJHaG1QQm8yVElYZFBzX2N3b2RIb3lY"
@@ -741,3 +814,175 @@ TEST(Mtproto, RSA) {
   rsa.encrypt(pem.substr(0, 256), to);
   ASSERT_EQ("U2nJEtB2AgpHrm3HB0yhpTQgb0wbesi9Pv/W1v/vULU=", td::base64_encode(td::sha256(to)));
 }
+
+TEST(Mtproto, SessionLoadBalancer) {
+  td::SessionLoadBalancer balancer(2, 4);
+  ASSERT_EQ(2, balancer.get_session_count());
+
+  // a big query makes the session less preferable
+  auto session_id = balancer.choose_session(1 << 20);
+  balancer.on_query_sent(1, session_id, 1 << 20, 1.0);
+  ASSERT_EQ(1 - session_id, balancer.choose_session(100));
+  balancer.on_query_sent(2, 1 - session_id, 100, 1.0);
+  balancer.on_query_finished(2, 1.5);
+  ASSERT_EQ(0.5, balancer.get_rtt(1 - session_id));
+  ASSERT_EQ(0, balancer.get_query_count(1 - session_id));
+  ASSERT_EQ(1 - session_id, balancer.choose_session(100));
+  balancer.on_query_finished(1, 2.0);
+  ASSERT_EQ(0, balancer.get_query_size(session_id));
+
+  // a session stalled behind slow queries is avoided
+  balancer.on_query_sent(3, 0, 100, 3.0);
+  balancer.on_query_sent(4, 1, 100, 3.0);
+  balancer.on_query_finished(3, 3.1);
+  balancer.on_query_sent(5, 0, 100, 3.1);
+  balancer.on_query_finished(4, 8.0);
+  balancer.on_query_sent(6, 1, 100, 8.0);
+  ASSERT_EQ(0, balancer.choose_session(100));
+  balancer.on_query_finished(5, 8.0);
+  balancer.on_query_finished(6, 8.0);
+  ASSERT_EQ(2, balancer.get_wanted_session_count(8.0));
+
+  // the pool grows, when all sessions are overloaded
+  td::uint64 query_id = 10;
+  for (int i = 0; i < 8; i++) {
+    balancer.on_query_sent(query_id++, 0, 100, 10.0);
+    balancer.on_query_sent(query_id++, 1, 100, 10.0);
+  }
+  ASSERT_EQ(3, balancer.get_wanted_session_count(10.0));
+  balancer.set_session_count(3, 10.0);
+  ASSERT_EQ(3, balancer.get_session_count());
+  ASSERT_EQ(2, balancer.choose_session(100));
+  ASSERT_EQ(3, balancer.get_wanted_session_count(10.5));
+  for (td::uint64 id = 10; id < query_id; id++) {
+    balancer.on_query_finished(id, 11.0);
+  }
+
+  // and shrinks after it has been idle for a while
+  ASSERT_EQ(3, balancer.get_wanted_session_count(20.0));
+  ASSERT_EQ(2, balancer.get_wanted_session_count(41.0));
+  balancer.set_session_count(1, 41.0);
+  ASSERT_EQ(2, balancer.get_session_count());
+}
+
+TEST(Mtproto, ObfuscatedTransportWriteBatch) {
+  td::mtproto::tcp::ObfuscatedTransport transport(2, td::mtproto::ProxySecret());
+  td::ChainBufferReader input;
+  td::ChainBufferWriter output;
+  auto output_reader = output.extract_reader();
+  transport.init(&input, &output);
+
+  td::vector<td::string> payloads;
+  td::vector<int> quick_acks;
+  for (auto size : {8, 100, 5000, 12, 16, 40000, 4}) {
+    payloads.push_back(td::string(size, static_cast<char>('a' + payloads.size())));
+    quick_acks.push_back(payloads.size() % 2 == 0 ? 1 : 0);
+  }
+  for (int i = 0; i < 20; i++) {
+    payloads.push_back(td::string(2000, static_cast<char>('A' + i)));
+    quick_acks.push_back(0);
+  }
+  td::vector<std::pair<td::BufferWriter, bool>> messages;
+  for (size_t i = 0; i < payloads.size(); i++) {
+    messages.emplace_back(td::BufferWriter(payloads[i], transport.max_prepend_size(), transport.max_append_size()),
+                          quick_acks[i] != 0);
+  }
+  transport.write_batch(std::move(messages));
+
+  output_reader.sync_with_writer();
+  td::string data = output_reader.move_as_buffer_slice().as_slice().str();
+  ASSERT_TRUE(data.size() > 64u);
+  td::AesCtrState state;
+  state.init(td::Slice(data).substr(8, 32), td::Slice(data).substr(40, 16));
+  td::string decrypted(data.size(), '\0');
+  state.encrypt(data, decrypted);
+  ASSERT_EQ(0xeeeeeeeeu, static_cast<td::uint32>(td::as<td::uint32>(decrypted.data() + 56)));
+
+  td::Slice left = td::Slice(decrypted).substr(64);
+  for (size_t i = 0; i < payloads.size(); i++) {
+    ASSERT_TRUE(left.size() >= 4u);
+    td::uint32 size = td::as<td::uint32>(left.data());
+    ASSERT_EQ(quick_acks[i] != 0, (size & (1u << 31)) != 0);
+    size &= ~(1u << 31);
+    ASSERT_TRUE(left.size() >= 4u + size);
+    ASSERT_EQ(payloads[i], left.substr(4, size));
+    left.remove_prefix(4 + size);
+  }
+  ASSERT_TRUE(left.empty());
+}
+
+TEST(Mtproto, SessionConnectionQuerySendDelay) {
+  using td::mtproto::SessionConnection;
+
+  // ordinary queries are latency-sensitive even in a burst
+  auto common_delay = SessionConnection::get_query_send_delay(false, false, 100, 1.0);
+  ASSERT_TRUE(common_delay > 0.0);
+  ASSERT_TRUE(common_delay <= 0.001);
+  ASSERT_EQ(common_delay, SessionConnection::get_query_send_delay(false, false, 100, 0.0));
+
+  // bulk queries are coalesced only within a burst
+  ASSERT_EQ(common_delay, SessionConnection::get_query_send_delay(true, false, 100, 1.0));
+  auto burst_delay = SessionConnection::get_query_send_delay(true, false, 100, 0.01);
+  ASSERT_TRUE(burst_delay > common_delay);
+  ASSERT_TRUE(burst_delay <= 0.005);
+
+  // high-priority queries are flushed immediately
+  ASSERT_EQ(0.0, SessionConnection::get_query_send_delay(false, true, 100, 1.0));
+  ASSERT_EQ(0.0, SessionConnection::get_query_send_delay(false, true, 100, 0.0));
+  ASSERT_EQ(0.0, SessionConnection::get_query_send_delay(true, true, 100, 0.01));
+
+  // a full packet is sent immediately
+  ASSERT_EQ(0.0, SessionConnection::get_query_send_delay(false, false, 1400, 1.0));
+  ASSERT_EQ(0.0, SessionConnection::get_query_send_delay(true, false, 1400, 0.01));
+  ASSERT_EQ(0.0, SessionConnection::get_query_send_delay(true, false, 100000, 0.0));
+}
+
+TEST(Mtproto, PacketStats) {
+  td::mtproto::PacketStats stats;
+  stats.packet_count = 2;
+  stats.query_count = 3;
+  stats.total_query_delay = 0.5;
+  stats.max_query_delay = 0.375;
+
+  td::mtproto::PacketStats other;
+  other.packet_count = 1;
+  other.ack_count = 4;
+  other.total_query_delay = 0.25;
+  other.max_query_delay = 0.125;
+
+  stats += other;
+  ASSERT_EQ(3u, stats.packet_count);
+  ASSERT_EQ(3u, stats.query_count);
+  ASSERT_EQ(4u, stats.ack_count);
+  ASSERT_EQ(0.75, stats.total_query_delay);
+  ASSERT_EQ(0.375, stats.max_query_delay);
+
+  ASSERT_TRUE(!(PSLICE() << stats).empty());
+}
+
+TEST(Mtproto, ConnectTimeStats) {
+  td::ConnectTimeStats stats;
+  stats.on_connected(0.0);
+  stats.on_connected(0.049);
+  stats.on_connected(0.05);
+  stats.on_connected(0.3);
+  stats.on_connected(4.999);
+  stats.on_connected(5.0);
+  stats.on_connected(100.0);
+  stats.on_failed();
+
+  ASSERT_EQ(2, stats.get_count(0));
+  ASSERT_EQ(1, stats.get_count(1));
+  ASSERT_EQ(0, stats.get_count(2));
+  ASSERT_EQ(1, stats.get_count(3));
+  ASSERT_EQ(0, stats.get_count(4));
+  ASSERT_EQ(0, stats.get_count(5));
+  ASSERT_EQ(1, stats.get_count(6));
+  ASSERT_EQ(2, stats.get_count(td::ConnectTimeStats::BUCKET_COUNT - 1));
+  ASSERT_EQ(1, stats.get_failure_count());
+
+  ASSERT_EQ(
+      "<0.050000s:2 <0.100000s:1 <0.200000s:0 <0.500000s:1 <1.000000s:0 <2.000000s:0 <5.000000s:1 >=5.000000s:2 "
+      "failed:1",
+      (PSTRING() << stats));
+}
@@ -8,8 +8,12 @@
 
 #include "td/telegram/Client.h"
 #include "td/telegram/ClientActor.h"
+#include "td/telegram/ClientJson.h"
 #include "td/telegram/files/PartsManager.h"
 #include "td/telegram/td_api.h"
+#include "td/telegram/td_api_json.h"
+
+#include "td/tl/tl_json.h"
 
 #include "td/actor/actor.h"
 #include "td/actor/ConcurrentScheduler.h"
@@ -20,6 +24,7 @@
 #include "td/utils/common.h"
 #include "td/utils/filesystem.h"
 #include "td/utils/format.h"
+#include "td/utils/JsonBuilder.h"
 #include "td/utils/logging.h"
 #include "td/utils/misc.h"
 #include "td/utils/port/FileFd.h"
@@ -28,6 +33,7 @@
 #include "td/utils/port/thread.h"
 #include "td/utils/Promise.h"
 #include "td/utils/Random.h"
+#include "td/utils/ScopeGuard.h"
 #include "td/utils/Slice.h"
 #include "td/utils/SliceBuilder.h"
 #include "td/utils/Status.h"
@@ -41,6 +47,7 @@
 #include <mutex>
 #include <set>
 #include <utility>
+#include <vector>
 
 template <class T>
 static void check_td_error(T &result) {
@@ -970,6 +977,48 @@ TEST(Client, Manager) {
   }
 }
 
+TEST(Client, ManagerThreadOptions) {
+  td::ClientManager::ThreadOptions invalid_options;
+  invalid_options.client_thread_count = 0;
+  ASSERT_TRUE(!td::ClientManager::set_thread_options(invalid_options));
+  invalid_options.client_thread_count = 10;
+  invalid_options.pool_count = 10;
+  ASSERT_TRUE(!td::ClientManager::set_thread_options(invalid_options));
+  invalid_options.client_thread_count = 1;
+  invalid_options.pool_count = 1;
+  invalid_options.database_reader_thread_count = -1;
+  ASSERT_TRUE(!td::ClientManager::set_thread_options(invalid_options));
+  invalid_options.database_reader_thread_count = 0;
+  invalid_options.file_worker_thread_count = -1;
+  ASSERT_TRUE(!td::ClientManager::set_thread_options(invalid_options));
+
+  td::ClientManager::ThreadOptions options;
+  options.pool_count = 2;
+  options.client_thread_count = 3;
+  options.share_service_threads = true;
+  options.database_reader_thread_count = 2;
+  options.file_worker_thread_count = 1;
+  ASSERT_TRUE(td::ClientManager::set_thread_options(options));
+  SCOPE_EXIT {
+    ASSERT_TRUE(td::ClientManager::set_thread_options(td::ClientManager::ThreadOptions()));
+  };
+
+  td::ClientManager client;
+  int clients_n = 20;
+  for (int i = 0; i < clients_n; i++) {
+    auto id = client.create_client_id();
+    client.send(id, 3, td::make_tl_object<td::td_api::testSquareInt>(3));
+  }
+  std::set<td::int32> ids;
+  while (ids.size() != static_cast<size_t>(clients_n)) {
+    auto event = client.receive(10);
+    if (event.request_id == 3) {
+      ASSERT_EQ(td::td_api::testInt::ID, event.object->get_id());
+      ASSERT_TRUE(ids.insert(event.client_id).second);
+    }
+  }
+}
+
 #if !TD_EVENTFD_UNSUPPORTED  // Client must be used from a single thread if there is no EventFd
 TEST(Client, Close) {
   std::atomic<bool> stop_send{false};
@@ -1094,9 +1143,251 @@ TEST(Client, ManagerClose) {
   ASSERT_EQ(send_count.load(), receive_count.load());
   ASSERT_TRUE(request_ids.empty());
 }
+
+TEST(Client, ManagerReceiveQueues) {
+  const td::int32 queue_count = 3;
+  const int clients_n = 10;
+  const int requests_n = 20;
+  td::ClientManager client_manager(queue_count);
+  ASSERT_EQ(queue_count, client_manager.get_receive_queue_count());
+
+  std::vector<td::int32> client_ids;
+  for (int i = 0; i < clients_n; i++) {
+    auto client_id = client_manager.create_client_id();
+    client_ids.push_back(client_id);
+    for (int j = 1; j <= requests_n; j++) {
+      client_manager.send(client_id, j, td::make_tl_object<td::td_api::testSquareInt>(j));
+    }
+  }
+
+  std::atomic<int> receive_count{0};
+  std::vector<td::thread> receive_threads;
+  for (td::int32 queue_id = 0; queue_id < queue_count; queue_id++) {
+    receive_threads.emplace_back([&, queue_id] {
+      std::map<td::int32, td::uint64> last_request_ids;
+      std::vector<td::ClientManager::Response> responses;
+      while (receive_count.load() != clients_n * requests_n) {
+        responses.clear();
+        auto response_count = client_manager.receive(queue_id, 0.1, 7, responses);
+        ASSERT_TRUE(response_count <= 7);
+        ASSERT_EQ(response_count, responses.size());
+        for (auto &response : responses) {
+          ASSERT_EQ(queue_id, client_manager.get_receive_queue_id(response.client_id));
+          if (response.request_id == 0) {
+            continue;
+          }
+          ASSERT_EQ(td::td_api::testInt::ID, response.object->get_id());
+          auto value = static_cast<td::uint64>(static_cast<const td::td_api::testInt &>(*response.object).value_);
+          ASSERT_EQ(response.request_id * response.request_id, value);
+          auto &last_request_id = last_request_ids[response.client_id];
+          ASSERT_EQ(last_request_id + 1, response.request_id);
+          last_request_id = response.request_id;
+          receive_count++;
+        }
+      }
+    });
+  }
+  for (auto &thread : receive_threads) {
+    thread.join();
+  }
+  ASSERT_EQ(clients_n * requests_n, receive_count.load());
+}
 #endif
 #endif
 
+TEST(Client, JsonReceiveMany) {
+  const char *result = nullptr;
+  size_t result_length = 1;
+  ASSERT_EQ(0, td::json_receive(0.0, 0, result, result_length));
+  ASSERT_TRUE(result == nullptr);
+  ASSERT_EQ(0u, result_length);
+
+  const int requests_n = 10;
+  auto client_id = td::json_create_client_id();
+  for (int i = 1; i <= requests_n; i++) {
+    td::json_send(client_id, PSLICE() << "{\"@type\":\"testSquareInt\",\"x\":" << i << ",\"@extra\":" << i << '}');
+  }
+
+  std::set<int> received_extra;
+  while (received_extra.size() != static_cast<size_t>(requests_n)) {
+    auto response_count = td::json_receive(10.0, 3, result, result_length);
+    ASSERT_TRUE(response_count > 0);
+    ASSERT_TRUE(response_count <= 3);
+    ASSERT_TRUE(result != nullptr);
+
+    // the responses are stored one after another as null-terminated strings
+    td::vector<td::string> responses;
+    size_t pos = 0;
+    while (pos < result_length) {
+      td::string response(result + pos);
+      pos += response.size() + 1;
+      responses.push_back(std::move(response));
+    }
+    ASSERT_EQ(result_length, pos);
+    ASSERT_EQ(static_cast<size_t>(response_count), responses.size());
+
+    for (auto &response : responses) {
+      if (response.find("\"@type\":\"testInt\"") == td::string::npos) {
+        continue;
+      }
+      for (int i = 1; i <= requests_n; i++) {
+        if (response.find(PSTRING() << "\"@extra\":" << i << ',') != td::string::npos) {
+          ASSERT_TRUE(response.find(PSTRING() << "\"value\":" << i * i << ',') != td::string::npos);
+          ASSERT_TRUE(received_extra.insert(i).second);
+        }
+      }
+    }
+  }
+
+  td::json_send(client_id, "{\"@type\":\"close\"}");
+}
+
+// parses a request in the same way as ClientJson, either with TlJsonParser or through JsonValue
+static td::Result<td::td_api::object_ptr<td::td_api::Function>> parse_json_request(const td::string &request,
+                                                                                 bool use_streaming_parser,
+                                                                                 td::string &extra) {
+  auto request_str = request;
+  td::td_api::object_ptr<td::td_api::Function> result;
+  if (use_streaming_parser) {
+    td::TlJsonParser parser(request_str);
+    if (parser.get_value_type() != td::JsonValue::Type::Object) {
+      return td::Status::Error("Expected a JSON object");
+    }
+    parser.set_saved_field_name("@extra");
+    TRY_STATUS(td::td_api::from_json(result, parser));
+    TRY_STATUS(parser.finish());
+    auto extra_value = parser.get_saved_field_value();
+    if (!extra_value.empty()) {
+      auto extra_str = extra_value.str();
+      extra = td::json_encode<td::string>(td::json_decode(extra_str).move_as_ok());
+    }
+  } else {
+    auto r_json_value = td::json_decode(request_str);
+    if (r_json_value.is_error()) {
+      return td::Status::Error(PSLICE() << "Failed to parse request as JSON object: "
+                                        << r_json_value.error().message());
+    }
+    auto json_value = r_json_value.move_as_ok();
+    if (json_value.type() != td::JsonValue::Type::Object) {
+      return td::Status::Error("Expected a JSON object");
+    }
+    if (json_value.get_object().has_field("@extra")) {
+      extra = td::json_encode<td::string>(json_value.get_object().extract_field("@extra"));
+    }
+    auto status = td::td_api::from_json(result, std::move(json_value));
+    if (status.is_error()) {
+      return td::Status::Error(PSLICE() << "Failed to parse JSON object as TDLib request: " << status.message());
+    }
+  }
+  return std::move(result);
+}
+
+TEST(Client, JsonRequestParsing) {
+  td::string deep_request = "{\"@type\":\"testSquareInt\",\"x\":1,\"unknown\":";
+  for (int i = 0; i < 200; i++) {
+    deep_request += "[";
+  }
+  for (int i = 0; i < 200; i++) {
+    deep_request += "]";
+  }
+  deep_request += "}";
+
+  td::vector<td::string> requests = {
+      // simple requests and @extra
+      "{\"@type\":\"testSquareInt\",\"x\":3}",
+      " \n{ \"@type\" : \"testSquareInt\" , \"x\" : 3 , \"@extra\" : 5 } \t",
+      "{\"@extra\":\"extra \\\"string\\\"\",\"@type\":\"testSquareInt\",\"x\":3}",
+      "{\"@type\":\"testSquareInt\",\"@extra\":{\"a\":[1,2.5,true,null,\"\\u00e9\"],\"b\":{}},\"x\":3}",
+      "{\"@type\":\"testSquareInt\",\"x\":3,\"@extra\":[1,{\"@extra\":2}]}",
+      "{\"@type\":\"testSquareInt\",\"x\":3,\"@extra\":1,\"@extra\":2}",
+      "{\"@type\":\"testCallEmpty\"}",
+      // nested objects
+      "{\"@type\":\"setChatPermissions\",\"chat_id\":-1001234567890,\"permissions\":{\"@type\":\"chatPermissions\","
+      "\"can_send_basic_messages\":true,\"can_send_photos\":false,\"can_invite_users\":true}}",
+      "{\"@type\":\"sendMessage\",\"chat_id\":1,\"input_message_content\":{\"@type\":\"inputMessageText\",\"text\":{"
+      "\"@type\":\"formattedText\",\"text\":\"bold \\\"text\\\"\\n\",\"entities\":[{\"@type\":\"textEntity\","
+      "\"offset\":0,\"length\":4,\"type\":{\"@type\":\"textEntityTypeBold\"}}]}},\"options\":{\"@type\":"
+      "\"messageSendOptions\",\"effect_id\":\"123\"}}",
+      "{\"input_message_content\":{\"text\":{\"text\":\"a\",\"@type\":\"formattedText\"},\"@type\":"
+      "\"inputMessageText\"},\"@type\":\"sendMessage\",\"chat_id\":1}",
+      "{\"@type\":\"testCallVectorIntObject\",\"x\":[{\"@type\":\"testInt\",\"value\":1},{\"value\":2}]}",
+      "{\"@type\":\"testCallVectorStringObject\",\"x\":[{\"@type\":\"testString\",\"value\":\"\\ud83d\\ude00\"}]}",
+      "{\"@type\":\"testCallVectorInt\",\"x\":[1,\"2\",-3]}",
+      "{\"@type\":\"testCallVectorString\",\"x\":[\"a\",\"\\u0000\",\"\\/\"]}",
+      "{\"@type\":\"setOption\",\"name\":\"a\",\"value\":{\"@type\":\"optionValueInteger\",\"value\":\"42\"}}",
+      "{\"@type\":\"setOption\",\"name\":\"a\",\"value\":null}",
+      "{\"@type\":\"sendMessage\",\"chat_id\":1,\"input_message_content\":null}",
+      // int64 as string
+      "{\"@type\":\"getStickerSet\",\"set_id\":\"-9223372036854775808\"}",
+      "{\"@type\":\"getStickerSet\",\"set_id\":9223372036854775807}",
+      "{\"@type\":\"getChat\",\"chat_id\":\"-1001234567890\"}",
+      "{\"@type\":\"getChat\",\"chat_id\":-1001234567890}",
+      "{\"@type\":\"getStickerSet\",\"set_id\":\"12a\"}",
+      "{\"@type\":\"getStickerSet\",\"set_id\":\"18446744073709551616\"}",
+      // base64 bytes
+      "{\"@type\":\"testCallBytes\",\"x\":\"aGVsbG8=\"}",
+      "{\"@type\":\"testCallBytes\",\"x\":\"aGVsbG8\"}",
+      "{\"@type\":\"testCallBytes\",\"x\":\"\"}",
+      "{\"@type\":\"testCallBytes\",\"x\":\"!!!!\"}",
+      "{\"@type\":\"testCallBytes\",\"x\":5}",
+      // unknown and duplicate fields
+      "{\"@type\":\"testSquareInt\",\"unknown\":{\"a\":[1,2,{\"b\":null}],\"@type\":\"x\"},\"x\":4}",
+      "{\"@type\":\"testSquareInt\",\"x\":3,\"x\":4}",
+      "{\"x\":3,\"@type\":\"testSquareInt\"}",
+      deep_request,
+      // malformed input
+      "",
+      "   ",
+      "[]",
+      "5",
+      "null",
+      "\"testSquareInt\"",
+      "{",
+      "{\"@type\":\"testSquareInt\",\"x\":}",
+      "{\"@type\":\"testSquareInt\",\"x\":3,}",
+      "{\"@type\":\"testSquareInt\",\"x\":3} trailing",
+      "{\"@type\":\"testSquareInt\",\"x\":3}{}",
+      "{\"@type\":\"testSquareInt\" \"x\":3}",
+      "{\"@type\":\"testSquareInt\",\"x\":\"abc\"}",
+      "{\"@type\":\"testSquareInt\",\"x\":3000000000}",
+      "{\"@type\":\"testSquareInt\",\"x\":3.5}",
+      "{\"@type\":\"testSquareInt\",\"x\":[3]}",
+      "{\"x\":3}",
+      "{\"@type\":5,\"x\":3}",
+      "{\"@type\":\"unknownMethod\"}",
+      "{\"@type\":\"testInt\",\"value\":1}",
+      "{\"@type\":\"testCallVectorIntObject\",\"x\":[{\"@type\":\"testString\",\"value\":\"a\"}]}",
+      "{\"@type\":\"testCallString\",\"x\":\"\\ud800\"}",
+      "{\"@type\":\"testCallString\",\"x\":\"\\x\"}",
+      "{\"@type\":\"testCallString\",\"x\":\"\xff\"}",
+      "{\"@type\":\"testSquareInt\",\"x\":3,\"@extra\":}",
+  };
+
+  for (auto &request : requests) {
+    td::string expected_extra;
+    auto r_expected = parse_json_request(request, false, expected_extra);
+    td::string received_extra;
+    auto r_received = parse_json_request(request, true, received_extra);
+    LOG_CHECK(r_expected.is_ok() == r_received.is_ok())
+        << request << ' ' << (r_expected.is_ok() ? td::Slice("OK") : r_expected.error().message()) << ' '
+        << (r_received.is_ok() ? td::Slice("OK") : r_received.error().message());
+    if (r_expected.is_ok()) {
+      ASSERT_EQ(to_string(r_expected.ok()), to_string(r_received.ok()));
+      ASSERT_EQ(expected_extra, received_extra);
+    } else {
+      // the error must be returned exactly as with JsonValue
+      auto response = td::string(td::json_execute(request));
+      auto expected_message = td::json_encode<td::string>(td::JsonString(r_expected.error().message()));
+      LOG_CHECK(response.find(PSTRING() << "\"@type\":\"error\",\"code\":400,\"message\":" << expected_message) !=
+                td::string::npos)
+          << request << ' ' << response;
+      if (!expected_extra.empty()) {
+        ASSERT_TRUE(response.find(PSTRING() << ",\"@extra\":" << expected_extra) != td::string::npos);
+      }
+    }
+  }
+}
+
 TEST(Client, ManagerCloseOneThread) {
   td::ClientManager client_manager;
 
@@ -1190,3 +1481,28 @@ TEST(PartsManager, hands) {
     pm.init(1, 100000, true, 10, {0, 1, 2}, false, true).ensure_error();
   }
 }
+
+TEST(PartsManager, reader_offsets) {
+  td::PartsManager pm;
+  pm.init(10 << 20, 10 << 20, true, 1 << 20, {}, false, false).ensure();
+  pm.set_reader_offsets({(7 << 20) + 1, 2 << 20}, 2 << 20);
+
+  auto start_part = [&] {
+    auto part = pm.start_part().move_as_ok();
+    pm.on_part_ok(part.id, part.size, part.size).ensure();
+    return part.id;
+  };
+  ASSERT_EQ(2, start_part());
+  ASSERT_EQ(7, start_part());
+  ASSERT_EQ(8, start_part());
+  ASSERT_EQ(3, start_part());
+  ASSERT_EQ(9, start_part());
+  // read-ahead windows are filled, so the rest of the file is downloaded from the beginning
+  ASSERT_EQ(0, start_part());
+  ASSERT_EQ(1, start_part());
+  ASSERT_EQ(4, start_part());
+  ASSERT_EQ(5, start_part());
+  ASSERT_EQ(6, start_part());
+  ASSERT_EQ(-1, pm.start_part().ok().id);
+  ASSERT_TRUE(pm.ready());
+}
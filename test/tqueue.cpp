@@ -20,6 +20,7 @@
 #include "td/utils/tests.h"
 #include "td/utils/Time.h"
 
+#include <map>
 #include <memory>
 #include <utility>
 
@@ -258,3 +259,97 @@ TEST(TQueue, clear) {
   CHECK(tqueue->get_tail(1) == tail_id);
   CHECK(deleted_events.size() == 100000 - keep_count);
 }
+
+TEST(TQueue, forget) {
+  auto tqueue = td::TQueue::create();
+  td::Random::Xorshift128plus rnd(123);
+  td::TQueue::Event events[100];
+
+  td::int32 now = 0;
+  std::map<td::int32, td::string> expected;
+  for (int i = 0; i < 100000; i++) {
+    if (expected.empty() || rnd.fast(0, 2) != 0) {
+      auto data = PSTRING() << i;
+      auto event_id = tqueue->push(1, data, now + 600000, 0, {}).move_as_ok();
+      expected[event_id.value()] = data;
+    } else {
+      // forget an event from the middle of the queue
+      auto it = expected.lower_bound(rnd.fast(expected.begin()->first, expected.rbegin()->first));
+      tqueue->forget(1, td::TQueue::EventId::from_int32(it->first).move_as_ok());
+      expected.erase(it);
+    }
+    if (i % 100 == 0) {
+      auto from_id = rnd.fast(expected.begin()->first, expected.rbegin()->first);
+      auto events_span = td::MutableSpan<td::TQueue::Event>(events, 100);
+      auto size =
+          tqueue->get(1, td::TQueue::EventId::from_int32(from_id).move_as_ok(), false, now, events_span).move_as_ok();
+      ASSERT_EQ(expected.size(), size);
+      auto it = expected.lower_bound(from_id);
+      for (auto &event : events_span) {
+        ASSERT_TRUE(it != expected.end());
+        ASSERT_EQ(it->first, event.id.value());
+        ASSERT_EQ(it->second, event.data);
+        ++it;
+      }
+      ASSERT_TRUE(events_span.size() == 100 || it == expected.end());
+    }
+  }
+}
+
+TEST(TQueue, gc) {
+  auto tqueue = td::TQueue::create();
+  auto tqueue_binlog = td::make_unique<td::TQueueBinlog<td::Binlog>>();
+  auto tqueue_binlog_ptr = tqueue_binlog.get();
+  td::CSlice binlog_path("test_tqueue_gc.binlog");
+  td::Binlog::destroy(binlog_path).ensure();
+  auto binlog = std::make_shared<td::Binlog>();
+  binlog->init(binlog_path.str(), [&](const td::BinlogEvent &event) { UNREACHABLE(); }).ensure();
+  tqueue_binlog->set_binlog(std::move(binlog));
+  tqueue->set_callback(std::move(tqueue_binlog));
+
+  td::Random::Xorshift128plus rnd(123);
+  td::int32 now = 1000;
+  std::map<td::int64, std::map<td::int32, td::int32>> expected;
+  td::int64 total_deleted_event_count = 0;
+  for (int i = 0; i < 100000; i++) {
+    td::int64 queue_id = rnd.fast(1, 100);
+    auto &queue = expected[queue_id];
+    if (queue.empty() || rnd.fast(0, 4) != 0) {
+      auto expires_at = now + rnd.fast(1, 1000);
+      auto event_id = tqueue->push(queue_id, "data", expires_at, 0, {}).move_as_ok();
+      queue[event_id.value()] = expires_at;
+    } else {
+      auto it = queue.lower_bound(rnd.fast(queue.begin()->first, queue.rbegin()->first));
+      tqueue->forget(queue_id, td::TQueue::EventId::from_int32(it->first).move_as_ok());
+      queue.erase(it);
+    }
+
+    if (i % 1000 == 0) {
+      now += rnd.fast(0, 50);
+      while (true) {
+        auto result = tqueue->run_gc(now);
+        total_deleted_event_count += result.first;
+        if (result.second) {
+          break;
+        }
+      }
+      for (auto &it : expected) {
+        auto &events = it.second;
+        for (auto event_it = events.begin(); event_it != events.end();) {
+          if (event_it->second < now) {
+            event_it = events.erase(event_it);
+          } else {
+            ++event_it;
+          }
+        }
+        ASSERT_EQ(events.size(), tqueue->get_size(it.first));
+      }
+    }
+  }
+  ASSERT_TRUE(total_deleted_event_count > 0);
+  ASSERT_EQ(total_deleted_event_count, tqueue_binlog_ptr->get_gc_deleted_event_count());
+  ASSERT_EQ(total_deleted_event_count * 4, tqueue_binlog_ptr->get_gc_deleted_data_size());
+
+  tqueue->close(td::Promise<>());
+  td::Binlog::destroy(binlog_path).ensure();
+}